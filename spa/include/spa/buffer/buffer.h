@@ -69,6 +69,13 @@ struct spa_chunk {
 	int32_t stride;			/**< stride of valid data */
 };
 
+/** The data pointer and maxsize of the data can be changed by the node
+ * that consumes or produces the buffer, for example to let the producer
+ * write directly into the memory of a device. Users of the buffer must
+ * use the data pointer and maxsize at the time they process the buffer and
+ * must not keep them. */
+#define SPA_DATA_FLAG_DYNAMIC	(1 << 0)
+
 /** Data for a buffer */
 struct spa_data {
 	uint32_t type;			/**< memory type */
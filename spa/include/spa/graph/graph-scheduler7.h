@@ -0,0 +1,735 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_GRAPH_SCHEDULER_H__
+#define __SPA_GRAPH_SCHEDULER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+
+#include <spa/graph/graph.h>
+
+/* This scheduler has the same semantics as scheduler6 but it does not
+ * recurse over the graph. When the topology changed, the graph is compiled
+ * into an array of nodes in topological order, with the linked ports of each
+ * node in a flat array next to it. A cycle then marks the nodes that need to
+ * pull or push and walks the array, upstream for pulls and downstream for
+ * pushes, until nothing is pending.
+ *
+ * With workers, the push walk of a graph that has independent branches is
+ * done by several threads. Like the activation counters of jack, the input
+ * ready counter of a node is incremented atomically by its upstream nodes and
+ * the one that makes it reach the required count queues the node. A thread
+ * continues with the first node it queued and leaves the others to idle
+ * threads. The thread that started the walk waits until all queued nodes are
+ * processed and all workers left before it continues. Pulls are always done
+ * by that thread. */
+
+#define SPA_GRAPH_PLAN_PULL	(1 << 0)
+#define SPA_GRAPH_PLAN_PUSH	(1 << 1)
+
+struct spa_graph_plan_port {
+	struct spa_graph_port *port;
+	struct spa_graph_port *peer;
+};
+
+struct spa_graph_plan_node {
+	struct spa_graph_node *node;
+	uint32_t ports[2];		/**< offset of the input and output ports */
+	uint32_t n_ports[2];		/**< number of linked input and output ports */
+	uint32_t pending;		/**< SPA_GRAPH_PLAN_PULL and SPA_GRAPH_PLAN_PUSH */
+};
+
+/** Threads that help with the push walk */
+struct spa_graph_workers {
+#define SPA_VERSION_GRAPH_WORKERS	0
+	uint32_t version;
+
+	/** make \a n_workers threads call spa_graph_plan_work() */
+	void (*wakeup) (void *data, uint32_t n_workers);
+};
+
+struct spa_graph_data {
+	struct spa_graph *graph;
+	uint32_t version;		/**< graph version of the plan */
+	uint32_t n_pending;
+	bool running;
+	bool parallel;			/**< the plan has independent branches */
+	bool freewheel;			/**< cycles are run with spa_graph_plan_freewheel() */
+
+	const struct spa_graph_workers *workers;
+	void *workers_data;
+	uint32_t n_workers;
+
+	/* nodes that are ready to be processed in the parallel push walk */
+	struct spa_graph_node **queue;
+	uint32_t max_queue;
+	uint32_t q_head;
+	uint32_t q_tail;
+	int32_t n_queued;		/**< queued nodes that are not finished */
+	int32_t active;			/**< workers can take nodes */
+	int32_t n_busy;			/**< workers in spa_graph_plan_work() */
+
+	struct spa_graph_plan_node *nodes;
+	uint32_t n_nodes;
+	uint32_t max_nodes;
+
+	struct spa_graph_plan_port *ports;
+	uint32_t n_ports;
+	uint32_t max_ports;
+};
+
+static inline void spa_graph_data_init(struct spa_graph_data *data,
+				       struct spa_graph *graph)
+{
+	data->graph = graph;
+	data->version = SPA_ID_INVALID;
+	data->n_pending = 0;
+	data->running = false;
+	data->nodes = NULL;
+	data->n_nodes = data->max_nodes = 0;
+	data->ports = NULL;
+	data->n_ports = data->max_ports = 0;
+	data->parallel = false;
+	data->freewheel = false;
+	data->workers = NULL;
+	data->workers_data = NULL;
+	data->n_workers = 0;
+	data->queue = NULL;
+	data->max_queue = 0;
+	data->q_head = data->q_tail = 0;
+	data->n_queued = data->active = data->n_busy = 0;
+}
+
+static inline void spa_graph_data_clear(struct spa_graph_data *data)
+{
+	free(data->nodes);
+	free(data->ports);
+	free(data->queue);
+	spa_graph_data_init(data, data->graph);
+}
+
+/** Use \a n_workers threads to help with the push walk, must not be called
+ * while the graph is running */
+static inline void spa_graph_data_set_workers(struct spa_graph_data *data,
+					      const struct spa_graph_workers *workers,
+					      void *workers_data, uint32_t n_workers)
+{
+	data->workers = workers;
+	data->workers_data = workers_data;
+	data->n_workers = workers ? n_workers : 0;
+}
+
+/** In freewheel mode, the graph no longer follows the need_input and
+ * have_output requests of the nodes, a cycle is only started with
+ * spa_graph_plan_freewheel() */
+static inline void spa_graph_data_set_freewheel(struct spa_graph_data *data, bool freewheel)
+{
+	data->freewheel = freewheel;
+}
+
+static inline bool spa_graph_plan_has_node(struct spa_graph_data *data,
+					   struct spa_graph_node *node)
+{
+	return node->graph == data->graph &&
+	       node->order < data->n_nodes &&
+	       data->nodes[node->order].node == node;
+}
+
+static inline bool spa_graph_plan_grow(void **array, uint32_t *max, uint32_t n, size_t size)
+{
+	void *a;
+	uint32_t m;
+
+	if (n <= *max)
+		return true;
+
+	m = SPA_MAX(n, *max * 2);
+	if ((a = realloc(*array, m * size)) == NULL)
+		return false;
+	*array = a;
+	*max = m;
+	return true;
+}
+
+/* Kahn's algorithm, the node order of the graph is kept among nodes that
+ * don't depend on each other. Nodes in a cycle are appended in list order. */
+static inline int spa_graph_plan_compile(struct spa_graph_data *data)
+{
+	struct spa_graph *graph = data->graph;
+	struct spa_graph_node *n;
+	struct spa_graph_port *p;
+	uint32_t i, d, n_nodes = 0, n_ports = 0, head, tail;
+
+	spa_list_for_each(n, &graph->nodes, link) {
+		n_nodes++;
+		for (d = 0; d < 2; d++) {
+			spa_list_for_each(p, &n->ports[d], link)
+				n_ports++;
+		}
+	}
+	/* a node is queued at most once for each walk, where it is either
+	 * processed or started the walk */
+	if (!spa_graph_plan_grow((void **) &data->nodes, &data->max_nodes,
+				 n_nodes, sizeof(struct spa_graph_plan_node)) ||
+	    !spa_graph_plan_grow((void **) &data->ports, &data->max_ports,
+				 n_ports, sizeof(struct spa_graph_plan_port)) ||
+	    !spa_graph_plan_grow((void **) &data->queue, &data->max_queue,
+				 n_nodes, sizeof(struct spa_graph_node *)))
+		return -ENOMEM;
+
+	/* count the in-plan upstream peers of each node in the order field,
+	 * SPA_ID_INVALID marks a node that is placed */
+	spa_list_for_each(n, &graph->nodes, link)
+		n->order = 0;
+	spa_list_for_each(n, &graph->nodes, link) {
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+			if (p->peer && p->peer->node && p->peer->node->graph == graph &&
+			    p->peer->node != n)
+				n->order++;
+		}
+	}
+
+	head = tail = 0;
+	while (tail < n_nodes) {
+		if (head == tail) {
+			/* nothing is ready, take the first node with the least
+			 * dependencies, this only happens with cycles */
+			struct spa_graph_node *best = NULL;
+
+			spa_list_for_each(n, &graph->nodes, link) {
+				if (n->order != SPA_ID_INVALID &&
+				    (best == NULL || n->order < best->order))
+					best = n;
+			}
+			if (best->order != 0)
+				spa_debug("graph %p: node %p in a cycle", graph, best);
+			best->order = SPA_ID_INVALID;
+			data->nodes[tail++].node = best;
+
+			/* all nodes without dependencies, in list order */
+			spa_list_for_each(n, &graph->nodes, link) {
+				if (n->order == 0) {
+					n->order = SPA_ID_INVALID;
+					data->nodes[tail++].node = n;
+				}
+			}
+		}
+		n = data->nodes[head++].node;
+
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
+			struct spa_graph_node *pn;
+
+			if (p->peer == NULL || (pn = p->peer->node) == NULL ||
+			    pn->graph != graph || pn->order == SPA_ID_INVALID)
+				continue;
+			if (--pn->order == 0) {
+				pn->order = SPA_ID_INVALID;
+				data->nodes[tail++].node = pn;
+			}
+		}
+	}
+
+	/* store the linked ports of each node next to each other */
+	n_ports = 0;
+	for (i = 0; i < n_nodes; i++) {
+		struct spa_graph_plan_node *pn = &data->nodes[i];
+
+		pn->node->order = i;
+		pn->pending = 0;
+		for (d = 0; d < 2; d++) {
+			pn->ports[d] = n_ports;
+			pn->n_ports[d] = 0;
+			spa_list_for_each(p, &pn->node->ports[d], link) {
+				if (p->peer == NULL || p->peer->node == NULL)
+					continue;
+				data->ports[n_ports].port = p;
+				data->ports[n_ports].peer = p->peer;
+				n_ports++;
+				pn->n_ports[d]++;
+			}
+		}
+	}
+
+	/* a chain can't be processed in parallel, only use the workers when a
+	 * node feeds more than one node or when there are several sources */
+	data->parallel = false;
+	for (i = 0, d = 0; i < n_nodes && !data->parallel; i++) {
+		struct spa_graph_plan_node *pn = &data->nodes[i];
+
+		if (pn->n_ports[SPA_DIRECTION_INPUT] == 0 &&
+		    pn->n_ports[SPA_DIRECTION_OUTPUT] > 0 && ++d > 1)
+			data->parallel = true;
+		if (pn->n_ports[SPA_DIRECTION_OUTPUT] > 1)
+			data->parallel = true;
+	}
+	data->n_nodes = n_nodes;
+	data->n_ports = n_ports;
+	data->n_pending = 0;
+	data->version = graph->version;
+
+	spa_debug("graph %p: compiled %d nodes %d ports", graph, n_nodes, n_ports);
+	return 0;
+}
+
+/* only called when no nodes are pending, a new plan starts without marks */
+static inline int spa_graph_plan_update(struct spa_graph_data *data)
+{
+	if (data->version == data->graph->version)
+		return 0;
+	return spa_graph_plan_compile(data);
+}
+
+static inline void spa_graph_plan_pull(struct spa_graph_data *data, struct spa_graph_node *node);
+static inline void spa_graph_plan_push(struct spa_graph_data *data, struct spa_graph_node *node);
+
+static inline void spa_graph_plan_mark(struct spa_graph_data *data,
+				       struct spa_graph_node *node, uint32_t mark)
+{
+	struct spa_graph_plan_node *pn;
+
+	if (!spa_graph_plan_has_node(data, node)) {
+		/* not part of the graph, run it now like scheduler6 does */
+		if (mark == SPA_GRAPH_PLAN_PULL)
+			spa_graph_plan_pull(data, node);
+		else
+			spa_graph_plan_push(data, node);
+		return;
+	}
+	pn = &data->nodes[node->order];
+	if (__atomic_load_n(&data->active, __ATOMIC_RELAXED)) {
+		/* workers can mark nodes at the same time */
+		if ((__atomic_fetch_or(&pn->pending, mark, __ATOMIC_SEQ_CST) & mark) == 0)
+			__atomic_add_fetch(&data->n_pending, 1, __ATOMIC_SEQ_CST);
+	}
+	else if ((pn->pending & mark) == 0) {
+		pn->pending |= mark;
+		data->n_pending++;
+	}
+}
+
+/* in freewheel, a sink that asks for more input after it consumed its
+ * buffer is pulled again in the next cycle, not in this one */
+static inline bool spa_graph_plan_is_freewheel_sink(struct spa_graph_data *data,
+						    struct spa_graph_node *node)
+{
+	return data->freewheel && spa_graph_plan_has_node(data, node) &&
+		data->nodes[node->order].n_ports[SPA_DIRECTION_OUTPUT] == 0;
+}
+
+static inline void
+spa_graph_plan_pull_ports(struct spa_graph_data *data, struct spa_graph_node *node,
+			  struct spa_graph_port *p, struct spa_graph_port *pport)
+{
+	struct spa_graph_node *pnode = pport->node;
+	uint32_t prequired, pready;
+
+	if (pport->io->status == SPA_STATUS_NEED_BUFFER) {
+		pnode->ready[SPA_DIRECTION_OUTPUT]++;
+		node->required[SPA_DIRECTION_INPUT]++;
+	}
+
+	pready = pnode->ready[SPA_DIRECTION_OUTPUT];
+	prequired = pnode->required[SPA_DIRECTION_OUTPUT];
+
+	spa_debug("node %p peer %p io %d %d %d %d", node, pnode, pport->io->status,
+			pport->io->buffer_id, pready, prequired);
+
+	if (prequired > 0 && pready >= prequired) {
+		pnode->state = spa_graph_node_process_output(pnode);
+
+		spa_debug("peer %p processed out %d", pnode, pnode->state);
+		if (pnode->state == SPA_STATUS_NEED_BUFFER)
+			spa_graph_plan_mark(data, pnode, SPA_GRAPH_PLAN_PULL);
+		else if (pnode->state == SPA_STATUS_HAVE_BUFFER)
+			spa_graph_plan_mark(data, pnode, SPA_GRAPH_PLAN_PUSH);
+	}
+}
+
+static inline void
+spa_graph_plan_push_ports(struct spa_graph_data *data, struct spa_graph_node *node,
+			  struct spa_graph_port *p, struct spa_graph_port *pport)
+{
+	struct spa_graph_node *pnode = pport->node;
+	uint32_t prequired, pready;
+
+	if (p->io->status == SPA_STATUS_HAVE_BUFFER) {
+		pnode->ready[SPA_DIRECTION_INPUT]++;
+		node->required[SPA_DIRECTION_OUTPUT]++;
+	}
+
+	pready = pnode->ready[SPA_DIRECTION_INPUT];
+	prequired = pnode->required[SPA_DIRECTION_INPUT];
+
+	spa_debug("node %p peer %p io %d %d %d", node, pnode, pport->io->status,
+			pready, prequired);
+
+	if (prequired > 0 && pready >= prequired) {
+		pnode->state = spa_graph_node_process_input(pnode);
+
+		spa_debug("node %p chain processed in %d", pnode, pnode->state);
+		if (pnode->state == SPA_STATUS_HAVE_BUFFER)
+			spa_graph_plan_mark(data, pnode, SPA_GRAPH_PLAN_PUSH);
+		else if (pnode->state == SPA_STATUS_NEED_BUFFER &&
+			 !spa_graph_plan_is_freewheel_sink(data, pnode))
+			spa_graph_plan_mark(data, pnode, SPA_GRAPH_PLAN_PULL);
+	}
+}
+
+static inline void spa_graph_plan_pull(struct spa_graph_data *data, struct spa_graph_node *node)
+{
+	spa_debug("node %p start pull", node);
+
+	node->ready[SPA_DIRECTION_INPUT] = 0;
+	node->required[SPA_DIRECTION_INPUT] = 0;
+
+	if (spa_graph_plan_has_node(data, node)) {
+		struct spa_graph_plan_node *pn = &data->nodes[node->order];
+		struct spa_graph_plan_port *pp = &data->ports[pn->ports[SPA_DIRECTION_INPUT]];
+		uint32_t i;
+
+		for (i = 0; i < pn->n_ports[SPA_DIRECTION_INPUT]; i++, pp++)
+			spa_graph_plan_pull_ports(data, node, pp->port, pp->peer);
+	}
+	else {
+		struct spa_graph_port *p;
+
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+			if (p->peer)
+				spa_graph_plan_pull_ports(data, node, p, p->peer);
+		}
+	}
+}
+
+static inline void spa_graph_plan_push(struct spa_graph_data *data, struct spa_graph_node *node)
+{
+	spa_debug("node %p start push", node);
+
+	node->ready[SPA_DIRECTION_OUTPUT] = 0;
+	node->required[SPA_DIRECTION_OUTPUT] = 0;
+
+	if (spa_graph_plan_has_node(data, node)) {
+		struct spa_graph_plan_node *pn = &data->nodes[node->order];
+		struct spa_graph_plan_port *pp = &data->ports[pn->ports[SPA_DIRECTION_OUTPUT]];
+		uint32_t i;
+
+		for (i = 0; i < pn->n_ports[SPA_DIRECTION_OUTPUT]; i++, pp++)
+			spa_graph_plan_push_ports(data, node, pp->port, pp->peer);
+	}
+	else {
+		struct spa_graph_port *p;
+
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+			if (p->peer)
+				spa_graph_plan_push_ports(data, node, p, p->peer);
+		}
+	}
+}
+
+static inline void spa_graph_plan_queue(struct spa_graph_data *data,
+					struct spa_graph_node *node)
+{
+	uint32_t idx;
+
+	__atomic_add_fetch(&data->n_queued, 1, __ATOMIC_SEQ_CST);
+	idx = __atomic_fetch_add(&data->q_tail, 1, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&data->queue[idx], node, __ATOMIC_RELEASE);
+}
+
+static inline struct spa_graph_node *spa_graph_plan_dequeue(struct spa_graph_data *data)
+{
+	struct spa_graph_node *node;
+	uint32_t head;
+
+	head = __atomic_load_n(&data->q_head, __ATOMIC_SEQ_CST);
+	while (head < __atomic_load_n(&data->q_tail, __ATOMIC_SEQ_CST)) {
+		/* the slot is taken but the node might not be stored yet */
+		if ((node = __atomic_load_n(&data->queue[head], __ATOMIC_ACQUIRE)) == NULL)
+			return NULL;
+		if (__atomic_compare_exchange_n(&data->q_head, &head, head + 1, false,
+						__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			return node;
+	}
+	return NULL;
+}
+
+/* the push step of the parallel walk, the peers that become ready are queued
+ * except for the first one, which is returned so that the caller can
+ * continue with it */
+static inline struct spa_graph_node *
+spa_graph_plan_push_parallel(struct spa_graph_data *data, struct spa_graph_node *node)
+{
+	struct spa_graph_plan_node *pn = &data->nodes[node->order];
+	struct spa_graph_plan_port *pp = &data->ports[pn->ports[SPA_DIRECTION_OUTPUT]];
+	struct spa_graph_node *next = NULL;
+	uint32_t i;
+
+	spa_debug("node %p start parallel push", node);
+
+	node->ready[SPA_DIRECTION_OUTPUT] = 0;
+	node->required[SPA_DIRECTION_OUTPUT] = 0;
+
+	for (i = 0; i < pn->n_ports[SPA_DIRECTION_OUTPUT]; i++, pp++) {
+		struct spa_graph_node *pnode = pp->peer->node;
+		uint32_t pready, prequired;
+
+		if (!spa_graph_plan_has_node(data, pnode)) {
+			spa_graph_plan_push_ports(data, node, pp->port, pp->peer);
+			continue;
+		}
+		if (pp->port->io->status != SPA_STATUS_HAVE_BUFFER)
+			continue;
+
+		node->required[SPA_DIRECTION_OUTPUT]++;
+		pready = __atomic_add_fetch(&pnode->ready[SPA_DIRECTION_INPUT], 1, __ATOMIC_SEQ_CST);
+		prequired = pnode->required[SPA_DIRECTION_INPUT];
+
+		spa_debug("node %p peer %p ready %d %d", node, pnode, pready, prequired);
+
+		/* only the last upstream node queues the peer */
+		if (prequired > 0 && pready == prequired) {
+			if (next == NULL) {
+				__atomic_add_fetch(&data->n_queued, 1, __ATOMIC_SEQ_CST);
+				next = pnode;
+			}
+			else
+				spa_graph_plan_queue(data, pnode);
+		}
+	}
+	return next;
+}
+
+static inline void spa_graph_plan_process(struct spa_graph_data *data,
+					  struct spa_graph_node *node)
+{
+	while (node) {
+		struct spa_graph_node *next = NULL;
+
+		node->state = spa_graph_node_process_input(node);
+
+		spa_debug("node %p parallel processed in %d", node, node->state);
+		if (node->state == SPA_STATUS_HAVE_BUFFER)
+			next = spa_graph_plan_push_parallel(data, node);
+		else if (node->state == SPA_STATUS_NEED_BUFFER &&
+			 !spa_graph_plan_is_freewheel_sink(data, node))
+			spa_graph_plan_mark(data, node, SPA_GRAPH_PLAN_PULL);
+
+		__atomic_sub_fetch(&data->n_queued, 1, __ATOMIC_SEQ_CST);
+		node = next;
+	}
+}
+
+#define SPA_GRAPH_PLAN_MAX_SPINS	256
+
+/** Wait a little for another thread. The first \ref SPA_GRAPH_PLAN_MAX_SPINS
+ * calls only pause the cpu, after that the cpu is given to other threads so
+ * that a waiting thread never keeps a core from the thread it waits for. */
+static inline void spa_graph_plan_relax(uint32_t *spins)
+{
+	if (*spins < SPA_GRAPH_PLAN_MAX_SPINS) {
+		(*spins)++;
+#if defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	} else
+		sched_yield();
+}
+
+/** Process queued nodes until the push walk is complete, called from the
+ * worker threads after a wakeup */
+static inline void spa_graph_plan_work(struct spa_graph_data *data)
+{
+	struct spa_graph_node *node;
+	uint32_t spins = 0;
+
+	__atomic_add_fetch(&data->n_busy, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&data->active, __ATOMIC_SEQ_CST)) {
+		while (__atomic_load_n(&data->n_queued, __ATOMIC_SEQ_CST) > 0) {
+			if ((node = spa_graph_plan_dequeue(data)) != NULL) {
+				spa_graph_plan_process(data, node);
+				spins = 0;
+			} else
+				spa_graph_plan_relax(&spins);
+		}
+	}
+	__atomic_sub_fetch(&data->n_busy, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void spa_graph_plan_run_parallel(struct spa_graph_data *data)
+{
+	struct spa_graph_node *node;
+	uint32_t i, spins = 0;
+
+	data->q_head = data->q_tail = 0;
+	data->n_queued = 0;
+	for (i = 0; i < data->n_nodes; i++)
+		data->queue[i] = NULL;
+
+	/* the nodes that were pushed start the walk from here */
+	for (i = 0; i < data->n_nodes; i++) {
+		struct spa_graph_plan_node *pn = &data->nodes[i];
+
+		if (pn->pending & SPA_GRAPH_PLAN_PUSH) {
+			pn->pending &= ~SPA_GRAPH_PLAN_PUSH;
+			data->n_pending--;
+			if ((node = spa_graph_plan_push_parallel(data, pn->node)) != NULL) {
+				__atomic_sub_fetch(&data->n_queued, 1, __ATOMIC_SEQ_CST);
+				spa_graph_plan_queue(data, node);
+			}
+		}
+	}
+	if (data->n_queued == 0)
+		return;
+
+	__atomic_store_n(&data->active, 1, __ATOMIC_SEQ_CST);
+	data->workers->wakeup(data->workers_data, data->n_workers);
+
+	spa_graph_plan_work(data);
+
+	/* join, no worker can touch the plan after this */
+	__atomic_store_n(&data->active, 0, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&data->n_busy, __ATOMIC_SEQ_CST) > 0)
+		spa_graph_plan_relax(&spins);
+}
+
+/* run the pending nodes, pulls go upstream so they walk the plan backwards,
+ * pushes go downstream and walk it forwards */
+static inline void spa_graph_plan_run(struct spa_graph_data *data)
+{
+	uint32_t i;
+
+	if (data->running)
+		return;
+	data->running = true;
+
+	while (data->n_pending > 0) {
+		for (i = data->n_nodes; i > 0; i--) {
+			struct spa_graph_plan_node *pn = &data->nodes[i - 1];
+
+			if (pn->pending & SPA_GRAPH_PLAN_PULL) {
+				pn->pending &= ~SPA_GRAPH_PLAN_PULL;
+				data->n_pending--;
+				spa_graph_plan_pull(data, pn->node);
+			}
+		}
+		if (data->parallel && data->n_workers > 0) {
+			spa_graph_plan_run_parallel(data);
+			continue;
+		}
+		for (i = 0; i < data->n_nodes; i++) {
+			struct spa_graph_plan_node *pn = &data->nodes[i];
+
+			if (pn->pending & SPA_GRAPH_PLAN_PUSH) {
+				pn->pending &= ~SPA_GRAPH_PLAN_PUSH;
+				data->n_pending--;
+				spa_graph_plan_push(data, pn->node);
+			}
+		}
+	}
+	data->running = false;
+}
+
+/** Run one freewheel cycle, all the sinks of the plan pull at the same time
+ * and the cycle completes before this function returns unless nodes are
+ * asynchronous. Returns the number of sinks that pulled, 0 when the plan
+ * has no sinks and the cycle did nothing. */
+static inline int spa_graph_plan_freewheel(struct spa_graph_data *data)
+{
+	uint32_t i;
+	int res, n_sinks = 0;
+
+	if (data->running)
+		return -EBUSY;
+
+	if ((res = spa_graph_plan_update(data)) < 0)
+		return res;
+	spa_graph_start_cycle(data->graph);
+
+	for (i = 0; i < data->n_nodes; i++) {
+		struct spa_graph_plan_node *pn = &data->nodes[i];
+
+		if (pn->n_ports[SPA_DIRECTION_INPUT] > 0 &&
+		    pn->n_ports[SPA_DIRECTION_OUTPUT] == 0) {
+			spa_graph_plan_mark(data, pn->node, SPA_GRAPH_PLAN_PULL);
+			n_sinks++;
+		}
+	}
+	if (n_sinks > 0)
+		spa_graph_plan_run(data);
+
+	return n_sinks;
+}
+
+static inline int spa_graph_impl_need_input(void *data, struct spa_graph_node *node)
+{
+	struct spa_graph_data *d = data;
+	int res;
+
+	/* the freewheel driver runs the cycles, node clocks are ignored */
+	if (d->freewheel && !d->running)
+		return 0;
+
+	if (!d->running) {
+		if ((res = spa_graph_plan_update(d)) < 0)
+			return res;
+		spa_graph_start_cycle(d->graph);
+	}
+
+	spa_graph_plan_mark(d, node, SPA_GRAPH_PLAN_PULL);
+	spa_graph_plan_run(d);
+	return 0;
+}
+
+static inline int spa_graph_impl_have_output(void *data, struct spa_graph_node *node)
+{
+	struct spa_graph_data *d = data;
+	int res;
+
+	if (d->freewheel && !d->running)
+		return 0;
+
+	if (!d->running) {
+		if ((res = spa_graph_plan_update(d)) < 0)
+			return res;
+		spa_graph_start_cycle(d->graph);
+	}
+
+	spa_graph_plan_mark(d, node, SPA_GRAPH_PLAN_PUSH);
+	spa_graph_plan_run(d);
+	return 0;
+}
+
+static const struct spa_graph_callbacks spa_graph_impl_default = {
+	SPA_VERSION_GRAPH_CALLBACKS,
+	.need_input = spa_graph_impl_need_input,
+	.have_output = spa_graph_impl_have_output,
+};
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_GRAPH_SCHEDULER_H__ */
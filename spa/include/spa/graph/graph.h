@@ -24,6 +24,8 @@
 extern "C" {
 #endif
 
+#include <time.h>
+
 #include <spa/utils/defs.h>
 #include <spa/utils/list.h>
 #include <spa/node/node.h>
@@ -45,6 +47,9 @@ struct spa_graph_callbacks {
 };
 
 struct spa_graph {
+	uint32_t version;		/**< incremented on each topology change */
+	uint64_t cycle_start;		/**< start time of the current cycle */
+	uint64_t cycle_period;		/**< time between the last two cycles */
 	struct spa_list nodes;
 	const struct spa_graph_callbacks *callbacks;
 	void *callbacks_data;
@@ -54,6 +59,24 @@ struct spa_graph {
 #define spa_graph_have_output(g,n)	((g)->callbacks->have_output((g)->callbacks_data, (n)))
 #define spa_graph_reuse_buffer(g,n,p,i)	((g)->callbacks->reuse_buffer((g)->callbacks_data, (n),(p),(i)))
 
+/** Processing statistics of a node.
+ *
+ * The counters are written from the data thread only, readers copy them
+ * when seq is even and did not change during the copy. */
+struct spa_graph_node_profile {
+	uint32_t seq;			/**< odd while the counters are updated */
+	uint32_t padding;
+	uint64_t cycles;		/**< number of cycles the node was processed in */
+	uint64_t last_ns;		/**< processing time in the last cycle */
+	uint64_t avg_ns;		/**< running average of the completed cycles */
+	uint64_t max_ns;		/**< longest processing time in a cycle */
+	uint64_t wakeup_ns;		/**< delay from the start of the cycle to the processing */
+	uint64_t xruns;			/**< cycles where the processing ended after the
+					  *  cycle period */
+	uint64_t cycle;			/**< start of the last cycle */
+	uint64_t xrun_cycle;		/**< start of the last cycle with an xrun */
+};
+
 struct spa_graph_node {
 	struct spa_list link;		/**< link in graph nodes list */
 	struct spa_graph *graph;	/**< owner graph */
@@ -66,6 +89,8 @@ struct spa_graph_node {
 	int state;			/**< state of the node */
 	struct spa_node *implementation;/**< node implementation */
 	void *scheduler_data;		/**< scheduler private data */
+	uint32_t order;			/**< position in the compiled plan */
+	struct spa_graph_node_profile *profile;	/**< statistics or NULL */
 };
 
 struct spa_graph_port {
@@ -81,9 +106,36 @@ struct spa_graph_port {
 
 static inline void spa_graph_init(struct spa_graph *graph)
 {
+	graph->version = 0;
+	graph->cycle_start = 0;
+	graph->cycle_period = 0;
 	spa_list_init(&graph->nodes);
 }
 
+static inline uint64_t spa_graph_get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/* called by the scheduler when a cycle starts */
+static inline void spa_graph_start_cycle(struct spa_graph *graph)
+{
+	uint64_t now = spa_graph_get_time();
+
+	if (graph->cycle_start != 0)
+		graph->cycle_period = now - graph->cycle_start;
+	graph->cycle_start = now;
+}
+
+/* let schedulers that cache the topology know that it changed */
+static inline void spa_graph_node_changed(struct spa_graph_node *node)
+{
+	if (node && node->graph)
+		node->graph->version++;
+}
+
 static inline void
 spa_graph_set_callbacks(struct spa_graph *graph,
 			const struct spa_graph_callbacks *callbacks,
@@ -98,6 +150,8 @@ spa_graph_node_init(struct spa_graph_node *node)
 {
 	spa_list_init(&node->ports[SPA_DIRECTION_INPUT]);
 	spa_list_init(&node->ports[SPA_DIRECTION_OUTPUT]);
+	node->graph = NULL;
+	node->profile = NULL;
 	node->flags = 0;
 	node->required[SPA_DIRECTION_INPUT] = node->ready[SPA_DIRECTION_INPUT] = 0;
 	node->required[SPA_DIRECTION_OUTPUT] = node->ready[SPA_DIRECTION_OUTPUT] = 0;
@@ -111,6 +165,97 @@ spa_graph_node_set_implementation(struct spa_graph_node *node,
 	node->implementation = implementation;
 }
 
+static inline void
+spa_graph_node_set_profile(struct spa_graph_node *node,
+			   struct spa_graph_node_profile *profile)
+{
+	node->profile = profile;
+}
+
+/* a node can be processed more than once in a cycle, in both directions,
+ * the time is added up per cycle. Without cycles, as with the schedulers
+ * that don't start them, each processing counts as a cycle. */
+static inline void
+spa_graph_node_update_profile(struct spa_graph_node *node, uint64_t start, uint64_t end)
+{
+	struct spa_graph_node_profile *p = node->profile;
+	struct spa_graph *graph = node->graph;
+	uint64_t duration = end - start, cycle_start;
+
+	cycle_start = graph && start >= graph->cycle_start ? graph->cycle_start : 0;
+
+	__atomic_store_n(&p->seq, p->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	if (cycle_start == 0 || cycle_start != p->cycle) {
+		/* average over about 32 cycles */
+		if (p->cycles > 0)
+			p->avg_ns = p->cycles == 1 ? p->last_ns :
+				p->avg_ns - (p->avg_ns >> 5) + (p->last_ns >> 5);
+		p->cycles++;
+		p->cycle = cycle_start;
+		p->last_ns = duration;
+		p->wakeup_ns = cycle_start ? start - cycle_start : 0;
+	}
+	else
+		p->last_ns += duration;
+
+	if (p->last_ns > p->max_ns)
+		p->max_ns = p->last_ns;
+	if (cycle_start && graph->cycle_period &&
+	    end - cycle_start > graph->cycle_period &&
+	    p->xrun_cycle != cycle_start) {
+		p->xrun_cycle = cycle_start;
+		p->xruns++;
+	}
+
+	__atomic_store_n(&p->seq, p->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* copy the statistics from another thread, false when they were being
+ * updated */
+static inline bool
+spa_graph_node_profile_read(const struct spa_graph_node_profile *profile,
+			    struct spa_graph_node_profile *copy)
+{
+	uint32_t seq = __atomic_load_n(&profile->seq, __ATOMIC_ACQUIRE);
+
+	if (seq & 1)
+		return false;
+	*copy = *profile;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&profile->seq, __ATOMIC_RELAXED) == seq;
+}
+
+/* process the node implementation and update the statistics */
+static inline int spa_graph_node_process_input(struct spa_graph_node *node)
+{
+	uint64_t start;
+	int res;
+
+	if (node->profile == NULL)
+		return spa_node_process_input(node->implementation);
+
+	start = spa_graph_get_time();
+	res = spa_node_process_input(node->implementation);
+	spa_graph_node_update_profile(node, start, spa_graph_get_time());
+	return res;
+}
+
+static inline int spa_graph_node_process_output(struct spa_graph_node *node)
+{
+	uint64_t start;
+	int res;
+
+	if (node->profile == NULL)
+		return spa_node_process_output(node->implementation);
+
+	start = spa_graph_get_time();
+	res = spa_node_process_output(node->implementation);
+	spa_graph_node_update_profile(node, start, spa_graph_get_time());
+	return res;
+}
+
 static inline void
 spa_graph_node_add(struct spa_graph *graph,
 		   struct spa_graph_node *node)
@@ -119,6 +264,7 @@ spa_graph_node_add(struct spa_graph *graph,
 	node->state = SPA_STATUS_OK;
 	node->ready_link.next = NULL;
 	spa_list_append(&graph->nodes, &node->link);
+	graph->version++;
 	spa_debug("node %p add", node);
 }
 
@@ -130,6 +276,8 @@ spa_graph_port_init(struct spa_graph_port *port,
 		    struct spa_port_io *io)
 {
 	spa_debug("port %p init type %d id %d", port, direction, port_id);
+	port->node = NULL;
+	port->peer = NULL;
 	port->direction = direction;
 	port->port_id = port_id;
 	port->flags = flags;
@@ -145,11 +293,13 @@ spa_graph_port_add(struct spa_graph_node *node,
 	spa_list_append(&node->ports[port->direction], &port->link);
 	if (!(port->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
 		node->required[port->direction]++;
+	spa_graph_node_changed(node);
 }
 
 static inline void spa_graph_node_remove(struct spa_graph_node *node)
 {
 	spa_debug("node %p remove", node);
+	spa_graph_node_changed(node);
 	spa_list_remove(&node->link);
 	if (node->ready_link.next)
 		spa_list_remove(&node->ready_link);
@@ -161,6 +311,7 @@ static inline void spa_graph_port_remove(struct spa_graph_port *port)
 	spa_list_remove(&port->link);
 	if (!(port->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
 		port->node->required[port->direction]--;
+	spa_graph_node_changed(port->node);
 }
 
 static inline void
@@ -169,6 +320,8 @@ spa_graph_port_link(struct spa_graph_port *out, struct spa_graph_port *in)
 	spa_debug("port %p link to %p", out, in);
 	out->peer = in;
 	in->peer = out;
+	spa_graph_node_changed(out->node);
+	spa_graph_node_changed(in->node);
 }
 
 static inline void
@@ -176,6 +329,8 @@ spa_graph_port_unlink(struct spa_graph_port *port)
 {
 	spa_debug("port %p unlink from %p", port, port->peer);
 	if (port->peer) {
+		spa_graph_node_changed(port->node);
+		spa_graph_node_changed(port->peer->node);
 		port->peer->peer = NULL;
 		port->peer = NULL;
 	}
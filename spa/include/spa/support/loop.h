@@ -50,6 +50,13 @@ struct spa_source;
 
 typedef void (*spa_source_func_t) (struct spa_source *source);
 
+/** Sources that are ready at the same time are dispatched in order of
+ * priority. Use a high priority for realtime sockets and a low priority for
+ * bulk traffic */
+#define SPA_SOURCE_PRIORITY_LOW		-1
+#define SPA_SOURCE_PRIORITY_DEFAULT	0
+#define SPA_SOURCE_PRIORITY_HIGH	1
+
 struct spa_source {
 	struct spa_loop *loop;
 	spa_source_func_t func;
@@ -57,6 +64,8 @@ struct spa_source {
 	int fd;
 	enum spa_io mask;
 	enum spa_io rmask;
+	int priority;		/**< one of SPA_SOURCE_PRIORITY_*, can be changed
+				  *  at any time */
 };
 
 typedef int (*spa_invoke_func_t) (struct spa_loop *loop,
@@ -114,10 +123,22 @@ struct spa_loop_control_hooks {
 /**
  * Control an event loop
  */
+/** Counters of a loop, for tuning */
+struct spa_loop_stats {
+	uint64_t n_iterations;		/**< number of iterations */
+	uint64_t n_events;		/**< total number of dispatched events */
+	uint64_t n_full;		/**< number of times the events did not fit in a batch */
+	uint64_t dispatch_time;		/**< total time spent in callbacks in nanoseconds */
+	uint32_t last_events;		/**< events dispatched in the last iteration */
+	uint32_t max_events;		/**< max events dispatched in one iteration */
+	uint64_t last_dispatch_time;	/**< time spent in callbacks in the last iteration */
+	uint64_t max_dispatch_time;	/**< max time spent in callbacks in one iteration */
+};
+
 struct spa_loop_control {
 	/* the version of this structure. This can be used to expand this
 	 * structure in the future */
-#define SPA_VERSION_LOOP_CONTROL	0
+#define SPA_VERSION_LOOP_CONTROL	1
 	uint32_t version;
 
 	int (*get_fd) (struct spa_loop_control *ctrl);
@@ -133,7 +154,14 @@ struct spa_loop_control {
 	void (*enter) (struct spa_loop_control *ctrl);
 	void (*leave) (struct spa_loop_control *ctrl);
 
+	/** Wait for events and dispatch them.
+	 * Events that are ready at the same time are dispatched in batches of
+	 * at most the batch size of the loop without running the hooks again.
+	 * \return 0 on success, an errno on error */
 	int (*iterate) (struct spa_loop_control *ctrl, int timeout);
+
+	/** Get the counters of the loop, since version 1 */
+	const struct spa_loop_stats *(*get_stats) (struct spa_loop_control *ctrl);
 };
 
 #define spa_loop_control_get_fd(l)		(l)->get_fd(l)
@@ -141,6 +169,7 @@ struct spa_loop_control {
 #define spa_loop_control_enter(l)		(l)->enter(l)
 #define spa_loop_control_iterate(l,...)		(l)->iterate((l),__VA_ARGS__)
 #define spa_loop_control_leave(l)		(l)->leave(l)
+#define spa_loop_control_get_stats(l)		(l)->get_stats(l)
 
 
 typedef void (*spa_source_io_func_t) (void *data, int fd, enum spa_io mask);
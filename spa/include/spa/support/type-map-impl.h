@@ -24,55 +24,116 @@
 extern "C" {
 #endif
 
+#include <spa/utils/hash.h>
 #include <spa/support/type-map.h>
+#include <spa/support/type-map-static.h>
+
+/* The types are indexed in an open addressing hash table of twice the
+ * maximum number of types, the slots store the id + 1 so that 0 marks an
+ * empty slot. The static types are in the initializer, they are added to
+ * the index on the first lookup. */
+#define SPA_TYPE_MAP_IMPL_INDEX_SIZE(maxtypes)	((maxtypes) * 2)
+
+struct spa_type_map_impl {
+	struct spa_type_map map;
+	uint32_t n_types;
+	uint32_t max_types;
+	uint32_t n_indexed;
+	char *types[1];
+};
+
+#define SPA_TYPE_MAP_IMPL_INDEX(impl)	((uint32_t *) &(impl)->types[(impl)->max_types])
+
+/* index the types of the initializer */
+static inline void spa_type_map_impl_index_static(struct spa_type_map_impl *impl)
+{
+	uint32_t *index = SPA_TYPE_MAP_IMPL_INDEX(impl);
+	uint32_t size = SPA_TYPE_MAP_IMPL_INDEX_SIZE(impl->max_types);
+	uint32_t i, id;
+
+	for (id = impl->n_indexed; id < impl->n_types; id++) {
+		for (i = spa_hash_string(impl->types[id]) % size; index[i] != 0; i = (i + 1) % size);
+		index[i] = id + 1;
+	}
+	impl->n_indexed = impl->n_types;
+}
 
 static inline uint32_t
-spa_type_map_impl_get_id (struct spa_type_map *map, const char *type)
+spa_type_map_impl_add(struct spa_type_map_impl *impl, const char *type)
 {
-	struct { struct spa_type_map map; uint32_t n_types; char *types[1]; } *impl = (void*) map;
-	uint32_t i = 0;
+	uint32_t *index = SPA_TYPE_MAP_IMPL_INDEX(impl);
+	uint32_t size = SPA_TYPE_MAP_IMPL_INDEX_SIZE(impl->max_types);
+	uint32_t i, id;
 
-	for (i = 1; i <= impl->n_types; i++) {
-		if (strcmp(impl->types[i], type) == 0)
-			return i;
+	if (SPA_UNLIKELY(impl->n_indexed < impl->n_types))
+		spa_type_map_impl_index_static(impl);
+
+	for (i = spa_hash_string(type) % size; (id = index[i]) != 0; i = (i + 1) % size) {
+		if (strcmp(impl->types[id - 1], type) == 0)
+			return id - 1;
 	}
-	impl->types[i] = (char *) type;
-	impl->n_types++;
-        return i;
+	if (impl->n_types >= impl->max_types)
+		return SPA_ID_INVALID;
+
+	id = impl->n_types++;
+	impl->types[id] = (char *) type;
+	index[i] = id + 1;
+	impl->n_indexed = impl->n_types;
+
+        return id;
+}
+
+static inline uint32_t
+spa_type_map_impl_get_id (struct spa_type_map *map, const char *type)
+{
+	struct spa_type_map_impl *impl = (void*) map;
+
+	if (type == NULL)
+		return SPA_ID_INVALID;
+
+	return spa_type_map_impl_add(impl, type);
 }
 
 static inline const char *
 spa_type_map_impl_get_type (const struct spa_type_map *map, uint32_t id)
 {
-	struct { struct spa_type_map map; uint32_t n_types; char *types[1]; } *impl = (void*) map;
-        if (id <= impl->n_types)
+	const struct spa_type_map_impl *impl = (const void*) map;
+
+        if (id < impl->n_types)
                 return impl->types[id];
         return NULL;
 }
 
 static inline size_t spa_type_map_impl_get_size (const struct spa_type_map *map)
 {
-	struct { struct spa_type_map map; uint32_t n_types; char *types[1]; } *impl = (void*) map;
+	const struct spa_type_map_impl *impl = (const void*) map;
+
 	return impl->n_types;
 }
 
-#define SPA_TYPE_MAP_IMPL_DEFINE(name,maxtypes)	\
-struct  {					\
-	struct spa_type_map map;		\
-	unsigned int n_types;			\
-	char *types[maxtypes];			\
+#define SPA_TYPE_MAP_IMPL_DEFINE(name,maxtypes)				\
+struct  {								\
+	struct spa_type_map map;					\
+	uint32_t n_types;						\
+	uint32_t max_types;						\
+	uint32_t n_indexed;						\
+	char *types[maxtypes];						\
+	uint32_t index[SPA_TYPE_MAP_IMPL_INDEX_SIZE(maxtypes)];	\
 } name
 
-#define SPA_TYPE_MAP_IMPL_INIT			\
+#define __SPA_TYPE_MAP_IMPL_STATIC(type)	(char *) type,
+
+#define SPA_TYPE_MAP_IMPL_INIT(maxtypes)	\
 	{ { SPA_VERSION_TYPE_MAP,		\
 	    NULL,				\
 	    spa_type_map_impl_get_id,		\
 	    spa_type_map_impl_get_type,		\
 	    spa_type_map_impl_get_size,},	\
-	  0, { NULL, } }
+	  SPA_TYPE_STATIC_N, maxtypes, 0,	\
+	  { SPA_TYPE_STATIC_FOREACH(__SPA_TYPE_MAP_IMPL_STATIC) }, { 0, } }
 
 #define SPA_TYPE_MAP_IMPL(name,maxtypes)		\
-	SPA_TYPE_MAP_IMPL_DEFINE(name,maxtypes) = SPA_TYPE_MAP_IMPL_INIT
+	SPA_TYPE_MAP_IMPL_DEFINE(name,maxtypes) = SPA_TYPE_MAP_IMPL_INIT(maxtypes)
 
 #ifdef __cplusplus
 }  /* extern "C" */
@@ -0,0 +1,407 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __SPA_TYPE_MAP_STATIC_H__
+#define __SPA_TYPE_MAP_STATIC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/utils/type.h>
+#include <spa/utils/dict.h>
+#include <spa/utils/ringbuffer.h>
+#include <spa/support/type-map.h>
+#include <spa/support/plugin.h>
+#include <spa/support/log.h>
+#include <spa/support/loop.h>
+#include <spa/pod/pod.h>
+#include <spa/pod/event.h>
+#include <spa/pod/command.h>
+#include <spa/buffer/buffer.h>
+#include <spa/buffer/meta.h>
+#include <spa/param/param.h>
+#include <spa/param/props.h>
+#include <spa/param/format.h>
+#include <spa/param/buffers.h>
+#include <spa/param/meta.h>
+#include <spa/param/video-padding.h>
+#include <spa/param/audio/format.h>
+#include <spa/param/audio/raw.h>
+#include <spa/param/video/format.h>
+#include <spa/param/video/raw.h>
+#include <spa/node/node.h>
+#include <spa/node/event.h>
+#include <spa/node/command.h>
+#include <spa/clock/clock.h>
+#include <spa/monitor/monitor.h>
+
+/**
+ * The types of the SPA headers, in the order of their id.
+ *
+ * These types have the same id in every process, the type maps register
+ * them before any other type. Only append new types to the end of the
+ * list, the position in the list is the id of the type. Other types get
+ * a dynamic id from SPA_TYPE_STATIC_N on.
+ */
+#define SPA_TYPE_STATIC_FOREACH(F)			\
+	/* utils/type */				\
+	F(SPA_TYPE__Enum)				\
+	F(SPA_TYPE__Pointer)				\
+	F(SPA_TYPE__Interface)				\
+	F(SPA_TYPE__Object)				\
+	/* utils/dict */				\
+	F(SPA_TYPE__Dict)				\
+	/* utils/ringbuffer */				\
+	F(SPA_TYPE__RingBuffer)				\
+	/* support/type-map */				\
+	F(SPA_TYPE__TypeMap)				\
+	/* support/plugin */				\
+	F(SPA_TYPE__Handle)				\
+	F(SPA_TYPE__HandleFactory)			\
+	/* support/log */				\
+	F(SPA_TYPE__Log)				\
+	/* support/loop */				\
+	F(SPA_TYPE__Loop)				\
+	F(SPA_TYPE__LoopControl)			\
+	F(SPA_TYPE__LoopUtils)				\
+	F(SPA_TYPE_LOOP__MainLoop)			\
+	F(SPA_TYPE_LOOP__DataLoop)			\
+	/* pod/pod */					\
+	F(SPA_TYPE__POD)				\
+	F(SPA_TYPE_POD__Object)				\
+	F(SPA_TYPE_POD__Struct)				\
+	/* pod/event */					\
+	F(SPA_TYPE__Event)				\
+	/* pod/command */				\
+	F(SPA_TYPE__Command)				\
+	/* buffer/buffer */				\
+	F(SPA_TYPE__Buffer)				\
+	F(SPA_TYPE__Data)				\
+	F(SPA_TYPE_DATA__MemPtr)			\
+	F(SPA_TYPE_DATA__MemFd)				\
+	F(SPA_TYPE_DATA__DmaBuf)			\
+	F(SPA_TYPE_DATA__Id)				\
+	/* buffer/meta */				\
+	F(SPA_TYPE__Meta)				\
+	F(SPA_TYPE_META__Header)			\
+	F(SPA_TYPE_META__Pointer)			\
+	F(SPA_TYPE_META__VideoCrop)			\
+	F(SPA_TYPE_META__Ringbuffer)			\
+	F(SPA_TYPE_META__Shared)			\
+	/* param/param */				\
+	F(SPA_TYPE__Param)				\
+	F(SPA_TYPE__ParamId)				\
+	F(SPA_TYPE_PARAM_ID__List)			\
+	F(SPA_TYPE_PARAM__List)				\
+	F(SPA_TYPE_PARAM_LIST__id)			\
+	F(SPA_TYPE_PARAM_ID__Props)			\
+	F(SPA_TYPE_PARAM_ID__EnumFormat)		\
+	F(SPA_TYPE_PARAM_ID__Format)			\
+	F(SPA_TYPE_PARAM_ID__Buffers)			\
+	F(SPA_TYPE_PARAM_ID__Meta)			\
+	/* param/props */				\
+	F(SPA_TYPE__Props)				\
+	F(SPA_TYPE_PROPS__device)			\
+	F(SPA_TYPE_PROPS__deviceName)			\
+	F(SPA_TYPE_PROPS__deviceFd)			\
+	F(SPA_TYPE_PROPS__card)				\
+	F(SPA_TYPE_PROPS__cardName)			\
+	F(SPA_TYPE_PROPS__minLatency)			\
+	F(SPA_TYPE_PROPS__maxLatency)			\
+	F(SPA_TYPE_PROPS__periods)			\
+	F(SPA_TYPE_PROPS__periodSize)			\
+	F(SPA_TYPE_PROPS__periodEvent)			\
+	F(SPA_TYPE_PROPS__live)				\
+	F(SPA_TYPE_PROPS__waveType)			\
+	F(SPA_TYPE_PROPS__frequency)			\
+	F(SPA_TYPE_PROPS__volume)			\
+	F(SPA_TYPE_PROPS__mute)				\
+	F(SPA_TYPE_PROPS__channelVolumes)		\
+	F(SPA_TYPE_PROPS__rampTime)			\
+	F(SPA_TYPE_PROPS__rampType)			\
+	F(SPA_TYPE_PROPS__patternType)			\
+	/* param/format */				\
+	F(SPA_TYPE__Format)				\
+	F(SPA_TYPE__MediaType)				\
+	F(SPA_TYPE_MEDIA_TYPE__audio)			\
+	F(SPA_TYPE_MEDIA_TYPE__video)			\
+	F(SPA_TYPE_MEDIA_TYPE__image)			\
+	F(SPA_TYPE_MEDIA_TYPE__binary)			\
+	F(SPA_TYPE_MEDIA_TYPE__stream)			\
+	F(SPA_TYPE__MediaSubtype)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__raw)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__h264)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__mjpg)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__dv)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__mpegts)		\
+	F(SPA_TYPE_MEDIA_SUBTYPE__h263)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__mpeg1)		\
+	F(SPA_TYPE_MEDIA_SUBTYPE__mpeg2)		\
+	F(SPA_TYPE_MEDIA_SUBTYPE__mpeg4)		\
+	F(SPA_TYPE_MEDIA_SUBTYPE__xvid)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__vc1)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__vp8)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__vp9)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__jpeg)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__bayer)		\
+	F(SPA_TYPE_MEDIA_SUBTYPE__mp3)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__aac)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__vorbis)		\
+	F(SPA_TYPE_MEDIA_SUBTYPE__wma)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__ra)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__sbc)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__adpcm)		\
+	F(SPA_TYPE_MEDIA_SUBTYPE__g723)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__g726)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__g729)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__amr)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__gsm)			\
+	F(SPA_TYPE_MEDIA_SUBTYPE__midi)			\
+	/* param/buffers */				\
+	F(SPA_TYPE_PARAM__Buffers)			\
+	F(SPA_TYPE_PARAM_BUFFERS__size)			\
+	F(SPA_TYPE_PARAM_BUFFERS__stride)		\
+	F(SPA_TYPE_PARAM_BUFFERS__buffers)		\
+	F(SPA_TYPE_PARAM_BUFFERS__align)		\
+	/* param/meta */				\
+	F(SPA_TYPE_PARAM__Meta)				\
+	F(SPA_TYPE_PARAM_META__type)			\
+	F(SPA_TYPE_PARAM_META__size)			\
+	F(SPA_TYPE_PARAM_META__ringbufferSize)		\
+	F(SPA_TYPE_PARAM_META__ringbufferMinAvail)	\
+	F(SPA_TYPE_PARAM_META__ringbufferStride)	\
+	F(SPA_TYPE_PARAM_META__ringbufferBlocks)	\
+	F(SPA_TYPE_PARAM_META__ringbufferAlign)		\
+	/* param/video-padding */			\
+	F(SPA_TYPE_PARAM__VideoPadding)			\
+	F(SPA_TYPE_PARAM_VIDEO_PADDING__top)		\
+	F(SPA_TYPE_PARAM_VIDEO_PADDING__bottom)		\
+	F(SPA_TYPE_PARAM_VIDEO_PADDING__left)		\
+	F(SPA_TYPE_PARAM_VIDEO_PADDING__right)		\
+	F(SPA_TYPE_PARAM_VIDEO_PADDING__strideAlign0)	\
+	F(SPA_TYPE_PARAM_VIDEO_PADDING__strideAlign1)	\
+	F(SPA_TYPE_PARAM_VIDEO_PADDING__strideAlign2)	\
+	F(SPA_TYPE_PARAM_VIDEO_PADDING__strideAlign3)	\
+	/* param/audio/format */			\
+	F(SPA_TYPE_FORMAT__Audio)			\
+	F(SPA_TYPE_FORMAT_AUDIO__format)		\
+	F(SPA_TYPE_FORMAT_AUDIO__flags)			\
+	F(SPA_TYPE_FORMAT_AUDIO__layout)		\
+	F(SPA_TYPE_FORMAT_AUDIO__rate)			\
+	F(SPA_TYPE_FORMAT_AUDIO__channels)		\
+	F(SPA_TYPE_FORMAT_AUDIO__channelMask)		\
+	/* param/audio/raw */				\
+	F(SPA_TYPE__AudioFormat)			\
+	F(SPA_TYPE_AUDIO_FORMAT__UNKNOWN)		\
+	F(SPA_TYPE_AUDIO_FORMAT__ENCODED)		\
+	F(SPA_TYPE_AUDIO_FORMAT__S8)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U8)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S16LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S16BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U16LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U16BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S24_32LE)		\
+	F(SPA_TYPE_AUDIO_FORMAT__S24_32BE)		\
+	F(SPA_TYPE_AUDIO_FORMAT__U24_32LE)		\
+	F(SPA_TYPE_AUDIO_FORMAT__U24_32BE)		\
+	F(SPA_TYPE_AUDIO_FORMAT__S32LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S32BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U32LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U32BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S24LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S24BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U24LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U24BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S20LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S20BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U20LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U20BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S18LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__S18BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U18LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__U18BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__F32LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__F32BE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__F64LE)			\
+	F(SPA_TYPE_AUDIO_FORMAT__F64BE)			\
+	/* param/video/format */			\
+	F(SPA_TYPE_FORMAT__Video)			\
+	F(SPA_TYPE_FORMAT_VIDEO__format)		\
+	F(SPA_TYPE_FORMAT_VIDEO__size)			\
+	F(SPA_TYPE_FORMAT_VIDEO__framerate)		\
+	F(SPA_TYPE_FORMAT_VIDEO__maxFramerate)		\
+	F(SPA_TYPE_FORMAT_VIDEO__views)			\
+	F(SPA_TYPE_FORMAT_VIDEO__interlaceMode)		\
+	F(SPA_TYPE_FORMAT_VIDEO__pixelAspectRatio)	\
+	F(SPA_TYPE_FORMAT_VIDEO__multiviewMode)		\
+	F(SPA_TYPE_FORMAT_VIDEO__multiviewFlags)	\
+	F(SPA_TYPE_FORMAT_VIDEO__chromaSite)		\
+	F(SPA_TYPE_FORMAT_VIDEO__colorRange)		\
+	F(SPA_TYPE_FORMAT_VIDEO__colorMatrix)		\
+	F(SPA_TYPE_FORMAT_VIDEO__transferFunction)	\
+	F(SPA_TYPE_FORMAT_VIDEO__colorPrimaries)	\
+	F(SPA_TYPE_FORMAT_VIDEO__profile)		\
+	F(SPA_TYPE_FORMAT_VIDEO__level)			\
+	F(SPA_TYPE_FORMAT_VIDEO__streamFormat)		\
+	F(SPA_TYPE_FORMAT_VIDEO__alignment)		\
+	/* param/video/raw */				\
+	F(SPA_TYPE__VideoFormat)			\
+	F(SPA_TYPE_VIDEO_FORMAT__ENCODED)		\
+	F(SPA_TYPE_VIDEO_FORMAT__I420)			\
+	F(SPA_TYPE_VIDEO_FORMAT__YV12)			\
+	F(SPA_TYPE_VIDEO_FORMAT__YUY2)			\
+	F(SPA_TYPE_VIDEO_FORMAT__UYVY)			\
+	F(SPA_TYPE_VIDEO_FORMAT__AYUV)			\
+	F(SPA_TYPE_VIDEO_FORMAT__RGBx)			\
+	F(SPA_TYPE_VIDEO_FORMAT__BGRx)			\
+	F(SPA_TYPE_VIDEO_FORMAT__xRGB)			\
+	F(SPA_TYPE_VIDEO_FORMAT__xBGR)			\
+	F(SPA_TYPE_VIDEO_FORMAT__RGBA)			\
+	F(SPA_TYPE_VIDEO_FORMAT__BGRA)			\
+	F(SPA_TYPE_VIDEO_FORMAT__ARGB)			\
+	F(SPA_TYPE_VIDEO_FORMAT__ABGR)			\
+	F(SPA_TYPE_VIDEO_FORMAT__RGB)			\
+	F(SPA_TYPE_VIDEO_FORMAT__BGR)			\
+	F(SPA_TYPE_VIDEO_FORMAT__Y41B)			\
+	F(SPA_TYPE_VIDEO_FORMAT__Y42B)			\
+	F(SPA_TYPE_VIDEO_FORMAT__YVYU)			\
+	F(SPA_TYPE_VIDEO_FORMAT__Y444)			\
+	F(SPA_TYPE_VIDEO_FORMAT__v210)			\
+	F(SPA_TYPE_VIDEO_FORMAT__v216)			\
+	F(SPA_TYPE_VIDEO_FORMAT__NV12)			\
+	F(SPA_TYPE_VIDEO_FORMAT__NV21)			\
+	F(SPA_TYPE_VIDEO_FORMAT__GRAY8)			\
+	F(SPA_TYPE_VIDEO_FORMAT__GRAY16_BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__GRAY16_LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__v308)			\
+	F(SPA_TYPE_VIDEO_FORMAT__RGB16)			\
+	F(SPA_TYPE_VIDEO_FORMAT__BGR16)			\
+	F(SPA_TYPE_VIDEO_FORMAT__RGB15)			\
+	F(SPA_TYPE_VIDEO_FORMAT__BGR15)			\
+	F(SPA_TYPE_VIDEO_FORMAT__UYVP)			\
+	F(SPA_TYPE_VIDEO_FORMAT__A420)			\
+	F(SPA_TYPE_VIDEO_FORMAT__RGB8P)			\
+	F(SPA_TYPE_VIDEO_FORMAT__YUV9)			\
+	F(SPA_TYPE_VIDEO_FORMAT__YVU9)			\
+	F(SPA_TYPE_VIDEO_FORMAT__IYU1)			\
+	F(SPA_TYPE_VIDEO_FORMAT__ARGB64)		\
+	F(SPA_TYPE_VIDEO_FORMAT__AYUV64)		\
+	F(SPA_TYPE_VIDEO_FORMAT__r210)			\
+	F(SPA_TYPE_VIDEO_FORMAT__I420_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__I420_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__I422_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__I422_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__Y444_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__Y444_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__GBR)			\
+	F(SPA_TYPE_VIDEO_FORMAT__GBR_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__GBR_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__NV16)			\
+	F(SPA_TYPE_VIDEO_FORMAT__NV24)			\
+	F(SPA_TYPE_VIDEO_FORMAT__NV12_64Z32)		\
+	F(SPA_TYPE_VIDEO_FORMAT__A420_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__A420_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__A422_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__A422_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__A444_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__A444_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__NV61)			\
+	F(SPA_TYPE_VIDEO_FORMAT__P010_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__P010_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__IYU2)			\
+	F(SPA_TYPE_VIDEO_FORMAT__VYUY)			\
+	F(SPA_TYPE_VIDEO_FORMAT__GBRA)			\
+	F(SPA_TYPE_VIDEO_FORMAT__GBRA_10BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__GBRA_10LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__GBR_12BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__GBR_12LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__GBRA_12BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__GBRA_12LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__I420_12BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__I420_12LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__I422_12BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__I422_12LE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__Y444_12BE)		\
+	F(SPA_TYPE_VIDEO_FORMAT__Y444_12LE)		\
+	/* node/node */					\
+	F(SPA_TYPE__Node)				\
+	/* node/event */				\
+	F(SPA_TYPE_EVENT__Node)				\
+	F(SPA_TYPE_EVENT_NODE__Error)			\
+	F(SPA_TYPE_EVENT_NODE__Buffering)		\
+	F(SPA_TYPE_EVENT_NODE__RequestRefresh)		\
+	F(SPA_TYPE_EVENT_NODE__RequestClockUpdate)	\
+	/* node/command */				\
+	F(SPA_TYPE_COMMAND__Node)			\
+	F(SPA_TYPE_COMMAND_NODE__Pause)			\
+	F(SPA_TYPE_COMMAND_NODE__Start)			\
+	F(SPA_TYPE_COMMAND_NODE__Flush)			\
+	F(SPA_TYPE_COMMAND_NODE__Drain)			\
+	F(SPA_TYPE_COMMAND_NODE__Marker)		\
+	F(SPA_TYPE_COMMAND_NODE__ClockUpdate)		\
+	/* clock/clock */				\
+	F(SPA_TYPE__Clock)				\
+	/* monitor/monitor */				\
+	F(SPA_TYPE__Monitor)				\
+	F(SPA_TYPE_EVENT__Monitor)			\
+	F(SPA_TYPE_EVENT_MONITOR__Added)		\
+	F(SPA_TYPE_EVENT_MONITOR__Removed)		\
+	F(SPA_TYPE_EVENT_MONITOR__Changed)		\
+	F(SPA_TYPE__MonitorItem)			\
+	F(SPA_TYPE_MONITOR_ITEM__id)			\
+	F(SPA_TYPE_MONITOR_ITEM__flags)			\
+	F(SPA_TYPE_MONITOR_ITEM__state)			\
+	F(SPA_TYPE_MONITOR_ITEM__name)			\
+	F(SPA_TYPE_MONITOR_ITEM__class)			\
+	F(SPA_TYPE_MONITOR_ITEM__info)			\
+	F(SPA_TYPE_MONITOR_ITEM__factory)
+
+/** The compile time id of the static \a type, \a type is the name of the
+ * type macro, for example SPA_TYPE_STATIC_ID(SPA_TYPE__Format) */
+#define SPA_TYPE_STATIC_ID(type)	SPA_TYPE_STATIC_ID_ ## type
+
+enum spa_type_static_id {
+#define __SPA_TYPE_STATIC_ENUM(type)	SPA_TYPE_STATIC_ID_ ## type,
+	SPA_TYPE_STATIC_FOREACH(__SPA_TYPE_STATIC_ENUM)
+#undef __SPA_TYPE_STATIC_ENUM
+	SPA_TYPE_STATIC_N,	/**< number of static types, the first dynamic id */
+};
+
+/** Check if \a id is a static type id */
+#define spa_type_is_static(id)	((uint32_t)(id) < SPA_TYPE_STATIC_N)
+
+/** Get the type of the static \a id
+ * \return the type or NULL when \a id is not a static id */
+static inline const char *spa_type_static_get_type(uint32_t id)
+{
+	static const char * const types[] = {
+#define __SPA_TYPE_STATIC_STRING(type)	type,
+		SPA_TYPE_STATIC_FOREACH(__SPA_TYPE_STATIC_STRING)
+#undef __SPA_TYPE_STATIC_STRING
+	};
+	return spa_type_is_static(id) ? types[id] : NULL;
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_TYPE_MAP_STATIC_H__ */
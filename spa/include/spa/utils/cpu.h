@@ -0,0 +1,73 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_CPU_H__
+#define __SPA_CPU_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/utils/defs.h>
+
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+/** CPU features that plugins can select optimized code paths for */
+#define SPA_CPU_FLAG_SSE2		(1 << 0)
+#define SPA_CPU_FLAG_SSE41		(1 << 1)
+#define SPA_CPU_FLAG_AVX2		(1 << 2)
+#define SPA_CPU_FLAG_NEON		(1 << 3)
+
+/**
+ * Get the features of the CPU we are running on.
+ *
+ * This should be called once when a plugin is initialized and the result
+ * used to select the functions that are used in the processing path.
+ *
+ * \return a mask of SPA_CPU_FLAG_ values
+ */
+static inline uint32_t spa_cpu_get_flags(void)
+{
+	uint32_t flags = 0;
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags |= SPA_CPU_FLAG_SSE2;
+	if (__builtin_cpu_supports("sse4.1"))
+		flags |= SPA_CPU_FLAG_SSE41;
+	if (__builtin_cpu_supports("avx2"))
+		flags |= SPA_CPU_FLAG_AVX2;
+#elif defined(__aarch64__)
+	flags |= SPA_CPU_FLAG_NEON;
+#elif defined(__arm__) && defined(__linux__)
+	/* HWCAP_NEON, not exported by all libc headers */
+	if (getauxval(AT_HWCAP) & (1 << 12))
+		flags |= SPA_CPU_FLAG_NEON;
+#endif
+	return flags;
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_CPU_H__ */
@@ -0,0 +1,240 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <immintrin.h>
+
+#include "mix.h"
+
+/* Same as the SSE2 versions but with 256 bits registers. We don't use FMA
+ * so that the results stay bit-exact with the C versions. */
+
+static void
+add_s16_s16_avx2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m256i in[2], out[2];
+
+	for (n = 0; n + 32 <= n_samples; n += 32) {
+		in[0] = _mm256_loadu_si256((__m256i*)(s + n));
+		in[1] = _mm256_loadu_si256((__m256i*)(s + n + 16));
+		out[0] = _mm256_loadu_si256((__m256i*)(d + n));
+		out[1] = _mm256_loadu_si256((__m256i*)(d + n + 16));
+		out[0] = _mm256_adds_epi16(out[0], in[0]);
+		out[1] = _mm256_adds_epi16(out[1], in[1]);
+		_mm256_storeu_si256((__m256i*)(d + n), out[0]);
+		_mm256_storeu_si256((__m256i*)(d + n + 16), out[1]);
+	}
+	if (n < n_samples)
+		add_s16_s16_c(d + n, s + n, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_f32_f32_avx2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 in[2], out[2];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm256_loadu_ps(s + n);
+		in[1] = _mm256_loadu_ps(s + n + 8);
+		out[0] = _mm256_loadu_ps(d + n);
+		out[1] = _mm256_loadu_ps(d + n + 8);
+		out[0] = _mm256_add_ps(out[0], in[0]);
+		out[1] = _mm256_add_ps(out[1], in[1]);
+		_mm256_storeu_ps(d + n, out[0]);
+		_mm256_storeu_ps(d + n + 8, out[1]);
+	}
+	if (n < n_samples)
+		add_f32_f32_c(d + n, s + n, (n_samples - n) * sizeof(float));
+}
+
+static void
+copy_scale_s16_s16_avx2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m256i v = _mm256_set1_epi16(*(int16_t*)scale), in[2];
+
+	for (n = 0; n + 32 <= n_samples; n += 32) {
+		in[0] = _mm256_loadu_si256((__m256i*)(s + n));
+		in[1] = _mm256_loadu_si256((__m256i*)(s + n + 16));
+		in[0] = _mm256_mulhi_epi16(in[0], v);
+		in[1] = _mm256_mulhi_epi16(in[1], v);
+		_mm256_storeu_si256((__m256i*)(d + n), in[0]);
+		_mm256_storeu_si256((__m256i*)(d + n + 16), in[1]);
+	}
+	if (n < n_samples)
+		copy_scale_s16_s16_c(d + n, s + n, scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+copy_scale_f32_f32_avx2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 v = _mm256_set1_ps(*(float*)scale), in[2];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm256_loadu_ps(s + n);
+		in[1] = _mm256_loadu_ps(s + n + 8);
+		in[0] = _mm256_mul_ps(in[0], v);
+		in[1] = _mm256_mul_ps(in[1], v);
+		_mm256_storeu_ps(d + n, in[0]);
+		_mm256_storeu_ps(d + n + 8, in[1]);
+	}
+	if (n < n_samples)
+		copy_scale_f32_f32_c(d + n, s + n, scale, (n_samples - n) * sizeof(float));
+}
+
+static void
+add_scale_s16_s16_avx2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m256i v = _mm256_set1_epi16(*(int16_t*)scale), in[2], out[2];
+
+	for (n = 0; n + 32 <= n_samples; n += 32) {
+		in[0] = _mm256_loadu_si256((__m256i*)(s + n));
+		in[1] = _mm256_loadu_si256((__m256i*)(s + n + 16));
+		out[0] = _mm256_loadu_si256((__m256i*)(d + n));
+		out[1] = _mm256_loadu_si256((__m256i*)(d + n + 16));
+		out[0] = _mm256_adds_epi16(out[0], _mm256_mulhi_epi16(in[0], v));
+		out[1] = _mm256_adds_epi16(out[1], _mm256_mulhi_epi16(in[1], v));
+		_mm256_storeu_si256((__m256i*)(d + n), out[0]);
+		_mm256_storeu_si256((__m256i*)(d + n + 16), out[1]);
+	}
+	if (n < n_samples)
+		add_scale_s16_s16_c(d + n, s + n, scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_scale_f32_f32_avx2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 v = _mm256_set1_ps(*(float*)scale), in[2], out[2];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm256_loadu_ps(s + n);
+		in[1] = _mm256_loadu_ps(s + n + 8);
+		out[0] = _mm256_loadu_ps(d + n);
+		out[1] = _mm256_loadu_ps(d + n + 8);
+		out[0] = _mm256_add_ps(out[0], _mm256_mul_ps(in[0], v));
+		out[1] = _mm256_add_ps(out[1], _mm256_mul_ps(in[1], v));
+		_mm256_storeu_ps(d + n, out[0]);
+		_mm256_storeu_ps(d + n + 8, out[1]);
+	}
+	if (n < n_samples)
+		add_scale_f32_f32_c(d + n, s + n, scale, (n_samples - n) * sizeof(float));
+}
+
+/* see volume_s16_sse2(), the unpacks and the pack work on the 128 bits
+ * lanes so the samples stay in order */
+static inline void
+volume_s16_avx2(__m256i in, __m256i vh, __m256i vl, int vl_neg, __m256i *lo, __m256i *hi)
+{
+	__m256i pl, ph, f;
+
+	pl = _mm256_mullo_epi16(in, vh);
+	ph = _mm256_mulhi_epi16(in, vh);
+	f = _mm256_mulhi_epi16(in, vl);
+	if (vl_neg)
+		f = _mm256_add_epi16(f, in);
+
+	*lo = _mm256_add_epi32(_mm256_unpacklo_epi16(pl, ph),
+			       _mm256_srai_epi32(_mm256_unpacklo_epi16(f, f), 16));
+	*hi = _mm256_add_epi32(_mm256_unpackhi_epi16(pl, ph),
+			       _mm256_srai_epi32(_mm256_unpackhi_epi16(f, f), 16));
+}
+
+static void
+copy_volume_s16_s16_avx2(void *dst, const void *src, const void *volume, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t v = VOLUME_S16(volume);
+	__m256i vh = _mm256_set1_epi16(v >> 16), vl = _mm256_set1_epi16(v & 0xffff);
+	__m256i in, lo, hi;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in = _mm256_loadu_si256((__m256i*)(s + n));
+		volume_s16_avx2(in, vh, vl, v & 0x8000, &lo, &hi);
+		_mm256_storeu_si256((__m256i*)(d + n), _mm256_packs_epi32(lo, hi));
+	}
+	if (n < n_samples)
+		copy_volume_s16_s16_c(d + n, s + n, volume, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_volume_s16_s16_avx2(void *dst, const void *src, const void *volume, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t v = VOLUME_S16(volume);
+	__m256i vh = _mm256_set1_epi16(v >> 16), vl = _mm256_set1_epi16(v & 0xffff);
+	__m256i in, out, lo, hi;
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in = _mm256_loadu_si256((__m256i*)(s + n));
+		out = _mm256_loadu_si256((__m256i*)(d + n));
+		volume_s16_avx2(in, vh, vl, v & 0x8000, &lo, &hi);
+		lo = _mm256_add_epi32(lo, _mm256_srai_epi32(_mm256_unpacklo_epi16(out, out), 16));
+		hi = _mm256_add_epi32(hi, _mm256_srai_epi32(_mm256_unpackhi_epi16(out, out), 16));
+		_mm256_storeu_si256((__m256i*)(d + n), _mm256_packs_epi32(lo, hi));
+	}
+	if (n < n_samples)
+		add_volume_s16_s16_c(d + n, s + n, volume, (n_samples - n) * sizeof(int16_t));
+}
+
+MAKE_STRIDED(add_s16_s16, avx2)
+MAKE_STRIDED(add_f32_f32, avx2)
+MAKE_STRIDED_SCALE(copy_scale_s16_s16, avx2)
+MAKE_STRIDED_SCALE(copy_scale_f32_f32, avx2)
+MAKE_STRIDED_SCALE(add_scale_s16_s16, avx2)
+MAKE_STRIDED_SCALE(add_scale_f32_f32, avx2)
+
+void spa_audiomixer_get_ops_avx2(struct spa_audiomixer_ops *ops)
+{
+	ops->add[CONV_S16_S16] = add_s16_s16_avx2;
+	ops->add[CONV_F32_F32] = add_f32_f32_avx2;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_avx2;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_avx2;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_avx2;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_avx2;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i_avx2;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i_avx2;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i_avx2;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i_avx2;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i_avx2;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i_avx2;
+	ops->copy_volume[CONV_S16_S16] = copy_volume_s16_s16_avx2;
+	ops->copy_volume[CONV_F32_F32] = copy_scale_f32_f32_avx2;
+	ops->add_volume[CONV_S16_S16] = add_volume_s16_s16_avx2;
+	ops->add_volume[CONV_F32_F32] = add_scale_f32_f32_avx2;
+}
@@ -0,0 +1,139 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <arm_neon.h>
+
+#include "mix.h"
+
+/* vqdmulh doubles the product, so the s16 scale is done with a widening
+ * multiply and a narrowing shift to get exactly (s * v) >> 16 */
+static inline int16x8_t mulhi_s16(int16x8_t a, int16x4_t v)
+{
+	int32x4_t lo = vmull_s16(vget_low_s16(a), v);
+	int32x4_t hi = vmull_s16(vget_high_s16(a), v);
+	return vcombine_s16(vshrn_n_s32(lo, 16), vshrn_n_s32(hi, 16));
+}
+
+static void
+add_s16_s16_neon(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		vst1q_s16(d + n, vqaddq_s16(vld1q_s16(d + n), vld1q_s16(s + n)));
+	if (n < n_samples)
+		add_s16_s16_c(d + n, s + n, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_f32_f32_neon(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		vst1q_f32(d + n, vaddq_f32(vld1q_f32(d + n), vld1q_f32(s + n)));
+	if (n < n_samples)
+		add_f32_f32_c(d + n, s + n, (n_samples - n) * sizeof(float));
+}
+
+static void
+copy_scale_s16_s16_neon(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int16x4_t v = vdup_n_s16(*(int16_t*)scale);
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		vst1q_s16(d + n, mulhi_s16(vld1q_s16(s + n), v));
+	if (n < n_samples)
+		copy_scale_s16_s16_c(d + n, s + n, scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+copy_scale_f32_f32_neon(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	float32x4_t v = vdupq_n_f32(*(float*)scale);
+
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		vst1q_f32(d + n, vmulq_f32(vld1q_f32(s + n), v));
+	if (n < n_samples)
+		copy_scale_f32_f32_c(d + n, s + n, scale, (n_samples - n) * sizeof(float));
+}
+
+static void
+add_scale_s16_s16_neon(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int16x4_t v = vdup_n_s16(*(int16_t*)scale);
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		vst1q_s16(d + n, vqaddq_s16(vld1q_s16(d + n), mulhi_s16(vld1q_s16(s + n), v)));
+	if (n < n_samples)
+		add_scale_s16_s16_c(d + n, s + n, scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_scale_f32_f32_neon(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	float32x4_t v = vdupq_n_f32(*(float*)scale);
+
+	/* no vmla/vfma, the C version does a separate multiply and add */
+	for (n = 0; n + 4 <= n_samples; n += 4)
+		vst1q_f32(d + n, vaddq_f32(vld1q_f32(d + n), vmulq_f32(vld1q_f32(s + n), v)));
+	if (n < n_samples)
+		add_scale_f32_f32_c(d + n, s + n, scale, (n_samples - n) * sizeof(float));
+}
+
+MAKE_STRIDED(add_s16_s16, neon)
+MAKE_STRIDED(add_f32_f32, neon)
+MAKE_STRIDED_SCALE(copy_scale_s16_s16, neon)
+MAKE_STRIDED_SCALE(copy_scale_f32_f32, neon)
+MAKE_STRIDED_SCALE(add_scale_s16_s16, neon)
+MAKE_STRIDED_SCALE(add_scale_f32_f32, neon)
+
+void spa_audiomixer_get_ops_neon(struct spa_audiomixer_ops *ops)
+{
+	ops->add[CONV_S16_S16] = add_s16_s16_neon;
+	ops->add[CONV_F32_F32] = add_f32_f32_neon;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_neon;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_neon;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_neon;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_neon;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i_neon;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i_neon;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i_neon;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i_neon;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i_neon;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i_neon;
+	ops->copy_volume[CONV_F32_F32] = copy_scale_f32_f32_neon;
+	ops->add_volume[CONV_F32_F32] = add_scale_f32_f32_neon;
+}
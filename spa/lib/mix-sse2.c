@@ -0,0 +1,242 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <emmintrin.h>
+
+#include "mix.h"
+
+/* All kernels use unaligned loads and stores, the ringbuffer offsets can
+ * be anything. The results are bit-exact with the C versions: the saturating
+ * adds do the same clamping and mulhi is the same (s * v) >> 16. */
+
+static void
+add_s16_s16_sse2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m128i in[2], out[2];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm_loadu_si128((__m128i*)(s + n));
+		in[1] = _mm_loadu_si128((__m128i*)(s + n + 8));
+		out[0] = _mm_loadu_si128((__m128i*)(d + n));
+		out[1] = _mm_loadu_si128((__m128i*)(d + n + 8));
+		out[0] = _mm_adds_epi16(out[0], in[0]);
+		out[1] = _mm_adds_epi16(out[1], in[1]);
+		_mm_storeu_si128((__m128i*)(d + n), out[0]);
+		_mm_storeu_si128((__m128i*)(d + n + 8), out[1]);
+	}
+	if (n < n_samples)
+		add_s16_s16_c(d + n, s + n, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_f32_f32_sse2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 in[2], out[2];
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in[0] = _mm_loadu_ps(s + n);
+		in[1] = _mm_loadu_ps(s + n + 4);
+		out[0] = _mm_loadu_ps(d + n);
+		out[1] = _mm_loadu_ps(d + n + 4);
+		out[0] = _mm_add_ps(out[0], in[0]);
+		out[1] = _mm_add_ps(out[1], in[1]);
+		_mm_storeu_ps(d + n, out[0]);
+		_mm_storeu_ps(d + n + 4, out[1]);
+	}
+	if (n < n_samples)
+		add_f32_f32_c(d + n, s + n, (n_samples - n) * sizeof(float));
+}
+
+static void
+copy_scale_s16_s16_sse2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m128i v = _mm_set1_epi16(*(int16_t*)scale), in[2];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm_loadu_si128((__m128i*)(s + n));
+		in[1] = _mm_loadu_si128((__m128i*)(s + n + 8));
+		in[0] = _mm_mulhi_epi16(in[0], v);
+		in[1] = _mm_mulhi_epi16(in[1], v);
+		_mm_storeu_si128((__m128i*)(d + n), in[0]);
+		_mm_storeu_si128((__m128i*)(d + n + 8), in[1]);
+	}
+	if (n < n_samples)
+		copy_scale_s16_s16_c(d + n, s + n, scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+copy_scale_f32_f32_sse2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 v = _mm_set1_ps(*(float*)scale), in[2];
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in[0] = _mm_loadu_ps(s + n);
+		in[1] = _mm_loadu_ps(s + n + 4);
+		in[0] = _mm_mul_ps(in[0], v);
+		in[1] = _mm_mul_ps(in[1], v);
+		_mm_storeu_ps(d + n, in[0]);
+		_mm_storeu_ps(d + n + 4, in[1]);
+	}
+	if (n < n_samples)
+		copy_scale_f32_f32_c(d + n, s + n, scale, (n_samples - n) * sizeof(float));
+}
+
+static void
+add_scale_s16_s16_sse2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m128i v = _mm_set1_epi16(*(int16_t*)scale), in[2], out[2];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm_loadu_si128((__m128i*)(s + n));
+		in[1] = _mm_loadu_si128((__m128i*)(s + n + 8));
+		out[0] = _mm_loadu_si128((__m128i*)(d + n));
+		out[1] = _mm_loadu_si128((__m128i*)(d + n + 8));
+		out[0] = _mm_adds_epi16(out[0], _mm_mulhi_epi16(in[0], v));
+		out[1] = _mm_adds_epi16(out[1], _mm_mulhi_epi16(in[1], v));
+		_mm_storeu_si128((__m128i*)(d + n), out[0]);
+		_mm_storeu_si128((__m128i*)(d + n + 8), out[1]);
+	}
+	if (n < n_samples)
+		add_scale_s16_s16_c(d + n, s + n, scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_scale_f32_f32_sse2(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 v = _mm_set1_ps(*(float*)scale), in[2], out[2];
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in[0] = _mm_loadu_ps(s + n);
+		in[1] = _mm_loadu_ps(s + n + 4);
+		out[0] = _mm_loadu_ps(d + n);
+		out[1] = _mm_loadu_ps(d + n + 4);
+		out[0] = _mm_add_ps(out[0], _mm_mul_ps(in[0], v));
+		out[1] = _mm_add_ps(out[1], _mm_mul_ps(in[1], v));
+		_mm_storeu_ps(d + n, out[0]);
+		_mm_storeu_ps(d + n + 4, out[1]);
+	}
+	if (n < n_samples)
+		add_scale_f32_f32_c(d + n, s + n, scale, (n_samples - n) * sizeof(float));
+}
+
+/* (s * v) >> 16 for a 16.16 gain v that does not fit in 16 bits. The gain
+ * is split in v = vh * 65536 + vl, s * vh is done in 32 bits and
+ * (s * vl) >> 16 with mulhi, which is exact because vl < 65536. */
+static inline void
+volume_s16_sse2(__m128i in, __m128i vh, __m128i vl, int vl_neg, __m128i *lo, __m128i *hi)
+{
+	__m128i pl, ph, f;
+
+	pl = _mm_mullo_epi16(in, vh);
+	ph = _mm_mulhi_epi16(in, vh);
+	f = _mm_mulhi_epi16(in, vl);
+	if (vl_neg)
+		f = _mm_add_epi16(f, in);
+
+	*lo = _mm_add_epi32(_mm_unpacklo_epi16(pl, ph),
+			    _mm_srai_epi32(_mm_unpacklo_epi16(f, f), 16));
+	*hi = _mm_add_epi32(_mm_unpackhi_epi16(pl, ph),
+			    _mm_srai_epi32(_mm_unpackhi_epi16(f, f), 16));
+}
+
+static void
+copy_volume_s16_s16_sse2(void *dst, const void *src, const void *volume, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t v = VOLUME_S16(volume);
+	__m128i vh = _mm_set1_epi16(v >> 16), vl = _mm_set1_epi16(v & 0xffff);
+	__m128i in, lo, hi;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in = _mm_loadu_si128((__m128i*)(s + n));
+		volume_s16_sse2(in, vh, vl, v & 0x8000, &lo, &hi);
+		_mm_storeu_si128((__m128i*)(d + n), _mm_packs_epi32(lo, hi));
+	}
+	if (n < n_samples)
+		copy_volume_s16_s16_c(d + n, s + n, volume, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_volume_s16_s16_sse2(void *dst, const void *src, const void *volume, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	int32_t v = VOLUME_S16(volume);
+	__m128i vh = _mm_set1_epi16(v >> 16), vl = _mm_set1_epi16(v & 0xffff);
+	__m128i in, out, lo, hi;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		in = _mm_loadu_si128((__m128i*)(s + n));
+		out = _mm_loadu_si128((__m128i*)(d + n));
+		volume_s16_sse2(in, vh, vl, v & 0x8000, &lo, &hi);
+		lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(out, out), 16));
+		hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(out, out), 16));
+		_mm_storeu_si128((__m128i*)(d + n), _mm_packs_epi32(lo, hi));
+	}
+	if (n < n_samples)
+		add_volume_s16_s16_c(d + n, s + n, volume, (n_samples - n) * sizeof(int16_t));
+}
+
+MAKE_STRIDED(add_s16_s16, sse2)
+MAKE_STRIDED(add_f32_f32, sse2)
+MAKE_STRIDED_SCALE(copy_scale_s16_s16, sse2)
+MAKE_STRIDED_SCALE(copy_scale_f32_f32, sse2)
+MAKE_STRIDED_SCALE(add_scale_s16_s16, sse2)
+MAKE_STRIDED_SCALE(add_scale_f32_f32, sse2)
+
+void spa_audiomixer_get_ops_sse2(struct spa_audiomixer_ops *ops)
+{
+	ops->add[CONV_S16_S16] = add_s16_s16_sse2;
+	ops->add[CONV_F32_F32] = add_f32_f32_sse2;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_sse2;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_sse2;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_sse2;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_sse2;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i_sse2;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i_sse2;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i_sse2;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i_sse2;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i_sse2;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i_sse2;
+	ops->copy_volume[CONV_S16_S16] = copy_volume_s16_s16_sse2;
+	ops->copy_volume[CONV_F32_F32] = copy_scale_f32_f32_sse2;
+	ops->add_volume[CONV_S16_S16] = add_volume_s16_s16_sse2;
+	ops->add_volume[CONV_F32_F32] = add_scale_f32_f32_sse2;
+}
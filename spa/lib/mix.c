@@ -0,0 +1,323 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "mix.h"
+
+void
+copy_s16_s16_c(void *dst, const void *src, int n_bytes)
+{
+	memcpy(dst, src, n_bytes);
+}
+
+void
+copy_f32_f32_c(void *dst, const void *src, int n_bytes)
+{
+	memcpy(dst, src, n_bytes);
+}
+
+void
+add_s16_s16_c(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + *s;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+add_f32_f32_c(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d += *s;
+		d++;
+		s++;
+	}
+}
+
+void
+copy_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = *(int16_t*)scale, t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = (*s * v) >> 16;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+copy_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d = *s * v;
+		d++;
+		s++;
+	}
+}
+
+void
+add_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = *(int16_t*)scale, t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + ((*s * v) >> 16);
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+add_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d += *s * v;
+		d++;
+		s++;
+	}
+}
+
+void
+copy_volume_s16_s16_c(void *dst, const void *src, const void *volume, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = VOLUME_S16(volume), t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = ((int64_t) *s * v) >> 16;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+add_volume_s16_s16_c(void *dst, const void *src, const void *volume, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = VOLUME_S16(volume), t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + (((int64_t) *s * v) >> 16);
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+copy_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+
+	if (dst_stride == 1 && src_stride == 1) {
+		memcpy(dst, src, n_bytes);
+		return;
+	}
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+copy_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+
+	if (dst_stride == 1 && src_stride == 1) {
+		memcpy(dst, src, n_bytes);
+		return;
+	}
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+add_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + *s;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+add_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d += *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+copy_scale_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = *(int16_t*)scale, t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = (*s * v) >> 16;
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+copy_scale_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d = *s * v;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+add_scale_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, const void *scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = *(int16_t*)scale, t;
+
+	n_bytes /= sizeof(int16_t);
+	while (n_bytes--) {
+		t = *d + ((*s * v) >> 16);
+		*d = SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void
+add_scale_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, const void *scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	float v = *(float*)scale;
+
+	n_bytes /= sizeof(float);
+	while (n_bytes--) {
+		*d += *s * v;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
+{
+	ops->copy[CONV_S16_S16] = copy_s16_s16_c;
+	ops->copy[CONV_F32_F32] = copy_f32_f32_c;
+	ops->add[CONV_S16_S16] = add_s16_s16_c;
+	ops->add[CONV_F32_F32] = add_f32_f32_c;
+	ops->copy_scale[CONV_S16_S16] = copy_scale_s16_s16_c;
+	ops->copy_scale[CONV_F32_F32] = copy_scale_f32_f32_c;
+	ops->add_scale[CONV_S16_S16] = add_scale_s16_s16_c;
+	ops->add_scale[CONV_F32_F32] = add_scale_f32_f32_c;
+	ops->copy_i[CONV_S16_S16] = copy_s16_s16_i_c;
+	ops->copy_i[CONV_F32_F32] = copy_f32_f32_i_c;
+	ops->add_i[CONV_S16_S16] = add_s16_s16_i_c;
+	ops->add_i[CONV_F32_F32] = add_f32_f32_i_c;
+	ops->copy_scale_i[CONV_S16_S16] = copy_scale_s16_s16_i_c;
+	ops->copy_scale_i[CONV_F32_F32] = copy_scale_f32_f32_i_c;
+	ops->add_scale_i[CONV_S16_S16] = add_scale_s16_s16_i_c;
+	ops->add_scale_i[CONV_F32_F32] = add_scale_f32_f32_i_c;
+	ops->copy_volume[CONV_S16_S16] = copy_volume_s16_s16_c;
+	ops->copy_volume[CONV_F32_F32] = copy_scale_f32_f32_c;
+	ops->add_volume[CONV_S16_S16] = add_volume_s16_s16_c;
+	ops->add_volume[CONV_F32_F32] = add_scale_f32_f32_c;
+
+	/* the optimized versions only replace what they implement, later
+	 * ones override earlier ones */
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		spa_audiomixer_get_ops_sse2(ops);
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		spa_audiomixer_get_ops_avx2(ops);
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		spa_audiomixer_get_ops_neon(ops);
+#endif
+}
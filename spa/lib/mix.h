@@ -0,0 +1,127 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_LIBMIX_H__
+#define __SPA_LIBMIX_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/cpu.h>
+
+typedef void (*mix_func_t) (void *dst, const void *src, int n_bytes);
+typedef void (*mix_scale_func_t) (void *dst, const void *src, const void *scale, int n_bytes);
+typedef void (*mix_i_func_t) (void *dst, int dst_stride,
+			      const void *src, int src_stride, int n_bytes);
+typedef void (*mix_scale_i_func_t) (void *dst, int dst_stride,
+				    const void *src, int src_stride, const void *scale, int n_bytes);
+
+enum {
+	CONV_S16_S16,
+	CONV_F32_F32,
+	CONV_MAX,
+};
+
+struct spa_audiomixer_ops {
+	mix_func_t copy[CONV_MAX];
+	mix_func_t add[CONV_MAX];
+	mix_scale_func_t copy_scale[CONV_MAX];
+	mix_scale_func_t add_scale[CONV_MAX];
+	mix_i_func_t copy_i[CONV_MAX];
+	mix_i_func_t add_i[CONV_MAX];
+	mix_scale_i_func_t copy_scale_i[CONV_MAX];
+	mix_scale_i_func_t add_scale_i[CONV_MAX];
+	/* scale is a float gain for all formats, also for gains >= 0.5 */
+	mix_scale_func_t copy_volume[CONV_MAX];
+	mix_scale_func_t add_volume[CONV_MAX];
+};
+
+/* fill ops with the best implementation for the features in cpu_flags */
+void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags);
+
+/* plain C versions, used as fallback and as reference */
+void copy_s16_s16_c(void *dst, const void *src, int n_bytes);
+void copy_f32_f32_c(void *dst, const void *src, int n_bytes);
+void add_s16_s16_c(void *dst, const void *src, int n_bytes);
+void add_f32_f32_c(void *dst, const void *src, int n_bytes);
+void copy_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes);
+void copy_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes);
+void add_scale_s16_s16_c(void *dst, const void *src, const void *scale, int n_bytes);
+void add_scale_f32_f32_c(void *dst, const void *src, const void *scale, int n_bytes);
+void copy_volume_s16_s16_c(void *dst, const void *src, const void *volume, int n_bytes);
+void add_volume_s16_s16_c(void *dst, const void *src, const void *volume, int n_bytes);
+void copy_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes);
+void copy_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes);
+void add_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes);
+void add_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes);
+void copy_scale_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride,
+			    const void *scale, int n_bytes);
+void copy_scale_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride,
+			    const void *scale, int n_bytes);
+void add_scale_s16_s16_i_c(void *dst, int dst_stride, const void *src, int src_stride,
+			   const void *scale, int n_bytes);
+void add_scale_f32_f32_i_c(void *dst, int dst_stride, const void *src, int src_stride,
+			   const void *scale, int n_bytes);
+
+/* the gain of the volume functions in 16.16 fixed point */
+#define VOLUME_S16(volume)	((int32_t) (*(const float *) (volume) * (1 << 16)))
+
+/* strided versions only have a vector path for contiguous samples, the
+ * other cases go to the C versions */
+#define MAKE_STRIDED(name,arch)									\
+static void											\
+name##_i_##arch(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)	\
+{												\
+	if (dst_stride == 1 && src_stride == 1)							\
+		name##_##arch(dst, src, n_bytes);						\
+	else											\
+		name##_i_c(dst, dst_stride, src, src_stride, n_bytes);				\
+}
+
+#define MAKE_STRIDED_SCALE(name,arch)								\
+static void											\
+name##_i_##arch(void *dst, int dst_stride, const void *src, int src_stride,			\
+		const void *scale, int n_bytes)							\
+{												\
+	if (dst_stride == 1 && src_stride == 1)							\
+		name##_##arch(dst, src, scale, n_bytes);					\
+	else											\
+		name##_i_c(dst, dst_stride, src, src_stride, scale, n_bytes);			\
+}
+
+#if defined(HAVE_SSE2)
+void spa_audiomixer_get_ops_sse2(struct spa_audiomixer_ops *ops);
+#endif
+#if defined(HAVE_AVX2)
+void spa_audiomixer_get_ops_avx2(struct spa_audiomixer_ops *ops);
+#endif
+#if defined(HAVE_NEON)
+void spa_audiomixer_get_ops_neon(struct spa_audiomixer_ops *ops);
+#endif
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __SPA_LIBMIX_H__ */
@@ -21,7 +21,9 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <alloca.h>
 
 #include <spa/param/props.h>
 #include <spa/pod/iter.h>
@@ -76,6 +78,143 @@ static int compare_value(enum spa_pod_type type, const void *r1, const void *r2)
 	return 0;
 }
 
+/* enum alternatives are intersected by sorting the alternatives of one side
+ * when there are enough of them. This only works for the types where the
+ * values that compare_value() finds equal are also equal in an order. */
+#define MIN_SORT_VALUES		8
+#define MAX_SORT_VALUES		4096
+
+typedef int (*order_func_t) (const void *v1, const void *v2);
+
+static int order_id(const void *v1, const void *v2)
+{
+	uint32_t i1 = *(uint32_t *) v1, i2 = *(uint32_t *) v2;
+	return i1 < i2 ? -1 : i1 > i2 ? 1 : 0;
+}
+
+static int order_int(const void *v1, const void *v2)
+{
+	int32_t i1 = *(int32_t *) v1, i2 = *(int32_t *) v2;
+	return i1 < i2 ? -1 : i1 > i2 ? 1 : 0;
+}
+
+static int order_string(const void *v1, const void *v2)
+{
+	return strcmp(v1, v2);
+}
+
+static int order_rectangle(const void *v1, const void *v2)
+{
+	const struct spa_rectangle *rec1 = v1, *rec2 = v2;
+	if (rec1->width != rec2->width)
+		return rec1->width < rec2->width ? -1 : 1;
+	if (rec1->height != rec2->height)
+		return rec1->height < rec2->height ? -1 : 1;
+	return 0;
+}
+
+static int order_fraction(const void *v1, const void *v2)
+{
+	return compare_value(SPA_POD_TYPE_FRACTION, v1, v2);
+}
+
+#define DEFINE_SORT(name)						\
+static int sort_##name(const void *p1, const void *p2)			\
+{									\
+	return order_##name(*(const void **) p1, *(const void **) p2);	\
+}
+DEFINE_SORT(id)
+DEFINE_SORT(int)
+DEFINE_SORT(string)
+DEFINE_SORT(rectangle)
+DEFINE_SORT(fraction)
+
+static bool has_zero_denom(const void *alt, int nalt)
+{
+	const struct spa_fraction *f = alt;
+	int i;
+
+	for (i = 0; i < nalt; i++) {
+		if (f[i].denom == 0)
+			return true;
+	}
+	return false;
+}
+
+/* copy each value of alt1 that is in alt2 as many times as it is in alt2,
+ * like comparing all pairs would. Returns the number of matches or -ENOTSUP
+ * when the values can't be sorted */
+static int
+copy_equal_sorted(struct spa_pod_builder *b, uint32_t type, uint32_t size,
+		  const void *alt1, int nalt1, const void *alt2, int nalt2, int skip_first)
+{
+	const void **sorted;
+	order_func_t order;
+	int (*sort) (const void *, const void *);
+	int i, j, n_copied = 0, log2;
+
+	if (nalt1 < MIN_SORT_VALUES || nalt2 < MIN_SORT_VALUES || nalt2 > MAX_SORT_VALUES)
+		return -ENOTSUP;
+
+	/* sorting only pays off when there are more lookups than the
+	 * compares of a sort of one value */
+	for (log2 = 0; (1 << log2) < nalt2; log2++);
+	if (nalt1 < 2 * log2)
+		return -ENOTSUP;
+
+	switch (type) {
+	case SPA_POD_TYPE_BOOL:
+	case SPA_POD_TYPE_ID:
+		order = order_id;
+		sort = sort_id;
+		break;
+	case SPA_POD_TYPE_INT:
+		order = order_int;
+		sort = sort_int;
+		break;
+	case SPA_POD_TYPE_STRING:
+		order = order_string;
+		sort = sort_string;
+		break;
+	case SPA_POD_TYPE_RECTANGLE:
+		order = order_rectangle;
+		sort = sort_rectangle;
+		break;
+	case SPA_POD_TYPE_FRACTION:
+		/* 0/0 is equal to all fractions */
+		if (has_zero_denom(alt1, nalt1) || has_zero_denom(alt2, nalt2))
+			return -ENOTSUP;
+		order = order_fraction;
+		sort = sort_fraction;
+		break;
+	default:
+		return -ENOTSUP;
+	}
+
+	sorted = alloca(nalt2 * sizeof(void *));
+	for (i = 0; i < nalt2; i++)
+		sorted[i] = SPA_MEMBER(alt2, i * size, void);
+	qsort(sorted, nalt2, sizeof(void *), sort);
+
+	for (j = 0; j < nalt1; j++, alt1 = SPA_MEMBER(alt1, size, void)) {
+		int lo = 0, hi = nalt2, mid;
+
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (order(sorted[mid], alt1) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (i = lo; i < nalt2 && order(sorted[i], alt1) == 0; i++) {
+			if (j >= skip_first)
+				spa_pod_builder_raw(b, alt1, size);
+			n_copied++;
+		}
+	}
+	return n_copied;
+}
+
 static void fix_default(struct spa_pod_prop *prop)
 {
 	void *val = SPA_MEMBER(prop, sizeof(struct spa_pod_prop), void),
@@ -121,15 +260,28 @@ static void fix_default(struct spa_pod_prop *prop)
 	}
 }
 
-static inline struct spa_pod_prop *find_prop(const struct spa_pod *pod, uint32_t size, uint32_t key)
+static inline bool is_prop(const struct spa_pod *pod, uint32_t key)
+{
+	return pod->type == SPA_POD_TYPE_PROP && ((struct spa_pod_prop *) pod)->body.key == key;
+}
+
+/* the props of a pod and of its filter are usually in the same order, \a hint
+ * is the pod after the last prop that was found and is tried first */
+static inline struct spa_pod_prop *find_prop(const struct spa_pod *pod, uint32_t size,
+					     const struct spa_pod **hint, uint32_t key)
 {
-	const struct spa_pod *res;
-	SPA_POD_FOREACH(pod, size, res) {
-		if (res->type == SPA_POD_TYPE_PROP
-		    && ((struct spa_pod_prop *) res)->body.key == key)
-			return (struct spa_pod_prop *) res;
+	const struct spa_pod *res = *hint;
+
+	if (res == NULL || !spa_pod_is_inside(pod, size, res) || !is_prop(res, key)) {
+		SPA_POD_FOREACH(pod, size, res) {
+			if (is_prop(res, key))
+				break;
+		}
+		if (!spa_pod_is_inside(pod, size, res))
+			return NULL;
 	}
-	return NULL;
+	*hint = spa_pod_next(res);
+	return (struct spa_pod_prop *) res;
 }
 
 static int
@@ -181,14 +333,20 @@ filter_prop(struct spa_pod_builder *b,
 	    (rt1 == SPA_POD_PROP_RANGE_NONE && rt2 == SPA_POD_PROP_RANGE_ENUM) ||
 	    (rt1 == SPA_POD_PROP_RANGE_ENUM && rt2 == SPA_POD_PROP_RANGE_NONE) ||
 	    (rt1 == SPA_POD_PROP_RANGE_ENUM && rt2 == SPA_POD_PROP_RANGE_ENUM)) {
-		int n_copied = 0;
+		int n_copied;
 		/* copy all equal values but don't copy the default value again */
-		for (j = 0, a1 = alt1; j < nalt1; j++, a1 += p1->body.value.size) {
-			for (k = 0, a2 = alt2; k < nalt2; k++, a2 += p2->body.value.size) {
-				if (compare_value(p1->body.value.type, a1, a2) == 0) {
-					if (rt1 == SPA_POD_PROP_RANGE_ENUM || j > 0)
-						spa_pod_builder_raw(b, a1, p1->body.value.size);
-					n_copied++;
+		n_copied = copy_equal_sorted(b, p1->body.value.type, p1->body.value.size,
+					     alt1, nalt1, alt2, nalt2,
+					     rt1 == SPA_POD_PROP_RANGE_ENUM ? 0 : 1);
+		if (n_copied == -ENOTSUP) {
+			n_copied = 0;
+			for (j = 0, a1 = alt1; j < nalt1; j++, a1 += p1->body.value.size) {
+				for (k = 0, a2 = alt2; k < nalt2; k++, a2 += p2->body.value.size) {
+					if (compare_value(p1->body.value.type, a1, a2) == 0) {
+						if (rt1 == SPA_POD_PROP_RANGE_ENUM || j > 0)
+							spa_pod_builder_raw(b, a1, p1->body.value.size);
+						n_copied++;
+					}
 				}
 			}
 		}
@@ -298,7 +456,7 @@ int pod_filter(struct spa_pod_builder *b,
 	       const struct spa_pod *pod, uint32_t pod_size,
 	       const struct spa_pod *filter, uint32_t filter_size)
 {
-	const struct spa_pod *pp, *pf, *tmp;
+	const struct spa_pod *pp, *pf, *tmp, *hint = NULL;
 	int res = 0;
 
 	pf = filter;
@@ -333,7 +491,7 @@ int pod_filter(struct spa_pod_builder *b,
 			struct spa_pod_prop *p1, *p2;
 
 			p1 = (struct spa_pod_prop *) pp;
-			p2 = find_prop(filter, filter_size, p1->body.key);
+			p2 = find_prop(filter, filter_size, &hint, p1->body.key);
 
 			if (p2 != NULL)
 				res = filter_prop(b, p1, p2);
@@ -404,7 +562,7 @@ spa_pod_filter(struct spa_pod_builder *b,
 int pod_compare(const struct spa_pod *pod1, uint32_t pod1_size,
 		const struct spa_pod *pod2, uint32_t pod2_size)
 {
-	const struct spa_pod *p1, *p2;
+	const struct spa_pod *p1, *p2, *hint = NULL;
 	int res;
 
 	p2 = pod2;
@@ -435,7 +593,7 @@ int pod_compare(const struct spa_pod *pod1, uint32_t pod1_size,
 			void *a1, *a2;
 
 			pr1 = (struct spa_pod_prop *) p1;
-			pr2 = find_prop(pod2, pod2_size, pr1->body.key);
+			pr2 = find_prop(pod2, pod2_size, &hint, pr1->body.key);
 
 			if (pr2 == NULL)
 				return -EINVAL;
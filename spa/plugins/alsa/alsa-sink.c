@@ -385,6 +385,7 @@ impl_node_port_enum_params(struct spa_node *node,
 static int clear_buffers(struct state *this)
 {
 	if (this->n_buffers > 0) {
+		spa_alsa_restore_buffers(this);
 		spa_list_init(&this->ready);
 		this->n_buffers = 0;
 	}
@@ -492,6 +493,8 @@ impl_node_port_use_buffers(struct spa_node *node,
 
 		b->h = spa_buffer_find_meta(b->outbuf, this->type.meta.Header);
 		b->rb = spa_buffer_find_meta(b->outbuf, this->type.meta.Ringbuffer);
+		b->ptr = buffers[i]->datas[0].data;
+		b->maxsize = buffers[i]->datas[0].maxsize;
 
 		type = buffers[i]->datas[0].type;
 		if ((type == this->type.data.MemFd ||
@@ -410,6 +410,7 @@ impl_node_port_enum_params(struct spa_node *node,
 static int clear_buffers(struct state *this)
 {
 	if (this->n_buffers > 0) {
+		spa_alsa_restore_buffers(this);
 		spa_list_init(&this->free);
 		spa_list_init(&this->ready);
 		this->n_buffers = 0;
@@ -512,6 +513,9 @@ impl_node_port_use_buffers(struct spa_node *node,
 		b->outstanding = false;
 
 		b->h = spa_buffer_find_meta(b->outbuf, this->type.meta.Header);
+		b->rb = NULL;
+		b->ptr = d[0].data;
+		b->maxsize = d[0].maxsize;
 
 		if (!((d[0].type == this->type.data.MemFd ||
 		       d[0].type == this->type.data.DmaBuf ||
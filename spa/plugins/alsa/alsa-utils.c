@@ -316,12 +316,77 @@ static int set_swparams(struct state *state)
 	return 0;
 }
 
-static inline void try_pull(struct state *state, snd_pcm_uframes_t frames, bool do_pull)
+/* Zero-copy is possible when the samples of a frame are next to each other
+ * in the mmap area, as in our buffers. The buffers must have dynamic data
+ * and no ringbuffer. */
+static inline bool can_zero_copy(struct state *state, const snd_pcm_channel_area_t *areas)
+{
+	uint32_t i, sample_bits = state->frame_size * 8 / state->channels;
+
+	for (i = 0; i < state->channels; i++) {
+		if (areas[i].addr != areas[0].addr ||
+		    areas[i].first != i * sample_bits ||
+		    areas[i].step != state->frame_size * 8)
+			return false;
+	}
+	return true;
+}
+
+static inline bool is_dynamic(struct buffer *b)
+{
+	return (b->outbuf->datas[0].flags & SPA_DATA_FLAG_DYNAMIC) && b->rb == NULL;
+}
+
+/* point the data of all dynamic buffers to data or restore the original
+ * memory when data is NULL */
+static void set_buffers_data(struct state *state, void *data, uint32_t maxsize)
+{
+	uint32_t i;
+
+	for (i = 0; i < state->n_buffers; i++) {
+		struct buffer *b = &state->buffers[i];
+		struct spa_data *d = b->outbuf->datas;
+
+		if (!is_dynamic(b))
+			continue;
+
+		if (data) {
+			d[0].data = data;
+			d[0].maxsize = SPA_MIN(maxsize, b->maxsize);
+		} else {
+			d[0].data = b->ptr;
+			d[0].maxsize = b->maxsize;
+		}
+	}
+}
+
+void spa_alsa_restore_buffers(struct state *state)
+{
+	set_buffers_data(state, NULL, 0);
+}
+
+/* pull a new buffer, upstream can render at most \a space frames into the
+ * ring at \a offset */
+static inline void try_pull(struct state *state,
+			    const snd_pcm_channel_area_t *my_areas,
+			    snd_pcm_uframes_t offset, snd_pcm_uframes_t space,
+			    snd_pcm_uframes_t frames, bool do_pull)
 {
 	struct spa_port_io *io = state->io;
 
 	if (spa_list_is_empty(&state->ready) && do_pull) {
 		spa_log_trace(state->log, "alsa-util %p: %d", state, io->status);
+
+		/* let upstream render into the device ring. We only do this
+		 * when nothing is queued, the data of queued buffers must not
+		 * move */
+		if (space > 0 && can_zero_copy(state, my_areas))
+			set_buffers_data(state,
+					 SPA_MEMBER(my_areas[0].addr, offset * state->frame_size, void),
+					 space * state->frame_size);
+		else
+			set_buffers_data(state, NULL, 0);
+
 		io->status = SPA_STATUS_NEED_BUFFER;
 		io->range.offset = state->sample_count * state->frame_size;
 		io->range.min_size = state->threshold * state->frame_size;
@@ -340,7 +405,7 @@ pull_frames(struct state *state,
 	snd_pcm_uframes_t total_frames = 0, to_write = SPA_MIN(frames, state->props.max_latency);
 	bool underrun = false;
 
-	try_pull(state, frames, do_pull);
+	try_pull(state, my_areas, offset, to_write, frames, do_pull);
 
 	while (!spa_list_is_empty(&state->ready) && to_write > 0) {
 		uint8_t *src, *dst;
@@ -353,7 +418,7 @@ pull_frames(struct state *state,
 		b = spa_list_first(&state->ready, struct buffer, link);
 		d = b->outbuf->datas;
 
-		dst = SPA_MEMBER(my_areas[0].addr, offset * state->frame_size, uint8_t);
+		dst = SPA_MEMBER(my_areas[0].addr, (offset + total_frames) * state->frame_size, uint8_t);
 
 		if (b->rb) {
 			struct spa_ringbuffer *ringbuffer = &b->rb->ringbuffer;
@@ -379,7 +444,10 @@ pull_frames(struct state *state,
 			n_bytes = SPA_MIN(size, to_write * state->frame_size);
 			n_frames = SPA_MIN(to_write, n_bytes / state->frame_size);
 
-			memcpy(dst, src, n_bytes);
+			/* when upstream rendered into the ring the data is
+			 * already in place */
+			if (src != dst)
+				memcpy(dst, src, n_bytes);
 
 			state->ready_offset += n_bytes;
 			reuse = (state->ready_offset >= size);
@@ -396,7 +464,11 @@ pull_frames(struct state *state,
 		spa_log_trace(state->log, "alsa-util %p: written %lu frames, left %ld", state, total_frames, to_write);
 	}
 
-	try_pull(state, frames, do_pull);
+	/* the next buffer goes right after what we wrote now. When nothing
+	 * was written, the ring is filled with silence below and the buffer
+	 * can't go there */
+	try_pull(state, my_areas, offset + total_frames,
+		 total_frames > 0 ? to_write : 0, frames, do_pull);
 
 	if (total_frames == 0 && do_pull) {
 		total_frames = SPA_MIN(frames, state->threshold);
@@ -442,11 +514,21 @@ push_frames(struct state *state,
 
 		d = b->outbuf->datas;
 
-		total_frames = SPA_MIN(frames, d[0].maxsize / state->frame_size);
+		total_frames = SPA_MIN(frames, b->maxsize / state->frame_size);
 		src = SPA_MEMBER(my_areas[0].addr, offset * state->frame_size, uint8_t);
 		n_bytes = total_frames * state->frame_size;
 
-		memcpy(d[0].data, src, n_bytes);
+		/* give the captured samples in the device ring to downstream. They
+		 * stay valid until the device wraps around, about the size of the
+		 * ring later */
+		if (is_dynamic(b) && can_zero_copy(state, my_areas)) {
+			d[0].data = src;
+			d[0].maxsize = n_bytes;
+		} else {
+			d[0].data = b->ptr;
+			d[0].maxsize = b->maxsize;
+			memcpy(d[0].data, src, n_bytes);
+		}
 
 		d[0].chunk->offset = 0;
 		d[0].chunk->size = n_bytes;
@@ -676,6 +758,7 @@ int spa_alsa_start(struct state *state, bool xrun_recover)
 	state->source.fd = state->timerfd;
 	state->source.mask = SPA_IO_IN;
 	state->source.rmask = 0;
+	state->source.priority = SPA_SOURCE_PRIORITY_HIGH;
 	spa_loop_add_source(state->data_loop, &state->source);
 
 	state->threshold = state->props.min_latency;
@@ -56,6 +56,8 @@ struct buffer {
 	struct spa_meta_ringbuffer *rb;
 	bool outstanding;
 	struct spa_list link;
+	void *ptr;		/* the data pointer and maxsize of the buffer, */
+	uint32_t maxsize;	/* restored after mmap zero-copy */
 };
 
 struct type {
@@ -175,6 +177,8 @@ spa_alsa_enum_format(struct state *state,
 
 int spa_alsa_set_format(struct state *state, struct spa_audio_info *info, uint32_t flags);
 
+void spa_alsa_restore_buffers(struct state *state);
+
 int spa_alsa_start(struct state *state, bool xrun_recover);
 int spa_alsa_pause(struct state *state, bool xrun_recover);
 int spa_alsa_close(struct state *state);
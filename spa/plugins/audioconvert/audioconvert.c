@@ -0,0 +1,951 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <spa/support/log.h>
+#include <spa/support/type-map.h>
+#include <spa/utils/list.h>
+#include <spa/node/node.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/buffers.h>
+#include <spa/param/meta.h>
+
+#include <lib/pod.h>
+
+#include "fmt-ops.h"
+#include "channelmix-ops.h"
+
+#define NAME "audioconvert"
+
+#define MAX_BUFFERS     16
+#define MAX_CHANNELS    64
+/* frames converted at a time through the planar float buffers */
+#define MAX_SAMPLES     256
+
+struct buffer {
+	struct spa_buffer *outbuf;
+	bool outstanding;
+	struct spa_meta_header *h;
+	struct spa_list link;
+};
+
+struct port {
+	bool have_format;
+	struct spa_audio_info format;
+	int fmt;
+	uint32_t bpf;
+
+	struct spa_port_info info;
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_port_io *io;
+
+	struct spa_list empty;
+};
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	struct spa_type_param param;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+	struct spa_type_command_node command_node;
+	struct spa_type_param_buffers param_buffers;
+	struct spa_type_param_meta param_meta;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_param_map(map, &type->param);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_buffers_map(map, &type->param_buffers);
+	spa_type_param_meta_map(map, &type->param_meta);
+}
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct type type;
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	const struct spa_node_callbacks *callbacks;
+	void *callbacks_data;
+
+	uint32_t cpu_flags;
+	struct spa_fmt_ops fmt_ops;
+	struct spa_channelmix_ops mix_ops;
+
+	struct port in_ports[1];
+	struct port out_ports[1];
+
+	/* same format on both sides, samples are copied */
+	bool passthrough;
+	/* same number of channels, no mixing needed */
+	bool identity;
+	float matrix[MAX_CHANNELS * MAX_CHANNELS];
+
+	float in_planes[MAX_CHANNELS][MAX_SAMPLES];
+	float out_planes[MAX_CHANNELS][MAX_SAMPLES];
+
+	bool started;
+};
+
+#define CHECK_IN_PORT(this,d,p)  ((d) == SPA_DIRECTION_INPUT && (p) == 0)
+#define CHECK_OUT_PORT(this,d,p) ((d) == SPA_DIRECTION_OUTPUT && (p) == 0)
+#define CHECK_PORT(this,d,p)     ((p) == 0)
+#define GET_IN_PORT(this,p)	 (&this->in_ports[p])
+#define GET_OUT_PORT(this,p)	 (&this->out_ports[p])
+#define GET_PORT(this,d,p)	 (d == SPA_DIRECTION_INPUT ? GET_IN_PORT(this,p) : GET_OUT_PORT(this,p))
+
+static int impl_node_enum_params(struct spa_node *node,
+				 uint32_t id, uint32_t *index,
+				 const struct spa_pod *filter,
+				 struct spa_pod **result,
+				 struct spa_pod_builder *builder)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+	spa_return_val_if_fail(builder != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (id == this->type.param.idList)
+		return 0;
+
+	return -ENOENT;
+}
+
+static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flags,
+			       const struct spa_pod *param)
+{
+	return -ENOENT;
+}
+
+static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(command != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (SPA_COMMAND_TYPE(command) == this->type.command_node.Start) {
+		this->started = true;
+	} else if (SPA_COMMAND_TYPE(command) == this->type.command_node.Pause) {
+		this->started = false;
+	} else
+		return -ENOTSUP;
+
+	return 0;
+}
+
+static int
+impl_node_set_callbacks(struct spa_node *node,
+			const struct spa_node_callbacks *callbacks,
+			void *data)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	this->callbacks = callbacks;
+	this->callbacks_data = data;
+
+	return 0;
+}
+
+static int
+impl_node_get_n_ports(struct spa_node *node,
+		      uint32_t *n_input_ports,
+		      uint32_t *max_input_ports,
+		      uint32_t *n_output_ports,
+		      uint32_t *max_output_ports)
+{
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	if (n_input_ports)
+		*n_input_ports = 1;
+	if (max_input_ports)
+		*max_input_ports = 1;
+	if (n_output_ports)
+		*n_output_ports = 1;
+	if (max_output_ports)
+		*max_output_ports = 1;
+
+	return 0;
+}
+
+static int
+impl_node_get_port_ids(struct spa_node *node,
+		       uint32_t n_input_ports,
+		       uint32_t *input_ids,
+		       uint32_t n_output_ports,
+		       uint32_t *output_ids)
+{
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	if (n_input_ports > 0 && input_ids)
+		input_ids[0] = 0;
+	if (n_output_ports > 0 && output_ids)
+		output_ids[0] = 0;
+
+	return 0;
+}
+
+static int impl_node_add_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_remove_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_get_info(struct spa_node *node,
+			enum spa_direction direction,
+			uint32_t port_id,
+			const struct spa_port_info **info)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+	*info = &port->info;
+
+	return 0;
+}
+
+static int get_fmt(struct impl *this, uint32_t format)
+{
+	struct spa_type_audio_format *f = &this->type.audio_format;
+
+	if (format == f->S16)
+		return FMT_S16;
+	if (format == f->S24)
+		return FMT_S24;
+	if (format == f->S24_32)
+		return FMT_S24_32;
+	if (format == f->S32)
+		return FMT_S32;
+	if (format == f->F32)
+		return FMT_F32;
+	if (format == f->F64)
+		return FMT_F64;
+	return -1;
+}
+
+/* Any format and number of channels can be converted to any other but the
+ * rate is the same on both sides, once one side has a format the other side
+ * prefers the same format. */
+static int port_enum_formats(struct spa_node *node,
+			     enum spa_direction direction, uint32_t port_id,
+			     uint32_t *index,
+			     const struct spa_pod *filter,
+			     struct spa_pod **param,
+			     struct spa_pod_builder *builder)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct type *t = &this->type;
+	struct port *other;
+	uint32_t format, channels;
+
+	other = direction == SPA_DIRECTION_INPUT ? GET_OUT_PORT(this, 0) : GET_IN_PORT(this, 0);
+
+	format = other->have_format ? other->format.info.raw.format : t->audio_format.F32;
+	channels = other->have_format ? other->format.info.raw.channels : 2;
+
+	switch (*index) {
+	case 0:
+		spa_pod_builder_push_object(builder, t->param.idEnumFormat, t->format);
+		spa_pod_builder_add(builder,
+			"I", t->media_type.audio,
+			"I", t->media_subtype.raw,
+			":", t->format_audio.format,  "Ieu", format,
+								6, t->audio_format.S16,
+								   t->audio_format.S24,
+								   t->audio_format.S24_32,
+								   t->audio_format.S32,
+								   t->audio_format.F32,
+								   t->audio_format.F64, NULL);
+		if (other->have_format)
+			spa_pod_builder_add(builder,
+				":", t->format_audio.rate, "i", other->format.info.raw.rate, NULL);
+		else
+			spa_pod_builder_add(builder,
+				":", t->format_audio.rate, "iru", 44100, 2, 1, INT32_MAX, NULL);
+		spa_pod_builder_add(builder,
+			":", t->format_audio.channels, "iru", channels, 2, 1, MAX_CHANNELS, NULL);
+		*param = spa_pod_builder_pop(builder);
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+static int port_get_format(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t *index,
+			   const struct spa_pod *filter,
+			   struct spa_pod **param,
+			   struct spa_pod_builder *builder)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port;
+	struct type *t = &this->type;
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return -EIO;
+	if (*index > 0)
+		return 0;
+
+	*param = spa_pod_builder_object(builder,
+			t->param.idFormat, t->format,
+			"I", t->media_type.audio,
+			"I", t->media_subtype.raw,
+			":", t->format_audio.format,   "I", port->format.info.raw.format,
+			":", t->format_audio.rate,     "i", port->format.info.raw.rate,
+			":", t->format_audio.channels, "i", port->format.info.raw.channels);
+
+	return 1;
+}
+
+static int
+impl_node_port_enum_params(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t id, uint32_t *index,
+			   const struct spa_pod *filter,
+			   struct spa_pod **result,
+			   struct spa_pod_builder *builder)
+{
+	struct impl *this;
+	struct type *t;
+	struct port *port;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	int res;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+	spa_return_val_if_fail(builder != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	if (id == t->param.idList) {
+		uint32_t list[] = { t->param.idEnumFormat,
+				    t->param.idFormat,
+				    t->param.idBuffers,
+				    t->param.idMeta };
+
+		if (*index < SPA_N_ELEMENTS(list))
+			param = spa_pod_builder_object(&b, id, t->param.List,
+				":", t->param.listId, "I", list[*index]);
+		else
+			return 0;
+	}
+	else if (id == t->param.idEnumFormat) {
+		if ((res = port_enum_formats(node, direction, port_id, index, filter, &param, &b)) <= 0)
+			return res;
+	}
+	else if (id == t->param.idFormat) {
+		if ((res = port_get_format(node, direction, port_id, index, filter, &param, &b)) <= 0)
+			return res;
+	}
+	else if (id == t->param.idBuffers) {
+		if (!port->have_format)
+			return -EIO;
+		if (*index > 0)
+			return 0;
+
+		param = spa_pod_builder_object(&b,
+			id, t->param_buffers.Buffers,
+			":", t->param_buffers.size,    "iru", 1024 * port->bpf,
+									2, 16 * port->bpf,
+									   INT32_MAX / port->bpf,
+			":", t->param_buffers.stride,  "i", port->bpf,
+			":", t->param_buffers.buffers, "iru", 2,
+									2, 1, MAX_BUFFERS,
+			":", t->param_buffers.align,   "i", 16);
+	}
+	else if (id == t->param.idMeta) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_meta.Meta,
+				":", t->param_meta.type, "I", t->meta.Header,
+				":", t->param_meta.size, "i", sizeof(struct spa_meta_header));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else
+		return -ENOENT;
+
+	(*index)++;
+
+	if (spa_pod_filter(builder, result, param, filter) < 0)
+		goto next;
+
+	return 1;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers", this);
+		port->n_buffers = 0;
+		spa_list_init(&port->empty);
+	}
+	return 0;
+}
+
+/* pick the conversion once both sides have a format */
+static void setup_convert(struct impl *this)
+{
+	struct port *in_port = GET_IN_PORT(this, 0), *out_port = GET_OUT_PORT(this, 0);
+	uint32_t n_in, n_out;
+
+	if (!in_port->have_format || !out_port->have_format)
+		return;
+
+	n_in = in_port->format.info.raw.channels;
+	n_out = out_port->format.info.raw.channels;
+
+	this->identity = spa_channelmix_default_matrix(this->matrix, n_out, n_in);
+	this->passthrough = this->identity && in_port->fmt == out_port->fmt;
+
+	spa_log_info(this->log, NAME " %p: %d/%u -> %d/%u passthrough:%d identity:%d", this,
+		     in_port->fmt, n_in, out_port->fmt, n_out, this->passthrough, this->identity);
+}
+
+static int port_set_format(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t flags,
+			   const struct spa_pod *format)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port, *other;
+
+	port = GET_PORT(this, direction, port_id);
+	other = direction == SPA_DIRECTION_INPUT ? GET_OUT_PORT(this, 0) : GET_IN_PORT(this, 0);
+
+	if (format == NULL) {
+		port->have_format = false;
+		clear_buffers(this, port);
+	} else {
+		struct spa_audio_info info = { 0 };
+		int fmt;
+
+		spa_pod_object_parse(format,
+			"I", &info.media_type,
+			"I", &info.media_subtype);
+
+		if (info.media_type != this->type.media_type.audio ||
+		    info.media_subtype != this->type.media_subtype.raw)
+			return -EINVAL;
+
+		if (spa_format_audio_raw_parse(format, &info.info.raw, &this->type.format_audio) < 0)
+			return -EINVAL;
+
+		if (info.info.raw.channels == 0 || info.info.raw.channels > MAX_CHANNELS)
+			return -EINVAL;
+		if (info.info.raw.layout != SPA_AUDIO_LAYOUT_INTERLEAVED)
+			return -EINVAL;
+		/* no resampling */
+		if (other->have_format && other->format.info.raw.rate != info.info.raw.rate)
+			return -EINVAL;
+
+		if ((fmt = get_fmt(this, info.info.raw.format)) < 0)
+			return -EINVAL;
+
+		port->format = info;
+		port->fmt = fmt;
+		port->bpf = spa_fmt_sample_size(fmt) * info.info.raw.channels;
+		port->have_format = true;
+
+		setup_convert(this);
+	}
+
+	return 0;
+}
+
+static int
+impl_node_port_set_param(struct spa_node *node,
+			 enum spa_direction direction, uint32_t port_id,
+			 uint32_t id, uint32_t flags,
+			 const struct spa_pod *param)
+{
+	struct impl *this;
+	struct type *t;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	if (id == t->param.idFormat) {
+		return port_set_format(node, direction, port_id, flags, param);
+	}
+	else
+		return -ENOENT;
+}
+
+static int
+impl_node_port_use_buffers(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   struct spa_buffer **buffers,
+			   uint32_t n_buffers)
+{
+	struct impl *this;
+	struct port *port;
+	uint32_t i;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return -EIO;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+
+		b = &port->buffers[i];
+		b->outbuf = buffers[i];
+		b->outstanding = direction == SPA_DIRECTION_INPUT;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+
+		if (!((d[0].type == this->type.data.MemPtr ||
+		       d[0].type == this->type.data.MemFd ||
+		       d[0].type == this->type.data.DmaBuf) && d[0].data != NULL)) {
+			spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+				      buffers[i]);
+			return -EINVAL;
+		}
+		if (!b->outstanding)
+			spa_list_append(&port->empty, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return 0;
+}
+
+static int
+impl_node_port_alloc_buffers(struct spa_node *node,
+			     enum spa_direction direction,
+			     uint32_t port_id,
+			     struct spa_pod **params,
+			     uint32_t n_params,
+			     struct spa_buffer **buffers,
+			     uint32_t *n_buffers)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_set_io(struct spa_node *node,
+		      enum spa_direction direction,
+		      uint32_t port_id,
+		      struct spa_port_io *io)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+	port->io = io;
+
+	return 0;
+}
+
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct buffer *b = &port->buffers[id];
+
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+
+	spa_list_append(&port->empty, &b->link);
+	b->outstanding = false;
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, SPA_DIRECTION_OUTPUT, port_id),
+			       -EINVAL);
+
+	port = GET_OUT_PORT(this, port_id);
+
+	if (buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	recycle_buffer(this, buffer_id);
+
+	return 0;
+}
+
+static int
+impl_node_port_send_command(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    const struct spa_command *command)
+{
+	return -ENOTSUP;
+}
+
+static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->empty))
+		return NULL;
+
+	b = spa_list_first(&port->empty, struct buffer, link);
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	return b->outbuf;
+}
+
+/* convert to planar float, mix the channels and convert to the output
+ * format, MAX_SAMPLES frames at a time */
+static void convert_frames(struct impl *this, void *dst, const void *src, uint32_t n_frames)
+{
+	struct port *in_port = GET_IN_PORT(this, 0), *out_port = GET_OUT_PORT(this, 0);
+	uint32_t i, n, n_in, n_out;
+	void *in[MAX_CHANNELS], *out[MAX_CHANNELS];
+
+	if (this->passthrough) {
+		memcpy(dst, src, n_frames * out_port->bpf);
+		return;
+	}
+
+	n_in = in_port->format.info.raw.channels;
+	n_out = out_port->format.info.raw.channels;
+
+	for (i = 0; i < n_in; i++)
+		in[i] = this->in_planes[i];
+	for (i = 0; i < n_out; i++)
+		out[i] = this->identity ? this->in_planes[i] : this->out_planes[i];
+
+	while (n_frames > 0) {
+		n = SPA_MIN(n_frames, MAX_SAMPLES);
+
+		this->fmt_ops.to_f32d[in_port->fmt](in, &src, n_in, n);
+		if (!this->identity)
+			this->mix_ops.mix(out, n_out, (const void **) in, n_in, this->matrix, n);
+		this->fmt_ops.from_f32d[out_port->fmt](&dst, (const void **) out, n_out, n);
+
+		src = SPA_MEMBER(src, n * in_port->bpf, void);
+		dst = SPA_MEMBER(dst, n * out_port->bpf, void);
+		n_frames -= n;
+	}
+}
+
+static void do_convert(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
+{
+	struct port *in_port = GET_IN_PORT(this, 0), *out_port = GET_OUT_PORT(this, 0);
+	struct spa_data *sd = &sbuf->datas[0], *dd = &dbuf->datas[0];
+	uint32_t n_frames;
+
+	n_frames = SPA_MIN(sd->chunk->size / in_port->bpf, dd->maxsize / out_port->bpf);
+
+	convert_frames(this, dd->data,
+		       SPA_MEMBER(sd->data, sd->chunk->offset, void), n_frames);
+
+	dd->chunk->offset = 0;
+	dd->chunk->size = n_frames * out_port->bpf;
+	dd->chunk->stride = out_port->bpf;
+}
+
+static int impl_node_process_input(struct spa_node *node)
+{
+	struct impl *this;
+	struct spa_port_io *input;
+	struct spa_port_io *output;
+	struct port *in_port, *out_port;
+	struct spa_buffer *dbuf, *sbuf;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, -EIO);
+
+	if (output->status == SPA_STATUS_HAVE_BUFFER)
+		return SPA_STATUS_HAVE_BUFFER;
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, -EIO);
+
+	if (input->buffer_id >= in_port->n_buffers)
+		return SPA_STATUS_NEED_BUFFER;
+
+	if ((dbuf = find_free_buffer(this, out_port)) == NULL) {
+		spa_log_error(this->log, NAME " %p: out of buffers", this);
+		return -EPIPE;
+	}
+
+	sbuf = in_port->buffers[input->buffer_id].outbuf;
+
+	input->status = SPA_STATUS_OK;
+
+	spa_log_trace(this->log, NAME " %p: convert %d -> %d", this, sbuf->id, dbuf->id);
+	do_convert(this, dbuf, sbuf);
+
+	output->buffer_id = dbuf->id;
+	output->status = SPA_STATUS_HAVE_BUFFER;
+
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static int impl_node_process_output(struct spa_node *node)
+{
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_port_io *input, *output;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, -EIO);
+
+	if (output->status == SPA_STATUS_HAVE_BUFFER)
+		return SPA_STATUS_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id < out_port->n_buffers) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, -EIO);
+
+	/* the range is in bytes, ask for the same number of frames */
+	input->range.offset = output->range.offset / out_port->bpf * in_port->bpf;
+	input->range.min_size = output->range.min_size / out_port->bpf * in_port->bpf;
+	input->range.max_size = output->range.max_size / out_port->bpf * in_port->bpf;
+	input->status = SPA_STATUS_NEED_BUFFER;
+
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+static const struct spa_node impl_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	impl_node_enum_params,
+	impl_node_set_param,
+	impl_node_send_command,
+	impl_node_set_callbacks,
+	impl_node_get_n_ports,
+	impl_node_get_port_ids,
+	impl_node_add_port,
+	impl_node_remove_port,
+	impl_node_port_get_info,
+	impl_node_port_enum_params,
+	impl_node_port_set_param,
+	impl_node_port_use_buffers,
+	impl_node_port_alloc_buffers,
+	impl_node_port_set_io,
+	impl_node_port_reuse_buffer,
+	impl_node_port_send_command,
+	impl_node_process_input,
+	impl_node_process_output,
+};
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id, void **interface)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	if (interface_id == this->type.node)
+		*interface = &this->node;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	return 0;
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *this;
+	uint32_t i;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < n_support; i++) {
+		if (strcmp(support[i].type, SPA_TYPE__TypeMap) == 0)
+			this->map = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE__Log) == 0)
+			this->log = support[i].data;
+	}
+	if (this->map == NULL) {
+		spa_log_error(this->log, "a type-map is needed");
+		return -EINVAL;
+	}
+	init_type(&this->type, this->map);
+
+	this->node = impl_node;
+
+	this->cpu_flags = spa_cpu_get_flags();
+	spa_fmt_get_ops(&this->fmt_ops, this->cpu_flags);
+	spa_channelmix_get_ops(&this->mix_ops, this->cpu_flags);
+	spa_log_info(this->log, NAME " %p: cpu flags %08x", this, this->cpu_flags);
+
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].empty);
+
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->out_ports[0].empty);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE__Node,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	switch (*index) {
+	case 0:
+		*info = &impl_interfaces[*index];
+		break;
+	default:
+		return 0;
+	}
+	(*index)++;
+	return 1;
+}
+
+const struct spa_handle_factory spa_audioconvert_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	NAME,
+	NULL,
+	sizeof(struct impl),
+	impl_init,
+	impl_enum_interface_info,
+};
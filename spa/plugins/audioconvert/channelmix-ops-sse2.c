@@ -0,0 +1,60 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <emmintrin.h>
+
+#include "channelmix-ops.h"
+
+/* Vectors of 4 frames with the remaining frames done in plain C, the
+ * samples are multiplied and added in the same order as the C version so
+ * the results are bit-exact. */
+
+void channelmix_sse2(void **dst, uint32_t n_dst, const void **src, uint32_t n_src,
+		     const float *matrix, uint32_t n_frames)
+{
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	uint32_t i, j, n;
+
+	for (i = 0; i < n_dst; i++) {
+		bool first = true;
+
+		for (j = 0; j < n_src; j++) {
+			float m = matrix[i * n_src + j];
+			__m128 mv = _mm_set1_ps(m);
+
+			if (m == 0.0f)
+				continue;
+			if (first) {
+				for (n = 0; n + 4 <= n_frames; n += 4)
+					_mm_storeu_ps(d[i] + n, _mm_mul_ps(_mm_loadu_ps(s[j] + n), mv));
+				for (; n < n_frames; n++)
+					d[i][n] = s[j][n] * m;
+				first = false;
+			} else {
+				for (n = 0; n + 4 <= n_frames; n += 4)
+					_mm_storeu_ps(d[i] + n, _mm_add_ps(_mm_loadu_ps(d[i] + n), _mm_mul_ps(_mm_loadu_ps(s[j] + n), mv)));
+				for (; n < n_frames; n++)
+					d[i][n] += s[j][n] * m;
+			}
+		}
+		if (first)
+			memset(d[i], 0, n_frames * sizeof(float));
+	}
+}
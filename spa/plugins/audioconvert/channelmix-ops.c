@@ -0,0 +1,107 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+
+#include "channelmix-ops.h"
+
+bool spa_channelmix_default_matrix(float *matrix, uint32_t n_dst, uint32_t n_src)
+{
+	uint32_t i, j;
+	float sum;
+
+	memset(matrix, 0, n_dst * n_src * sizeof(float));
+
+	if (n_dst == n_src) {
+		for (i = 0; i < n_dst; i++)
+			matrix[i * n_src + i] = 1.0f;
+		return true;
+	}
+	if (n_src == 1) {
+		for (i = 0; i < n_dst; i++)
+			matrix[i] = 1.0f;
+		return false;
+	}
+	if (n_dst == 1) {
+		for (j = 0; j < n_src; j++)
+			matrix[j] = 1.0f / n_src;
+		return false;
+	}
+	for (j = 0; j < n_src; j++) {
+		if (j < n_dst)
+			matrix[j * n_src + j] = 1.0f;
+		else
+			matrix[(j % n_dst) * n_src + j] = M_SQRT1_2;
+	}
+	/* don't let the folded channels clip */
+	for (i = 0; i < n_dst; i++) {
+		for (j = 0, sum = 0.0f; j < n_src; j++)
+			sum += matrix[i * n_src + j];
+		if (sum > 1.0f) {
+			for (j = 0; j < n_src; j++)
+				matrix[i * n_src + j] /= sum;
+		}
+	}
+	return false;
+}
+
+/* the first input channel with a non-zero gain is copied and the others
+ * are added, the vector versions do the same in the same order */
+void channelmix_c(void **dst, uint32_t n_dst, const void **src, uint32_t n_src,
+		  const float *matrix, uint32_t n_frames)
+{
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	uint32_t i, j, n;
+
+	for (i = 0; i < n_dst; i++) {
+		bool first = true;
+
+		for (j = 0; j < n_src; j++) {
+			float m = matrix[i * n_src + j];
+
+			if (m == 0.0f)
+				continue;
+			if (first) {
+				for (n = 0; n < n_frames; n++)
+					d[i][n] = s[j][n] * m;
+				first = false;
+			} else {
+				for (n = 0; n < n_frames; n++)
+					d[i][n] += s[j][n] * m;
+			}
+		}
+		if (first)
+			memset(d[i], 0, n_frames * sizeof(float));
+	}
+}
+
+void spa_channelmix_get_ops(struct spa_channelmix_ops *ops, uint32_t cpu_flags)
+{
+	ops->mix = channelmix_c;
+
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		ops->mix = channelmix_sse2;
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		ops->mix = channelmix_neon;
+#endif
+}
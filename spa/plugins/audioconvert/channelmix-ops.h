@@ -0,0 +1,58 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/cpu.h>
+
+/* Mix planar float channels. Output channel i is the sum of all input
+ * channels j multiplied with matrix[i * n_src + j]. */
+typedef void (*channelmix_func_t) (void **dst, uint32_t n_dst,
+				   const void **src, uint32_t n_src,
+				   const float *matrix, uint32_t n_frames);
+
+struct spa_channelmix_ops {
+	channelmix_func_t mix;
+};
+
+/* fill ops with the best implementation for the features in cpu_flags */
+void spa_channelmix_get_ops(struct spa_channelmix_ops *ops, uint32_t cpu_flags);
+
+/* Make the default matrix to go from n_src to n_dst channels. Returns true
+ * when the matrix does nothing and the channels can be used as they are.
+ *
+ * There are no channel positions in the format so this only looks at the
+ * number of channels: mono is copied to all channels, all channels are
+ * averaged to make mono, channels that exist on both sides are copied and
+ * extra input channels are folded into the output channels at -3dB. */
+bool spa_channelmix_default_matrix(float *matrix, uint32_t n_dst, uint32_t n_src);
+
+void channelmix_c(void **dst, uint32_t n_dst, const void **src, uint32_t n_src,
+		  const float *matrix, uint32_t n_frames);
+
+#if defined(HAVE_SSE2)
+void channelmix_sse2(void **dst, uint32_t n_dst, const void **src, uint32_t n_src,
+		     const float *matrix, uint32_t n_frames);
+#endif
+#if defined(HAVE_NEON)
+void channelmix_neon(void **dst, uint32_t n_dst, const void **src, uint32_t n_src,
+		     const float *matrix, uint32_t n_frames);
+#endif
@@ -0,0 +1,165 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <arm_neon.h>
+
+#include "fmt-ops.h"
+
+/* Only the conversions to float and the float (de)interleaving are done
+ * with NEON, armv7 has no conversion from float to integer that rounds to
+ * nearest like the C version. */
+
+#define S16_SCALE	32768.0f
+#define S32_SCALE	2147483648.0f
+
+static inline void
+to_f32d_tail(convert_func_t func, float **d, const void *s,
+	     uint32_t n_channels, uint32_t n, uint32_t n_frames)
+{
+	float *d2[2] = { d[0] + n, n_channels > 1 ? d[1] + n : NULL };
+	const void *s2[1] = { s };
+	func((void **) d2, s2, n_channels, n_frames - n);
+}
+
+static void
+conv_s16_to_f32d_neon(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const int16_t *s = src[0];
+	float **d = (float **) dst;
+	const float scale = 1.0f / S16_SCALE;
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_s16_to_f32d_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		for (; n + 8 <= n_frames; n += 8) {
+			int16x8_t in = vld1q_s16(s + n);
+			vst1q_f32(d[0] + n, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in))), scale));
+			vst1q_f32(d[0] + n + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in))), scale));
+		}
+	}
+	else {
+		for (; n + 8 <= n_frames; n += 8) {
+			int16x8x2_t in = vld2q_s16(s + 2 * n);
+			vst1q_f32(d[0] + n, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in.val[0]))), scale));
+			vst1q_f32(d[0] + n + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in.val[0]))), scale));
+			vst1q_f32(d[1] + n, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(in.val[1]))), scale));
+			vst1q_f32(d[1] + n + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(in.val[1]))), scale));
+		}
+	}
+	if (n < n_frames)
+		to_f32d_tail(conv_s16_to_f32d_c, d, s + n * n_channels, n_channels, n, n_frames);
+}
+
+static void
+conv_s32_to_f32d_neon(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const int32_t *s = src[0];
+	float **d = (float **) dst;
+	const float scale = 1.0f / S32_SCALE;
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_s32_to_f32d_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		for (; n + 4 <= n_frames; n += 4)
+			vst1q_f32(d[0] + n, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(s + n)), scale));
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			int32x4x2_t in = vld2q_s32(s + 2 * n);
+			vst1q_f32(d[0] + n, vmulq_n_f32(vcvtq_f32_s32(in.val[0]), scale));
+			vst1q_f32(d[1] + n, vmulq_n_f32(vcvtq_f32_s32(in.val[1]), scale));
+		}
+	}
+	if (n < n_frames)
+		to_f32d_tail(conv_s32_to_f32d_c, d, s + n * n_channels, n_channels, n, n_frames);
+}
+
+static void
+conv_f32_to_f32d_neon(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s = src[0];
+	float **d = (float **) dst;
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_f32_to_f32d_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		memcpy(d[0], s, n_frames * sizeof(float));
+		return;
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			float32x4x2_t in = vld2q_f32(s + 2 * n);
+			vst1q_f32(d[0] + n, in.val[0]);
+			vst1q_f32(d[1] + n, in.val[1]);
+		}
+	}
+	if (n < n_frames)
+		to_f32d_tail(conv_f32_to_f32d_c, d, s + n * n_channels, n_channels, n, n_frames);
+}
+
+static void
+conv_f32d_to_f32_neon(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	float *d = dst[0];
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_f32d_to_f32_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		memcpy(d, s[0], n_frames * sizeof(float));
+		return;
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			float32x4x2_t out;
+			out.val[0] = vld1q_f32(s[0] + n);
+			out.val[1] = vld1q_f32(s[1] + n);
+			vst2q_f32(d + 2 * n, out);
+		}
+	}
+	if (n < n_frames) {
+		const float *s2[2] = { s[0] + n, n_channels > 1 ? s[1] + n : NULL };
+		void *d2[1] = { d + n * n_channels };
+		conv_f32d_to_f32_c(d2, (const void **) s2, n_channels, n_frames - n);
+	}
+}
+
+void spa_fmt_get_ops_neon(struct spa_fmt_ops *ops)
+{
+	ops->to_f32d[FMT_S16] = conv_s16_to_f32d_neon;
+	ops->to_f32d[FMT_S32] = conv_s32_to_f32d_neon;
+	ops->to_f32d[FMT_F32] = conv_f32_to_f32d_neon;
+	ops->from_f32d[FMT_F32] = conv_f32d_to_f32_neon;
+}
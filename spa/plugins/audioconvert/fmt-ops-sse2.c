@@ -0,0 +1,264 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <emmintrin.h>
+
+#include "fmt-ops.h"
+
+/* Mono and stereo are done with vectors, other layouts and the remaining
+ * frames use the C versions. Integers are converted to float exactly and
+ * the conversion back to integer rounds to nearest like lrintf(), the
+ * results are bit-exact with the C versions. */
+
+#define S16_SCALE	32768.0f
+#define S32_SCALE	2147483648.0f
+
+#define S16_MAX_F	(32767.0f / S16_SCALE)
+#define S32_MAX_F	(2147483520.0f / S32_SCALE)
+
+static inline __m128 clamp_scale(__m128 v, __m128 max, __m128 scale)
+{
+	v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), max);
+	return _mm_mul_ps(v, scale);
+}
+
+/* finish the last frames of a planar float destination */
+static inline void
+to_f32d_tail(convert_func_t func, float **d, const void *s,
+	     uint32_t n_channels, uint32_t n, uint32_t n_frames)
+{
+	float *d2[2] = { d[0] + n, n_channels > 1 ? d[1] + n : NULL };
+	const void *s2[1] = { s };
+	func((void **) d2, s2, n_channels, n_frames - n);
+}
+
+/* finish the last frames of a planar float source */
+static inline void
+from_f32d_tail(convert_func_t func, void *d, const float **s,
+	       uint32_t n_channels, uint32_t n, uint32_t n_frames)
+{
+	const float *s2[2] = { s[0] + n, n_channels > 1 ? s[1] + n : NULL };
+	void *d2[1] = { d };
+	func(d2, (const void **) s2, n_channels, n_frames - n);
+}
+
+static void
+conv_s16_to_f32d_sse2(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const int16_t *s = src[0];
+	float **d = (float **) dst;
+	__m128 scale = _mm_set1_ps(1.0f / S16_SCALE);
+	__m128i in;
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_s16_to_f32d_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		for (; n + 8 <= n_frames; n += 8) {
+			in = _mm_loadu_si128((__m128i*)(s + n));
+			_mm_storeu_ps(d[0] + n, _mm_mul_ps(_mm_cvtepi32_ps(
+					_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16)), scale));
+			_mm_storeu_ps(d[0] + n + 4, _mm_mul_ps(_mm_cvtepi32_ps(
+					_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16)), scale));
+		}
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			/* each 32 bits holds a frame, left in the low half */
+			in = _mm_loadu_si128((__m128i*)(s + 2 * n));
+			_mm_storeu_ps(d[0] + n, _mm_mul_ps(_mm_cvtepi32_ps(
+					_mm_srai_epi32(_mm_slli_epi32(in, 16), 16)), scale));
+			_mm_storeu_ps(d[1] + n, _mm_mul_ps(_mm_cvtepi32_ps(
+					_mm_srai_epi32(in, 16)), scale));
+		}
+	}
+	if (n < n_frames)
+		to_f32d_tail(conv_s16_to_f32d_c, d, s + n * n_channels, n_channels, n, n_frames);
+}
+
+static void
+conv_s32_to_f32d_sse2(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const int32_t *s = src[0];
+	float **d = (float **) dst;
+	__m128 scale = _mm_set1_ps(1.0f / S32_SCALE), in[2];
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_s32_to_f32d_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		for (; n + 4 <= n_frames; n += 4) {
+			_mm_storeu_ps(d[0] + n, _mm_mul_ps(_mm_cvtepi32_ps(
+					_mm_loadu_si128((__m128i*)(s + n))), scale));
+		}
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			in[0] = _mm_loadu_ps((float*)(s + 2 * n));
+			in[1] = _mm_loadu_ps((float*)(s + 2 * n + 4));
+			_mm_storeu_ps(d[0] + n, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(
+					_mm_shuffle_ps(in[0], in[1], _MM_SHUFFLE(2, 0, 2, 0)))), scale));
+			_mm_storeu_ps(d[1] + n, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(
+					_mm_shuffle_ps(in[0], in[1], _MM_SHUFFLE(3, 1, 3, 1)))), scale));
+		}
+	}
+	if (n < n_frames)
+		to_f32d_tail(conv_s32_to_f32d_c, d, s + n * n_channels, n_channels, n, n_frames);
+}
+
+static void
+conv_f32_to_f32d_sse2(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s = src[0];
+	float **d = (float **) dst;
+	__m128 in[2];
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_f32_to_f32d_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		memcpy(d[0], s, n_frames * sizeof(float));
+		return;
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			in[0] = _mm_loadu_ps(s + 2 * n);
+			in[1] = _mm_loadu_ps(s + 2 * n + 4);
+			_mm_storeu_ps(d[0] + n, _mm_shuffle_ps(in[0], in[1], _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(d[1] + n, _mm_shuffle_ps(in[0], in[1], _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	if (n < n_frames)
+		to_f32d_tail(conv_f32_to_f32d_c, d, s + n * n_channels, n_channels, n, n_frames);
+}
+
+static void
+conv_f32d_to_s16_sse2(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	int16_t *d = dst[0];
+	__m128 scale = _mm_set1_ps(S16_SCALE), max = _mm_set1_ps(S16_MAX_F);
+	__m128i out[2];
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_f32d_to_s16_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		for (; n + 8 <= n_frames; n += 8) {
+			out[0] = _mm_cvtps_epi32(clamp_scale(_mm_loadu_ps(s[0] + n), max, scale));
+			out[1] = _mm_cvtps_epi32(clamp_scale(_mm_loadu_ps(s[0] + n + 4), max, scale));
+			_mm_storeu_si128((__m128i*)(d + n), _mm_packs_epi32(out[0], out[1]));
+		}
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			out[0] = _mm_cvtps_epi32(clamp_scale(_mm_loadu_ps(s[0] + n), max, scale));
+			out[1] = _mm_cvtps_epi32(clamp_scale(_mm_loadu_ps(s[1] + n), max, scale));
+			/* 4 left samples followed by 4 right samples, interleave them */
+			out[0] = _mm_packs_epi32(out[0], out[1]);
+			out[0] = _mm_unpacklo_epi16(out[0], _mm_srli_si128(out[0], 8));
+			_mm_storeu_si128((__m128i*)(d + 2 * n), out[0]);
+		}
+	}
+	if (n < n_frames)
+		from_f32d_tail(conv_f32d_to_s16_c, d + n * n_channels, s, n_channels, n, n_frames);
+}
+
+static void
+conv_f32d_to_s32_sse2(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	int32_t *d = dst[0];
+	__m128 scale = _mm_set1_ps(S32_SCALE), max = _mm_set1_ps(S32_MAX_F);
+	__m128i out[2];
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_f32d_to_s32_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		for (; n + 4 <= n_frames; n += 4) {
+			out[0] = _mm_cvtps_epi32(clamp_scale(_mm_loadu_ps(s[0] + n), max, scale));
+			_mm_storeu_si128((__m128i*)(d + n), out[0]);
+		}
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			out[0] = _mm_cvtps_epi32(clamp_scale(_mm_loadu_ps(s[0] + n), max, scale));
+			out[1] = _mm_cvtps_epi32(clamp_scale(_mm_loadu_ps(s[1] + n), max, scale));
+			_mm_storeu_si128((__m128i*)(d + 2 * n), _mm_unpacklo_epi32(out[0], out[1]));
+			_mm_storeu_si128((__m128i*)(d + 2 * n + 4), _mm_unpackhi_epi32(out[0], out[1]));
+		}
+	}
+	if (n < n_frames)
+		from_f32d_tail(conv_f32d_to_s32_c, d + n * n_channels, s, n_channels, n, n_frames);
+}
+
+static void
+conv_f32d_to_f32_sse2(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	float *d = dst[0];
+	__m128 in[2];
+	uint32_t n = 0;
+
+	if (n_channels > 2) {
+		conv_f32d_to_f32_c(dst, src, n_channels, n_frames);
+		return;
+	}
+
+	if (n_channels == 1) {
+		memcpy(d, s[0], n_frames * sizeof(float));
+		return;
+	}
+	else {
+		for (; n + 4 <= n_frames; n += 4) {
+			in[0] = _mm_loadu_ps(s[0] + n);
+			in[1] = _mm_loadu_ps(s[1] + n);
+			_mm_storeu_ps(d + 2 * n, _mm_unpacklo_ps(in[0], in[1]));
+			_mm_storeu_ps(d + 2 * n + 4, _mm_unpackhi_ps(in[0], in[1]));
+		}
+	}
+	if (n < n_frames)
+		from_f32d_tail(conv_f32d_to_f32_c, d + n * n_channels, s, n_channels, n, n_frames);
+}
+
+void spa_fmt_get_ops_sse2(struct spa_fmt_ops *ops)
+{
+	ops->to_f32d[FMT_S16] = conv_s16_to_f32d_sse2;
+	ops->to_f32d[FMT_S32] = conv_s32_to_f32d_sse2;
+	ops->to_f32d[FMT_F32] = conv_f32_to_f32d_sse2;
+	ops->from_f32d[FMT_S16] = conv_f32d_to_s16_sse2;
+	ops->from_f32d[FMT_S32] = conv_f32d_to_s32_sse2;
+	ops->from_f32d[FMT_F32] = conv_f32d_to_f32_sse2;
+}
@@ -0,0 +1,236 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+#include <endian.h>
+
+#include "fmt-ops.h"
+
+#define S16_SCALE	32768.0f
+#define S24_SCALE	8388608.0f
+#define S32_SCALE	2147483648.0f
+
+/* the largest sample values as float, 32 bits is limited to the 24 bits of
+ * precision in float */
+#define S16_MAX_F	(32767.0f / S16_SCALE)
+#define S24_MAX_F	(8388607.0f / S24_SCALE)
+#define S32_MAX_F	(2147483520.0f / S32_SCALE)
+
+static inline int32_t read_s24(const uint8_t *p)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	return ((int32_t) (((uint32_t) p[2] << 24) | (p[1] << 16) | (p[0] << 8))) >> 8;
+#else
+	return ((int32_t) (((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8))) >> 8;
+#endif
+}
+
+static inline void write_s24(uint8_t *p, int32_t v)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+#else
+	p[0] = v >> 16;
+	p[1] = v >> 8;
+	p[2] = v;
+#endif
+}
+
+/* the vector versions clamp, scale and round to the nearest integer in
+ * float, do exactly the same here. The scale is a power of 2 so all integers
+ * survive a round trip through float. */
+static inline int32_t f32_to_int(float v, float max, float scale)
+{
+	return lrintf(SPA_CLAMP(v, -1.0f, max) * scale);
+}
+
+void conv_s16_to_f32d_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const int16_t *s = src[0];
+	float **d = (float **) dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			d[c][n] = *s++ * (1.0f / S16_SCALE);
+	}
+}
+
+void conv_s24_to_f32d_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const uint8_t *s = src[0];
+	float **d = (float **) dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			d[c][n] = read_s24(s) * (1.0f / S24_SCALE);
+			s += 3;
+		}
+	}
+}
+
+void conv_s24_32_to_f32d_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const int32_t *s = src[0];
+	float **d = (float **) dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			d[c][n] = (((int32_t) ((uint32_t) *s++ << 8)) >> 8) * (1.0f / S24_SCALE);
+	}
+}
+
+void conv_s32_to_f32d_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const int32_t *s = src[0];
+	float **d = (float **) dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			d[c][n] = *s++ * (1.0f / S32_SCALE);
+	}
+}
+
+void conv_f32_to_f32d_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float *s = src[0];
+	float **d = (float **) dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			d[c][n] = *s++;
+	}
+}
+
+void conv_f64_to_f32d_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const double *s = src[0];
+	float **d = (float **) dst;
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			d[c][n] = *s++;
+	}
+}
+
+void conv_f32d_to_s16_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	int16_t *d = dst[0];
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = f32_to_int(s[c][n], S16_MAX_F, S16_SCALE);
+	}
+}
+
+void conv_f32d_to_s24_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	uint8_t *d = dst[0];
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++) {
+			write_s24(d, f32_to_int(s[c][n], S24_MAX_F, S24_SCALE));
+			d += 3;
+		}
+	}
+}
+
+void conv_f32d_to_s24_32_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	int32_t *d = dst[0];
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = f32_to_int(s[c][n], S24_MAX_F, S24_SCALE);
+	}
+}
+
+void conv_f32d_to_s32_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	int32_t *d = dst[0];
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = f32_to_int(s[c][n], S32_MAX_F, S32_SCALE);
+	}
+}
+
+void conv_f32d_to_f32_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	float *d = dst[0];
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = s[c][n];
+	}
+}
+
+void conv_f32d_to_f64_c(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+{
+	const float **s = (const float **) src;
+	double *d = dst[0];
+	uint32_t n, c;
+
+	for (n = 0; n < n_frames; n++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = s[c][n];
+	}
+}
+
+void spa_fmt_get_ops(struct spa_fmt_ops *ops, uint32_t cpu_flags)
+{
+	ops->to_f32d[FMT_S16] = conv_s16_to_f32d_c;
+	ops->to_f32d[FMT_S24] = conv_s24_to_f32d_c;
+	ops->to_f32d[FMT_S24_32] = conv_s24_32_to_f32d_c;
+	ops->to_f32d[FMT_S32] = conv_s32_to_f32d_c;
+	ops->to_f32d[FMT_F32] = conv_f32_to_f32d_c;
+	ops->to_f32d[FMT_F64] = conv_f64_to_f32d_c;
+	ops->from_f32d[FMT_S16] = conv_f32d_to_s16_c;
+	ops->from_f32d[FMT_S24] = conv_f32d_to_s24_c;
+	ops->from_f32d[FMT_S24_32] = conv_f32d_to_s24_32_c;
+	ops->from_f32d[FMT_S32] = conv_f32d_to_s32_c;
+	ops->from_f32d[FMT_F32] = conv_f32d_to_f32_c;
+	ops->from_f32d[FMT_F64] = conv_f32d_to_f64_c;
+
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		spa_fmt_get_ops_sse2(ops);
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		spa_fmt_get_ops_neon(ops);
+#endif
+}
@@ -0,0 +1,85 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/cpu.h>
+
+/* Conversion between the sample formats and planar float. All samples go
+ * through planar float so that the channels can be mixed. The planar side
+ * uses one pointer per channel, the interleaved side only the first
+ * pointer.
+ *
+ * Integer samples are scaled to [-1.0, 1.0) and floats are clamped to the
+ * same range and rounded to the nearest integer when converted back. 32 bits
+ * samples only keep the 24 bits of precision of float. */
+typedef void (*convert_func_t) (void **dst, const void **src,
+				uint32_t n_channels, uint32_t n_frames);
+
+enum {
+	FMT_S16,
+	FMT_S24,		/* packed in 3 bytes */
+	FMT_S24_32,		/* in the lower 24 bits of 32 bits */
+	FMT_S32,
+	FMT_F32,
+	FMT_F64,
+	FMT_MAX,
+};
+
+struct spa_fmt_ops {
+	/* interleaved format to planar float */
+	convert_func_t to_f32d[FMT_MAX];
+	/* planar float to interleaved format */
+	convert_func_t from_f32d[FMT_MAX];
+};
+
+static inline uint32_t spa_fmt_sample_size(int fmt)
+{
+	static const uint32_t sizes[FMT_MAX] = { 2, 3, 4, 4, 4, 8 };
+	return sizes[fmt];
+}
+
+/* fill ops with the best implementation for the features in cpu_flags */
+void spa_fmt_get_ops(struct spa_fmt_ops *ops, uint32_t cpu_flags);
+
+#define DECLARE_CONVERT(name) \
+void name(void **dst, const void **src, uint32_t n_channels, uint32_t n_frames)
+
+/* plain C versions, used as fallback and as reference */
+DECLARE_CONVERT(conv_s16_to_f32d_c);
+DECLARE_CONVERT(conv_s24_to_f32d_c);
+DECLARE_CONVERT(conv_s24_32_to_f32d_c);
+DECLARE_CONVERT(conv_s32_to_f32d_c);
+DECLARE_CONVERT(conv_f32_to_f32d_c);
+DECLARE_CONVERT(conv_f64_to_f32d_c);
+DECLARE_CONVERT(conv_f32d_to_s16_c);
+DECLARE_CONVERT(conv_f32d_to_s24_c);
+DECLARE_CONVERT(conv_f32d_to_s24_32_c);
+DECLARE_CONVERT(conv_f32d_to_s32_c);
+DECLARE_CONVERT(conv_f32d_to_f32_c);
+DECLARE_CONVERT(conv_f32d_to_f64_c);
+
+#if defined(HAVE_SSE2)
+void spa_fmt_get_ops_sse2(struct spa_fmt_ops *ops);
+#endif
+#if defined(HAVE_NEON)
+void spa_fmt_get_ops_neon(struct spa_fmt_ops *ops);
+#endif
@@ -0,0 +1,271 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fmt-ops.h"
+#include "channelmix-ops.h"
+
+/* checks that the optimized conversion and mix functions produce exactly
+ * the same output as the C versions and that integer samples survive a
+ * round trip through float */
+
+#define N_FRAMES	1031
+#define MAX_CHANNELS	8
+#define BUF_SIZE	((N_FRAMES + 8) * MAX_CHANNELS * sizeof(double))
+
+static uint8_t src[BUF_SIZE], dst_ref[BUF_SIZE], dst_test[BUF_SIZE];
+static float planes[3][MAX_CHANNELS][N_FRAMES + 8];
+static int n_failed;
+
+static const char *names[FMT_MAX] = { "s16", "s24", "s24_32", "s32", "f32", "f64" };
+
+static void fill_random(int fmt)
+{
+	size_t i;
+
+	for (i = 0; i < BUF_SIZE; i++)
+		src[i] = rand();
+
+	switch (fmt) {
+	case FMT_S24_32:
+	{
+		int32_t *s = (int32_t *) src;
+		for (i = 0; i < BUF_SIZE / sizeof(int32_t); i++)
+			s[i] = ((int32_t)((uint32_t) s[i] << 8)) >> 8;
+		break;
+	}
+	case FMT_F32:
+	{
+		float *f = (float *) src;
+		/* also some values out of range to exercise the clamping */
+		for (i = 0; i < BUF_SIZE / sizeof(float); i++)
+			f[i] = (float) rand() / RAND_MAX * 2.5f - 1.25f;
+		break;
+	}
+	case FMT_F64:
+	{
+		double *f = (double *) src;
+		for (i = 0; i < BUF_SIZE / sizeof(double); i++)
+			f[i] = (double) rand() / RAND_MAX * 2.0 - 1.0;
+		break;
+	}
+	}
+}
+
+static void fill_planes(float p[MAX_CHANNELS][N_FRAMES + 8])
+{
+	int c, n;
+
+	for (c = 0; c < MAX_CHANNELS; c++) {
+		for (n = 0; n < N_FRAMES + 8; n++) {
+			switch (rand() % 16) {
+			case 0:
+				p[c][n] = 1.0f;
+				break;
+			case 1:
+				p[c][n] = -1.0f;
+				break;
+			case 2:
+				p[c][n] = (float) rand() / RAND_MAX * 4.0f - 2.0f;
+				break;
+			default:
+				p[c][n] = (float) rand() / RAND_MAX * 2.0f - 1.0f;
+				break;
+			}
+		}
+	}
+}
+
+static void check(const void *a, const void *b, size_t size, const char *func,
+		  const char *name, int n_channels, int n_frames)
+{
+	if (memcmp(a, b, size) != 0) {
+		fprintf(stderr, "%s %s: mismatch channels %d frames %d\n",
+			func, name, n_channels, n_frames);
+		n_failed++;
+	}
+}
+
+static void test_fmt_ops(const struct spa_fmt_ops *ref, const struct spa_fmt_ops *ops, int fmt)
+{
+	int n_channels, n_frames, c;
+	void *p1[MAX_CHANNELS], *p2[MAX_CHANNELS], *d;
+	const void *s;
+
+	for (c = 0; c < MAX_CHANNELS; c++) {
+		p1[c] = planes[0][c];
+		p2[c] = planes[1][c];
+	}
+
+	for (n_channels = 1; n_channels <= MAX_CHANNELS; n_channels++) {
+		for (n_frames = 0; n_frames <= N_FRAMES; n_frames += 1 + n_frames / 4) {
+			fill_random(fmt);
+			memset(planes, 0, sizeof(planes));
+			s = src;
+			ref->to_f32d[fmt](p1, &s, n_channels, n_frames);
+			ops->to_f32d[fmt](p2, &s, n_channels, n_frames);
+			check(planes[0], planes[1], sizeof(planes[0]), "to_f32d",
+			      names[fmt], n_channels, n_frames);
+
+			fill_planes(planes[2]);
+			for (c = 0; c < MAX_CHANNELS; c++)
+				p1[c] = planes[2][c];
+			memset(dst_ref, 0, BUF_SIZE);
+			memset(dst_test, 0, BUF_SIZE);
+			d = dst_ref;
+			ref->from_f32d[fmt](&d, (const void **) p1, n_channels, n_frames);
+			d = dst_test;
+			ops->from_f32d[fmt](&d, (const void **) p1, n_channels, n_frames);
+			check(dst_ref, dst_test, BUF_SIZE, "from_f32d",
+			      names[fmt], n_channels, n_frames);
+			for (c = 0; c < MAX_CHANNELS; c++)
+				p1[c] = planes[0][c];
+		}
+	}
+}
+
+/* integers go to float and back without loss, 32 bits keeps 24 bits */
+static void test_roundtrip(const struct spa_fmt_ops *ops, int fmt)
+{
+	uint32_t n_channels = 2, size = N_FRAMES * n_channels * spa_fmt_sample_size(fmt);
+	void *p[MAX_CHANNELS] = { planes[0][0], planes[0][1] }, *d = dst_test;
+	const void *s = src;
+
+	fill_random(fmt);
+	if (fmt == FMT_S32) {
+		int32_t *v = (int32_t *) src;
+		uint32_t i;
+		for (i = 0; i < size / sizeof(int32_t); i++)
+			v[i] &= ~0xff;
+	}
+	ops->to_f32d[fmt](p, &s, n_channels, N_FRAMES);
+	ops->from_f32d[fmt](&d, (const void **) p, n_channels, N_FRAMES);
+
+	check(src, dst_test, size, "roundtrip", names[fmt], n_channels, N_FRAMES);
+}
+
+static void test_channelmix(const struct spa_channelmix_ops *ref,
+			    const struct spa_channelmix_ops *ops)
+{
+	float matrix[MAX_CHANNELS * MAX_CHANNELS];
+	void *s[MAX_CHANNELS], *d1[MAX_CHANNELS], *d2[MAX_CHANNELS];
+	uint32_t n_src, n_dst, c;
+	int n_frames;
+
+	for (c = 0; c < MAX_CHANNELS; c++) {
+		s[c] = planes[2][c];
+		d1[c] = planes[0][c];
+		d2[c] = planes[1][c];
+	}
+
+	for (n_src = 1; n_src <= MAX_CHANNELS; n_src++) {
+		for (n_dst = 1; n_dst <= MAX_CHANNELS; n_dst++) {
+			spa_channelmix_default_matrix(matrix, n_dst, n_src);
+
+			for (n_frames = 0; n_frames <= N_FRAMES; n_frames += 1 + n_frames / 2) {
+				fill_planes(planes[2]);
+				memset(planes, 0, sizeof(planes[0]) * 2);
+				ref->mix(d1, n_dst, (const void **) s, n_src, matrix, n_frames);
+				ops->mix(d2, n_dst, (const void **) s, n_src, matrix, n_frames);
+				check(planes[0], planes[1], sizeof(planes[0]), "channelmix",
+				      "f32", n_src, n_frames);
+			}
+		}
+	}
+}
+
+/* mono goes to all channels and all channels average to mono */
+static void test_matrix(void)
+{
+	float matrix[MAX_CHANNELS * MAX_CHANNELS];
+	uint32_t i;
+
+	if (!spa_channelmix_default_matrix(matrix, 2, 2) ||
+	    matrix[0] != 1.0f || matrix[1] != 0.0f || matrix[2] != 0.0f || matrix[3] != 1.0f) {
+		fprintf(stderr, "matrix: stereo is not identity\n");
+		n_failed++;
+	}
+	spa_channelmix_default_matrix(matrix, 6, 1);
+	for (i = 0; i < 6; i++) {
+		if (matrix[i] != 1.0f) {
+			fprintf(stderr, "matrix: mono not copied to channel %u\n", i);
+			n_failed++;
+		}
+	}
+	spa_channelmix_default_matrix(matrix, 1, 4);
+	for (i = 0; i < 4; i++) {
+		if (matrix[i] != 0.25f) {
+			fprintf(stderr, "matrix: channel %u not averaged\n", i);
+			n_failed++;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		uint32_t flags;
+	} variants[] = {
+		{ "sse2", SPA_CPU_FLAG_SSE2 },
+		{ "neon", SPA_CPU_FLAG_NEON },
+	};
+	struct spa_fmt_ops ref, ops;
+	struct spa_channelmix_ops mix_ref, mix_ops;
+	uint32_t cpu_flags = spa_cpu_get_flags();
+	int i, fmt;
+
+	srand(4711);
+
+	spa_fmt_get_ops(&ref, 0);
+	spa_channelmix_get_ops(&mix_ref, 0);
+
+	for (fmt = 0; fmt < FMT_MAX; fmt++) {
+		if (fmt != FMT_F32 && fmt != FMT_F64)
+			test_roundtrip(&ref, fmt);
+	}
+	test_matrix();
+
+	for (i = 0; i < SPA_N_ELEMENTS(variants); i++) {
+		if ((cpu_flags & variants[i].flags) != variants[i].flags) {
+			printf("%s: not supported, skipped\n", variants[i].name);
+			continue;
+		}
+		spa_fmt_get_ops(&ops, variants[i].flags);
+		spa_channelmix_get_ops(&mix_ops, variants[i].flags);
+
+		for (fmt = 0; fmt < FMT_MAX; fmt++) {
+			test_fmt_ops(&ref, &ops, fmt);
+			test_roundtrip(&ops, fmt == FMT_F32 || fmt == FMT_F64 ? FMT_S16 : fmt);
+		}
+		test_channelmix(&mix_ref, &mix_ops);
+
+		printf("%s: tested\n", variants[i].name);
+	}
+
+	if (n_failed > 0) {
+		fprintf(stderr, "%d checks failed\n", n_failed);
+		return 1;
+	}
+	return 0;
+}
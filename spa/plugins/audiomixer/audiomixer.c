@@ -30,8 +30,7 @@
 #include <spa/param/meta.h>
 
 #include <lib/pod.h>
-
-#include "conv.h"
+#include <lib/mix.h>
 
 #define NAME "audiomixer"
 
@@ -106,6 +105,7 @@ struct impl {
 	struct spa_type_map *map;
 	struct spa_log *log;
 
+	uint32_t cpu_flags;
 	struct spa_audiomixer_ops ops;
 
 	const struct spa_node_callbacks *callbacks;
@@ -1035,7 +1035,9 @@ impl_init(const struct spa_handle_factory *factory,
 	    SPA_PORT_INFO_FLAG_NO_REF;
 	spa_list_init(&port->queue);
 
-	spa_audiomixer_get_ops(&this->ops);
+	this->cpu_flags = spa_cpu_get_flags();
+	spa_audiomixer_get_ops(&this->ops, this->cpu_flags);
+	spa_log_info(this->log, NAME " %p: cpu flags %08x", this, this->cpu_flags);
 
 	return 0;
 }
@@ -0,0 +1,203 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/mix.h>
+
+/* checks that the optimized mix functions produce exactly the same
+ * output as the C versions */
+
+#define N_SAMPLES	1031
+#define MAX_STRIDE	3
+#define BUF_SIZE	((N_SAMPLES + 8) * MAX_STRIDE * sizeof(float))
+
+static uint8_t src[BUF_SIZE], dst_ref[BUF_SIZE], dst_test[BUF_SIZE];
+static int n_failed;
+
+static const char *names[CONV_MAX] = { "s16", "f32" };
+
+static void fill_random(void)
+{
+	size_t i;
+	int16_t *s16 = (int16_t *) src;
+
+	for (i = 0; i < BUF_SIZE / sizeof(int16_t); i++) {
+		/* mix in some full scale values to exercise the clamping */
+		switch (rand() % 8) {
+		case 0:
+			s16[i] = INT16_MAX;
+			break;
+		case 1:
+			s16[i] = INT16_MIN;
+			break;
+		default:
+			s16[i] = rand();
+			break;
+		}
+	}
+	for (i = 0; i < BUF_SIZE; i++)
+		dst_ref[i] = dst_test[i] = rand();
+}
+
+static void fill_random_f32(void)
+{
+	size_t i;
+	float *f = (float *) src, *d1 = (float *) dst_ref, *d2 = (float *) dst_test;
+
+	for (i = 0; i < BUF_SIZE / sizeof(float); i++) {
+		f[i] = (float) rand() / RAND_MAX * 2.0f - 1.0f;
+		d1[i] = d2[i] = (float) rand() / RAND_MAX * 2.0f - 1.0f;
+	}
+}
+
+static void prepare(int conv)
+{
+	if (conv == CONV_S16_S16)
+		fill_random();
+	else
+		fill_random_f32();
+}
+
+static void check(const char *func, int conv, int offset, int n_samples, int stride)
+{
+	if (memcmp(dst_ref, dst_test, BUF_SIZE) != 0) {
+		fprintf(stderr, "%s %s: mismatch offset %d samples %d stride %d\n",
+			func, names[conv], offset, n_samples, stride);
+		n_failed++;
+	}
+}
+
+static void test_ops(const struct spa_audiomixer_ops *ref,
+		     const struct spa_audiomixer_ops *ops, int conv)
+{
+	static const int16_t s16_scales[] = { 0, 1, -1, 16384, INT16_MAX, INT16_MIN, 12345, -23456 };
+	static const float f32_scales[] = { 0.0f, 1.0f, -1.0f, 0.5f, 0.123f, 2.75f, -1.5f, 1e-6f };
+	static const float volumes[] = { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f, 1.5f, 4.0f, 0.333f };
+	int sample_size = conv == CONV_S16_S16 ? sizeof(int16_t) : sizeof(float);
+	int offset, n_samples, stride, k;
+
+	for (offset = 0; offset < 4; offset++) {
+		for (n_samples = 0; n_samples <= N_SAMPLES; n_samples += 1 + n_samples / 4) {
+			int n_bytes = n_samples * sample_size;
+			void *s = src + offset * sample_size;
+			void *d1 = dst_ref + offset * sample_size;
+			void *d2 = dst_test + offset * sample_size;
+
+			for (k = 0; k < SPA_N_ELEMENTS(s16_scales); k++) {
+				const void *scale = conv == CONV_S16_S16 ?
+					(const void *) &s16_scales[k] : (const void *) &f32_scales[k];
+
+				prepare(conv);
+				ref->copy_scale[conv](d1, s, scale, n_bytes);
+				ops->copy_scale[conv](d2, s, scale, n_bytes);
+				check("copy_scale", conv, offset, n_samples, 1);
+
+				prepare(conv);
+				ref->add_scale[conv](d1, s, scale, n_bytes);
+				ops->add_scale[conv](d2, s, scale, n_bytes);
+				check("add_scale", conv, offset, n_samples, 1);
+
+				prepare(conv);
+				ref->copy_volume[conv](d1, s, &volumes[k], n_bytes);
+				ops->copy_volume[conv](d2, s, &volumes[k], n_bytes);
+				check("copy_volume", conv, offset, n_samples, 1);
+
+				prepare(conv);
+				ref->add_volume[conv](d1, s, &volumes[k], n_bytes);
+				ops->add_volume[conv](d2, s, &volumes[k], n_bytes);
+				check("add_volume", conv, offset, n_samples, 1);
+
+				for (stride = 1; stride <= MAX_STRIDE; stride++) {
+					prepare(conv);
+					ref->copy_scale_i[conv](d1, stride, s, stride, scale, n_bytes);
+					ops->copy_scale_i[conv](d2, stride, s, stride, scale, n_bytes);
+					check("copy_scale_i", conv, offset, n_samples, stride);
+
+					prepare(conv);
+					ref->add_scale_i[conv](d1, stride, s, stride, scale, n_bytes);
+					ops->add_scale_i[conv](d2, stride, s, stride, scale, n_bytes);
+					check("add_scale_i", conv, offset, n_samples, stride);
+				}
+			}
+
+			prepare(conv);
+			ref->copy[conv](d1, s, n_bytes);
+			ops->copy[conv](d2, s, n_bytes);
+			check("copy", conv, offset, n_samples, 1);
+
+			prepare(conv);
+			ref->add[conv](d1, s, n_bytes);
+			ops->add[conv](d2, s, n_bytes);
+			check("add", conv, offset, n_samples, 1);
+
+			for (stride = 1; stride <= MAX_STRIDE; stride++) {
+				prepare(conv);
+				ref->copy_i[conv](d1, stride, s, stride, n_bytes);
+				ops->copy_i[conv](d2, stride, s, stride, n_bytes);
+				check("copy_i", conv, offset, n_samples, stride);
+
+				prepare(conv);
+				ref->add_i[conv](d1, stride, s, stride, n_bytes);
+				ops->add_i[conv](d2, stride, s, stride, n_bytes);
+				check("add_i", conv, offset, n_samples, stride);
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		uint32_t flags;
+	} variants[] = {
+		{ "sse2", SPA_CPU_FLAG_SSE2 },
+		{ "avx2", SPA_CPU_FLAG_SSE2 | SPA_CPU_FLAG_AVX2 },
+		{ "neon", SPA_CPU_FLAG_NEON },
+	};
+	struct spa_audiomixer_ops ref, ops;
+	uint32_t cpu_flags = spa_cpu_get_flags();
+	int i, conv;
+
+	srand(4711);
+
+	spa_audiomixer_get_ops(&ref, 0);
+
+	for (i = 0; i < SPA_N_ELEMENTS(variants); i++) {
+		if ((cpu_flags & variants[i].flags) != variants[i].flags) {
+			printf("%s: not supported, skipped\n", variants[i].name);
+			continue;
+		}
+		spa_audiomixer_get_ops(&ops, variants[i].flags);
+
+		for (conv = 0; conv < CONV_MAX; conv++)
+			test_ops(&ref, &ops, conv);
+
+		printf("%s: tested\n", variants[i].name);
+	}
+
+	if (n_failed > 0) {
+		fprintf(stderr, "%d checks failed\n", n_failed);
+		return 1;
+	}
+	return 0;
+}
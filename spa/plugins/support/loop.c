@@ -27,6 +27,10 @@
 #include <sys/timerfd.h>
 #include <sys/eventfd.h>
 #include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
+#include <time.h>
 #include <pthread.h>
 
 #include <spa/support/loop.h>
@@ -34,23 +38,58 @@
 #include <spa/support/type-map.h>
 #include <spa/support/plugin.h>
 #include <spa/utils/list.h>
-#include <spa/utils/ringbuffer.h>
 
 #define NAME "loop"
 
 #define DATAS_SIZE (4096 * 8)
+#define ITEM_ALIGN 64
+
+/* max number of events handled with one epoll_wait, configurable with the
+ * loop.batch-size property */
+#define DEFAULT_BATCH_SIZE	32
+#define MAX_BATCH_SIZE		4096
+/* when a batch is full, poll again this many times before running the
+ * hooks and returning */
+#define MAX_ROUNDS		8
 
 /** \cond */
 
+#define ITEM_EMPTY	0	/* slot not written yet */
+#define ITEM_READY	1	/* item can be invoked */
+#define ITEM_SKIP	2	/* padding until the end of the queue */
+
+/* completion of a blocking invoke, lives on the stack of the caller */
+struct invoke_ack {
+	int res;
+	uint32_t done;
+};
+
 struct invoke_item {
-	size_t item_size;
+	uint32_t state;
+	uint32_t item_size;
 	spa_invoke_func_t func;
 	uint32_t seq;
 	size_t size;
 	void *data;
-	bool block;
 	void *user_data;
-	int res;
+	struct invoke_ack *ack;
+};
+
+/* Multiple producer, single consumer queue of invoke items.
+ *
+ * Producers reserve space by moving head forward with a compare-and-swap and
+ * then fill the item and publish it by setting its state. The loop thread
+ * consumes items in order from tail until it finds one that is not published
+ * yet. Items are aligned to ITEM_ALIGN and are never split, an item that does
+ * not fit before the end of the queue is placed at the start and the gap is
+ * filled with a skip item. */
+struct invoke_queue {
+	uint32_t head;
+	uint8_t _pad1[ITEM_ALIGN - sizeof(uint32_t)];
+	uint32_t tail;
+	uint32_t waiters;
+	uint8_t _pad2[ITEM_ALIGN - 2 * sizeof(uint32_t)];
+	uint8_t data[DATAS_SIZE];
 };
 
 struct type {
@@ -85,11 +124,13 @@ struct impl {
 	int epoll_fd;
 	pthread_t thread;
 
+	struct epoll_event *ep;
+	uint32_t batch_size;
+	struct spa_loop_stats stats;
+
 	struct spa_source *wakeup;
-	int ack_fd;
 
-	struct spa_ringbuffer buffer;
-	uint8_t buffer_data[DATAS_SIZE];
+	struct invoke_queue queue;
 };
 
 struct source_impl {
@@ -191,6 +232,54 @@ static void loop_remove_source(struct spa_source *source)
 	source->loop = NULL;
 }
 
+static inline int futex_wait(uint32_t *addr, uint32_t val)
+{
+	return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline int futex_wake(uint32_t *addr, int n)
+{
+	return syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+/* reserve \a item_size bytes in the queue, blocks while the queue is full */
+static struct invoke_item *queue_reserve(struct impl *impl, uint32_t item_size)
+{
+	struct invoke_queue *queue = &impl->queue;
+	uint32_t head, tail, offset, pad;
+	bool warned = false;
+
+	head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	while (true) {
+		offset = head & (DATAS_SIZE - 1);
+		pad = offset + item_size > DATAS_SIZE ? DATAS_SIZE - offset : 0;
+
+		tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+		if (head - tail + pad + item_size > DATAS_SIZE) {
+			if (!warned) {
+				spa_log_warn(impl->log, NAME " %p: queue full, waiting", impl);
+				warned = true;
+			}
+			__atomic_add_fetch(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST) == tail)
+				futex_wait(&queue->tail, tail);
+			__atomic_sub_fetch(&queue->waiters, 1, __ATOMIC_SEQ_CST);
+			head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+			continue;
+		}
+		if (__atomic_compare_exchange_n(&queue->head, &head, head + pad + item_size,
+						true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+	}
+	if (pad > 0) {
+		struct invoke_item *skip = SPA_MEMBER(queue->data, offset, struct invoke_item);
+		skip->item_size = pad;
+		__atomic_store_n(&skip->state, ITEM_SKIP, __ATOMIC_RELEASE);
+		offset = 0;
+	}
+	return SPA_MEMBER(queue->data, offset, struct invoke_item);
+}
+
 static int
 loop_invoke(struct spa_loop *loop,
 	    spa_invoke_func_t func,
@@ -203,56 +292,38 @@ loop_invoke(struct spa_loop *loop,
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 	bool in_thread = pthread_equal(impl->thread, pthread_self());
 	struct invoke_item *item;
+	struct invoke_ack ack = { 0, 0 };
+	size_t item_size;
 	int res;
 
 	if (in_thread) {
 		res = func(loop, false, seq, size, data, user_data);
 	} else {
-		int32_t filled, avail;
-		uint32_t idx, offset, l0;
-		uint64_t count = 1;
-
-		filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
-		if (filled < 0 || filled > impl->buffer.size) {
-			spa_log_warn(impl->log, NAME " %p: queue xrun %d", impl, filled);
-			return -EPIPE;
-		}
-		avail = impl->buffer.size - filled;
-		if (avail < sizeof(struct invoke_item)) {
-			spa_log_warn(impl->log, NAME " %p: queue full %d", impl, avail);
-			return -EPIPE;
+		item_size = SPA_ROUND_UP_N(sizeof(struct invoke_item) + size, ITEM_ALIGN);
+		if (item_size > DATAS_SIZE) {
+			spa_log_error(impl->log, NAME " %p: invoke data too large %zd", impl, size);
+			return -ENOSPC;
 		}
-		offset = idx & impl->buffer.mask;
 
-		l0 = impl->buffer.size - offset;
-
-		item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
+		item = queue_reserve(impl, item_size);
+		item->item_size = item_size;
 		item->func = func;
 		item->seq = seq;
 		item->size = size;
-		item->block = block;
+		item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
 		item->user_data = user_data;
+		item->ack = block ? &ack : NULL;
+		if (size > 0)
+			memcpy(item->data, data, size);
 
-		if (l0 > sizeof(struct invoke_item) + size) {
-			item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
-			item->item_size = sizeof(struct invoke_item) + size;
-			if (l0 < sizeof(struct invoke_item) + item->item_size)
-				item->item_size = l0;
-		} else {
-			item->data = impl->buffer_data;
-			item->item_size = l0 + size;
-		}
-		memcpy(item->data, data, size);
-
-		spa_ringbuffer_write_update(&impl->buffer, idx + item->item_size);
+		__atomic_store_n(&item->state, ITEM_READY, __ATOMIC_RELEASE);
 
 		spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
 
 		if (block) {
-			if (read(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to read event fd: %s",
-						impl, strerror(errno));
-			res = item->res;
+			while (__atomic_load_n(&ack.done, __ATOMIC_ACQUIRE) == 0)
+				futex_wait(&ack.done, 0);
+			res = ack.res;
 		}
 		else {
 			if (seq != SPA_ID_INVALID)
@@ -267,21 +338,40 @@ loop_invoke(struct spa_loop *loop,
 static void wakeup_func(void *data, uint64_t count)
 {
 	struct impl *impl = data;
-	uint32_t index;
+	struct invoke_queue *queue = &impl->queue;
+	uint32_t tail, i;
 
-	while (spa_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
+	tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+	while (true) {
 		struct invoke_item *item =
-		    SPA_MEMBER(impl->buffer_data, index & impl->buffer.mask, struct invoke_item);
-		item->res = item->func(&impl->loop, true, item->seq, item->size, item->data,
-			   item->user_data);
-		spa_ringbuffer_read_update(&impl->buffer, index + item->item_size);
-
-		if (item->block) {
-			uint64_t count = 1;
-			if (write(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to write event fd: %s",
-						impl, strerror(errno));
+		    SPA_MEMBER(queue->data, tail & (DATAS_SIZE - 1), struct invoke_item);
+		uint32_t state = __atomic_load_n(&item->state, __ATOMIC_ACQUIRE);
+
+		if (state == ITEM_EMPTY)
+			break;
+
+		if (state == ITEM_READY) {
+			struct invoke_ack *ack = item->ack;
+			int res;
+
+			res = item->func(&impl->loop, true, item->seq, item->size, item->data,
+					 item->user_data);
+			if (ack) {
+				ack->res = res;
+				__atomic_store_n(&ack->done, 1, __ATOMIC_RELEASE);
+				futex_wake(&ack->done, 1);
+			}
 		}
+		/* clear every place where a later item header can start so that
+		 * stale data is not mistaken for a published item */
+		for (i = 0; i < item->item_size; i += ITEM_ALIGN)
+			SPA_MEMBER(item, i, struct invoke_item)->state = ITEM_EMPTY;
+
+		tail += item->item_size;
+		__atomic_store_n(&queue->tail, tail, __ATOMIC_SEQ_CST);
+
+		if (__atomic_load_n(&queue->waiters, __ATOMIC_SEQ_CST) > 0)
+			futex_wake(&queue->tail, INT_MAX);
 	}
 }
 
@@ -315,16 +405,54 @@ static void loop_leave(struct spa_loop_control *ctrl)
 	impl->thread = 0;
 }
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void dispatch(struct impl *impl, int nfds)
+{
+	struct epoll_event *ep = impl->ep;
+	int i, prio, min_prio = SPA_SOURCE_PRIORITY_HIGH, max_prio = SPA_SOURCE_PRIORITY_LOW;
+
+	/* first we set all the rmasks, then call the callbacks. The reason is that
+	 * some callback might also want to look at other sources it manages and
+	 * can then reset the rmask to suppress the callback. The events are not
+	 * needed anymore after this, we keep the priority there. */
+	for (i = 0; i < nfds; i++) {
+		struct spa_source *s = ep[i].data.ptr;
+		s->rmask = spa_epoll_to_io(ep[i].events);
+		prio = SPA_CLAMP(s->priority, SPA_SOURCE_PRIORITY_LOW, SPA_SOURCE_PRIORITY_HIGH);
+		ep[i].events = prio - SPA_SOURCE_PRIORITY_LOW;
+		min_prio = SPA_MIN(min_prio, prio);
+		max_prio = SPA_MAX(max_prio, prio);
+	}
+	/* dispatch in kernel order, once for each priority that is used */
+	for (prio = max_prio; prio >= min_prio; prio--) {
+		for (i = 0; i < nfds; i++) {
+			struct spa_source *s = ep[i].data.ptr;
+			if (ep[i].events == prio - SPA_SOURCE_PRIORITY_LOW &&
+			    s->rmask && s->fd != -1) {
+				s->func(s);
+			}
+		}
+	}
+}
+
 static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 {
 	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
-	struct epoll_event ep[32];
-	int i, nfds, save_errno = 0;
+	struct spa_loop_stats *stats = &impl->stats;
+	int nfds, round, save_errno = 0;
+	uint32_t n_events = 0;
+	uint64_t t1, t2;
 	struct source_impl *source, *tmp;
 
 	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, before);
 
-	if (SPA_UNLIKELY((nfds = epoll_wait(impl->epoll_fd, ep, SPA_N_ELEMENTS(ep), timeout)) < 0))
+	if (SPA_UNLIKELY((nfds = epoll_wait(impl->epoll_fd, impl->ep, impl->batch_size, timeout)) < 0))
 		save_errno = errno;
 
 	spa_hook_list_call(&impl->hooks_list, struct spa_loop_control_hooks, after);
@@ -332,27 +460,46 @@ static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 	if (SPA_UNLIKELY(nfds < 0))
 		return save_errno;
 
-	/* first we set all the rmasks, then call the callbacks. The reason is that
-	 * some callback might also want to look at other sources it manages and
-	 * can then reset the rmask to suppress the callback */
-	for (i = 0; i < nfds; i++) {
-		struct spa_source *s = ep[i].data.ptr;
-		s->rmask = spa_epoll_to_io(ep[i].events);
-	}
-	for (i = 0; i < nfds; i++) {
-		struct spa_source *s = ep[i].data.ptr;
-		if (s->rmask && s->fd != -1) {
-			s->func(s);
-		}
+	t1 = get_time_ns();
+	for (round = 0; ; round++) {
+		dispatch(impl, nfds);
+		n_events += nfds;
+
+		if ((uint32_t) nfds < impl->batch_size)
+			break;
+
+		/* more events might be ready, handle them without going
+		 * through the hooks again */
+		stats->n_full++;
+		if (round + 1 == MAX_ROUNDS)
+			break;
+		if ((nfds = epoll_wait(impl->epoll_fd, impl->ep, impl->batch_size, 0)) <= 0)
+			break;
 	}
+	t2 = get_time_ns();
+
 	spa_list_for_each_safe(source, tmp, &impl->destroy_list, link)
 		free(source);
 
 	spa_list_init(&impl->destroy_list);
 
+	stats->n_iterations++;
+	stats->n_events += n_events;
+	stats->last_events = n_events;
+	stats->max_events = SPA_MAX(stats->max_events, n_events);
+	stats->last_dispatch_time = t2 - t1;
+	stats->dispatch_time += t2 - t1;
+	stats->max_dispatch_time = SPA_MAX(stats->max_dispatch_time, t2 - t1);
+
 	return 0;
 }
 
+static const struct spa_loop_stats *loop_get_stats(struct spa_loop_control *ctrl)
+{
+	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
+	return &impl->stats;
+}
+
 static void source_io_func(struct spa_source *source)
 {
 	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
@@ -638,6 +785,7 @@ static const struct spa_loop_control impl_loop_control = {
 	loop_enter,
 	loop_leave,
 	loop_iterate,
+	loop_get_stats,
 };
 
 static const struct spa_loop_utils impl_loop_utils = {
@@ -689,8 +837,8 @@ static int impl_clear(struct spa_handle *handle)
 	spa_list_for_each_safe(source, tmp, &impl->destroy_list, link)
 		free(source);
 
-	close(impl->ack_fd);
 	close(impl->epoll_fd);
+	free(impl->ep);
 
 	return 0;
 }
@@ -704,6 +852,7 @@ impl_init(const struct spa_handle_factory *factory,
 {
 	struct impl *impl;
 	uint32_t i;
+	const char *str;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -728,20 +877,28 @@ impl_init(const struct spa_handle_factory *factory,
 	}
 	init_type(&impl->type, impl->map);
 
+	impl->batch_size = DEFAULT_BATCH_SIZE;
+	if (info && (str = spa_dict_lookup(info, "loop.batch-size")))
+		impl->batch_size = SPA_CLAMP(atoi(str), 1, MAX_BATCH_SIZE);
+
+	impl->ep = calloc(impl->batch_size, sizeof(struct epoll_event));
+	if (impl->ep == NULL)
+		return -ENOMEM;
+
 	impl->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
-	if (impl->epoll_fd == -1)
+	if (impl->epoll_fd == -1) {
+		free(impl->ep);
 		return errno;
+	}
 
 	spa_list_init(&impl->source_list);
 	spa_list_init(&impl->destroy_list);
 	spa_hook_list_init(&impl->hooks_list);
 
-	spa_ringbuffer_init(&impl->buffer, DATAS_SIZE);
-
+	spa_zero(impl->queue);
 	impl->wakeup = spa_loop_utils_add_event(&impl->utils, wakeup_func, impl);
-	impl->ack_fd = eventfd(0, EFD_CLOEXEC);
 
-	spa_log_info(impl->log, NAME " %p: initialized", impl);
+	spa_log_info(impl->log, NAME " %p: initialized, batch size %u", impl, impl->batch_size);
 
 	return 0;
 }
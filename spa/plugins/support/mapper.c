@@ -25,6 +25,8 @@
 #include <sys/eventfd.h>
 
 #include <spa/support/type-map.h>
+#include <spa/support/type-map-impl.h>
+#include <spa/support/type-map-static.h>
 #include <spa/support/plugin.h>
 
 #define NAME "mapper"
@@ -44,6 +46,11 @@ struct array {
 	void *data;
 };
 
+struct entry {
+	uint32_t hash;
+	uint32_t id;
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_type_map map;
@@ -52,6 +59,11 @@ struct impl {
 
 	struct array types;
 	struct array strings;
+
+	/* open addressing hash table on the type strings, the size is a
+	 * power of 2 and it is kept at most half full */
+	struct entry *index;
+	uint32_t index_size;
 };
 
 static inline void * alloc_size(struct array *array, size_t size, size_t extend)
@@ -66,22 +78,66 @@ static inline void * alloc_size(struct array *array, size_t size, size_t extend)
 	return res;
 }
 
+static inline const char *get_type(struct impl *impl, uint32_t id)
+{
+	off_t o = ((off_t *)impl->types.data)[id];
+	return SPA_MEMBER(impl->strings.data, o, char);
+}
+
+static inline uint32_t n_types(struct impl *impl)
+{
+	return impl->types.size / sizeof(off_t);
+}
+
+static int grow_index(struct impl *impl)
+{
+	uint32_t i, j, mask, size = impl->index_size ? impl->index_size * 2 : 256;
+	struct entry *index;
+
+	index = malloc(size * sizeof(struct entry));
+	if (index == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < size; i++)
+		index[i].id = SPA_ID_INVALID;
+
+	mask = size - 1;
+	for (i = 0; i < impl->index_size; i++) {
+		if (impl->index[i].id == SPA_ID_INVALID)
+			continue;
+		for (j = impl->index[i].hash & mask; index[j].id != SPA_ID_INVALID; j = (j + 1) & mask);
+		index[j] = impl->index[i];
+	}
+	free(impl->index);
+	impl->index = index;
+	impl->index_size = size;
+
+	return 0;
+}
+
 static uint32_t
 impl_type_map_get_id(struct spa_type_map *map, const char *type)
 {
 	struct impl *impl = SPA_CONTAINER_OF(map, struct impl, map);
-	uint32_t i, len;
+	uint32_t i, j, mask, len, hash;
 	void *p;
-	off_t o, *off;
+	off_t *off;
 
 	if (type == NULL)
 		return SPA_ID_INVALID;
 
-	for (i = 0; i < impl->types.size / sizeof(off_t); i++) {
-		o = ((off_t *)impl->types.data)[i];
-		if (strcmp(SPA_MEMBER(impl->strings.data, o, char), type) == 0)
-			return i;
+	if ((n_types(impl) + 1) * 2 > impl->index_size && grow_index(impl) < 0)
+		return SPA_ID_INVALID;
+
+	hash = spa_hash_string(type);
+	mask = impl->index_size - 1;
+
+	for (j = hash & mask; impl->index[j].id != SPA_ID_INVALID; j = (j + 1) & mask) {
+		struct entry *e = &impl->index[j];
+		if (e->hash == hash && strcmp(get_type(impl, e->id), type) == 0)
+			return e->id;
 	}
+
 	len = strlen(type);
 	p = alloc_size(&impl->strings, len+1, 1024);
 	memcpy(p, type, len + 1);
@@ -90,6 +146,9 @@ impl_type_map_get_id(struct spa_type_map *map, const char *type)
 	*off = SPA_PTRDIFF(p, impl->strings.data);
 	i = SPA_PTRDIFF(off, impl->types.data) / sizeof(off_t);
 
+	impl->index[j].hash = hash;
+	impl->index[j].id = i;
+
 	return i;
 
 }
@@ -99,10 +158,8 @@ impl_type_map_get_type(const struct spa_type_map *map, uint32_t id)
 {
 	struct impl *impl = SPA_CONTAINER_OF(map, struct impl, map);
 
-	if (id < impl->types.size / sizeof(off_t)) {
-		off_t o = ((off_t *)impl->types.data)[id];
-		return SPA_MEMBER(impl->strings.data, o, char);
-	}
+	if (id < n_types(impl))
+		return get_type(impl, id);
 	return NULL;
 }
 
@@ -110,7 +167,7 @@ static size_t
 impl_type_map_get_size(const struct spa_type_map *map)
 {
 	struct impl *impl = SPA_CONTAINER_OF(map, struct impl, map);
-	return impl->types.size / sizeof(off_t);
+	return n_types(impl);
 }
 
 static const struct spa_type_map impl_type_map = {
@@ -150,6 +207,7 @@ static int impl_clear(struct spa_handle *handle)
 		free(impl->types.data);
 	if (impl->strings.data)
 		free(impl->strings.data);
+	free(impl->index);
 
 	return 0;
 }
@@ -162,6 +220,7 @@ impl_init(const struct spa_handle_factory *factory,
 	  uint32_t n_support)
 {
 	struct impl *impl;
+	uint32_t i;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -173,6 +232,10 @@ impl_init(const struct spa_handle_factory *factory,
 
 	impl->map = impl_type_map;
 
+	/* the static types get the same ids in every process */
+	for (i = 0; i < SPA_TYPE_STATIC_N; i++)
+		impl_type_map_get_id(&impl->map, spa_type_static_get_type(i));
+
 	init_type(&impl->type, &impl->map);
 
 	return 0;
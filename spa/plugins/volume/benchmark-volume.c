@@ -0,0 +1,157 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "volume-ops.h"
+
+/* compares the speed of the volume functions with the loop that the volume
+ * plugin used before, also checks that the optimized versions give the same
+ * result as the C versions */
+
+#define N_CHANNELS	2
+#define N_FRAMES	4096
+#define N_SAMPLES	(N_CHANNELS * N_FRAMES)
+#define N_LOOPS		2000
+#define MAX_SAMPLE_SIZE	4
+
+static uint8_t src[N_SAMPLES * MAX_SAMPLE_SIZE];
+static uint8_t dst[N_SAMPLES * MAX_SAMPLE_SIZE];
+static uint8_t ref[N_SAMPLES * MAX_SAMPLE_SIZE];
+static float gain[VOLUME_LINE_ALIGN];
+
+static const struct {
+	const char *name;
+	int sample_size;
+	volume_func_t ref;
+} formats[VOLUME_MAX] = {
+	{ "s16", 2, volume_s16_c },
+	{ "s24", 3, volume_s24_c },
+	{ "s32", 4, volume_s32_c },
+	{ "f32", 4, volume_f32_c },
+};
+
+/* the loop of the volume plugin before it had optimized versions */
+static void volume_s16_old(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	double volume = gain[0];
+	uint32_t i;
+
+	for (i = 0; i < n_samples; i++)
+		d[i] = s[i] * volume;
+}
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void fill_random(int format)
+{
+	uint32_t i;
+
+	if (format == VOLUME_F32) {
+		float *f = (float *) src;
+		for (i = 0; i < N_SAMPLES; i++)
+			f[i] = (float) rand() / RAND_MAX * 2.0f - 1.0f;
+	} else {
+		for (i = 0; i < sizeof(src); i++)
+			src[i] = rand();
+	}
+}
+
+static double run(const char *name, int format, volume_func_t func)
+{
+	int64_t t1, t2;
+	double ns;
+	int i;
+
+	t1 = get_time();
+	for (i = 0; i < N_LOOPS; i++)
+		func(dst, src, gain, VOLUME_LINE_ALIGN, N_SAMPLES);
+	t2 = get_time();
+
+	ns = (double) (t2 - t1) / ((double) N_LOOPS * N_SAMPLES);
+	printf("%s %-6s: %6.3f ns per sample, %8.1f MB/s\n", formats[format].name, name, ns,
+	       formats[format].sample_size * 1000.0 / ns);
+	return ns;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		uint32_t flags;
+	} variants[] = {
+		{ "sse2", SPA_CPU_FLAG_SSE2 },
+		{ "avx2", SPA_CPU_FLAG_SSE2 | SPA_CPU_FLAG_AVX2 },
+		{ "neon", SPA_CPU_FLAG_NEON },
+	};
+	uint32_t cpu_flags = spa_cpu_get_flags();
+	struct spa_volume_ops ops;
+	int i, j, format, res = 0;
+
+	srand(4711);
+
+	for (i = 0; i < VOLUME_LINE_ALIGN; i++)
+		gain[i] = (i % N_CHANNELS) == 0 ? 0.5f : 0.75f;
+
+	for (format = 0; format < VOLUME_MAX; format++) {
+		fill_random(format);
+
+		formats[format].ref(ref, src, gain, VOLUME_LINE_ALIGN, N_SAMPLES);
+
+		if (format == VOLUME_S16) {
+			/* only one gain, it used one volume for all channels */
+			float g = gain[0];
+			for (j = 0; j < VOLUME_LINE_ALIGN; j++)
+				gain[j] = g;
+			run("old", format, volume_s16_old);
+			for (j = 0; j < VOLUME_LINE_ALIGN; j++)
+				gain[j] = (j % N_CHANNELS) == 0 ? 0.5f : 0.75f;
+		}
+		run("c", format, formats[format].ref);
+
+		for (i = 0; i < SPA_N_ELEMENTS(variants); i++) {
+			if ((cpu_flags & variants[i].flags) != variants[i].flags)
+				continue;
+
+			spa_volume_get_ops(&ops, variants[i].flags);
+			if (ops.volume[format] == formats[format].ref)
+				continue;
+
+			memset(dst, 0, sizeof(dst));
+			ops.volume[format](dst, src, gain, VOLUME_LINE_ALIGN, N_SAMPLES);
+			if (memcmp(dst, ref, N_SAMPLES * formats[format].sample_size) != 0) {
+				fprintf(stderr, "%s %s: result differs from C version\n",
+					formats[format].name, variants[i].name);
+				res = 1;
+			}
+			run(variants[i].name, format, ops.volume[format]);
+		}
+	}
+	return res;
+}
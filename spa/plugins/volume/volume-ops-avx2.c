@@ -0,0 +1,84 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <immintrin.h>
+
+#include "volume-ops.h"
+
+/* Same as the SSE2 versions with 256 bits registers. */
+
+static void
+volume_s16_avx2(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	uint32_t n, g = 0;
+	__m256i in, out[2];
+	__m256 f[2];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in = _mm256_loadu_si256((__m256i*)(s + n));
+
+		out[0] = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(in));
+		out[1] = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(in, 1));
+
+		f[0] = _mm256_mul_ps(_mm256_cvtepi32_ps(out[0]), _mm256_loadu_ps(gain + g));
+		f[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(out[1]), _mm256_loadu_ps(gain + g + 8));
+
+		/* packs works on each 128 bits lane, put the samples back in order */
+		in = _mm256_packs_epi32(_mm256_cvtps_epi32(f[0]), _mm256_cvtps_epi32(f[1]));
+		in = _mm256_permute4x64_epi64(in, _MM_SHUFFLE(3, 1, 2, 0));
+
+		_mm256_storeu_si256((__m256i*)(d + n), in);
+
+		if ((g += 16) == n_gains)
+			g = 0;
+	}
+	if (n < n_samples)
+		volume_s16_c(d + n, s + n, gain + g, n_gains - g, n_samples - n);
+}
+
+static void
+volume_f32_avx2(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, g = 0;
+	__m256 in[2];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm256_loadu_ps(s + n);
+		in[1] = _mm256_loadu_ps(s + n + 8);
+		in[0] = _mm256_mul_ps(in[0], _mm256_loadu_ps(gain + g));
+		in[1] = _mm256_mul_ps(in[1], _mm256_loadu_ps(gain + g + 8));
+		_mm256_storeu_ps(d + n, in[0]);
+		_mm256_storeu_ps(d + n + 8, in[1]);
+
+		if ((g += 16) == n_gains)
+			g = 0;
+	}
+	if (n < n_samples)
+		volume_f32_c(d + n, s + n, gain + g, n_gains - g, n_samples - n);
+}
+
+void spa_volume_get_ops_avx2(struct spa_volume_ops *ops)
+{
+	ops->volume[VOLUME_S16] = volume_s16_avx2;
+	ops->volume[VOLUME_F32] = volume_f32_avx2;
+}
@@ -0,0 +1,59 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <arm_neon.h>
+
+#include "volume-ops.h"
+
+/* Only the float version is done with NEON, armv7 has no conversion
+ * from float to integer that rounds to nearest like the C version. */
+
+static void
+volume_f32_neon(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, g = 0;
+	float32x4_t in[4];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = vld1q_f32(s + n);
+		in[1] = vld1q_f32(s + n + 4);
+		in[2] = vld1q_f32(s + n + 8);
+		in[3] = vld1q_f32(s + n + 12);
+		in[0] = vmulq_f32(in[0], vld1q_f32(gain + g));
+		in[1] = vmulq_f32(in[1], vld1q_f32(gain + g + 4));
+		in[2] = vmulq_f32(in[2], vld1q_f32(gain + g + 8));
+		in[3] = vmulq_f32(in[3], vld1q_f32(gain + g + 12));
+		vst1q_f32(d + n, in[0]);
+		vst1q_f32(d + n + 4, in[1]);
+		vst1q_f32(d + n + 8, in[2]);
+		vst1q_f32(d + n + 12, in[3]);
+
+		if ((g += 16) == n_gains)
+			g = 0;
+	}
+	if (n < n_samples)
+		volume_f32_c(d + n, s + n, gain + g, n_gains - g, n_samples - n);
+}
+
+void spa_volume_get_ops_neon(struct spa_volume_ops *ops)
+{
+	ops->volume[VOLUME_F32] = volume_f32_neon;
+}
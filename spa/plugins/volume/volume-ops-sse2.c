@@ -0,0 +1,100 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <emmintrin.h>
+
+#include "volume-ops.h"
+
+/* All kernels use unaligned loads and stores and handle 16 samples per
+ * iteration, the line of gains is a multiple of 16 so a block of samples
+ * never wraps around in the gains. The results are bit-exact with the C
+ * versions, the conversion rounds to nearest like lrintf() and the packing
+ * saturates. */
+
+static void
+volume_s16_sse2(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	uint32_t n, g = 0;
+	__m128i in[2], out[4];
+	__m128 f[4];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm_loadu_si128((__m128i*)(s + n));
+		in[1] = _mm_loadu_si128((__m128i*)(s + n + 8));
+
+		/* sign extend to 32 bits */
+		out[0] = _mm_srai_epi32(_mm_unpacklo_epi16(in[0], in[0]), 16);
+		out[1] = _mm_srai_epi32(_mm_unpackhi_epi16(in[0], in[0]), 16);
+		out[2] = _mm_srai_epi32(_mm_unpacklo_epi16(in[1], in[1]), 16);
+		out[3] = _mm_srai_epi32(_mm_unpackhi_epi16(in[1], in[1]), 16);
+
+		f[0] = _mm_mul_ps(_mm_cvtepi32_ps(out[0]), _mm_loadu_ps(gain + g));
+		f[1] = _mm_mul_ps(_mm_cvtepi32_ps(out[1]), _mm_loadu_ps(gain + g + 4));
+		f[2] = _mm_mul_ps(_mm_cvtepi32_ps(out[2]), _mm_loadu_ps(gain + g + 8));
+		f[3] = _mm_mul_ps(_mm_cvtepi32_ps(out[3]), _mm_loadu_ps(gain + g + 12));
+
+		in[0] = _mm_packs_epi32(_mm_cvtps_epi32(f[0]), _mm_cvtps_epi32(f[1]));
+		in[1] = _mm_packs_epi32(_mm_cvtps_epi32(f[2]), _mm_cvtps_epi32(f[3]));
+
+		_mm_storeu_si128((__m128i*)(d + n), in[0]);
+		_mm_storeu_si128((__m128i*)(d + n + 8), in[1]);
+
+		if ((g += 16) == n_gains)
+			g = 0;
+	}
+	if (n < n_samples)
+		volume_s16_c(d + n, s + n, gain + g, n_gains - g, n_samples - n);
+}
+
+static void
+volume_f32_sse2(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, g = 0;
+	__m128 in[4];
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		in[0] = _mm_loadu_ps(s + n);
+		in[1] = _mm_loadu_ps(s + n + 4);
+		in[2] = _mm_loadu_ps(s + n + 8);
+		in[3] = _mm_loadu_ps(s + n + 12);
+		in[0] = _mm_mul_ps(in[0], _mm_loadu_ps(gain + g));
+		in[1] = _mm_mul_ps(in[1], _mm_loadu_ps(gain + g + 4));
+		in[2] = _mm_mul_ps(in[2], _mm_loadu_ps(gain + g + 8));
+		in[3] = _mm_mul_ps(in[3], _mm_loadu_ps(gain + g + 12));
+		_mm_storeu_ps(d + n, in[0]);
+		_mm_storeu_ps(d + n + 4, in[1]);
+		_mm_storeu_ps(d + n + 8, in[2]);
+		_mm_storeu_ps(d + n + 12, in[3]);
+
+		if ((g += 16) == n_gains)
+			g = 0;
+	}
+	if (n < n_samples)
+		volume_f32_c(d + n, s + n, gain + g, n_gains - g, n_samples - n);
+}
+
+void spa_volume_get_ops_sse2(struct spa_volume_ops *ops)
+{
+	ops->volume[VOLUME_S16] = volume_s16_sse2;
+	ops->volume[VOLUME_F32] = volume_f32_sse2;
+}
@@ -0,0 +1,198 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+#include <endian.h>
+
+#include "volume-ops.h"
+
+#define S24_MIN		-8388608
+#define S24_MAX		8388607
+
+static inline int32_t read_s24(const uint8_t *p)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	return ((int32_t) (((uint32_t) p[2] << 24) | (p[1] << 16) | (p[0] << 8))) >> 8;
+#else
+	return ((int32_t) (((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8))) >> 8;
+#endif
+}
+
+static inline void write_s24(uint8_t *p, int32_t v)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+#else
+	p[0] = v >> 16;
+	p[1] = v >> 8;
+	p[2] = v;
+#endif
+}
+
+/* the vector versions convert to float, multiply and round to the nearest
+ * integer with saturation, do exactly the same here */
+void volume_s16_c(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	uint32_t n, g = 0;
+
+	for (n = 0; n < n_samples; n++) {
+		long v = lrintf(s[n] * gain[g]);
+		d[n] = SPA_CLAMP(v, INT16_MIN, INT16_MAX);
+		if (++g == n_gains)
+			g = 0;
+	}
+}
+
+void volume_s24_c(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint32_t n, g = 0;
+
+	for (n = 0; n < n_samples; n++) {
+		long v = lrintf(read_s24(s) * gain[g]);
+		write_s24(d, SPA_CLAMP(v, S24_MIN, S24_MAX));
+		s += 3;
+		d += 3;
+		if (++g == n_gains)
+			g = 0;
+	}
+}
+
+/* float does not have enough precision for 32 bits samples */
+void volume_s32_c(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	uint32_t n, g = 0;
+
+	for (n = 0; n < n_samples; n++) {
+		int64_t v = llrint(s[n] * (double) gain[g]);
+		d[n] = SPA_CLAMP(v, INT32_MIN, INT32_MAX);
+		if (++g == n_gains)
+			g = 0;
+	}
+}
+
+void volume_f32_c(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d = dst;
+	uint32_t n, g = 0;
+
+	for (n = 0; n < n_samples; n++) {
+		d[n] = s[n] * gain[g];
+		if (++g == n_gains)
+			g = 0;
+	}
+}
+
+/* ramps are short and need a new gain for each frame, they are done in C
+ * with the gains in double precision so that they don't drift */
+#define MAKE_RAMP(fmt,type,read,write)							\
+static void										\
+volume_ramp_##fmt##_c(void *dst, const void *src, double *gain, const double *step,	\
+		      bool log, uint32_t n_channels, uint32_t n_frames)			\
+{											\
+	const type *s = src;								\
+	type *d = dst;									\
+	uint32_t n, c;									\
+											\
+	for (n = 0; n < n_frames; n++) {						\
+		for (c = 0; c < n_channels; c++) {					\
+			write(d, read(s) * gain[c]);					\
+			s++;								\
+			d++;								\
+			if (log)							\
+				gain[c] *= step[c];					\
+			else								\
+				gain[c] += step[c];					\
+		}									\
+	}										\
+}
+
+static inline void write_ramp_s16(int16_t *d, double v)
+{
+	long l = lrint(v);
+	*d = SPA_CLAMP(l, INT16_MIN, INT16_MAX);
+}
+
+static inline void write_ramp_s32(int32_t *d, double v)
+{
+	int64_t l = llrint(v);
+	*d = SPA_CLAMP(l, INT32_MIN, INT32_MAX);
+}
+
+static inline void write_ramp_f32(float *d, double v)
+{
+	*d = v;
+}
+
+#define READ_SAMPLE(s)	(*(s))
+
+MAKE_RAMP(s16, int16_t, READ_SAMPLE, write_ramp_s16)
+MAKE_RAMP(s32, int32_t, READ_SAMPLE, write_ramp_s32)
+MAKE_RAMP(f32, float, READ_SAMPLE, write_ramp_f32)
+
+/* packed 24 bits samples are handled as 3 bytes */
+struct s24 {
+	uint8_t v[3];
+};
+
+static inline int32_t read_ramp_s24(const struct s24 *s)
+{
+	return read_s24(s->v);
+}
+
+static inline void write_ramp_s24(struct s24 *d, double v)
+{
+	long l = lrint(v);
+	write_s24(d->v, SPA_CLAMP(l, S24_MIN, S24_MAX));
+}
+
+MAKE_RAMP(s24, struct s24, read_ramp_s24, write_ramp_s24)
+
+void spa_volume_get_ops(struct spa_volume_ops *ops, uint32_t cpu_flags)
+{
+	ops->volume[VOLUME_S16] = volume_s16_c;
+	ops->volume[VOLUME_S24] = volume_s24_c;
+	ops->volume[VOLUME_S32] = volume_s32_c;
+	ops->volume[VOLUME_F32] = volume_f32_c;
+	ops->ramp[VOLUME_S16] = volume_ramp_s16_c;
+	ops->ramp[VOLUME_S24] = volume_ramp_s24_c;
+	ops->ramp[VOLUME_S32] = volume_ramp_s32_c;
+	ops->ramp[VOLUME_F32] = volume_ramp_f32_c;
+
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2)
+		spa_volume_get_ops_sse2(ops);
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		spa_volume_get_ops_avx2(ops);
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		spa_volume_get_ops_neon(ops);
+#endif
+}
@@ -0,0 +1,72 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/cpu.h>
+
+/* The gains for interleaved samples are passed as a line of gains that is
+ * repeated over the samples, sample n gets gain[n % n_gains]. The line length
+ * is a multiple of the number of channels and of VOLUME_LINE_ALIGN so that
+ * the vector versions never wrap inside a vector. */
+#define VOLUME_LINE_ALIGN	16
+
+typedef void (*volume_func_t) (void *dst, const void *src,
+			       const float *gain, uint32_t n_gains, uint32_t n_samples);
+
+/* Ramp the gain of each channel over \a n_frames frames. After each frame
+ * gain[c] is incremented with step[c] for a linear ramp or multiplied with
+ * step[c] for a logarithmic ramp. The updated gains are returned in \a gain. */
+typedef void (*volume_ramp_func_t) (void *dst, const void *src,
+				    double *gain, const double *step, bool log,
+				    uint32_t n_channels, uint32_t n_frames);
+
+enum {
+	VOLUME_S16,
+	VOLUME_S24,
+	VOLUME_S32,
+	VOLUME_F32,
+	VOLUME_MAX,
+};
+
+struct spa_volume_ops {
+	volume_func_t volume[VOLUME_MAX];
+	volume_ramp_func_t ramp[VOLUME_MAX];
+};
+
+/* fill ops with the best implementation for the features in cpu_flags */
+void spa_volume_get_ops(struct spa_volume_ops *ops, uint32_t cpu_flags);
+
+/* plain C versions, used as fallback and as reference */
+void volume_s16_c(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples);
+void volume_s24_c(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples);
+void volume_s32_c(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples);
+void volume_f32_c(void *dst, const void *src, const float *gain, uint32_t n_gains, uint32_t n_samples);
+
+#if defined(HAVE_SSE2)
+void spa_volume_get_ops_sse2(struct spa_volume_ops *ops);
+#endif
+#if defined(HAVE_AVX2)
+void spa_volume_get_ops_avx2(struct spa_volume_ops *ops);
+#endif
+#if defined(HAVE_NEON)
+void spa_volume_get_ops_neon(struct spa_volume_ops *ops);
+#endif
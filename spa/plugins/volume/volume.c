@@ -20,8 +20,10 @@
 #include <errno.h>
 #include <string.h>
 #include <stddef.h>
+#include <math.h>
 
 #include <spa/support/log.h>
+#include <spa/support/loop.h>
 #include <spa/support/type-map.h>
 #include <spa/utils/list.h>
 #include <spa/node/node.h>
@@ -31,13 +33,23 @@
 
 #include <lib/pod.h>
 
+#include "volume-ops.h"
+
 #define NAME "volume"
 
 #define MAX_BUFFERS     16
+#define MAX_CHANNELS    64
+
+/* log ramps can't start or end at 0, they go to this gain (-60dB) instead */
+#define RAMP_LOG_MIN    0.001
 
 struct props {
 	double volume;
 	bool mute;
+	float channel_volumes[MAX_CHANNELS];
+	uint32_t n_channel_volumes;
+	int32_t ramp_time;
+	uint32_t ramp_type;
 };
 
 struct buffer {
@@ -67,6 +79,11 @@ struct type {
 	uint32_t props;
 	uint32_t prop_volume;
 	uint32_t prop_mute;
+	uint32_t prop_channel_volumes;
+	uint32_t prop_ramp_time;
+	uint32_t prop_ramp_type;
+	uint32_t ramp_linear;
+	uint32_t ramp_log;
 	struct spa_type_param param;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
@@ -87,6 +104,11 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
 	type->prop_mute = spa_type_map_get_id(map, SPA_TYPE_PROPS__mute);
+	type->prop_channel_volumes = spa_type_map_get_id(map, SPA_TYPE_PROPS__channelVolumes);
+	type->prop_ramp_time = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampTime);
+	type->prop_ramp_type = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType);
+	type->ramp_linear = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType ":linear");
+	type->ramp_log = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampType ":log");
 	spa_type_param_map(map, &type->param);
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
@@ -107,14 +129,36 @@ struct impl {
 	struct type type;
 	struct spa_type_map *map;
 	struct spa_log *log;
+	struct spa_loop *data_loop;
 
 	struct props props;
+	/* copy of the props for the data thread, updated with spa_loop_invoke */
+	struct props data_props;
+	bool props_changed;
 
 	const struct spa_node_callbacks *callbacks;
 	void *callbacks_data;
 
+	uint32_t cpu_flags;
+	struct spa_volume_ops ops;
+
 	struct spa_audio_info current_format;
 	int bpf;
+	int conv;
+	uint32_t n_channels;
+
+	/* the current gain of each channel and the ramp towards the target */
+	bool have_gain;
+	double gain[MAX_CHANNELS];
+	double step[MAX_CHANNELS];
+	double target[MAX_CHANNELS];
+	uint32_t ramp_left;
+	bool ramp_log;
+	bool unity;
+
+	/* the target gains repeated for the interleaved samples */
+	float line[MAX_CHANNELS * VOLUME_LINE_ALIGN];
+	uint32_t n_line;
 
 	struct port in_ports[1];
 	struct port out_ports[1];
@@ -131,11 +175,45 @@ struct impl {
 
 #define DEFAULT_VOLUME 1.0
 #define DEFAULT_MUTE false
+#define DEFAULT_RAMP_TIME 10000
 
-static void reset_props(struct props *props)
+static void reset_props(struct impl *this, struct props *props)
 {
+	uint32_t i;
+
 	props->volume = DEFAULT_VOLUME;
 	props->mute = DEFAULT_MUTE;
+	for (i = 0; i < MAX_CHANNELS; i++)
+		props->channel_volumes[i] = 1.0;
+	props->n_channel_volumes = 0;
+	props->ramp_time = DEFAULT_RAMP_TIME;
+	props->ramp_type = this->type.ramp_linear;
+}
+
+static int do_update_props(struct spa_loop *loop,
+			   bool async,
+			   uint32_t seq,
+			   size_t size,
+			   const void *data,
+			   void *user_data)
+{
+	struct impl *this = user_data;
+
+	this->data_props = *(const struct props *) data;
+	this->props_changed = true;
+	return 0;
+}
+
+/* hand the props over to the data thread, the gains are updated before
+ * the next buffer is processed */
+static void update_props(struct impl *this)
+{
+	if (this->data_loop)
+		spa_loop_invoke(this->data_loop, do_update_props, SPA_ID_INVALID,
+				sizeof(struct props), &this->props, false, this);
+	else
+		do_update_props(NULL, false, SPA_ID_INVALID,
+				sizeof(struct props), &this->props, this);
 }
 
 static int impl_node_enum_params(struct spa_node *node,
@@ -176,8 +254,15 @@ static int impl_node_enum_params(struct spa_node *node,
 
 		param = spa_pod_builder_object(&b,
 			id, t->props,
-			":", t->prop_volume, "dr", p->volume, 2, 0.0, 10.0,
-			":", t->prop_mute,   "b",  p->mute);
+			":", t->prop_volume,    "dr", p->volume, 2, 0.0, 10.0,
+			":", t->prop_mute,      "b",  p->mute,
+			":", t->prop_channel_volumes, "a", sizeof(float), SPA_POD_TYPE_FLOAT,
+								p->n_channel_volumes,
+								p->channel_volumes,
+			":", t->prop_ramp_time, "ir", p->ramp_time, 2, 0, INT32_MAX,
+			":", t->prop_ramp_type, "Ie", p->ramp_type,
+							2, t->ramp_linear,
+							   t->ramp_log);
 	}
 	else
 		return -ENOENT;
@@ -203,14 +288,35 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 
 	if (id == t->param.idProps) {
 		struct props *p = &this->props;
+		struct spa_pod *volumes = NULL;
 
 		if (param == NULL) {
-			reset_props(p);
+			reset_props(this, p);
+			update_props(this);
 			return 0;
 		}
 		spa_pod_object_parse(param,
-			":", t->prop_volume, "?d", &p->volume,
-			":", t->prop_mute,   "?b", &p->mute, NULL);
+			":", t->prop_volume,    "?d", &p->volume,
+			":", t->prop_mute,      "?b", &p->mute,
+			":", t->prop_channel_volumes, "?P", &volumes,
+			":", t->prop_ramp_time, "?i", &p->ramp_time,
+			":", t->prop_ramp_type, "?I", &p->ramp_type, NULL);
+
+		if (volumes && SPA_POD_TYPE(volumes) == SPA_POD_TYPE_ARRAY) {
+			struct spa_pod_array *arr = (struct spa_pod_array *) volumes;
+
+			if (arr->body.child.type == SPA_POD_TYPE_FLOAT &&
+			    arr->body.child.size == sizeof(float)) {
+				p->n_channel_volumes = SPA_MIN((SPA_POD_BODY_SIZE(arr) -
+						sizeof(struct spa_pod_array_body)) / sizeof(float),
+						MAX_CHANNELS);
+				memcpy(p->channel_volumes, SPA_MEMBER(arr, sizeof(struct spa_pod_array), void),
+				       p->n_channel_volumes * sizeof(float));
+			}
+		}
+		p->volume = SPA_CLAMP(p->volume, 0.0, 10.0);
+		p->ramp_time = SPA_MAX(p->ramp_time, 0);
+		update_props(this);
 	}
 	else
 		return -ENOENT;
@@ -343,8 +449,10 @@ static int port_enum_formats(struct spa_node *node,
 			"I", t->media_type.audio,
 			"I", t->media_subtype.raw,
 			":", t->format_audio.format,  "Ieu", t->audio_format.S16,
-									2, t->audio_format.S16,
+									4, t->audio_format.S16,
+								           t->audio_format.S24,
 								           t->audio_format.S32,
+								           t->audio_format.F32,
 			":", t->format_audio.rate,    "iru", 44100,	2, 1, INT32_MAX,
 			":", t->format_audio.channels,"iru", 2,		2, 1, INT32_MAX);
 		break;
@@ -509,8 +617,29 @@ static int port_set_format(struct spa_node *node,
 		if (spa_format_audio_raw_parse(format, &info.info.raw, &this->type.format_audio) < 0)
 			return -EINVAL;
 
-		this->bpf = 2 * info.info.raw.channels;
+		if (info.info.raw.channels == 0 || info.info.raw.channels > MAX_CHANNELS)
+			return -EINVAL;
+
+		if (info.info.raw.format == this->type.audio_format.S16) {
+			this->conv = VOLUME_S16;
+			this->bpf = 2;
+		} else if (info.info.raw.format == this->type.audio_format.S24) {
+			this->conv = VOLUME_S24;
+			this->bpf = 3;
+		} else if (info.info.raw.format == this->type.audio_format.S32) {
+			this->conv = VOLUME_S32;
+			this->bpf = 4;
+		} else if (info.info.raw.format == this->type.audio_format.F32) {
+			this->conv = VOLUME_F32;
+			this->bpf = 4;
+		} else
+			return -EINVAL;
+
+		this->n_channels = info.info.raw.channels;
+		this->bpf *= this->n_channels;
 		this->current_format = info;
+		this->have_gain = false;
+		update_props(this);
 		port->have_format = true;
 	}
 
@@ -684,14 +813,114 @@ static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
 	return b->outbuf;
 }
 
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = b;
+		b = a % b;
+		a = t;
+	}
+	return a;
+}
+
+/* set the gains to the target and make the line of gains for the samples */
+static void finish_ramp(struct impl *this)
+{
+	uint32_t i, n_channels = this->n_channels;
+
+	this->unity = true;
+	for (i = 0; i < n_channels; i++) {
+		this->gain[i] = this->target[i];
+		if (this->target[i] != 1.0)
+			this->unity = false;
+	}
+	this->n_line = n_channels * VOLUME_LINE_ALIGN / gcd(n_channels, VOLUME_LINE_ALIGN);
+	for (i = 0; i < this->n_line; i++)
+		this->line[i] = this->target[i % n_channels];
+	this->ramp_left = 0;
+}
+
+/* compute the new target gains and start a ramp towards them */
+static void update_gains(struct impl *this)
+{
+	struct props *p = &this->data_props;
+	uint32_t i, n_frames;
+	bool changed = false;
+
+	for (i = 0; i < this->n_channels; i++) {
+		double target = p->mute ? 0.0 : p->volume;
+		if (i < p->n_channel_volumes)
+			target *= p->channel_volumes[i];
+		if (this->target[i] != target)
+			changed = true;
+		this->target[i] = target;
+	}
+	if (!changed && this->have_gain)
+		return;
+
+	n_frames = (uint64_t) p->ramp_time * this->current_format.info.raw.rate / SPA_USEC_PER_SEC;
+
+	if (!this->have_gain || n_frames == 0) {
+		this->have_gain = true;
+		finish_ramp(this);
+		return;
+	}
+
+	this->ramp_log = p->ramp_type == this->type.ramp_log;
+	for (i = 0; i < this->n_channels; i++) {
+		if (this->ramp_log) {
+			double from = SPA_MAX(this->gain[i], RAMP_LOG_MIN);
+			double to = SPA_MAX(this->target[i], RAMP_LOG_MIN);
+			this->gain[i] = from;
+			this->step[i] = pow(to / from, 1.0 / n_frames);
+		} else {
+			this->step[i] = (this->target[i] - this->gain[i]) / n_frames;
+		}
+	}
+	this->ramp_left = n_frames;
+	this->unity = false;
+
+	spa_log_trace(this->log, NAME " %p: ramp over %u frames", this, n_frames);
+}
+
+static void process_frames(struct impl *this, void *dst, const void *src, uint32_t n_frames)
+{
+	uint32_t n;
+
+	if (this->ramp_left > 0) {
+		n = SPA_MIN(n_frames, this->ramp_left);
+
+		this->ops.ramp[this->conv](dst, src, this->gain, this->step, this->ramp_log,
+					   this->n_channels, n);
+		if ((this->ramp_left -= n) == 0)
+			finish_ramp(this);
+
+		n_frames -= n;
+		dst = SPA_MEMBER(dst, n * this->bpf, void);
+		src = SPA_MEMBER(src, n * this->bpf, void);
+	}
+	if (n_frames == 0)
+		return;
+
+	if (this->unity) {
+		if (dst != src)
+			memcpy(dst, src, n_frames * this->bpf);
+	} else {
+		this->ops.volume[this->conv](dst, src, this->line, this->n_line,
+					     n_frames * this->n_channels);
+	}
+}
+
 static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
 {
-	uint32_t si, di, i, n_samples, n_bytes, soff, doff;
+	uint32_t si, di, n_frames, n_bytes, soff, doff;
 	struct spa_data *sd, *dd;
-	int16_t *src, *dst;
-	double volume;
+	void *src, *dst;
 
-	volume = this->props.volume;
+	if (this->props_changed) {
+		this->props_changed = false;
+		update_gains(this);
+	}
 
 	si = di = 0;
 	soff = doff = 0;
@@ -703,14 +932,16 @@ static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buf
 		sd = &sbuf->datas[si];
 		dd = &dbuf->datas[di];
 
-		src = (int16_t *) ((uint8_t *) sd->data + sd->chunk->offset + soff);
-		dst = (int16_t *) ((uint8_t *) dd->data + doff);
+		src = SPA_MEMBER(sd->data, sd->chunk->offset + soff, void);
+		dst = SPA_MEMBER(dd->data, doff, void);
 
 		n_bytes = SPA_MIN(sd->chunk->size - soff, dd->maxsize - doff);
-		n_samples = n_bytes / sizeof(uint16_t);
+		n_frames = n_bytes / this->bpf;
+		if (n_frames == 0)
+			break;
+		n_bytes = n_frames * this->bpf;
 
-		for (i = 0; i < n_samples; i++)
-			dst[i] = src[i] * volume;
+		process_frames(this, dst, src, n_frames);
 
 		soff += n_bytes;
 		doff += n_bytes;
@@ -718,11 +949,11 @@ static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buf
 		dd->chunk->offset = 0;
 		dd->chunk->size = doff;
 
-		if (soff >= sd->chunk->size) {
+		if (soff + this->bpf > sd->chunk->size) {
 			si++;
 			soff = 0;
 		}
-		if (doff >= dd->maxsize) {
+		if (doff + this->bpf > dd->maxsize) {
 			di++;
 			doff = 0;
 		}
@@ -874,6 +1105,8 @@ impl_init(const struct spa_handle_factory *factory,
 			this->map = support[i].data;
 		else if (strcmp(support[i].type, SPA_TYPE__Log) == 0)
 			this->log = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE_LOOP__DataLoop) == 0)
+			this->data_loop = support[i].data;
 	}
 	if (this->map == NULL) {
 		spa_log_error(this->log, "a type-map is needed");
@@ -882,7 +1115,12 @@ impl_init(const struct spa_handle_factory *factory,
 	init_type(&this->type, this->map);
 
 	this->node = impl_node;
-	reset_props(&this->props);
+	reset_props(this, &this->props);
+	this->data_props = this->props;
+
+	this->cpu_flags = spa_cpu_get_flags();
+	spa_volume_get_ops(&this->ops, this->cpu_flags);
+	spa_log_info(this->log, NAME " %p: cpu flags %08x", this, this->cpu_flags);
 
 	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
 	    SPA_PORT_INFO_FLAG_IN_PLACE;
@@ -0,0 +1,431 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <spa/support/log-impl.h>
+#include <spa/support/loop.h>
+#include <spa/support/type-map-impl.h>
+#include <spa/node/node.h>
+#include <spa/param/param.h>
+#include <spa/param/props.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/format-utils.h>
+#include <spa/graph/graph.h>
+#include <spa/graph/graph-scheduler7.h>
+
+/* Runs audiotestsrc -> volume -> fakesink with the freewheel driver of the
+ * graph, cycles are started back-to-back without a clock and the benchmark
+ * reports how many cycles per second the graph can do. */
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+#define RATE		44100
+#define CHANNELS	2
+#define N_BUFFERS	2
+
+struct type {
+	uint32_t node;
+	uint32_t props;
+	uint32_t format;
+	uint32_t props_volume;
+	uint32_t props_live;
+	struct spa_type_param param;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+	struct spa_type_command_node command_node;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
+	type->props_live = spa_type_map_get_id(map, SPA_TYPE_PROPS__live);
+	spa_type_param_map(map, &type->param);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+	spa_type_command_node_map(map, &type->command_node);
+}
+
+struct buffer {
+	struct spa_buffer buffer;
+	struct spa_meta metas[1];
+	struct spa_meta_header header;
+	struct spa_data datas[1];
+	struct spa_chunk chunks[1];
+};
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_log *log;
+	struct spa_loop data_loop;
+	struct type type;
+
+	struct spa_support support[4];
+	uint32_t n_support;
+
+	struct spa_graph graph;
+	struct spa_graph_data graph_data;
+
+	struct spa_node *source;
+	struct spa_graph_node source_node;
+	struct spa_graph_port source_out;
+	struct spa_port_io source_volume_io[1];
+	struct spa_buffer *source_buffers[N_BUFFERS];
+	struct buffer source_buffer[N_BUFFERS];
+
+	struct spa_node *volume;
+	struct spa_graph_node volume_node;
+	struct spa_graph_port volume_in;
+	struct spa_graph_port volume_out;
+	struct spa_port_io volume_sink_io[1];
+	struct spa_buffer *volume_buffers[N_BUFFERS];
+	struct buffer volume_buffer[N_BUFFERS];
+
+	struct spa_node *sink;
+	struct spa_graph_node sink_node;
+	struct spa_graph_port sink_in;
+};
+
+static void
+init_buffer(struct data *data, struct spa_buffer **bufs, struct buffer *ba, int n_buffers,
+	    size_t size)
+{
+	int i;
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &ba[i];
+		bufs[i] = &b->buffer;
+
+		b->buffer.id = i;
+		b->buffer.n_metas = 1;
+		b->buffer.metas = b->metas;
+		b->buffer.n_datas = 1;
+		b->buffer.datas = b->datas;
+
+		b->header.flags = 0;
+		b->header.seq = 0;
+		b->header.pts = 0;
+		b->header.dts_offset = 0;
+		b->metas[0].type = data->type.meta.Header;
+		b->metas[0].data = &b->header;
+		b->metas[0].size = sizeof(b->header);
+
+		b->datas[0].type = data->type.data.MemPtr;
+		b->datas[0].flags = 0;
+		b->datas[0].fd = -1;
+		b->datas[0].mapoffset = 0;
+		b->datas[0].maxsize = size;
+		b->datas[0].data = calloc(1, size);
+		b->datas[0].chunk = &b->chunks[0];
+		b->datas[0].chunk->offset = 0;
+		b->datas[0].chunk->size = size;
+		b->datas[0].chunk->stride = 0;
+	}
+}
+
+static int make_node(struct data *data, struct spa_node **node, const char *lib, const char *name)
+{
+	struct spa_handle *handle;
+	int res;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return -errno;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -errno;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		handle = calloc(1, factory->size);
+		if ((res =
+		     spa_handle_factory_init(factory, handle, NULL, data->support,
+					     data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(handle, data->type.node, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		*node = iface;
+		return 0;
+	}
+	return -EBADF;
+}
+
+static int do_add_source(struct spa_loop *loop, struct spa_source *source)
+{
+	return 0;
+}
+
+static int do_update_source(struct spa_source *source)
+{
+	return 0;
+}
+
+static void do_remove_source(struct spa_source *source)
+{
+}
+
+static int
+do_invoke(struct spa_loop *loop,
+	  spa_invoke_func_t func, uint32_t seq, size_t size, const void *data, bool block, void *user_data)
+{
+	return func(loop, false, seq, size, data, user_data);
+}
+
+static void add_node(struct data *data, struct spa_graph_node *gnode, struct spa_node *node)
+{
+	spa_graph_node_init(gnode);
+	spa_graph_node_set_implementation(gnode, node);
+	spa_graph_node_add(&data->graph, gnode);
+}
+
+static void link_nodes(struct spa_graph_node *out_node, struct spa_graph_port *out,
+		       struct spa_graph_node *in_node, struct spa_graph_port *in,
+		       struct spa_port_io *io)
+{
+	*io = SPA_PORT_IO_INIT;
+	io->status = SPA_STATUS_NEED_BUFFER;
+
+	spa_node_port_set_io(out_node->implementation, SPA_DIRECTION_OUTPUT, 0, io);
+	spa_node_port_set_io(in_node->implementation, SPA_DIRECTION_INPUT, 0, io);
+
+	spa_graph_port_init(out, SPA_DIRECTION_OUTPUT, 0, 0, io);
+	spa_graph_port_add(out_node, out);
+	spa_graph_port_init(in, SPA_DIRECTION_INPUT, 0, 0, io);
+	spa_graph_port_add(in_node, in);
+	spa_graph_port_link(out, in);
+}
+
+static int make_nodes(struct data *data)
+{
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod *props;
+	uint8_t buffer[128];
+	int res;
+
+	/* no callbacks, the nodes don't drive the graph themselves */
+	if ((res = make_node(data, &data->source,
+			     "build/spa/plugins/audiotestsrc/libspa-audiotestsrc.so",
+			     "audiotestsrc")) < 0) {
+		printf("can't create audiotestsrc: %d\n", res);
+		return res;
+	}
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	props = spa_pod_builder_object(&b,
+		0, data->type.props,
+		":", data->type.props_live, "b", false);
+	if ((res = spa_node_set_param(data->source, data->type.param.idProps, 0, props)) < 0)
+		printf("got set_props error %d\n", res);
+
+	if ((res = make_node(data, &data->volume,
+			     "build/spa/plugins/volume/libspa-volume.so", "volume")) < 0) {
+		printf("can't create volume: %d\n", res);
+		return res;
+	}
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	props = spa_pod_builder_object(&b,
+		0, data->type.props,
+		":", data->type.props_volume, "d", 0.5);
+	if ((res = spa_node_set_param(data->volume, data->type.param.idProps, 0, props)) < 0)
+		printf("got set_props error %d\n", res);
+
+	if ((res = make_node(data, &data->sink,
+			     "build/spa/plugins/test/libspa-test.so", "fakesink")) < 0) {
+		printf("can't create fakesink: %d\n", res);
+		return res;
+	}
+
+	add_node(data, &data->source_node, data->source);
+	add_node(data, &data->volume_node, data->volume);
+	add_node(data, &data->sink_node, data->sink);
+
+	link_nodes(&data->source_node, &data->source_out,
+		   &data->volume_node, &data->volume_in, &data->source_volume_io[0]);
+	link_nodes(&data->volume_node, &data->volume_out,
+		   &data->sink_node, &data->sink_in, &data->volume_sink_io[0]);
+
+	return 0;
+}
+
+static int negotiate_formats(struct data *data, uint32_t n_frames)
+{
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod *format;
+	uint8_t buffer[256];
+	size_t size = n_frames * CHANNELS * sizeof(int16_t);
+	int res;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	format = spa_pod_builder_object(&b,
+		0, data->type.format,
+		"I", data->type.media_type.audio,
+		"I", data->type.media_subtype.raw,
+		":", data->type.format_audio.format,   "I", data->type.audio_format.S16,
+		":", data->type.format_audio.layout,   "i", SPA_AUDIO_LAYOUT_INTERLEAVED,
+		":", data->type.format_audio.rate,     "i", RATE,
+		":", data->type.format_audio.channels, "i", CHANNELS);
+
+	if ((res = spa_node_port_set_param(data->source, SPA_DIRECTION_OUTPUT, 0,
+					   data->type.param.idFormat, 0, format)) < 0 ||
+	    (res = spa_node_port_set_param(data->volume, SPA_DIRECTION_INPUT, 0,
+					   data->type.param.idFormat, 0, format)) < 0 ||
+	    (res = spa_node_port_set_param(data->volume, SPA_DIRECTION_OUTPUT, 0,
+					   data->type.param.idFormat, 0, format)) < 0 ||
+	    (res = spa_node_port_set_param(data->sink, SPA_DIRECTION_INPUT, 0,
+					   data->type.param.idFormat, 0, format)) < 0)
+		return res;
+
+	init_buffer(data, data->source_buffers, data->source_buffer, N_BUFFERS, size);
+	if ((res = spa_node_port_use_buffers(data->source, SPA_DIRECTION_OUTPUT, 0,
+					     data->source_buffers, N_BUFFERS)) < 0 ||
+	    (res = spa_node_port_use_buffers(data->volume, SPA_DIRECTION_INPUT, 0,
+					     data->source_buffers, N_BUFFERS)) < 0)
+		return res;
+
+	init_buffer(data, data->volume_buffers, data->volume_buffer, N_BUFFERS, size);
+	if ((res = spa_node_port_use_buffers(data->volume, SPA_DIRECTION_OUTPUT, 0,
+					     data->volume_buffers, N_BUFFERS)) < 0 ||
+	    (res = spa_node_port_use_buffers(data->sink, SPA_DIRECTION_INPUT, 0,
+					     data->volume_buffers, N_BUFFERS)) < 0)
+		return res;
+
+	return 0;
+}
+
+static void send_command(struct data *data, uint32_t id)
+{
+	struct spa_command cmd = SPA_COMMAND_INIT(id);
+	int res;
+
+	if ((res = spa_node_send_command(data->source, &cmd)) < 0)
+		printf("got source error %d\n", res);
+	if ((res = spa_node_send_command(data->volume, &cmd)) < 0)
+		printf("got volume error %d\n", res);
+	if ((res = spa_node_send_command(data->sink, &cmd)) < 0)
+		printf("got sink error %d\n", res);
+}
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL };
+	uint32_t n_frames, n_cycles, i;
+	int64_t start, elapsed;
+	const char *str;
+	int res;
+
+	n_frames = argc > 1 ? atoi(argv[1]) : 256;
+	n_cycles = argc > 2 ? atoi(argv[2]) : 100000;
+
+	spa_graph_init(&data.graph);
+	spa_graph_data_init(&data.graph_data, &data.graph);
+	spa_graph_set_callbacks(&data.graph, &spa_graph_impl_default, &data.graph_data);
+	spa_graph_data_set_freewheel(&data.graph_data, true);
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+	data.data_loop.version = SPA_VERSION_LOOP;
+	data.data_loop.add_source = do_add_source;
+	data.data_loop.update_source = do_update_source;
+	data.data_loop.remove_source = do_remove_source;
+	data.data_loop.invoke = do_invoke;
+
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.support[0] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, data.map);
+	data.support[1] = SPA_SUPPORT_INIT(SPA_TYPE__Log, data.log);
+	data.support[2] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__DataLoop, &data.data_loop);
+	data.support[3] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__MainLoop, &data.data_loop);
+	data.n_support = 4;
+
+	init_type(&data.type, data.map);
+
+	if ((res = make_nodes(&data)) < 0) {
+		printf("can't make nodes: %d\n", res);
+		return -1;
+	}
+	if ((res = negotiate_formats(&data, n_frames)) < 0) {
+		printf("can't negotiate nodes: %d\n", res);
+		return -1;
+	}
+
+	send_command(&data, data.type.command_node.Start);
+
+	start = get_time();
+	for (i = 0; i < n_cycles; i++) {
+		if ((res = spa_graph_plan_freewheel(&data.graph_data)) < 0) {
+			printf("cycle %u failed: %s\n", i, spa_strerror(res));
+			break;
+		}
+	}
+	elapsed = get_time() - start;
+
+	send_command(&data, data.type.command_node.Pause);
+
+	printf("%u cycles of %u frames in %" PRIi64 " ns: %.0f cycles/s, %.1fx realtime\n",
+	       i, n_frames, elapsed, (double)i * SPA_NSEC_PER_SEC / elapsed,
+	       (double)i * n_frames * SPA_NSEC_PER_SEC / RATE / elapsed);
+
+	return i == n_cycles ? 0 : 1;
+}
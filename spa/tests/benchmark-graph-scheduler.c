@@ -0,0 +1,140 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "benchmark-graph.h"
+
+/* compiled with -DSCHEDULER=<n> for each graph-scheduler<n>.h */
+
+#define debug(...)
+
+#define SCHEDULER_HEADER2(n)	<spa/graph/graph-scheduler##n.h>
+#define SCHEDULER_HEADER(n)	SCHEDULER_HEADER2(n)
+#define SCHEDULER_NAME2(n)	bench_scheduler##n
+#define SCHEDULER_NAME(n)	SCHEDULER_NAME2(n)
+#define STR2(n)			#n
+#define STR(n)			STR2(n)
+
+#include SCHEDULER_HEADER(SCHEDULER)
+
+#if SCHEDULER == 3
+/* this one has no data */
+struct spa_graph_data {
+	struct spa_graph *graph;
+};
+
+static inline void spa_graph_data_init(struct spa_graph_data *data,
+				       struct spa_graph *graph)
+{
+	data->graph = graph;
+}
+#endif
+
+struct data {
+	struct spa_graph_data data;
+#if SCHEDULER == 7
+	sem_t sem;
+	bool running;
+	uint32_t n_workers;
+	pthread_t workers[16];
+#endif
+};
+
+#if SCHEDULER == 7
+static void *worker_start(void *arg)
+{
+	struct data *d = arg;
+
+	while (true) {
+		while (sem_wait(&d->sem) < 0 && errno == EINTR);
+		if (!d->running)
+			break;
+		spa_graph_plan_work(&d->data);
+	}
+	return NULL;
+}
+
+static void workers_wakeup(void *data, uint32_t n_workers)
+{
+	struct data *d = data;
+
+	while (n_workers--)
+		sem_post(&d->sem);
+}
+
+static const struct spa_graph_workers workers = {
+	SPA_VERSION_GRAPH_WORKERS,
+	.wakeup = workers_wakeup,
+};
+#endif
+
+static void *create(struct spa_graph *graph, uint32_t n_workers)
+{
+	struct data *d;
+
+	if ((d = calloc(1, sizeof(struct data))) == NULL)
+		return NULL;
+
+	spa_graph_data_init(&d->data, graph);
+
+#if SCHEDULER == 7
+	d->n_workers = SPA_MIN(n_workers, SPA_N_ELEMENTS(d->workers));
+	if (d->n_workers > 0) {
+		uint32_t i;
+
+		sem_init(&d->sem, 0, 0);
+		d->running = true;
+		for (i = 0; i < d->n_workers; i++)
+			pthread_create(&d->workers[i], NULL, worker_start, d);
+		spa_graph_data_set_workers(&d->data, &workers, d, d->n_workers);
+	}
+#endif
+	return d;
+}
+
+static void destroy(void *data)
+{
+	struct data *d = data;
+
+#if SCHEDULER == 7
+	if (d->n_workers > 0) {
+		uint32_t i;
+
+		d->running = false;
+		for (i = 0; i < d->n_workers; i++)
+			sem_post(&d->sem);
+		for (i = 0; i < d->n_workers; i++)
+			pthread_join(d->workers[i], NULL);
+		sem_destroy(&d->sem);
+	}
+	spa_graph_data_clear(&d->data);
+#endif
+	free(d);
+}
+
+const struct bench_scheduler SCHEDULER_NAME(SCHEDULER) = {
+	"scheduler" STR(SCHEDULER),
+	create,
+	destroy,
+	&spa_graph_impl_default,
+};
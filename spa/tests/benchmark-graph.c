@@ -0,0 +1,423 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <spa/node/node.h>
+
+#include "benchmark-graph.h"
+
+/* Runs cycles over synthetic graphs with every scheduler and reports the
+ * time per cycle, the worst case, the jitter and the cache misses per cycle.
+ * The nodes do a configurable amount of work so that the overhead of the
+ * scheduler can be compared with the cost of the processing. */
+
+#define DEFAULT_CYCLES	2000
+#define TIMEOUT		10
+
+struct bench_node {
+	struct spa_node node;
+	struct spa_graph_node gnode;
+	struct spa_graph_port *in;
+	struct spa_graph_port *out;
+	uint32_t n_in;
+	uint32_t n_out;
+	bool is_source;
+	bool is_sink;
+	uint32_t count;
+};
+
+struct bench_graph {
+	const char *name;
+	struct spa_graph graph;
+	struct bench_node *nodes;
+	uint32_t n_nodes;
+	struct spa_port_io *ios;
+	uint32_t n_ios;
+	struct bench_node *sink;
+};
+
+static const struct bench_scheduler *schedulers[] = {
+	&bench_scheduler1,
+	&bench_scheduler3,
+	&bench_scheduler4,
+	&bench_scheduler6,
+	&bench_scheduler7,
+};
+
+static uint32_t node_cost = 64;
+static uint32_t n_cycles = DEFAULT_CYCLES;
+static uint32_t n_workers = 0;
+static volatile float sink_value;
+
+/* the work of a node, a loop that the compiler can't remove */
+static void node_work(void)
+{
+	float v = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < node_cost; i++)
+		v = v * 0.999f + 0.5f;
+	sink_value = v;
+}
+
+static int node_process_input(struct spa_node *node)
+{
+	struct bench_node *n = SPA_CONTAINER_OF(node, struct bench_node, node);
+	uint32_t i;
+
+	n->count++;
+	node_work();
+	for (i = 0; i < n->n_in; i++)
+		n->in[i].io->status = SPA_STATUS_NEED_BUFFER;
+	if (n->is_sink)
+		return SPA_STATUS_OK;
+	for (i = 0; i < n->n_out; i++)
+		n->out[i].io->status = SPA_STATUS_HAVE_BUFFER;
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static int node_process_output(struct spa_node *node)
+{
+	struct bench_node *n = SPA_CONTAINER_OF(node, struct bench_node, node);
+	uint32_t i;
+
+	if (!n->is_source)
+		return SPA_STATUS_NEED_BUFFER;
+
+	n->count++;
+	node_work();
+	for (i = 0; i < n->n_out; i++)
+		n->out[i].io->status = SPA_STATUS_HAVE_BUFFER;
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static struct bench_node *add_node(struct bench_graph *g, uint32_t n_in, uint32_t n_out)
+{
+	struct bench_node *n = &g->nodes[g->n_nodes++];
+	uint32_t i;
+
+	n->node.version = SPA_VERSION_NODE;
+	n->node.process_input = node_process_input;
+	n->node.process_output = node_process_output;
+	n->is_source = n_in == 0;
+	n->is_sink = n_out == 0;
+	n->in = calloc(SPA_MAX(n_in, 1u), sizeof(struct spa_graph_port));
+	n->out = calloc(SPA_MAX(n_out, 1u), sizeof(struct spa_graph_port));
+	n->n_in = n_in;
+	n->n_out = n_out;
+
+	spa_graph_node_init(&n->gnode);
+	spa_graph_node_set_implementation(&n->gnode, &n->node);
+	spa_graph_node_add(&g->graph, &n->gnode);
+
+	for (i = 0; i < n_in; i++) {
+		spa_graph_port_init(&n->in[i], SPA_DIRECTION_INPUT, i, 0, NULL);
+		spa_graph_port_add(&n->gnode, &n->in[i]);
+	}
+	for (i = 0; i < n_out; i++) {
+		spa_graph_port_init(&n->out[i], SPA_DIRECTION_OUTPUT, i, 0, NULL);
+		spa_graph_port_add(&n->gnode, &n->out[i]);
+	}
+	if (n->is_sink)
+		g->sink = n;
+	return n;
+}
+
+static void link_nodes(struct bench_graph *g, struct bench_node *out, uint32_t out_port,
+		       struct bench_node *in, uint32_t in_port)
+{
+	struct spa_port_io *io = &g->ios[g->n_ios++];
+
+	*io = SPA_PORT_IO_INIT;
+	io->status = SPA_STATUS_NEED_BUFFER;
+	out->out[out_port].io = in->in[in_port].io = io;
+	spa_graph_port_link(&out->out[out_port], &in->in[in_port]);
+}
+
+static void graph_init(struct bench_graph *g, const char *name, uint32_t max_nodes)
+{
+	g->name = name;
+	spa_graph_init(&g->graph);
+	g->nodes = calloc(max_nodes, sizeof(struct bench_node));
+	g->ios = calloc(max_nodes * 2, sizeof(struct spa_port_io));
+	g->n_nodes = g->n_ios = 0;
+}
+
+static void graph_clear(struct bench_graph *g)
+{
+	uint32_t i;
+
+	for (i = 0; i < g->n_nodes; i++) {
+		free(g->nodes[i].in);
+		free(g->nodes[i].out);
+	}
+	free(g->nodes);
+	free(g->ios);
+}
+
+/* source -> filter -> ... -> sink */
+static void make_chain(struct bench_graph *g, uint32_t n_nodes)
+{
+	struct bench_node *prev, *n;
+	uint32_t i;
+
+	graph_init(g, "chain", n_nodes);
+	prev = add_node(g, 0, 1);
+	for (i = 0; i < n_nodes - 2; i++) {
+		n = add_node(g, 1, 1);
+		link_nodes(g, prev, 0, n, 0);
+		prev = n;
+	}
+	link_nodes(g, prev, 0, add_node(g, 1, 0), 0);
+}
+
+/* source -> n filters -> mixer -> sink */
+static void make_fan(struct bench_graph *g, uint32_t n_nodes)
+{
+	struct bench_node *src, *mix, *n;
+	uint32_t i, n_filters = n_nodes - 3;
+
+	graph_init(g, "fan", n_nodes);
+	src = add_node(g, 0, n_filters);
+	mix = add_node(g, n_filters, 1);
+	for (i = 0; i < n_filters; i++) {
+		n = add_node(g, 1, 1);
+		link_nodes(g, src, i, n, 0);
+		link_nodes(g, n, 0, mix, i);
+	}
+	link_nodes(g, mix, 0, add_node(g, 1, 0), 0);
+}
+
+/* n sources -> mixer -> sink */
+static void make_fan_in(struct bench_graph *g, uint32_t n_nodes)
+{
+	struct bench_node *mix;
+	uint32_t i, n_sources = n_nodes - 2;
+
+	graph_init(g, "fan-in", n_nodes);
+	mix = add_node(g, n_sources, 1);
+	for (i = 0; i < n_sources; i++)
+		link_nodes(g, add_node(g, 0, 1), 0, mix, i);
+	link_nodes(g, mix, 0, add_node(g, 1, 0), 0);
+}
+
+/* source -> (a, b) -> mixer -> (a, b) -> mixer ... -> sink */
+static void make_diamonds(struct bench_graph *g, uint32_t n_nodes)
+{
+	struct bench_node *prev, *a, *b, *mix;
+	uint32_t i, n_diamonds = (n_nodes - 2) / 3;
+
+	graph_init(g, "diamonds", n_nodes);
+	prev = add_node(g, 0, 2);
+	for (i = 0; i < n_diamonds; i++) {
+		a = add_node(g, 1, 1);
+		b = add_node(g, 1, 1);
+		mix = add_node(g, 2, i == n_diamonds - 1 ? 1 : 2);
+		link_nodes(g, prev, 0, a, 0);
+		link_nodes(g, prev, 1, b, 0);
+		link_nodes(g, a, 0, mix, 0);
+		link_nodes(g, b, 0, mix, 1);
+		prev = mix;
+	}
+	link_nodes(g, prev, 0, add_node(g, 1, 0), 0);
+}
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static int open_cache_misses(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static int compare_time(const void *a, const void *b)
+{
+	int64_t t1 = *(const int64_t *) a, t2 = *(const int64_t *) b;
+	return t1 < t2 ? -1 : t1 > t2 ? 1 : 0;
+}
+
+static void run(const struct bench_scheduler *s, struct bench_graph *g, int64_t *times)
+{
+	void *data;
+	uint32_t i, n_ok = 0;
+	uint64_t misses = 0;
+	int64_t total = 0;
+	int fd;
+	char misses_str[32];
+
+	data = s->create(&g->graph, n_workers);
+	spa_graph_set_callbacks(&g->graph, s->callbacks, data);
+
+	for (i = 0; i < g->n_nodes; i++)
+		g->nodes[i].count = 0;
+	for (i = 0; i < g->n_ios; i++)
+		g->ios[i].status = SPA_STATUS_NEED_BUFFER;
+
+	/* warm up, this also lets scheduler7 compile its plan */
+	spa_graph_need_input(&g->graph, &g->sink->gnode);
+
+	if ((fd = open_cache_misses()) >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	for (i = 0; i < n_cycles; i++) {
+		int64_t t1 = get_time();
+		spa_graph_need_input(&g->graph, &g->sink->gnode);
+		times[i] = get_time() - t1;
+		total += times[i];
+	}
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+			misses = 0;
+		close(fd);
+		snprintf(misses_str, sizeof(misses_str), "%.1f", (double) misses / n_cycles);
+	}
+	else
+		snprintf(misses_str, sizeof(misses_str), "-");
+
+	/* a scheduler that does not process every node once per cycle can't
+	 * be compared */
+	for (i = 0; i < g->n_nodes; i++) {
+		if (g->nodes[i].count == n_cycles + 1)
+			n_ok++;
+	}
+
+	qsort(times, n_cycles, sizeof(int64_t), compare_time);
+
+	printf("%-11s %-9s %5u %10.0f %10" PRIi64 " %10" PRIi64 " %10s %5u/%u\n",
+	       s->name, g->name, g->n_nodes, (double) total / n_cycles,
+	       times[n_cycles - 1], times[n_cycles - 1] - times[n_cycles / 2],
+	       misses_str, n_ok, g->n_nodes);
+
+	s->destroy(data);
+}
+
+/* some schedulers crash or loop forever on some graphs, run each benchmark
+ * in a child so that this can be reported */
+static void run_child(const struct bench_scheduler *s, struct bench_graph *g, int64_t *times)
+{
+	pid_t pid;
+	int status;
+
+	fflush(stdout);
+	if ((pid = fork()) == 0) {
+		alarm(TIMEOUT);
+		run(s, g, times);
+		fflush(stdout);
+		_exit(0);
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) < 0) {
+		perror("fork");
+		return;
+	}
+	if (WIFSIGNALED(status))
+		printf("%-11s %-9s %5u %s\n", s->name, g->name, g->n_nodes,
+		       WTERMSIG(status) == SIGALRM ? "timeout" : strsignal(WTERMSIG(status)));
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-c cost] [-n cycles] [-w workers] [scheduler...]\n"
+			"  -c cost     work of each node in loop iterations (default 64)\n"
+			"  -n cycles   number of cycles for each graph (default %d)\n"
+			"  -w workers  worker threads for scheduler7 (default 0)\n",
+			name, DEFAULT_CYCLES);
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t sizes[] = { 10, 100, 1000 };
+	static void (*const makers[]) (struct bench_graph *g, uint32_t n_nodes) = {
+		make_chain, make_fan, make_fan_in, make_diamonds,
+	};
+	struct bench_graph g;
+	int64_t *times;
+	uint32_t i, j, k;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:n:w:h")) != -1) {
+		switch (c) {
+		case 'c':
+			node_cost = atoi(optarg);
+			break;
+		case 'n':
+			n_cycles = SPA_MAX(atoi(optarg), 1);
+			break;
+		case 'w':
+			n_workers = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	times = calloc(n_cycles, sizeof(int64_t));
+
+	printf("node cost %u, %u cycles, %u workers\n", node_cost, n_cycles, n_workers);
+	printf("%-11s %-9s %5s %10s %10s %10s %10s %9s\n",
+	       "scheduler", "graph", "nodes", "ns/cycle", "max ns", "jitter ns",
+	       "misses", "processed");
+
+	for (i = 0; i < SPA_N_ELEMENTS(schedulers); i++) {
+		if (optind < argc) {
+			for (j = optind; j < argc; j++)
+				if (strcmp(argv[j], schedulers[i]->name) == 0)
+					break;
+			if (j == argc)
+				continue;
+		}
+		for (j = 0; j < SPA_N_ELEMENTS(makers); j++) {
+			for (k = 0; k < SPA_N_ELEMENTS(sizes); k++) {
+				makers[j](&g, sizes[k]);
+				run_child(schedulers[i], &g, times);
+				graph_clear(&g);
+			}
+		}
+	}
+	free(times);
+
+	return 0;
+}
@@ -0,0 +1,37 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <spa/graph/graph.h>
+
+/* every graph scheduler header is compiled in its own object, they all
+ * define the same symbols. scheduler2 has a different API and scheduler5
+ * does not compile, they are not benchmarked. */
+struct bench_scheduler {
+	const char *name;
+	/* make the scheduler data for \a graph */
+	void *(*create) (struct spa_graph *graph, uint32_t n_workers);
+	void (*destroy) (void *data);
+	const struct spa_graph_callbacks *callbacks;
+};
+
+extern const struct bench_scheduler bench_scheduler1;
+extern const struct bench_scheduler bench_scheduler3;
+extern const struct bench_scheduler bench_scheduler4;
+extern const struct bench_scheduler bench_scheduler6;
+extern const struct bench_scheduler bench_scheduler7;
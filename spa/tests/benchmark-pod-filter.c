@@ -0,0 +1,202 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <spa/pod/builder.h>
+#include <spa/pod/iter.h>
+
+#include <lib/pod.h>
+
+/* Measures spa_pod_filter() on the formats of a link. A videotestsrc-like
+ * port has one format with enums of sizes and framerates, a v4l2-like port
+ * has a format for each size with an enum of framerates. The filter is the
+ * format of the other port with enums of the sizes and framerates it
+ * supports. The checksum of the results can be compared between versions. */
+
+#define N_ROUNDS	200
+
+#define KEY_FORMAT	1
+#define KEY_SIZE	2
+#define KEY_FRAMERATE	3
+
+#define BUFFER_SIZE	(256 * 1024)
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void add_sizes(struct spa_pod_builder *b, int n_sizes, int step)
+{
+	int i;
+
+	spa_pod_builder_push_prop(b, KEY_SIZE, SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET);
+	spa_pod_builder_rectangle(b, 320, 240);
+	for (i = 0; i < n_sizes; i++)
+		spa_pod_builder_rectangle(b, 16 + i * step * 8, 16 + i * step * 6);
+	spa_pod_builder_pop(b);
+}
+
+static void add_framerates(struct spa_pod_builder *b, int n_rates, int step)
+{
+	int i;
+
+	spa_pod_builder_push_prop(b, KEY_FRAMERATE, SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET);
+	spa_pod_builder_fraction(b, 25, 1);
+	/* rates in 1/1000 steps, every other one as a multiple of its
+	 * reduced form to exercise the fraction compare */
+	for (i = 0; i < n_rates; i++) {
+		int num = 1000 + i * step * 250;
+		if (i & 1)
+			spa_pod_builder_fraction(b, num * 2, 2000);
+		else
+			spa_pod_builder_fraction(b, num, 1000);
+	}
+	spa_pod_builder_pop(b);
+}
+
+static void add_formats(struct spa_pod_builder *b)
+{
+	spa_pod_builder_push_prop(b, KEY_FORMAT, SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET);
+	spa_pod_builder_id(b, 1);
+	spa_pod_builder_id(b, 1);
+	spa_pod_builder_id(b, 2);
+	spa_pod_builder_id(b, 3);
+	spa_pod_builder_pop(b);
+}
+
+static struct spa_pod *build_filter(struct spa_pod_builder *b, int n_sizes, int n_rates)
+{
+	spa_pod_builder_push_object(b, 0, 0);
+	add_formats(b);
+	add_sizes(b, n_sizes, 2);
+	add_framerates(b, n_rates, 2);
+	return spa_pod_builder_pop(b);
+}
+
+static struct spa_pod *build_testsrc(struct spa_pod_builder *b, int n_sizes, int n_rates)
+{
+	spa_pod_builder_push_object(b, 0, 0);
+	add_formats(b);
+	add_sizes(b, n_sizes, 1);
+	add_framerates(b, n_rates, 1);
+	return spa_pod_builder_pop(b);
+}
+
+static struct spa_pod *build_v4l2(struct spa_pod_builder *b, int size, int n_rates)
+{
+	spa_pod_builder_push_object(b, 0, 0);
+	spa_pod_builder_push_prop(b, KEY_FORMAT, 0);
+	spa_pod_builder_id(b, 1);
+	spa_pod_builder_pop(b);
+	spa_pod_builder_push_prop(b, KEY_SIZE, 0);
+	spa_pod_builder_rectangle(b, 16 + size * 8, 16 + size * 6);
+	spa_pod_builder_pop(b);
+	add_framerates(b, n_rates, 1);
+	return spa_pod_builder_pop(b);
+}
+
+static uint32_t checksum(const struct spa_pod *pod)
+{
+	const uint8_t *p = (const uint8_t *) pod;
+	uint32_t i, sum = 0;
+
+	for (i = 0; i < SPA_POD_SIZE(pod); i++)
+		sum = sum * 31 + p[i];
+	return sum;
+}
+
+static void run(const char *name, struct spa_pod **formats, int n_formats, struct spa_pod *filter)
+{
+	static uint8_t buffer[BUFFER_SIZE];
+	struct spa_pod_builder b;
+	struct spa_pod *result;
+	uint32_t sum = 0;
+	int64_t t;
+	int i, j, n_ok = 0;
+
+	t = get_time();
+	for (i = 0; i < N_ROUNDS; i++) {
+		spa_pod_builder_init(&b, buffer, sizeof(buffer));
+		for (j = 0; j < n_formats; j++) {
+			if (spa_pod_filter(&b, &result, formats[j], filter) < 0)
+				continue;
+			if (i == 0) {
+				sum = sum * 31 + checksum(result);
+				n_ok++;
+			}
+		}
+	}
+	t = get_time() - t;
+
+	printf("%-24s %8d %8d %10.2f   %08x\n", name, n_formats, n_ok,
+	       t / 1000.0 / N_ROUNDS, sum);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		int n_sizes;
+		int n_rates;
+	} sets[] = {
+		{ 8, 4 },
+		{ 64, 16 },
+		{ 256, 32 },
+		{ 512, 64 },
+	};
+	static uint8_t buffer[BUFFER_SIZE];
+	struct spa_pod_builder b;
+	struct spa_pod *filter, *formats[512];
+	char name[64];
+	uint32_t offsets[512], filter_offset;
+	int i, j;
+
+	printf("formats                   n_enum   n_match  us/enum    checksum\n");
+	for (i = 0; i < SPA_N_ELEMENTS(sets); i++) {
+		int n_sizes = sets[i].n_sizes, n_rates = sets[i].n_rates;
+
+		spa_pod_builder_init(&b, buffer, sizeof(buffer));
+		filter_offset = b.state.offset;
+		build_filter(&b, n_sizes, n_rates);
+		offsets[0] = b.state.offset;
+		build_testsrc(&b, n_sizes, n_rates);
+		filter = spa_pod_builder_deref(&b, filter_offset);
+		formats[0] = spa_pod_builder_deref(&b, offsets[0]);
+
+		snprintf(name, sizeof(name), "testsrc %dx%d", n_sizes, n_rates);
+		run(name, formats, 1, filter);
+
+		for (j = 0; j < n_sizes; j++) {
+			offsets[j] = b.state.offset;
+			build_v4l2(&b, j, n_rates);
+		}
+		for (j = 0; j < n_sizes; j++)
+			formats[j] = spa_pod_builder_deref(&b, offsets[j]);
+
+		snprintf(name, sizeof(name), "v4l2 %dx%d", n_sizes, n_rates);
+		run(name, formats, n_sizes, filter);
+	}
+	return 0;
+}
@@ -0,0 +1,280 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include <spa/support/type-map-impl.h>
+#include <spa/support/type-map-static.h>
+#include <spa/support/plugin.h>
+#include <spa/node/node.h>
+#include <spa/node/command.h>
+#include <spa/node/event.h>
+#include <spa/monitor/monitor.h>
+#include <spa/param/param.h>
+#include <spa/param/props.h>
+#include <spa/param/buffers.h>
+#include <spa/param/meta.h>
+#include <spa/param/video-padding.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/video/format-utils.h>
+#include <spa/clock/clock.h>
+#include <spa/support/log.h>
+#include <spa/support/loop.h>
+
+#define MAX_TYPES	4096
+#define N_ROUNDS	200
+
+static SPA_TYPE_MAP_IMPL(hash_map, MAX_TYPES);
+
+/* the type map as it was before it had an index, as a reference */
+static struct {
+	struct spa_type_map map;
+	uint32_t n_types;
+	const char *types[MAX_TYPES];
+} linear_map;
+
+static uint32_t linear_get_id(struct spa_type_map *map, const char *type)
+{
+	uint32_t i;
+
+	for (i = 0; i < linear_map.n_types; i++) {
+		if (strcmp(linear_map.types[i], type) == 0)
+			return i;
+	}
+	linear_map.types[i] = type;
+	linear_map.n_types++;
+	return i;
+}
+
+static const char *linear_get_type(const struct spa_type_map *map, uint32_t id)
+{
+	return id < linear_map.n_types ? linear_map.types[id] : NULL;
+}
+
+static size_t linear_get_size(const struct spa_type_map *map)
+{
+	return linear_map.n_types;
+}
+
+/* register everything the plugins register in their init_type() */
+static void register_types(struct spa_type_map *map)
+{
+	struct spa_type_param param = { 0, };
+	struct spa_type_meta meta = { 0, };
+	struct spa_type_data data = { 0, };
+	struct spa_type_media_type media_type = { 0, };
+	struct spa_type_media_subtype media_subtype = { 0, };
+	struct spa_type_media_subtype_audio media_subtype_audio = { 0, };
+	struct spa_type_media_subtype_video media_subtype_video = { 0, };
+	struct spa_type_format_audio format_audio = { 0, };
+	struct spa_type_format_video format_video = { 0, };
+	struct spa_type_audio_format audio_format = { 0, };
+	struct spa_type_video_format video_format = { 0, };
+	struct spa_type_command_node command_node = { 0, };
+	struct spa_type_event_node event_node = { 0, };
+	struct spa_type_monitor monitor = { 0, };
+	struct spa_type_param_buffers param_buffers = { 0, };
+	struct spa_type_param_meta param_meta = { 0, };
+	struct spa_type_param_video_padding param_video_padding = { 0, };
+
+	spa_type_map_get_id(map, SPA_TYPE__Node);
+	spa_type_map_get_id(map, SPA_TYPE__Clock);
+	spa_type_map_get_id(map, SPA_TYPE__Monitor);
+	spa_type_map_get_id(map, SPA_TYPE__Log);
+	spa_type_map_get_id(map, SPA_TYPE__TypeMap);
+	spa_type_map_get_id(map, SPA_TYPE_LOOP__MainLoop);
+	spa_type_map_get_id(map, SPA_TYPE_LOOP__DataLoop);
+	spa_type_map_get_id(map, SPA_TYPE__Props);
+	spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__device);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__deviceName);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__deviceFd);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__card);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__cardName);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__minLatency);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__maxLatency);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__periods);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__periodSize);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__periodEvent);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__live);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__frequency);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__mute);
+	spa_type_map_get_id(map, SPA_TYPE_PROPS__patternType);
+
+	spa_type_param_map(map, &param);
+	spa_type_meta_map(map, &meta);
+	spa_type_data_map(map, &data);
+	spa_type_media_type_map(map, &media_type);
+	spa_type_media_subtype_map(map, &media_subtype);
+	spa_type_media_subtype_audio_map(map, &media_subtype_audio);
+	spa_type_media_subtype_video_map(map, &media_subtype_video);
+	spa_type_format_audio_map(map, &format_audio);
+	spa_type_format_video_map(map, &format_video);
+	spa_type_audio_format_map(map, &audio_format);
+	spa_type_video_format_map(map, &video_format);
+	spa_type_command_node_map(map, &command_node);
+	spa_type_event_node_map(map, &event_node);
+	spa_type_monitor_map(map, &monitor);
+	spa_type_param_buffers_map(map, &param_buffers);
+	spa_type_param_meta_map(map, &param_meta);
+	spa_type_param_video_padding_map(map, &param_video_padding);
+}
+
+static struct spa_type_map *load_mapper(const char *lib)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	uint32_t i, type_map_id;
+	void *hnd, *iface;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return NULL;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL)
+		return NULL;
+
+	for (i = 0; enum_func(&factory, &i) > 0;) {
+		if (strcmp(factory->name, "mapper"))
+			continue;
+
+		handle = calloc(1, factory->size);
+		if (spa_handle_factory_init(factory, handle, NULL, NULL, 0) < 0)
+			return NULL;
+
+		/* the mapper type has a static id */
+		type_map_id = SPA_TYPE_STATIC_ID(SPA_TYPE__TypeMap);
+		if (spa_handle_get_interface(handle, type_map_id, &iface) < 0)
+			return NULL;
+		return iface;
+	}
+	return NULL;
+}
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/* look up copies of all registered strings so that nothing can match on the
+ * pointer value */
+static double bench_lookup(const char *name, struct spa_type_map *map, char **strings, uint32_t n_strings)
+{
+	int64_t t1, t2;
+	uint32_t i, j;
+	double ns;
+
+	t1 = get_time();
+	for (i = 0; i < N_ROUNDS; i++) {
+		for (j = 0; j < n_strings; j++)
+			spa_type_map_get_id(map, strings[j]);
+	}
+	t2 = get_time();
+
+	ns = (double)(t2 - t1) / (N_ROUNDS * n_strings);
+	printf("%-10s: %u types, %.1f ns per lookup\n", name, n_strings, ns);
+
+	return ns;
+}
+
+static double bench_register(const char *name, struct spa_type_map *map)
+{
+	int64_t t1, t2;
+	double us;
+
+	t1 = get_time();
+	register_types(map);
+	t2 = get_time();
+
+	us = (t2 - t1) / 1000.0;
+	printf("%-10s: registered %zd types in %.1f us\n", name, spa_type_map_get_size(map), us);
+
+	return us;
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_type_map *map = &hash_map.map, *mapper;
+	char **strings;
+	uint32_t i, n_types;
+	int res = 0;
+
+	linear_map.map = (struct spa_type_map) {
+		SPA_VERSION_TYPE_MAP, NULL,
+		linear_get_id, linear_get_type, linear_get_size };
+
+	/* the static types come first in every map */
+	for (i = 0; i < SPA_TYPE_STATIC_N; i++)
+		linear_get_id(&linear_map.map, spa_type_static_get_type(i));
+
+	bench_register("linear", &linear_map.map);
+	bench_register("hashed", map);
+
+	/* the ids must not change */
+	n_types = spa_type_map_get_size(map);
+	if (n_types != spa_type_map_get_size(&linear_map.map)) {
+		printf("different number of types %u != %zd\n", n_types,
+		       spa_type_map_get_size(&linear_map.map));
+		res = -1;
+	}
+	strings = calloc(n_types, sizeof(char *));
+	for (i = 0; i < n_types; i++) {
+		const char *t1 = spa_type_map_get_type(map, i);
+		const char *t2 = spa_type_map_get_type(&linear_map.map, i);
+
+		if (t1 == NULL || t2 == NULL || strcmp(t1, t2) != 0) {
+			printf("type %u differs: %s != %s\n", i, t1, t2);
+			res = -1;
+		}
+		strings[i] = strdup(t1 ? t1 : "");
+	}
+
+	bench_lookup("linear", &linear_map.map, strings, n_types);
+	bench_lookup("hashed", map, strings, n_types);
+
+	mapper = load_mapper(argc > 1 ? argv[1] :
+			"build/spa/plugins/support/libspa-support.so");
+	if (mapper) {
+		bench_register("mapper", mapper);
+		bench_lookup("mapper", mapper, strings, n_types);
+
+		for (i = 0; i < SPA_TYPE_STATIC_N; i++) {
+			if (spa_type_map_get_id(mapper, spa_type_static_get_type(i)) != i) {
+				printf("mapper: static type %u has another id\n", i);
+				res = -1;
+			}
+		}
+	}
+
+	for (i = 0; i < n_types; i++)
+		free(strings[i]);
+	free(strings);
+
+	return res;
+}
@@ -0,0 +1,218 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include <spa/support/type-map-impl.h>
+#include <spa/support/loop.h>
+#include <spa/support/plugin.h>
+
+/* Many threads invoke into the loop at the same time with items of
+ * different sizes while the loop thread checks that every item arrives
+ * complete and in order per thread. */
+
+#define MAX_THREADS	64
+#define MAX_DATA	4000
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+
+struct payload {
+	uint32_t thread;
+	uint32_t count;
+	uint32_t n_data;
+	uint8_t data[MAX_DATA];
+};
+
+static struct spa_loop *loop;
+static struct spa_loop_control *control;
+static int n_threads = 8;
+static int n_items = 100000;
+
+/* only touched from the loop thread */
+static uint32_t expected[MAX_THREADS];
+static unsigned long n_received;
+static bool running = true;
+
+static unsigned long n_failures;
+
+static int do_check(struct spa_loop *loop, bool async, uint32_t seq,
+		    size_t size, const void *data, void *user_data)
+{
+	const struct payload *p = data;
+	uint32_t i;
+
+	n_received++;
+
+	if (size != offsetof(struct payload, data) + p->n_data) {
+		printf("thread %u item %u: size %zd != %zd\n", p->thread, p->count,
+		       size, offsetof(struct payload, data) + p->n_data);
+		__atomic_add_fetch(&n_failures, 1, __ATOMIC_SEQ_CST);
+		return -EINVAL;
+	}
+	if (p->count != expected[p->thread]) {
+		printf("thread %u: item %u != expected %u\n", p->thread, p->count,
+		       expected[p->thread]);
+		__atomic_add_fetch(&n_failures, 1, __ATOMIC_SEQ_CST);
+	}
+	expected[p->thread] = p->count + 1;
+
+	for (i = 0; i < p->n_data; i++) {
+		if (p->data[i] != (uint8_t) (p->thread + p->count + i)) {
+			printf("thread %u item %u: corrupted at byte %u\n",
+			       p->thread, p->count, i);
+			__atomic_add_fetch(&n_failures, 1, __ATOMIC_SEQ_CST);
+			break;
+		}
+	}
+	return p->count;
+}
+
+static int do_stop(struct spa_loop *loop, bool async, uint32_t seq,
+		   size_t size, const void *data, void *user_data)
+{
+	running = false;
+	return 0;
+}
+
+static void *producer_start(void *arg)
+{
+	uint32_t thread = SPA_PTR_TO_UINT32(arg);
+	struct payload p;
+	uint32_t i, j;
+	unsigned int rnd = thread;
+	int res;
+
+	p.thread = thread;
+
+	for (i = 0; i < n_items; i++) {
+		bool block = (rand_r(&rnd) % 64) == 0;
+
+		p.count = i;
+		p.n_data = rand_r(&rnd) % MAX_DATA;
+		for (j = 0; j < p.n_data; j++)
+			p.data[j] = thread + i + j;
+
+		res = spa_loop_invoke(loop, do_check, SPA_ID_INVALID,
+				      offsetof(struct payload, data) + p.n_data,
+				      &p, block, NULL);
+		if (block && res != i) {
+			printf("thread %u item %u: blocking invoke returned %d\n", thread, i, res);
+			__atomic_add_fetch(&n_failures, 1, __ATOMIC_SEQ_CST);
+		}
+		else if (!block && res != 0) {
+			printf("thread %u item %u: invoke failed %d\n", thread, i, res);
+			__atomic_add_fetch(&n_failures, 1, __ATOMIC_SEQ_CST);
+		}
+	}
+	return NULL;
+}
+
+static void *loop_start(void *arg)
+{
+	spa_loop_control_enter(control);
+	while (running)
+		spa_loop_control_iterate(control, -1);
+	spa_loop_control_leave(control);
+	return NULL;
+}
+
+static int make_loop(const char *lib)
+{
+	struct spa_support support[1];
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_handle *handle;
+	void *hnd, *iface;
+	uint32_t i;
+	int res;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return -errno;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return -errno;
+	}
+
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, &default_map.map);
+
+	for (i = 0; enum_func(&factory, &i) > 0;) {
+		if (strcmp(factory->name, "loop"))
+			continue;
+
+		handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, handle, NULL, support, 1)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(handle,
+				spa_type_map_get_id(&default_map.map, SPA_TYPE__Loop), &iface)) < 0)
+			return res;
+		loop = iface;
+		if ((res = spa_handle_get_interface(handle,
+				spa_type_map_get_id(&default_map.map, SPA_TYPE__LoopControl), &iface)) < 0)
+			return res;
+		control = iface;
+		return 0;
+	}
+	return -ENOENT;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t loop_thread, threads[MAX_THREADS];
+	int i, res;
+
+	printf("starting loop invoke stress test\n");
+
+	if (argc > 1)
+		sscanf(argv[1], "%d", &n_threads);
+	if (argc > 2)
+		sscanf(argv[2], "%d", &n_items);
+	n_threads = SPA_CLAMP(n_threads, 1, MAX_THREADS);
+
+	if ((res = make_loop(argc > 3 ? argv[3] :
+			"build/spa/plugins/support/libspa-support.so")) < 0)
+		return -1;
+
+	printf("producer threads: %d\n", n_threads);
+	printf("items per thread: %d\n", n_items);
+
+	pthread_create(&loop_thread, NULL, loop_start, NULL);
+	for (i = 0; i < n_threads; i++)
+		pthread_create(&threads[i], NULL, producer_start, SPA_UINT32_TO_PTR(i));
+	for (i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	spa_loop_invoke(loop, do_stop, SPA_ID_INVALID, 0, NULL, true, NULL);
+	pthread_join(loop_thread, NULL);
+
+	printf("received %lu items, %lu failures\n", n_received, n_failures);
+
+	if (n_received != (unsigned long) n_threads * n_items || n_failures > 0)
+		return 1;
+	return 0;
+}
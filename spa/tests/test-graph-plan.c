@@ -0,0 +1,461 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <spa/node/node.h>
+#include <spa/graph/graph.h>
+#include <spa/graph/graph-scheduler7.h>
+
+/* runs cycles over graphs of fake nodes and checks that every node is
+ * processed once per cycle, in topological order, also after the topology
+ * changed and when worker threads help */
+
+#define N_BRANCHES	8
+#define MAX_PORTS	N_BRANCHES
+#define MAX_LOG		64
+#define MAX_WORKERS	3
+#define N_CYCLES	10000
+
+struct test_node {
+	struct spa_node node;
+	const char *name;
+	bool is_source;
+	bool is_sink;
+	struct spa_graph_node gnode;
+	struct spa_graph_port in[MAX_PORTS];
+	struct spa_graph_port out[MAX_PORTS];
+	uint32_t n_in;
+	uint32_t n_out;
+	uint32_t count;
+	uint32_t seq;
+};
+
+static const char *log_names[MAX_LOG];
+static uint32_t n_log;
+static uint32_t seq;
+static int n_failed;
+
+static struct spa_port_io ios[32];
+static uint32_t n_ios;
+
+/* nodes can be processed from the workers */
+static void log_node(struct test_node *t)
+{
+	uint32_t idx = __atomic_fetch_add(&n_log, 1, __ATOMIC_SEQ_CST);
+
+	if (idx < MAX_LOG)
+		log_names[idx] = t->name;
+	t->count++;
+	t->seq = __atomic_add_fetch(&seq, 1, __ATOMIC_SEQ_CST);
+}
+
+/* consume all inputs and produce on all outputs */
+static int node_process_input(struct spa_node *node)
+{
+	struct test_node *t = SPA_CONTAINER_OF(node, struct test_node, node);
+	uint32_t i;
+
+	log_node(t);
+	for (i = 0; i < t->n_in; i++)
+		t->in[i].io->status = SPA_STATUS_NEED_BUFFER;
+	if (t->is_sink)
+		return SPA_STATUS_OK;
+	for (i = 0; i < t->n_out; i++)
+		t->out[i].io->status = SPA_STATUS_HAVE_BUFFER;
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+/* sources produce, other nodes need input first */
+static int node_process_output(struct spa_node *node)
+{
+	struct test_node *t = SPA_CONTAINER_OF(node, struct test_node, node);
+	uint32_t i;
+
+	if (!t->is_source)
+		return SPA_STATUS_NEED_BUFFER;
+
+	log_node(t);
+	for (i = 0; i < t->n_out; i++)
+		t->out[i].io->status = SPA_STATUS_HAVE_BUFFER;
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static void init_node(struct spa_graph *graph, struct test_node *t, const char *name,
+		      uint32_t n_in, uint32_t n_out)
+{
+	uint32_t i;
+
+	memset(t, 0, sizeof(*t));
+	t->node.version = SPA_VERSION_NODE;
+	t->node.process_input = node_process_input;
+	t->node.process_output = node_process_output;
+	t->name = name;
+	t->is_source = n_in == 0;
+	t->is_sink = n_out == 0;
+
+	spa_graph_node_init(&t->gnode);
+	spa_graph_node_set_implementation(&t->gnode, &t->node);
+	spa_graph_node_add(graph, &t->gnode);
+
+	for (i = 0; i < n_in; i++) {
+		spa_graph_port_init(&t->in[i], SPA_DIRECTION_INPUT, i, 0, NULL);
+		spa_graph_port_add(&t->gnode, &t->in[i]);
+	}
+	for (i = 0; i < n_out; i++) {
+		spa_graph_port_init(&t->out[i], SPA_DIRECTION_OUTPUT, i, 0, NULL);
+		spa_graph_port_add(&t->gnode, &t->out[i]);
+	}
+	t->n_in = n_in;
+	t->n_out = n_out;
+}
+
+static void link_ports(struct spa_graph_port *out, struct spa_graph_port *in)
+{
+	struct spa_port_io *io = &ios[n_ios++];
+
+	*io = SPA_PORT_IO_INIT;
+	io->status = SPA_STATUS_NEED_BUFFER;
+	out->io = in->io = io;
+	spa_graph_port_link(out, in);
+}
+
+static void check_cycle(const char *test, struct spa_graph *graph,
+			struct test_node *sink, const char **expected)
+{
+	uint32_t i;
+
+	n_log = 0;
+	spa_graph_need_input(graph, &sink->gnode);
+
+	for (i = 0; expected[i]; i++) {
+		if (i >= n_log || strcmp(log_names[i], expected[i]) != 0)
+			break;
+	}
+	if (expected[i] != NULL || i != n_log) {
+		fprintf(stderr, "%s: unexpected order:", test);
+		for (i = 0; i < n_log; i++)
+			fprintf(stderr, " %s", log_names[i]);
+		fprintf(stderr, "\n");
+		n_failed++;
+	}
+}
+
+static void check_plan(const char *test, struct spa_graph *graph,
+		       struct spa_graph_data *data, uint32_t n_nodes)
+{
+	if (data->version != graph->version || data->n_nodes != n_nodes) {
+		fprintf(stderr, "%s: plan not compiled, %d nodes, version %d != %d\n",
+			test, data->n_nodes, data->version, graph->version);
+		n_failed++;
+	}
+}
+
+static void test_chain(void)
+{
+	struct spa_graph graph;
+	struct spa_graph_data data;
+	struct test_node src, f1, f2, sink;
+	const char *order1[] = { "src", "f1", "sink", NULL };
+	const char *order2[] = { "src", "f1", "f2", "sink", NULL };
+	struct spa_graph_node_profile profile = { 0, }, copy = { 0, };
+	uint32_t version;
+	int i;
+
+	n_ios = 0;
+	spa_graph_init(&graph);
+	spa_graph_data_init(&data, &graph);
+	spa_graph_set_callbacks(&graph, &spa_graph_impl_default, &data);
+
+	/* add the nodes in reverse order, the plan must not depend on it */
+	init_node(&graph, &sink, "sink", 1, 0);
+	init_node(&graph, &f2, "f2", 1, 1);
+	init_node(&graph, &f1, "f1", 1, 1);
+	init_node(&graph, &src, "src", 0, 1);
+
+	link_ports(&src.out[0], &f1.in[0]);
+	link_ports(&f1.out[0], &sink.in[0]);
+
+	spa_graph_node_set_profile(&f1.gnode, &profile);
+
+	for (i = 0; i < 3; i++)
+		check_cycle("chain", &graph, &sink, order1);
+
+	if (!spa_graph_node_profile_read(&profile, &copy) || copy.cycles != 3 ||
+	    copy.max_ns < copy.last_ns || (copy.seq & 1)) {
+		fprintf(stderr, "chain: wrong profile, %" PRIu64 " cycles\n", copy.cycles);
+		n_failed++;
+	}
+	/* f2 is not linked but it is in the graph */
+	check_plan("chain", &graph, &data, 4);
+	if (data.nodes[0].node != &f2.gnode && data.nodes[0].node != &src.gnode) {
+		fprintf(stderr, "chain: unexpected first node\n");
+		n_failed++;
+	}
+
+	/* the plan is only compiled again when the topology changes */
+	version = data.version;
+	check_cycle("chain", &graph, &sink, order1);
+	if (data.version != version) {
+		fprintf(stderr, "chain: plan compiled without a change\n");
+		n_failed++;
+	}
+
+	/* insert f2 between f1 and sink */
+	spa_graph_port_unlink(&f1.out[0]);
+	link_ports(&f1.out[0], &f2.in[0]);
+	link_ports(&f2.out[0], &sink.in[0]);
+
+	for (i = 0; i < 3; i++)
+		check_cycle("chain", &graph, &sink, order2);
+	check_plan("chain", &graph, &data, 4);
+
+	/* and remove it again */
+	spa_graph_port_unlink(&f1.out[0]);
+	spa_graph_port_unlink(&f2.out[0]);
+	spa_graph_node_remove(&f2.gnode);
+	link_ports(&f1.out[0], &sink.in[0]);
+
+	check_cycle("chain", &graph, &sink, order1);
+	check_plan("chain", &graph, &data, 3);
+
+	spa_graph_data_clear(&data);
+}
+
+static void test_diamond(void)
+{
+	struct spa_graph graph;
+	struct spa_graph_data data;
+	struct test_node src, a, b, mix, sink;
+	const char *order[] = { "src", "a", "b", "mix", "sink", NULL };
+	int i;
+
+	n_ios = 0;
+	spa_graph_init(&graph);
+	spa_graph_data_init(&data, &graph);
+	spa_graph_set_callbacks(&graph, &spa_graph_impl_default, &data);
+
+	init_node(&graph, &sink, "sink", 1, 0);
+	init_node(&graph, &mix, "mix", 2, 1);
+	init_node(&graph, &a, "a", 1, 1);
+	init_node(&graph, &b, "b", 1, 1);
+	init_node(&graph, &src, "src", 0, 2);
+
+	link_ports(&src.out[0], &a.in[0]);
+	link_ports(&src.out[1], &b.in[0]);
+	link_ports(&a.out[0], &mix.in[0]);
+	link_ports(&b.out[0], &mix.in[1]);
+	link_ports(&mix.out[0], &sink.in[0]);
+
+	/* the mixer must wait for both inputs and run once */
+	for (i = 0; i < 3; i++)
+		check_cycle("diamond", &graph, &sink, order);
+	check_plan("diamond", &graph, &data, 5);
+
+	if (mix.gnode.order <= a.gnode.order || mix.gnode.order <= b.gnode.order ||
+	    sink.gnode.order <= mix.gnode.order || a.gnode.order <= src.gnode.order) {
+		fprintf(stderr, "diamond: plan is not in topological order\n");
+		n_failed++;
+	}
+	spa_graph_data_clear(&data);
+}
+
+static void test_freewheel(void)
+{
+	struct spa_graph graph;
+	struct spa_graph_data data;
+	struct test_node src1, f1, sink1, src2, sink2;
+	struct test_node *nodes[] = { &src1, &f1, &sink1, &src2, &sink2 };
+	const char *order[] = { "src1", "f1", "sink1", NULL };
+	int i, j;
+
+	n_ios = 0;
+	spa_graph_init(&graph);
+	spa_graph_data_init(&data, &graph);
+	spa_graph_set_callbacks(&graph, &spa_graph_impl_default, &data);
+
+	init_node(&graph, &sink1, "sink1", 1, 0);
+	init_node(&graph, &f1, "f1", 1, 1);
+	init_node(&graph, &src1, "src1", 0, 1);
+	init_node(&graph, &sink2, "sink2", 1, 0);
+	init_node(&graph, &src2, "src2", 0, 1);
+
+	link_ports(&src1.out[0], &f1.in[0]);
+	link_ports(&f1.out[0], &sink1.in[0]);
+	link_ports(&src2.out[0], &sink2.in[0]);
+
+	spa_graph_data_set_freewheel(&data, true);
+
+	/* the sinks can't start a cycle themselves */
+	n_log = 0;
+	spa_graph_need_input(&graph, &sink1.gnode);
+	if (n_log != 0) {
+		fprintf(stderr, "freewheel: node started a cycle\n");
+		n_failed++;
+	}
+
+	/* every cycle runs all the sinks once */
+	for (i = 0; i < 3; i++) {
+		n_log = 0;
+		if (spa_graph_plan_freewheel(&data) < 0 || n_log != SPA_N_ELEMENTS(nodes)) {
+			fprintf(stderr, "freewheel: %d nodes processed\n", n_log);
+			n_failed++;
+		}
+	}
+	for (j = 0; j < SPA_N_ELEMENTS(nodes); j++) {
+		if (nodes[j]->count != 3) {
+			fprintf(stderr, "freewheel: %s processed %d times\n",
+				nodes[j]->name, nodes[j]->count);
+			n_failed++;
+		}
+	}
+	if (sink1.seq < f1.seq || f1.seq < src1.seq || sink2.seq < src2.seq) {
+		fprintf(stderr, "freewheel: wrong order\n");
+		n_failed++;
+	}
+
+	/* and the sinks drive the graph again when we leave freewheel */
+	spa_graph_data_set_freewheel(&data, false);
+	check_cycle("freewheel", &graph, &sink1, order);
+
+	spa_graph_data_clear(&data);
+}
+
+static sem_t worker_sem;
+static bool workers_running;
+
+static void *worker_start(void *arg)
+{
+	struct spa_graph_data *data = arg;
+
+	while (true) {
+		while (sem_wait(&worker_sem) < 0 && errno == EINTR);
+		if (!workers_running)
+			break;
+		spa_graph_plan_work(data);
+	}
+	return NULL;
+}
+
+static void workers_wakeup(void *data, uint32_t n_workers)
+{
+	while (n_workers--)
+		sem_post(&worker_sem);
+}
+
+static const struct spa_graph_workers test_workers = {
+	SPA_VERSION_GRAPH_WORKERS,
+	.wakeup = workers_wakeup,
+};
+
+/* a source feeding branches of different lengths that are mixed */
+static void test_parallel(void)
+{
+	struct spa_graph graph;
+	struct spa_graph_data data;
+	struct test_node src, mix, sink, branch[N_BRANCHES][3];
+	pthread_t workers[MAX_WORKERS];
+	uint32_t i, j, c, len;
+
+	n_ios = 0;
+	spa_graph_init(&graph);
+	spa_graph_data_init(&data, &graph);
+	spa_graph_set_callbacks(&graph, &spa_graph_impl_default, &data);
+
+	init_node(&graph, &src, "src", 0, N_BRANCHES);
+	init_node(&graph, &mix, "mix", N_BRANCHES, 1);
+	init_node(&graph, &sink, "sink", 1, 0);
+
+	for (i = 0; i < N_BRANCHES; i++) {
+		len = 1 + i % 3;
+		for (j = 0; j < len; j++) {
+			init_node(&graph, &branch[i][j], "branch", 1, 1);
+			link_ports(j == 0 ? &src.out[i] : &branch[i][j - 1].out[0],
+				   &branch[i][j].in[0]);
+		}
+		link_ports(&branch[i][len - 1].out[0], &mix.in[i]);
+	}
+	link_ports(&mix.out[0], &sink.in[0]);
+
+	sem_init(&worker_sem, 0, 0);
+	workers_running = true;
+	for (i = 0; i < MAX_WORKERS; i++)
+		pthread_create(&workers[i], NULL, worker_start, &data);
+	spa_graph_data_set_workers(&data, &test_workers, NULL, MAX_WORKERS);
+
+	for (c = 1; c <= N_CYCLES; c++) {
+		n_log = 0;
+		spa_graph_need_input(&graph, &sink.gnode);
+
+		if (src.count != c || mix.count != c || sink.count != c ||
+		    mix.seq <= src.seq || sink.seq <= mix.seq) {
+			fprintf(stderr, "parallel: cycle %d wrong order or count\n", c);
+			n_failed++;
+			break;
+		}
+		for (i = 0; i < N_BRANCHES; i++) {
+			len = 1 + i % 3;
+			for (j = 0; j < len; j++) {
+				struct test_node *t = &branch[i][j];
+				uint32_t up = j == 0 ? src.seq : branch[i][j - 1].seq;
+
+				if (t->count != c || t->seq <= up || t->seq >= mix.seq) {
+					fprintf(stderr, "parallel: cycle %d branch %d.%d wrong order\n",
+						c, i, j);
+					n_failed++;
+					c = N_CYCLES;
+				}
+			}
+		}
+	}
+	if (!data.parallel) {
+		fprintf(stderr, "parallel: plan is not parallel\n");
+		n_failed++;
+	}
+
+	workers_running = false;
+	for (i = 0; i < MAX_WORKERS; i++)
+		sem_post(&worker_sem);
+	for (i = 0; i < MAX_WORKERS; i++)
+		pthread_join(workers[i], NULL);
+	sem_destroy(&worker_sem);
+
+	spa_graph_data_clear(&data);
+}
+
+int main(int argc, char *argv[])
+{
+	test_chain();
+	test_diamond();
+	test_parallel();
+	test_freewheel();
+
+	if (n_failed > 0) {
+		fprintf(stderr, "%d checks failed\n", n_failed);
+		return 1;
+	}
+	printf("all tests passed\n");
+	return 0;
+}
@@ -0,0 +1,244 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <spa/pod/builder.h>
+#include <spa/pod/iter.h>
+
+#include <lib/pod.h>
+
+/* Filters random enum props against enum and fixed props and checks the
+ * result against comparing all pairs of values, which is what
+ * spa_pod_filter() did before large enums were sorted. The enums are big
+ * enough to take the sorted path and have a small range of values so that
+ * both sides have duplicates. */
+
+#define KEY		1
+#define N_ROUNDS	200
+#define BUFFER_SIZE	(1024 * 1024)
+
+static uint32_t seed = 1;
+
+static uint32_t next_random(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+static void add_value(struct spa_pod_builder *b, uint32_t type, uint32_t v, bool zero_denom)
+{
+	char str[16];
+
+	switch (type) {
+	case SPA_POD_TYPE_ID:
+		spa_pod_builder_id(b, v);
+		break;
+	case SPA_POD_TYPE_INT:
+		spa_pod_builder_int(b, (int32_t) v - 100);
+		break;
+	case SPA_POD_TYPE_STRING:
+		/* all alternatives must have the same size */
+		snprintf(str, sizeof(str), "v%05u", v);
+		spa_pod_builder_string(b, str);
+		break;
+	case SPA_POD_TYPE_RECTANGLE:
+		spa_pod_builder_rectangle(b, 16 * (v % 8), 16 * (v / 8));
+		break;
+	case SPA_POD_TYPE_FRACTION:
+	{
+		/* the same value is written in different ways */
+		uint32_t mult = 1 + next_random() % 3;
+		if (zero_denom)
+			spa_pod_builder_fraction(b, 0, 0);
+		else
+			spa_pod_builder_fraction(b, v * mult, 4 * mult);
+		break;
+	}
+	}
+}
+
+static struct spa_pod *build(struct spa_pod_builder *b, uint32_t type,
+			     int n_values, uint32_t range, bool zero_denom)
+{
+	int i, zero = zero_denom ? next_random() % n_values : -1;
+
+	spa_pod_builder_push_object(b, 0, 0);
+	if (n_values == 0) {
+		spa_pod_builder_push_prop(b, KEY, 0);
+		add_value(b, type, next_random() % range, false);
+	} else {
+		spa_pod_builder_push_prop(b, KEY, SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET);
+		add_value(b, type, next_random() % range, false);
+		for (i = 0; i < n_values; i++)
+			add_value(b, type, next_random() % range, i == zero);
+	}
+	spa_pod_builder_pop(b);
+	return spa_pod_builder_pop(b);
+}
+
+static bool equal(uint32_t type, const void *v1, const void *v2)
+{
+	switch (type) {
+	case SPA_POD_TYPE_ID:
+	case SPA_POD_TYPE_INT:
+		return *(uint32_t *) v1 == *(uint32_t *) v2;
+	case SPA_POD_TYPE_STRING:
+		return strcmp(v1, v2) == 0;
+	case SPA_POD_TYPE_RECTANGLE:
+		return memcmp(v1, v2, sizeof(struct spa_rectangle)) == 0;
+	case SPA_POD_TYPE_FRACTION:
+	{
+		const struct spa_fraction *f1 = v1, *f2 = v2;
+		return (int64_t) f1->num * f2->denom == (int64_t) f2->num * f1->denom;
+	}
+	}
+	return false;
+}
+
+/* the values of a prop that take part in the intersection */
+static void *get_values(struct spa_pod_prop *prop, int *n_values, bool *is_enum)
+{
+	void *values = SPA_MEMBER(prop, sizeof(struct spa_pod_prop), void);
+
+	*is_enum = (prop->body.flags & SPA_POD_PROP_FLAG_UNSET) != 0;
+	if (!*is_enum) {
+		*n_values = 1;
+		return values;
+	}
+	*n_values = SPA_POD_PROP_N_VALUES(prop) - 1;
+	return SPA_MEMBER(values, prop->body.value.size, void);
+}
+
+/* every value of pod for every equal value of filter, without the value of
+ * a fixed pod */
+static int intersect_pairs(uint32_t type, uint32_t size, uint8_t *result,
+			   struct spa_pod_prop *p1, struct spa_pod_prop *p2)
+{
+	uint8_t *v1, *v2, *alt1, *alt2;
+	int j, k, nalt1, nalt2, n_copied = 0, n_result = 0;
+	bool enum1, enum2;
+
+	alt1 = get_values(p1, &nalt1, &enum1);
+	alt2 = get_values(p2, &nalt2, &enum2);
+
+	for (j = 0, v1 = alt1; j < nalt1; j++, v1 += size) {
+		for (k = 0, v2 = alt2; k < nalt2; k++, v2 += size) {
+			if (!equal(type, v1, v2))
+				continue;
+			if (enum1)
+				memcpy(result + size * n_result++, v1, size);
+			n_copied++;
+		}
+	}
+	return n_copied == 0 ? -1 : n_result;
+}
+
+static bool check(uint32_t type, int n1, int n2, uint32_t range, bool zero_denom)
+{
+	static uint8_t buffer[BUFFER_SIZE], expected[BUFFER_SIZE];
+	struct spa_pod_builder b;
+	struct spa_pod *pod, *filter, *result;
+	struct spa_pod_prop *p1, *p2, *pr;
+	uint32_t ref, size;
+	int n_expected, res;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	ref = b.state.offset;
+	build(&b, type, n1, range, zero_denom);
+	pod = spa_pod_builder_deref(&b, ref);
+	ref = b.state.offset;
+	build(&b, type, n2, range, false);
+	filter = spa_pod_builder_deref(&b, ref);
+
+	p1 = spa_pod_find_prop(pod, KEY);
+	p2 = spa_pod_find_prop(filter, KEY);
+	size = p1->body.value.size;
+
+	n_expected = intersect_pairs(type, size, expected, p1, p2);
+	res = spa_pod_filter(&b, &result, pod, filter);
+
+	if (n_expected < 0 || res < 0) {
+		if ((n_expected < 0) == (res < 0))
+			return true;
+		fprintf(stderr, "type %u %dx%d: filter returned %d, expected %d values\n",
+			type, n1, n2, res, n_expected);
+		return false;
+	}
+
+	pr = spa_pod_find_prop(result, KEY);
+	if (SPA_POD_PROP_N_VALUES(pr) - 1 != n_expected ||
+	    memcmp(SPA_MEMBER(pr, sizeof(struct spa_pod_prop) + size, void),
+		   expected, n_expected * size) != 0) {
+		fprintf(stderr, "type %u %dx%d: got %d values, expected %d\n",
+			type, n1, n2, (int) SPA_POD_PROP_N_VALUES(pr) - 1, n_expected);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t types[] = {
+		SPA_POD_TYPE_ID,
+		SPA_POD_TYPE_INT,
+		SPA_POD_TYPE_STRING,
+		SPA_POD_TYPE_RECTANGLE,
+		SPA_POD_TYPE_FRACTION,
+	};
+	/* 0 values is a fixed prop */
+	static const struct {
+		int n1;
+		int n2;
+	} sizes[] = {
+		{ 4, 4 },
+		{ 8, 8 },
+		{ 20, 8 },
+		{ 64, 64 },
+		{ 300, 40 },
+		{ 40, 300 },
+		{ 0, 64 },
+		{ 64, 0 },
+	};
+	int i, j, k, n_checked = 0, n_failed = 0;
+
+	for (i = 0; i < SPA_N_ELEMENTS(types); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(sizes); j++) {
+			int n1 = sizes[j].n1, n2 = sizes[j].n2;
+			uint32_t n = SPA_MAX(SPA_MAX(n1, n2), 1);
+
+			for (k = 0; k < N_ROUNDS; k++) {
+				/* many duplicates, some duplicates, mostly misses */
+				uint32_t range = k % 3 == 0 ? n / 4 + 1 : k % 3 == 1 ? n : 4 * n;
+				bool zero_denom = types[i] == SPA_POD_TYPE_FRACTION && n1 > 0 &&
+						  k % 10 == 0;
+
+				if (!check(types[i], n1, n2, range, zero_denom))
+					n_failed++;
+				n_checked++;
+			}
+		}
+	}
+	printf("%d of %d filters matched comparing all pairs\n",
+	       n_checked - n_failed, n_checked);
+
+	return n_failed > 0 ? -1 : 0;
+}
@@ -38,6 +38,7 @@ int main(int argc, char *argv[])
 	struct pw_daemon_config *config;
 	char *err = NULL;
 	struct pw_properties *props;
+	const char *str;
 
 	pw_init(&argc, &argv);
 
@@ -51,6 +52,10 @@ int main(int argc, char *argv[])
 
 	props = pw_properties_new(PW_CORE_PROP_NAME, "pipewire-0",
 				  PW_CORE_PROP_DAEMON, "1", NULL);
+	if ((str = getenv("PIPEWIRE_DATA_WORKERS")) != NULL)
+		pw_properties_set(props, PW_CORE_PROP_DATA_WORKERS, str);
+	if ((str = getenv("PIPEWIRE_FREEWHEEL")) != NULL)
+		pw_properties_set(props, PW_CORE_PROP_FREEWHEEL, str);
 
 	loop = pw_main_loop_new(props);
 	pw_loop_add_signal(pw_main_loop_get_loop(loop), SIGINT, do_quit, loop);
@@ -453,10 +453,14 @@ static const struct spa_node impl_node = {
 static void make_node(struct data *data)
 {
 	struct pw_properties *props;
+	const char *str;
 
 	props = pw_properties_new(PW_NODE_PROP_AUTOCONNECT, "1", NULL);
 	if (data->path)
 		pw_properties_set(props, PW_NODE_PROP_TARGET_NODE, data->path);
+	/* 0 selects the message transport, to compare with the default */
+	if ((str = getenv("PIPEWIRE_TRANSPORT_VERSION")) != NULL)
+		pw_properties_set(props, "pipewire.client.transport-version", str);
 
 	data->node = pw_node_new(data->core, "sine-source", props, 0);
 	data->impl_node = impl_node;
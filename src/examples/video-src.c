@@ -94,7 +94,11 @@ static void on_timeout(void *userdata, uint64_t expirations)
 
 	buf = pw_stream_peek_buffer(data->stream, id);
 
-	if (buf->datas[0].type == data->type.data.MemFd) {
+	if (buf->datas[0].data != NULL) {
+		/* the stream has mapped the memory */
+		map = NULL;
+		p = buf->datas[0].data;
+	} else if (buf->datas[0].type == data->type.data.MemFd) {
 		map =
 		    mmap(NULL, buf->datas[0].maxsize + buf->datas[0].mapoffset,
 			 PROT_READ | PROT_WRITE, MAP_SHARED, buf->datas[0].fd, 0);
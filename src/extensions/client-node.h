@@ -38,14 +38,102 @@ struct pw_client_node_proxy;
 
 struct pw_client_node_message;
 
+/** Activation record of a client node \memberof pw_client_node
+ *
+ * Upstream client nodes that are linked directly to this node decrement
+ * \a pending of the activation in the peer area when they have placed
+ * their output in the inputs of the peer area. The peer that brings
+ * \a pending to 0 sets \a status to PW_CLIENT_NODE_ACTIVATION_TRIGGERED and
+ * wakes up this node.
+ *
+ * With PW_CLIENT_NODE_AREA_VERSION_ACTIVATION, the process requests are
+ * posted as bits in \a signals instead of messages in the ringbuffers.
+ * \a wakeup works like a futex word, the eventfd of the owner is only
+ * written when it goes from IDLE to SIGNALED, a signal to a node that is
+ * awake or that already has a wakeup pending does not make a syscall. */
+struct pw_client_node_activation {
+#define PW_CLIENT_NODE_ACTIVATION_NOT_TRIGGERED	0
+#define PW_CLIENT_NODE_ACTIVATION_TRIGGERED	1
+	uint32_t status;		/**< current activation status */
+	int32_t required;		/**< number of peers that signal this node */
+	int32_t pending;		/**< peers that still need to signal this cycle */
+#define PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT	(1 << 0)	/**< to the client */
+#define PW_CLIENT_NODE_SIGNAL_PROCESS_OUTPUT	(1 << 1)	/**< to the client */
+#define PW_CLIENT_NODE_SIGNAL_HAVE_OUTPUT	(1 << 3)	/**< to the server */
+#define PW_CLIENT_NODE_SIGNAL_NEED_INPUT	(1 << 4)	/**< to the server */
+	uint32_t signals;		/**< pending signals for the owner */
+#define PW_CLIENT_NODE_WAKEUP_IDLE	0
+#define PW_CLIENT_NODE_WAKEUP_SIGNALED	1
+	uint32_t wakeup;		/**< the owner is awake or will wake up */
+	uint32_t padding;
+	uint64_t signal_time;		/**< time when the node was signaled */
+	uint64_t awake_time;		/**< time when the node took its signals */
+};
+
+/** Post \a signals to the owner of \a a
+ * \return true when the eventfd of the owner needs to be written */
+static inline bool
+pw_client_node_activation_signal(struct pw_client_node_activation *a, uint32_t signals)
+{
+	__atomic_or_fetch(&a->signals, signals, __ATOMIC_SEQ_CST);
+	return __atomic_exchange_n(&a->wakeup, PW_CLIENT_NODE_WAKEUP_SIGNALED,
+				   __ATOMIC_SEQ_CST) == PW_CLIENT_NODE_WAKEUP_IDLE;
+}
+
+/** Take the pending signals of \a a, called by the owner until it
+ * returns 0, after which the owner can go back to sleep */
+static inline uint32_t
+pw_client_node_activation_take(struct pw_client_node_activation *a)
+{
+	uint32_t signals;
+
+	while (true) {
+		if ((signals = __atomic_exchange_n(&a->signals, 0, __ATOMIC_SEQ_CST)) != 0)
+			return signals;
+
+		__atomic_store_n(&a->wakeup, PW_CLIENT_NODE_WAKEUP_IDLE, __ATOMIC_SEQ_CST);
+
+		/* a signal that was posted before we went idle did not write
+		 * the eventfd, take it now unless a new wakeup is on its way */
+		if (__atomic_load_n(&a->signals, __ATOMIC_SEQ_CST) == 0 ||
+		    __atomic_exchange_n(&a->wakeup, PW_CLIENT_NODE_WAKEUP_SIGNALED,
+					__ATOMIC_SEQ_CST) != PW_CLIENT_NODE_WAKEUP_IDLE)
+			return 0;
+	}
+}
+
 /** Shared structure between client and server \memberof pw_client_node */
 struct pw_client_node_area {
+#define PW_CLIENT_NODE_AREA_VERSION_MESSAGES	0	/**< process requests are messages */
+#define PW_CLIENT_NODE_AREA_VERSION_ACTIVATION	1	/**< process requests are signals */
+	uint32_t version;		/**< transport version, set by the server */
 	uint32_t max_input_ports;	/**< max input ports of the node */
 	uint32_t n_input_ports;		/**< number of input ports of the node */
 	uint32_t max_output_ports;	/**< max output ports of the node */
 	uint32_t n_output_ports;	/**< number of output ports of the node */
+	uint32_t padding;
+	struct pw_client_node_activation activation;	/**< activation of the client */
+	struct pw_client_node_activation server;	/**< activation of the server side */
 };
 
+/** Area shared with the client nodes that are linked directly to the
+ * inputs of a client node \memberof pw_client_node
+ *
+ * The peer area has its own memfd so that upstream clients only get the
+ * activation record and the io of the inputs, not the messages and the
+ * other io areas of the transport. The io areas of the inputs follow
+ * the structure. */
+struct pw_client_node_peer_area {
+	uint32_t max_input_ports;	/**< number of input io areas */
+	uint32_t padding;
+	struct pw_client_node_activation activation;	/**< activation by the peers */
+};
+
+#define pw_client_node_peer_area_get_inputs(a)	\
+	SPA_MEMBER(a, sizeof(struct pw_client_node_peer_area), struct spa_port_io)
+#define pw_client_node_peer_area_get_size(max_input_ports)	\
+	(sizeof(struct pw_client_node_peer_area) + (max_input_ports) * sizeof(struct spa_port_io))
+
 /** \class pw_client_node_transport
  *
  * \brief Transport object
@@ -62,6 +150,7 @@ struct pw_client_node_transport {
 	struct spa_ringbuffer *input_buffer;	/**< ringbuffer for input memory */
 	void *output_data;			/**< output memory for ringbuffer */
 	struct spa_ringbuffer *output_buffer;	/**< ringbuffer for output memory */
+	struct pw_client_node_peer_area *peer_area;	/**< area shared with peers or NULL */
 
 	/** Destroy a transport
 	 * \param trans a transport to destroy
@@ -299,7 +388,9 @@ pw_client_node_proxy_destroy(struct pw_client_node_proxy *p)
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_ADD_MEM		7
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_USE_BUFFERS	8
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_COMMAND		9
-#define PW_CLIENT_NODE_PROXY_EVENT_NUM			10
+#define PW_CLIENT_NODE_PROXY_EVENT_ADD_PEER		10
+#define PW_CLIENT_NODE_PROXY_EVENT_REMOVE_PEER		11
+#define PW_CLIENT_NODE_PROXY_EVENT_NUM			12
 
 /** \ref pw_client_node events */
 struct pw_client_node_proxy_events {
@@ -434,7 +525,39 @@ struct pw_client_node_proxy_events {
 			      enum spa_direction direction,
 			      uint32_t port_id,
 			      const struct spa_command *command);
-
+	/**
+	 * An output port was linked directly to another client node
+	 *
+	 * When output is available on \a port_id, the client copies the
+	 * io area of the port into input \a peer_port_id of the peer area,
+	 * decrements the pending counter of the peer activation and, when
+	 * it reaches 0, signals \a signalfd to wake up the peer.
+	 *
+	 * \param peer_id the node id of the peer
+	 * \param port_id the output port id
+	 * \param peer_port_id the input port id on the peer
+	 * \param signalfd fd to wake up the peer
+	 * \param memfd the memfd of the peer area
+	 * \param offset offset of the peer area in \a memfd
+	 * \param size size of the peer area
+	 */
+	void (*add_peer) (void *object,
+			  uint32_t peer_id,
+			  uint32_t port_id,
+			  uint32_t peer_port_id,
+			  int signalfd,
+			  int memfd,
+			  uint32_t offset,
+			  uint32_t size);
+	/**
+	 * A direct link to a peer was removed
+	 *
+	 * \param peer_id the node id of the peer
+	 * \param port_id the output port id
+	 */
+	void (*remove_peer) (void *object,
+			     uint32_t peer_id,
+			     uint32_t port_id);
 };
 
 static inline void
@@ -466,6 +589,10 @@ pw_client_node_proxy_add_listener(struct pw_client_node_proxy *p,
 	pw_resource_notify(r,struct pw_client_node_proxy_events,port_use_buffers,__VA_ARGS__)
 #define pw_client_node_resource_port_command(r,...)	\
 	pw_resource_notify(r,struct pw_client_node_proxy_events,port_command,__VA_ARGS__)
+#define pw_client_node_resource_add_peer(r,...)		\
+	pw_resource_notify(r,struct pw_client_node_proxy_events,add_peer,__VA_ARGS__)
+#define pw_client_node_resource_remove_peer(r,...)	\
+	pw_resource_notify(r,struct pw_client_node_proxy_events,remove_peer,__VA_ARGS__)
 
 #ifdef __cplusplus
 }  /* extern "C" */
@@ -121,6 +121,7 @@ struct impl {
 	struct pw_client_node this;
 
 	bool client_reuse;
+	uint32_t transport_version;
 
 	struct pw_core *core;
 	struct pw_type *t;
@@ -137,6 +138,29 @@ struct impl {
 
 	uint32_t input_ready;
 	bool out_pending;
+
+	bool direct_wakeup;
+	struct spa_list peers;		/**< direct links to downstream client nodes */
+	struct spa_list upstream;	/**< direct links from upstream client nodes */
+	bool in_chained[MAX_INPUTS];
+
+	struct spa_hook in_port_listeners[MAX_INPUTS];
+	struct spa_hook out_port_listeners[MAX_OUTPUTS];
+};
+
+/** a direct link between the output port of a client node and the input
+ * port of another client node. The upstream client wakes up the peer
+ * itself, the daemon only picks up the messages of the upstream client
+ * when the peer signals the daemon. */
+struct peer {
+	struct spa_list link;		/**< link in impl->peers */
+	struct spa_list peer_link;	/**< link in peer->upstream */
+	struct pw_link *pw_link;
+	struct impl *impl;
+	struct impl *peer;
+	uint32_t peer_id;
+	uint32_t port_id;
+	uint32_t peer_port_id;
 };
 
 /** \endcond */
@@ -207,6 +231,20 @@ static inline void do_flush(struct proxy *this)
 
 }
 
+static inline void send_process(struct proxy *this, uint32_t signal, uint32_t type)
+{
+	struct pw_client_node_transport *trans = this->impl->transport;
+
+	if (trans->area->version >= PW_CLIENT_NODE_AREA_VERSION_ACTIVATION) {
+		/* no syscall when the client is awake or already woken up */
+		if (pw_client_node_activation_signal(&trans->area->activation, signal))
+			do_flush(this);
+	} else {
+		pw_client_node_transport_add_message(trans, &PW_CLIENT_NODE_MESSAGE_INIT(type));
+		do_flush(this);
+	}
+}
+
 static int spa_proxy_node_send_command(struct spa_node *node, const struct spa_command *command)
 {
 	struct proxy *this;
@@ -607,6 +645,10 @@ spa_proxy_node_port_use_buffers(struct spa_node *node,
 		for (j = 0; j < buffers[i]->n_datas; j++) {
 			struct spa_data *d = &buffers[i]->datas[j];
 
+			/* the client uses its own mapping of the memory, the data
+			 * can't be moved by the other side of the link */
+			d->flags &= ~SPA_DATA_FLAG_DYNAMIC;
+
 			memcpy(&b->buffer.datas[j], d, sizeof(struct spa_data));
 
 			if (d->type == t->data.DmaBuf ||
@@ -704,6 +746,20 @@ spa_proxy_node_port_send_command(struct spa_node *node,
 	return -ENOTSUP;
 }
 
+static bool inputs_chained(struct impl *impl, struct spa_graph_node *n)
+{
+	struct spa_graph_port *p;
+
+	if (spa_list_is_empty(&impl->upstream))
+		return false;
+
+	spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+		if (p->port_id >= MAX_INPUTS || !impl->in_chained[p->port_id])
+			return false;
+	}
+	return true;
+}
+
 static int spa_proxy_node_process_input(struct spa_node *node)
 {
 	struct proxy *this = SPA_CONTAINER_OF(node, struct proxy, node);
@@ -711,6 +767,7 @@ static int spa_proxy_node_process_input(struct spa_node *node)
 	struct spa_graph_node *n = &impl->this.node->rt.node;
 	bool client_reuse = impl->client_reuse;
 	struct spa_graph_port *p, *pp;
+	bool chained;
 	int res;
 
 	if (impl->input_ready == 0) {
@@ -721,19 +778,25 @@ static int spa_proxy_node_process_input(struct spa_node *node)
 		res = SPA_STATUS_NEED_BUFFER;
 	}
 	else {
+		/* when all inputs are linked directly, the upstream clients have
+		 * already placed their output in the transport and woken up the
+		 * client */
+		chained = inputs_chained(impl, n);
+
 		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
 			struct spa_port_io *io = p->io;
 
 			pw_log_trace("set io status to %d %d", io->status, io->buffer_id);
-			impl->transport->inputs[p->port_id] = *io;
+			if (!chained)
+				impl->transport->inputs[p->port_id] = *io;
 
 			/* explicitly recycle buffers when the client is not going to do it */
 			if (!client_reuse && (pp = p->peer))
 		                spa_node_port_reuse_buffer(pp->node->implementation, pp->port_id, io->buffer_id);
 		}
-		pw_client_node_transport_add_message(impl->transport,
-			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT));
-		do_flush(this);
+		if (!chained)
+			send_process(this, PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT,
+				     PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT);
 
 		impl->input_ready--;
 		res = SPA_STATUS_OK;
@@ -768,35 +831,56 @@ static int spa_proxy_node_process_output(struct spa_node *node)
 	}
 
       done:
-	pw_client_node_transport_add_message(impl->transport,
-			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT));
-	do_flush(this);
+	send_process(this, PW_CLIENT_NODE_SIGNAL_PROCESS_OUTPUT,
+		     PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT);
 
 	return SPA_STATUS_OK;
 }
 
-static int handle_node_message(struct proxy *this, struct pw_client_node_message *message)
+static void handle_have_output(struct proxy *this)
 {
-	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, proxy);
-	struct spa_graph_node *n;
+	struct impl *impl = this->impl;
+	struct spa_graph_node *n = &impl->this.node->rt.node;
 	struct spa_graph_port *p;
 
-	n = &impl->this.node->rt.node;
+	spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
+		*p->io = impl->transport->outputs[p->port_id];
+		pw_log_trace("have output %d %d", p->io->status, p->io->buffer_id);
+	}
+	impl->out_pending = false;
+	this->callbacks->have_output(this->callbacks_data);
+}
+
+static void handle_need_input(struct proxy *this)
+{
+	struct impl *impl = this->impl;
+	struct spa_graph_node *n = &impl->this.node->rt.node;
+	struct spa_graph_port *p;
+
+	spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+		*p->io = impl->transport->inputs[p->port_id];
+		pw_log_trace("need input %d %d", p->io->status, p->io->buffer_id);
+	}
+	impl->input_ready++;
+	this->callbacks->need_input(this->callbacks_data);
+}
+
+static void handle_node_signals(struct proxy *this, uint32_t signals)
+{
+	if (signals & PW_CLIENT_NODE_SIGNAL_HAVE_OUTPUT)
+		handle_have_output(this);
+	if (signals & PW_CLIENT_NODE_SIGNAL_NEED_INPUT)
+		handle_need_input(this);
+}
+
+static int handle_node_message(struct proxy *this, struct pw_client_node_message *message)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, proxy);
 
 	if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT) {
-		spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
-			*p->io = impl->transport->outputs[p->port_id];
-			pw_log_trace("have output %d %d", p->io->status, p->io->buffer_id);
-		}
-		impl->out_pending = false;
-		this->callbacks->have_output(this->callbacks_data);
+		handle_have_output(this);
 	} else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_NEED_INPUT) {
-		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
-			*p->io = impl->transport->inputs[p->port_id];
-			pw_log_trace("need input %d %d", p->io->status, p->io->buffer_id);
-		}
-		impl->input_ready++;
-		this->callbacks->need_input(this->callbacks_data);
+		handle_need_input(this);
 	} else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_REUSE_BUFFER) {
 		if (impl->client_reuse) {
 			struct pw_client_node_message_reuse_buffer *p =
@@ -811,12 +895,18 @@ static int handle_node_message(struct proxy *this, struct pw_client_node_message
 static void setup_transport(struct impl *impl)
 {
 	uint32_t max_inputs = 0, max_outputs = 0, n_inputs = 0, n_outputs = 0;
+	int res;
 
 	spa_proxy_node_get_n_ports(&impl->proxy.node, &n_inputs, &max_inputs, &n_outputs, &max_outputs);
 
 	impl->transport = pw_client_node_transport_new(max_inputs, max_outputs);
+	impl->transport->area->version = impl->transport_version;
 	impl->transport->area->n_input_ports = n_inputs;
 	impl->transport->area->n_output_ports = n_outputs;
+
+	if (impl->direct_wakeup &&
+	    (res = pw_client_node_transport_add_peer_area(impl->transport)) < 0)
+		pw_log_warn("client-node %p: can't allocate peer area: %s", impl, strerror(-res));
 }
 
 static void
@@ -921,6 +1011,22 @@ static struct pw_client_node_proxy_methods client_node_methods = {
 	.destroy = client_node_destroy,
 };
 
+static void process_messages(struct proxy *this)
+{
+	struct impl *impl = this->impl;
+	struct pw_client_node_area *a = impl->transport->area;
+	struct pw_client_node_message message;
+
+	while (pw_client_node_transport_next_message(impl->transport, &message) == 1) {
+		struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
+		pw_client_node_transport_parse_message(impl->transport, msg);
+		handle_node_message(this, msg);
+	}
+	if (a->version >= PW_CLIENT_NODE_AREA_VERSION_ACTIVATION)
+		handle_node_signals(this, __atomic_exchange_n(&a->server.signals, 0,
+							      __ATOMIC_SEQ_CST));
+}
+
 static void proxy_on_data_fd_events(struct spa_source *source)
 {
 	struct proxy *this = source->data;
@@ -932,17 +1038,25 @@ static void proxy_on_data_fd_events(struct spa_source *source)
 	}
 
 	if (source->rmask & SPA_IO_IN) {
-		struct pw_client_node_message message;
+		struct peer *p;
 		uint64_t cmd;
 
 		if (read(this->data_source.fd, &cmd, sizeof(uint64_t)) != sizeof(uint64_t))
 			spa_log_warn(this->log, "proxy %p: error reading message: %s",
 					this, strerror(errno));
 
-		while (pw_client_node_transport_next_message(impl->transport, &message) == 1) {
-			struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
-			pw_client_node_transport_parse_message(impl->transport, msg);
-			handle_node_message(this, msg);
+		/* upstream clients that wake us up directly don't signal the
+		 * daemon, pick up their messages first */
+		spa_list_for_each(p, &impl->upstream, peer_link)
+			process_messages(&p->impl->proxy);
+
+		process_messages(this);
+
+		if (impl->transport->area->version >= PW_CLIENT_NODE_AREA_VERSION_ACTIVATION) {
+			uint32_t signals;
+
+			while ((signals = pw_client_node_activation_take(&impl->transport->area->server)))
+				handle_node_signals(this, signals);
 		}
 	}
 }
@@ -1002,6 +1116,7 @@ proxy_init(struct proxy *this,
 	this->data_source.fd = -1;
 	this->data_source.mask = SPA_IO_IN | SPA_IO_ERR | SPA_IO_HUP;
 	this->data_source.rmask = 0;
+	this->data_source.priority = SPA_SOURCE_PRIORITY_HIGH;
 
 	return SPA_RESULT_RETURN_ASYNC(this->seq++);
 }
@@ -1022,6 +1137,8 @@ static int proxy_clear(struct proxy *this)
 	return 0;
 }
 
+static void clear_peers(struct impl *impl);
+
 static void client_node_resource_destroy(void *data)
 {
 	struct impl *impl = data;
@@ -1032,6 +1149,8 @@ static void client_node_resource_destroy(void *data)
 
 	impl->proxy.resource = this->resource = NULL;
 
+	clear_peers(impl);
+
 	if (proxy->data_source.fd != -1)
 		spa_loop_remove_source(proxy->data_loop, &proxy->data_source);
 
@@ -1062,6 +1181,234 @@ static void node_initialized(void *data)
 					  impl->other_fds[0], impl->other_fds[1], impl->transport);
 }
 
+static struct impl *port_get_client_node(struct pw_port *port)
+{
+	struct spa_node *node = port->node->node;
+	struct proxy *this;
+
+	if (node == NULL || node->process_input != spa_proxy_node_process_input)
+		return NULL;
+
+	this = SPA_CONTAINER_OF(node, struct proxy, node);
+	return this->impl;
+}
+
+static inline bool port_has_single_link(struct pw_port *port)
+{
+	return !spa_list_is_empty(&port->links) && port->links.next == port->links.prev;
+}
+
+static int
+do_add_peer(struct spa_loop *loop,
+	    bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct peer *p = user_data;
+	struct pw_client_node_activation *a = &p->peer->transport->peer_area->activation;
+
+	spa_list_append(&p->impl->peers, &p->link);
+	spa_list_append(&p->peer->upstream, &p->peer_link);
+	p->peer->in_chained[p->peer_port_id] = true;
+
+	a->required++;
+	a->pending = a->required;
+	a->status = PW_CLIENT_NODE_ACTIVATION_NOT_TRIGGERED;
+
+	return 0;
+}
+
+static int
+do_remove_peer(struct spa_loop *loop,
+	       bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct peer *p = user_data;
+	struct pw_client_node_activation *a = &p->peer->transport->peer_area->activation;
+
+	spa_list_remove(&p->link);
+	spa_list_remove(&p->peer_link);
+	p->peer->in_chained[p->peer_port_id] = false;
+
+	a->required--;
+	a->pending = a->required;
+
+	return 0;
+}
+
+static void add_peer(struct impl *impl, struct pw_link *link)
+{
+	struct pw_port *output = link->output, *input = link->input;
+	struct impl *peer_impl;
+	struct pw_client_node_transport_info info;
+	struct pw_global *global;
+	uint32_t perms;
+	struct peer *p;
+
+	if ((peer_impl = port_get_client_node(input)) == NULL ||
+	    peer_impl == impl || !peer_impl->direct_wakeup)
+		return;
+
+	if (impl->this.resource == NULL || peer_impl->this.resource == NULL ||
+	    peer_impl->transport == NULL || peer_impl->transport->peer_area == NULL ||
+	    peer_impl->fds[1] == -1)
+		return;
+
+	/* only plain 1:1 links can bypass the mixer and the daemon */
+	if (output->port_id >= MAX_OUTPUTS || input->port_id >= MAX_INPUTS ||
+	    !port_has_single_link(output) || !port_has_single_link(input))
+		return;
+
+	/* the client gets to wake up the peer and write its inputs */
+	global = pw_node_get_global(peer_impl->this.node);
+	perms = pw_global_get_permissions(global, pw_resource_get_client(impl->this.resource));
+	if (!PW_PERM_IS_R(perms) || !PW_PERM_IS_X(perms)) {
+		pw_log_debug("client-node %p: no permission for direct link to node %u",
+			     impl, pw_global_get_id(global));
+		return;
+	}
+
+	p = calloc(1, sizeof(struct peer));
+	if (p == NULL)
+		return;
+
+	p->pw_link = link;
+	p->impl = impl;
+	p->peer = peer_impl;
+	p->peer_id = pw_global_get_id(global);
+	p->port_id = output->port_id;
+	p->peer_port_id = input->port_id;
+
+	pw_log_debug("client-node %p: port %u linked directly to node %u port %u",
+		     impl, p->port_id, p->peer_id, p->peer_port_id);
+
+	spa_loop_invoke(impl->proxy.data_loop, do_add_peer, SPA_ID_INVALID, 0, NULL, true, p);
+
+	pw_client_node_transport_get_info(peer_impl->transport, &info);
+	pw_client_node_resource_add_peer(impl->this.resource, p->peer_id,
+					 p->port_id, p->peer_port_id, peer_impl->fds[1],
+					 info.peer_memfd, info.peer_offset, info.peer_size);
+}
+
+static void remove_peer(struct peer *p)
+{
+	struct impl *impl = p->impl;
+
+	pw_log_debug("client-node %p: remove direct link of port %u to node %u",
+		     impl, p->port_id, p->peer_id);
+
+	spa_loop_invoke(impl->proxy.data_loop, do_remove_peer, SPA_ID_INVALID, 0, NULL, true, p);
+
+	if (impl->this.resource)
+		pw_client_node_resource_remove_peer(impl->this.resource, p->peer_id, p->port_id);
+
+	free(p);
+}
+
+static void remove_port_peers(struct impl *impl, enum pw_direction direction, uint32_t port_id)
+{
+	struct peer *p, *t;
+
+	if (direction == PW_DIRECTION_OUTPUT) {
+		spa_list_for_each_safe(p, t, &impl->peers, link)
+			if (p->port_id == port_id)
+				remove_peer(p);
+	} else {
+		spa_list_for_each_safe(p, t, &impl->upstream, peer_link)
+			if (p->peer_port_id == port_id)
+				remove_peer(p);
+	}
+}
+
+static void clear_peers(struct impl *impl)
+{
+	struct peer *p, *t;
+
+	spa_list_for_each_safe(p, t, &impl->peers, link)
+		remove_peer(p);
+	spa_list_for_each_safe(p, t, &impl->upstream, peer_link)
+		remove_peer(p);
+}
+
+static void output_link_added(void *data, struct pw_link *link)
+{
+	struct impl *impl = data;
+
+	/* a second link on the port needs the daemon to split the output */
+	remove_port_peers(impl, PW_DIRECTION_OUTPUT, link->output->port_id);
+	add_peer(impl, link);
+}
+
+static void output_link_removed(void *data, struct pw_link *link)
+{
+	struct impl *impl = data;
+	struct peer *p, *t;
+
+	spa_list_for_each_safe(p, t, &impl->peers, link)
+		if (p->pw_link == link)
+			remove_peer(p);
+}
+
+static void input_link_added(void *data, struct pw_link *link)
+{
+	struct impl *impl = data;
+
+	/* more than one link on the input needs the daemon to mix */
+	if (!port_has_single_link(link->input))
+		remove_port_peers(impl, PW_DIRECTION_INPUT, link->input->port_id);
+}
+
+static void input_link_removed(void *data, struct pw_link *link)
+{
+	struct impl *impl = data;
+	struct peer *p, *t;
+
+	spa_list_for_each_safe(p, t, &impl->upstream, peer_link)
+		if (p->pw_link == link)
+			remove_peer(p);
+}
+
+static const struct pw_port_events output_port_events = {
+	PW_VERSION_PORT_EVENTS,
+	.link_added = output_link_added,
+	.link_removed = output_link_removed,
+};
+
+static const struct pw_port_events input_port_events = {
+	PW_VERSION_PORT_EVENTS,
+	.link_added = input_link_added,
+	.link_removed = input_link_removed,
+};
+
+static void node_port_added(void *data, struct pw_port *port)
+{
+	struct impl *impl = data;
+
+	if (!impl->direct_wakeup)
+		return;
+
+	if (port->direction == PW_DIRECTION_INPUT && port->port_id < MAX_INPUTS)
+		pw_port_add_listener(port, &impl->in_port_listeners[port->port_id],
+				     &input_port_events, impl);
+	else if (port->direction == PW_DIRECTION_OUTPUT && port->port_id < MAX_OUTPUTS)
+		pw_port_add_listener(port, &impl->out_port_listeners[port->port_id],
+				     &output_port_events, impl);
+}
+
+static void node_port_removed(void *data, struct pw_port *port)
+{
+	struct impl *impl = data;
+
+	if (!impl->direct_wakeup)
+		return;
+
+	if (port->direction == PW_DIRECTION_INPUT && port->port_id < MAX_INPUTS)
+		spa_hook_remove(&impl->in_port_listeners[port->port_id]);
+	else if (port->direction == PW_DIRECTION_OUTPUT && port->port_id < MAX_OUTPUTS)
+		spa_hook_remove(&impl->out_port_listeners[port->port_id]);
+	else
+		return;
+
+	remove_port_peers(impl, port->direction, port->port_id);
+}
+
 static void node_free(void *data)
 {
 	struct impl *impl = data;
@@ -1085,6 +1432,8 @@ static const struct pw_node_events node_events = {
 	PW_VERSION_NODE_EVENTS,
 	.free = node_free,
 	.initialized = node_initialized,
+	.port_added = node_port_added,
+	.port_removed = node_port_removed,
 };
 
 static const struct pw_resource_events resource_events = {
@@ -1092,6 +1441,27 @@ static const struct pw_resource_events resource_events = {
 	.destroy = client_node_resource_destroy,
 };
 
+/* the transport version the client asked for, unknown versions get the
+ * messages transport that every client understands */
+static uint32_t parse_transport_version(const char *str)
+{
+	unsigned long version;
+	char *end;
+
+	if (str == NULL)
+		return PW_CLIENT_NODE_AREA_VERSION_MESSAGES;
+
+	errno = 0;
+	version = strtoul(str, &end, 10);
+	if (errno != 0 || end == str || *end != '\0' ||
+	    (version != PW_CLIENT_NODE_AREA_VERSION_MESSAGES &&
+	     version != PW_CLIENT_NODE_AREA_VERSION_ACTIVATION)) {
+		pw_log_warn("client-node: unknown transport version \"%s\"", str);
+		return PW_CLIENT_NODE_AREA_VERSION_MESSAGES;
+	}
+	return version;
+}
+
 /** Create a new client node
  * \param client an owner \ref pw_client
  * \param id an id
@@ -1124,6 +1494,8 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 	impl->core = core;
 	impl->t = pw_core_get_type(core);
 	impl->fds[0] = impl->fds[1] = -1;
+	spa_list_init(&impl->peers);
+	spa_list_init(&impl->upstream);
 	pw_log_debug("client-node %p: new", impl);
 
 	support = pw_core_get_support(impl->core, &n_support);
@@ -1146,6 +1518,12 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 	str = pw_properties_get(properties, "pipewire.client.reuse");
 	impl->client_reuse = str && pw_properties_parse_bool(str);
 
+	str = pw_properties_get(properties, "pipewire.client.direct-wakeup");
+	impl->direct_wakeup = str && pw_properties_parse_bool(str);
+
+	str = pw_properties_get(properties, "pipewire.client.transport-version");
+	impl->transport_version = parse_transport_version(str);
+
 	pw_resource_add_listener(this->resource,
 				 &impl->resource_listener,
 				 &resource_events,
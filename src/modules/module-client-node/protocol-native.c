@@ -153,7 +153,7 @@ static bool client_node_demarshal_transport(void *object, void *data, size_t siz
 {
 	struct pw_proxy *proxy = object;
 	struct spa_pod_parser prs;
-	uint32_t node_id, ridx, widx, memfd_idx;
+	uint32_t node_id, ridx, widx, memfd_idx, peer_memfd_idx;
 	int readfd, writefd;
 	struct pw_client_node_transport_info info;
 	struct pw_client_node_transport *transport;
@@ -166,12 +166,17 @@ static bool client_node_demarshal_transport(void *object, void *data, size_t siz
 			"i", &widx,
 			"i", &memfd_idx,
 			"i", &info.offset,
-			"i", &info.size, NULL) < 0)
+			"i", &info.size,
+			"i", &peer_memfd_idx,
+			"i", &info.peer_offset,
+			"i", &info.peer_size, NULL) < 0)
 		return false;
 
 	readfd = pw_protocol_native_get_proxy_fd(proxy, ridx);
 	writefd = pw_protocol_native_get_proxy_fd(proxy, widx);
 	info.memfd = pw_protocol_native_get_proxy_fd(proxy, memfd_idx);
+	info.peer_memfd = peer_memfd_idx == SPA_ID_INVALID ? -1 :
+		pw_protocol_native_get_proxy_fd(proxy, peer_memfd_idx);
 
 	if (readfd == -1 || writefd == -1 || info.memfd == -1)
 		return false;
@@ -408,6 +413,58 @@ static bool client_node_demarshal_port_command(void *object, void *data, size_t
 	return true;
 }
 
+static bool client_node_demarshal_add_peer(void *object, void *data, size_t size)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_parser prs;
+	uint32_t peer_id, port_id, peer_port_id, sidx, memfd_idx, offset, sz;
+	int signalfd, memfd;
+
+	spa_pod_parser_init(&prs, data, size, 0);
+	if (spa_pod_parser_get(&prs,
+			"["
+			"i", &peer_id,
+			"i", &port_id,
+			"i", &peer_port_id,
+			"i", &sidx,
+			"i", &memfd_idx,
+			"i", &offset,
+			"i", &sz, NULL) < 0)
+		return false;
+
+	signalfd = pw_protocol_native_get_proxy_fd(proxy, sidx);
+	memfd = pw_protocol_native_get_proxy_fd(proxy, memfd_idx);
+
+	if (signalfd == -1 || memfd == -1)
+		return false;
+
+	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, add_peer, peer_id,
+								   port_id,
+								   peer_port_id,
+								   signalfd,
+								   memfd,
+								   offset,
+								   sz);
+	return true;
+}
+
+static bool client_node_demarshal_remove_peer(void *object, void *data, size_t size)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_parser prs;
+	uint32_t peer_id, port_id;
+
+	spa_pod_parser_init(&prs, data, size, 0);
+	if (spa_pod_parser_get(&prs,
+			"["
+			"i", &peer_id,
+			"i", &port_id, NULL) < 0)
+		return false;
+
+	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, remove_peer, peer_id, port_id);
+	return true;
+}
+
 static void client_node_marshal_transport(void *object, uint32_t node_id, int readfd, int writefd,
 					  struct pw_client_node_transport *transport)
 {
@@ -425,7 +482,11 @@ static void client_node_marshal_transport(void *object, uint32_t node_id, int re
 			       "i", pw_protocol_native_add_resource_fd(resource, writefd),
 			       "i", pw_protocol_native_add_resource_fd(resource, info.memfd),
 			       "i", info.offset,
-			       "i", info.size);
+			       "i", info.size,
+			       "i", info.peer_memfd == -1 ? SPA_ID_INVALID :
+				    pw_protocol_native_add_resource_fd(resource, info.peer_memfd),
+			       "i", info.peer_offset,
+			       "i", info.peer_size);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -768,6 +829,41 @@ static bool client_node_demarshal_destroy(void *object, void *data, size_t size)
 	return true;
 }
 
+static void client_node_marshal_add_peer(void *object, uint32_t peer_id, uint32_t port_id,
+					 uint32_t peer_port_id, int signalfd,
+					 int memfd, uint32_t offset, uint32_t size)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_ADD_PEER);
+
+	spa_pod_builder_struct(b,
+			       "i", peer_id,
+			       "i", port_id,
+			       "i", peer_port_id,
+			       "i", pw_protocol_native_add_resource_fd(resource, signalfd),
+			       "i", pw_protocol_native_add_resource_fd(resource, memfd),
+			       "i", offset,
+			       "i", size);
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
+static void client_node_marshal_remove_peer(void *object, uint32_t peer_id, uint32_t port_id)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_REMOVE_PEER);
+
+	spa_pod_builder_struct(b,
+			       "i", peer_id,
+			       "i", port_id);
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
 static const struct pw_client_node_proxy_methods pw_protocol_native_client_node_method_marshal = {
 	PW_VERSION_CLIENT_NODE_PROXY_METHODS,
 	&client_node_marshal_done,
@@ -799,6 +895,8 @@ static const struct pw_client_node_proxy_events pw_protocol_native_client_node_e
 	&client_node_marshal_port_add_mem,
 	&client_node_marshal_port_use_buffers,
 	&client_node_marshal_port_command,
+	&client_node_marshal_add_peer,
+	&client_node_marshal_remove_peer,
 };
 
 static const struct pw_protocol_native_demarshal pw_protocol_native_client_node_event_demarshal[] = {
@@ -812,6 +910,8 @@ static const struct pw_protocol_native_demarshal pw_protocol_native_client_node_
 	{ &client_node_demarshal_port_add_mem, PW_PROTOCOL_NATIVE_REMAP },
 	{ &client_node_demarshal_port_use_buffers, PW_PROTOCOL_NATIVE_REMAP },
 	{ &client_node_demarshal_port_command, PW_PROTOCOL_NATIVE_REMAP },
+	{ &client_node_demarshal_add_peer, 0 },
+	{ &client_node_demarshal_remove_peer, 0 },
 };
 
 const struct pw_protocol_marshal pw_protocol_native_client_node_marshal = {
@@ -37,6 +37,8 @@ struct transport {
 	struct pw_memblock mem;
 	size_t offset;
 
+	struct pw_memblock peer_mem;
+
 	struct pw_client_node_message current;
 	uint32_t current_index;
 };
@@ -96,6 +98,9 @@ static void transport_reset_area(struct pw_client_node_transport *trans)
 	}
 	spa_ringbuffer_init(trans->input_buffer, INPUT_BUFFER_SIZE);
 	spa_ringbuffer_init(trans->output_buffer, OUTPUT_BUFFER_SIZE);
+
+	spa_zero(a->activation);
+	spa_zero(a->server);
 }
 
 static void destroy(struct pw_client_node_transport *trans)
@@ -105,6 +110,8 @@ static void destroy(struct pw_client_node_transport *trans)
 	pw_log_debug("transport %p: destroy", trans);
 
 	pw_memblock_free(&impl->mem);
+	if (trans->peer_area)
+		pw_memblock_free(&impl->peer_mem);
 	free(impl);
 }
 
@@ -184,6 +191,8 @@ pw_client_node_transport_new(uint32_t max_input_ports, uint32_t max_output_ports
 	struct pw_client_node_transport *trans;
 	struct pw_client_node_area area;
 
+	spa_zero(area);
+	area.version = PW_CLIENT_NODE_AREA_VERSION_MESSAGES;
 	area.max_input_ports = max_input_ports;
 	area.n_input_ports = 0;
 	area.max_output_ports = max_output_ports;
@@ -196,8 +205,11 @@ pw_client_node_transport_new(uint32_t max_input_ports, uint32_t max_output_ports
 	trans = &impl->trans;
 	impl->offset = 0;
 
+	/* the area is small and used by the data thread in every cycle, keep
+	 * it in memory */
 	pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
 			  PW_MEMBLOCK_FLAG_MAP_READWRITE |
+			  PW_MEMBLOCK_FLAG_MAP_LOCK |
 			  PW_MEMBLOCK_FLAG_SEAL, area_get_size(&area), &impl->mem);
 
 	memcpy(impl->mem.ptr, &area, sizeof(struct pw_client_node_area));
@@ -212,6 +224,80 @@ pw_client_node_transport_new(uint32_t max_input_ports, uint32_t max_output_ports
 	return trans;
 }
 
+static void peer_area_reset(struct pw_client_node_peer_area *a)
+{
+	struct spa_port_io *inputs = pw_client_node_peer_area_get_inputs(a);
+	int i;
+
+	for (i = 0; i < a->max_input_ports; i++) {
+		inputs[i].status = SPA_STATUS_OK;
+		inputs[i].buffer_id = SPA_ID_INVALID;
+	}
+	spa_zero(a->activation);
+}
+
+/** Add a peer area to a transport
+ * \param trans the transport
+ * \return 0 on success, < 0 on error
+ *
+ * The peer area is allocated in its own memfd and can be shared with
+ * the clients that are linked directly to the inputs of the node.
+ *
+ * \memberof pw_client_node_transport
+ */
+int pw_client_node_transport_add_peer_area(struct pw_client_node_transport *trans)
+{
+	struct transport *impl = (struct transport *) trans;
+	uint32_t max_input_ports = trans->area->max_input_ports;
+	int res;
+
+	if (trans->peer_area != NULL)
+		return 0;
+
+	if ((res = pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+				     PW_MEMBLOCK_FLAG_MAP_READWRITE |
+				     PW_MEMBLOCK_FLAG_MAP_LOCK |
+				     PW_MEMBLOCK_FLAG_SEAL,
+				     pw_client_node_peer_area_get_size(max_input_ports),
+				     &impl->peer_mem)) < 0)
+		return res;
+
+	trans->peer_area = impl->peer_mem.ptr;
+	trans->peer_area->max_input_ports = max_input_ports;
+	peer_area_reset(trans->peer_area);
+
+	return 0;
+}
+
+static int map_peer_area(struct transport *impl, struct pw_client_node_transport_info *info)
+{
+	struct pw_client_node_transport *trans = &impl->trans;
+	struct pw_client_node_peer_area *a;
+	int res;
+
+	if (info->peer_size < sizeof(struct pw_client_node_peer_area))
+		return -EINVAL;
+
+	impl->peer_mem.flags = PW_MEMBLOCK_FLAG_MAP_READWRITE |
+			       PW_MEMBLOCK_FLAG_MAP_LOCK |
+			       PW_MEMBLOCK_FLAG_WITH_FD;
+	impl->peer_mem.fd = info->peer_memfd;
+	impl->peer_mem.offset = info->peer_offset;
+	impl->peer_mem.size = info->peer_size;
+	if ((res = pw_memblock_map(&impl->peer_mem)) < 0)
+		return res;
+
+	a = impl->peer_mem.ptr;
+	if (a->max_input_ports != trans->area->max_input_ports ||
+	    info->peer_size < pw_client_node_peer_area_get_size(a->max_input_ports)) {
+		munmap(a, info->peer_size);
+		return -EINVAL;
+	}
+	trans->peer_area = a;
+
+	return 0;
+}
+
 struct pw_client_node_transport *
 pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *info)
 {
@@ -225,7 +311,9 @@ pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *inf
 
 	trans = &impl->trans;
 
-	impl->mem.flags = PW_MEMBLOCK_FLAG_MAP_READWRITE | PW_MEMBLOCK_FLAG_WITH_FD;
+	impl->mem.flags = PW_MEMBLOCK_FLAG_MAP_READWRITE |
+			  PW_MEMBLOCK_FLAG_MAP_LOCK |
+			  PW_MEMBLOCK_FLAG_WITH_FD;
 	impl->mem.fd = info->memfd;
 	impl->mem.offset = info->offset;
 	impl->mem.size = info->size;
@@ -239,6 +327,11 @@ pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *inf
 
 	transport_setup_area(impl->mem.ptr, trans);
 
+	if (info->peer_memfd != -1 && map_peer_area(impl, info) < 0) {
+		pw_log_warn("transport %p: invalid peer area fd %d", impl, info->peer_memfd);
+		close(info->peer_memfd);
+	}
+
 	tmp = trans->output_buffer;
 	trans->output_buffer = trans->input_buffer;
 	trans->input_buffer = tmp;
@@ -278,5 +371,15 @@ int pw_client_node_transport_get_info(struct pw_client_node_transport *trans,
 	info->offset = impl->offset;
 	info->size = impl->mem.size;
 
+	if (trans->peer_area) {
+		info->peer_memfd = impl->peer_mem.fd;
+		info->peer_offset = impl->peer_mem.offset;
+		info->peer_size = impl->peer_mem.size;
+	} else {
+		info->peer_memfd = -1;
+		info->peer_offset = 0;
+		info->peer_size = 0;
+	}
+
 	return 0;
 }
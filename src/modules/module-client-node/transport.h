@@ -35,11 +35,17 @@ struct pw_client_node_transport_info {
 	int memfd;		/**< the memfd of the transport area */
 	uint32_t offset;	/**< offset to map \a memfd at */
 	uint32_t size;		/**< size of memfd mapping */
+	int peer_memfd;		/**< the memfd of the peer area or -1 */
+	uint32_t peer_offset;	/**< offset to map \a peer_memfd at */
+	uint32_t peer_size;	/**< size of the peer area mapping */
 };
 
 struct pw_client_node_transport *
 pw_client_node_transport_new(uint32_t max_input_ports, uint32_t max_output_ports);
 
+int
+pw_client_node_transport_add_peer_area(struct pw_client_node_transport *trans);
+
 struct pw_client_node_transport *
 pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *info);
 
@@ -75,6 +75,7 @@ struct client {
 
         bool disconnecting;
 	bool flush_signaled;
+	bool need_out;
         struct spa_source *flush_event;
 };
 
@@ -96,35 +97,50 @@ struct client_data {
 	struct spa_source *source;
 	struct pw_protocol_native_connection *connection;
 	bool busy;
+	bool need_out;		/**< messages are queued until the socket is writable */
 };
 
-static bool pod_remap_data(uint32_t type, void *body, uint32_t size, struct pw_map *types)
+static inline bool remap_id(uint32_t *id, struct pw_map *types, uint32_t n_identity)
 {
 	void *t;
 
+	/* the static types and the types both sides registered in the same
+	 * order have the same id on both sides, they are all registered by
+	 * the peer so only the range needs to be checked. Other ids must be
+	 * registered or the message is invalid. */
+	if (SPA_LIKELY(*id < n_identity))
+		return true;
+	if ((t = pw_map_lookup(types, *id)) == NULL)
+		return false;
+	*id = PW_MAP_PTR_TO_ID(t);
+	return true;
+}
+
+static bool pod_remap_data(uint32_t type, void *body, uint32_t size,
+			   struct pw_map *types, uint32_t n_identity)
+{
 	switch (type) {
 	case SPA_POD_TYPE_ID:
-		if ((t = pw_map_lookup(types, *(int32_t *) body)) == NULL)
+		if (!remap_id(body, types, n_identity))
 			return false;
-		*(int32_t *) body = PW_MAP_PTR_TO_ID(t);
 		break;
 
 	case SPA_POD_TYPE_PROP:
 	{
 		struct spa_pod_prop_body *b = body;
 
-		if ((t = pw_map_lookup(types, b->key)) == NULL)
+		if (!remap_id(&b->key, types, n_identity))
 			return false;
-		b->key = PW_MAP_PTR_TO_ID(t);
 
 		if (b->value.type == SPA_POD_TYPE_ID) {
 			void *alt;
-			if (!pod_remap_data
-			    (b->value.type, SPA_POD_BODY(&b->value), b->value.size, types))
+			if (!pod_remap_data(b->value.type, SPA_POD_BODY(&b->value),
+					    b->value.size, types, n_identity))
 				return false;
 
 			SPA_POD_PROP_ALTERNATIVE_FOREACH(b, size, alt)
-				if (!pod_remap_data(b->value.type, alt, b->value.size, types))
+				if (!pod_remap_data(b->value.type, alt, b->value.size,
+						    types, n_identity))
 					return false;
 		}
 		break;
@@ -134,17 +150,14 @@ static bool pod_remap_data(uint32_t type, void *body, uint32_t size, struct pw_m
 		struct spa_pod_object_body *b = body;
 		struct spa_pod *p;
 
-		if ((t = pw_map_lookup(types, b->id)) != NULL)
-			b->id = PW_MAP_PTR_TO_ID(t);
-		else
+		if (!remap_id(&b->id, types, n_identity))
 			b->id = SPA_ID_INVALID;
 
-		if ((t = pw_map_lookup(types, b->type)) == NULL)
+		if (!remap_id(&b->type, types, n_identity))
 			return false;
-		b->type = PW_MAP_PTR_TO_ID(t);
 
 		SPA_POD_OBJECT_BODY_FOREACH(b, size, p)
-			if (!pod_remap_data(p->type, SPA_POD_BODY(p), p->size, types))
+			if (!pod_remap_data(p->type, SPA_POD_BODY(p), p->size, types, n_identity))
 				return false;
 		break;
 	}
@@ -153,7 +166,7 @@ static bool pod_remap_data(uint32_t type, void *body, uint32_t size, struct pw_m
 		struct spa_pod *b = body, *p;
 
 		SPA_POD_FOREACH(b, size, p)
-			if (!pod_remap_data(p->type, SPA_POD_BODY(p), p->size, types))
+			if (!pod_remap_data(p->type, SPA_POD_BODY(p), p->size, types, n_identity))
 				return false;
 		break;
 	}
@@ -163,6 +176,14 @@ static bool pod_remap_data(uint32_t type, void *body, uint32_t size, struct pw_m
 	return true;
 }
 
+static inline bool remap_message(void *message, uint32_t size,
+				 struct pw_map *types, uint32_t n_identity)
+{
+	/* even when all types of the peer have the same id here, every id
+	 * is checked so that unknown ids are rejected */
+	return pod_remap_data(SPA_POD_TYPE_STRUCT, message, size, types, n_identity);
+}
+
 static void
 process_messages(struct client_data *data)
 {
@@ -216,7 +237,7 @@ process_messages(struct client_data *data)
 		}
 
 		if (demarshal[opcode].flags & PW_PROTOCOL_NATIVE_REMAP)
-			if (!pod_remap_data(SPA_POD_TYPE_STRUCT, message, size, &client->types))
+			if (!remap_message(message, size, &client->types, client->n_types_identity))
 				goto invalid_message;
 
 		if (!demarshal[opcode].func(resource, message, size))
@@ -236,20 +257,51 @@ process_messages(struct client_data *data)
 	return;
 }
 
+static void update_client_io(struct client_data *c)
+{
+	enum spa_io mask = SPA_IO_ERR | SPA_IO_HUP;
+
+	if (!c->busy)
+		mask |= SPA_IO_IN;
+	if (c->need_out)
+		mask |= SPA_IO_OUT;
+
+	pw_loop_update_io(c->client->core->main_loop, c->source, mask);
+}
+
+/* a client that can't be flushed or doesn't read its messages is
+ * disconnected, the client is destroyed when this returns < 0 */
+static int flush_client(struct client_data *c)
+{
+	int res;
+	bool need_out;
+
+	res = pw_protocol_native_connection_flush(c->connection);
+	if (res < 0 && res != -EAGAIN) {
+		pw_log_error("protocol-native %p: client %p flush failed: %s",
+			     c->client->protocol, c->client, spa_strerror(res));
+		pw_client_destroy(c->client);
+		return res;
+	}
+
+	need_out = res == -EAGAIN;
+	if (need_out != c->need_out) {
+		c->need_out = need_out;
+		update_client_io(c);
+	}
+	return 0;
+}
+
 static void
 client_busy_changed(void *data, bool busy)
 {
 	struct client_data *c = data;
 	struct pw_client *client = c->client;
-	enum spa_io mask = SPA_IO_ERR | SPA_IO_HUP;
 
 	c->busy = busy;
 
-	if (!busy)
-		mask |= SPA_IO_IN;
-
 	pw_log_debug("protocol-native %p: busy changed %d", client->protocol, busy);
-	pw_loop_update_io(client->core->main_loop, c->source, mask);
+	update_client_io(c);
 
 	if (!busy)
 		process_messages(c);
@@ -268,6 +320,11 @@ connection_data(void *data, int fd, enum spa_io mask)
 		return;
 	}
 
+	if (mask & SPA_IO_OUT) {
+		if (flush_client(this) < 0)
+			return;
+	}
+
 	if (mask & SPA_IO_IN)
 		process_messages(this);
 }
@@ -326,6 +383,9 @@ static struct pw_client *client_new(struct server *s, int fd)
 	if (this->source == NULL)
 		goto no_source;
 
+	/* protocol messages can wait for the realtime sources */
+	this->source->priority = SPA_SOURCE_PRIORITY_LOW;
+
 	this->connection = pw_protocol_native_connection_new(fd);
 	if (this->connection == NULL)
 		goto no_connection;
@@ -528,6 +588,31 @@ static int impl_connect(struct pw_protocol_client *client)
 }
 
 
+static void flush_remote(struct client *impl)
+{
+	struct pw_remote *remote = impl->this.remote;
+	bool need_out;
+	int res;
+
+	if (impl->connection == NULL)
+		return;
+
+	res = pw_protocol_native_connection_flush(impl->connection);
+	if (res < 0 && res != -EAGAIN) {
+		impl->this.disconnect(&impl->this);
+		return;
+	}
+
+	/* wait until the socket is writable to send the rest */
+	need_out = res == -EAGAIN;
+	if (need_out != impl->need_out && impl->source) {
+		impl->need_out = need_out;
+		pw_loop_update_io(remote->core->main_loop, impl->source,
+				  SPA_IO_IN | SPA_IO_HUP | SPA_IO_ERR |
+				  (need_out ? SPA_IO_OUT : 0));
+	}
+}
+
 static void
 on_remote_data(void *data, int fd, enum spa_io mask)
 {
@@ -544,6 +629,12 @@ on_remote_data(void *data, int fd, enum spa_io mask)
 		return;
         }
 
+	if (mask & SPA_IO_OUT) {
+		flush_remote(impl);
+		if (impl->connection == NULL)
+			return;
+	}
+
         if (mask & SPA_IO_IN) {
                 uint8_t opcode;
                 uint32_t id;
@@ -580,7 +671,7 @@ on_remote_data(void *data, int fd, enum spa_io mask)
 			}
 
 			if (demarshal[opcode].flags & PW_PROTOCOL_NATIVE_REMAP) {
-				if (!pod_remap_data(SPA_POD_TYPE_STRUCT, message, size, &this->types)) {
+				if (!remap_message(message, size, &this->types, this->n_types_identity)) {
                                         pw_log_error
                                             ("protocol-native %p: invalid message received %u for %u", this,
                                              opcode, id);
@@ -601,9 +692,7 @@ static void do_flush_event(void *data, uint64_t count)
 {
         struct client *impl = data;
 	impl->flush_signaled = false;
-        if (impl->connection)
-                if (!pw_protocol_native_connection_flush(impl->connection))
-                        impl->this.disconnect(&impl->this);
+	flush_remote(impl);
 }
 
 static void on_need_flush(void *data)
@@ -636,6 +725,7 @@ static int impl_connect_fd(struct pw_protocol_client *client, int fd)
 						   &conn_events,
 						   impl);
 
+	impl->need_out = false;
         impl->source = pw_loop_add_io(remote->core->main_loop,
                                       fd,
                                       SPA_IO_IN | SPA_IO_HUP | SPA_IO_ERR,
@@ -739,7 +829,7 @@ static void on_before_hook(void *_data)
 
 	spa_list_for_each_safe(client, tmp, &this->client_list, protocol_link) {
 		data = client->user_data;
-		pw_protocol_native_connection_flush(data->connection);
+		flush_client(data);
 	}
 }
 
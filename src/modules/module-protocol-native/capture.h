@@ -0,0 +1,69 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __PIPEWIRE_PROTOCOL_NATIVE_CAPTURE_H__
+#define __PIPEWIRE_PROTOCOL_NATIVE_CAPTURE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** \cond
+ *
+ * Format of the files written when PIPEWIRE_PROTOCOL_CAPTURE is set.
+ *
+ * Every connection writes its messages to its own file, named after the
+ * value of PIPEWIRE_PROTOCOL_CAPTURE followed by the pid and a sequence
+ * number. The file starts with a header and then contains a record for
+ * each message that was sent or received, followed by the message pod,
+ * padded to 8 bytes.
+ *
+ * fds are not captured. The pods refer to the fds of their batch with an
+ * index, the record only keeps how many fds the batch had so that a replay
+ * can send placeholders instead.
+ */
+
+#define PW_PROTOCOL_NATIVE_CAPTURE_MAGIC	0x434e5750	/* "PWNC" */
+#define PW_PROTOCOL_NATIVE_CAPTURE_VERSION	0
+
+struct pw_protocol_native_capture_header {
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct pw_protocol_native_capture_record {
+	uint64_t time;		/**< CLOCK_MONOTONIC time in nanoseconds */
+	uint32_t dest_id;	/**< destination object id */
+	uint8_t opcode;		/**< method or event opcode */
+#define PW_PROTOCOL_NATIVE_CAPTURE_FLAG_OUT	(1 << 0)	/**< message was sent */
+	uint8_t flags;
+	uint16_t n_fds;		/**< number of fds in the batch of the message */
+	uint32_t size;		/**< size of the pod that follows */
+	uint32_t padding;
+};
+
+/** \endcond */
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __PIPEWIRE_PROTOCOL_NATIVE_CAPTURE_H__ */
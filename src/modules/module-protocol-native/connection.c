@@ -19,10 +19,13 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
 #include <sys/socket.h>
 
 #include <spa/lib/debug.h>
@@ -31,11 +34,17 @@
 #include <pipewire/private.h>
 
 #include "connection.h"
+#include "capture.h"
 
 #define MAX_BUFFER_SIZE (1024 * 32)
 #define MAX_FDS 28
+#define MAX_IOV 64
+#define MAX_FREE_SEGMENTS 4
+#define MAX_QUEUE_SIZE (8 * 1024 * 1024)	/**< max bytes waiting for a slow peer */
+#define MAX_QUEUE_FDS 256			/**< max fds waiting for a slow peer */
 
 static bool debug_messages = 0;
+static const char *capture_path = NULL;
 
 struct buffer {
 	uint8_t *buffer_data;
@@ -51,14 +60,35 @@ struct buffer {
 	bool update;
 };
 
+/* a flushed batch of messages that is waiting to be written to the
+ * socket. The fds of the batch are sent with its first byte. */
+struct segment {
+	struct spa_list link;
+	uint8_t *data;
+	size_t maxsize;
+	size_t size;
+	size_t offset;		/**< bytes already written */
+	int fds[MAX_FDS];
+	bool owned[MAX_FDS];	/**< fd is our own copy and is closed by us */
+	uint32_t n_fds;		/**< fds that still need to be sent */
+};
+
 struct impl {
 	struct pw_protocol_native_connection this;
 
 	struct buffer in, out;
 
+	struct spa_list queue;		/**< segments waiting to be written */
+	struct spa_list free;		/**< segments with data to reuse */
+	uint32_t n_free;
+	size_t queue_size;		/**< bytes in the queue */
+	uint32_t queue_fds;		/**< fds in the queue */
+
 	uint32_t dest_id;
 	uint8_t opcode;
 	struct spa_pod_builder builder;
+
+	FILE *capture;
 };
 
 /** \endcond */
@@ -84,7 +114,7 @@ int pw_protocol_native_connection_get_fd(struct pw_protocol_native_connection *c
 /** Add an fd to a connection
  *
  * \param conn the connection
- * \param fd the fd to add
+ * \param fd the fd to add, the fd is not closed by the connection
  * \return the index of the fd or -1 when an error occured
  *
  * \memberof pw_protocol_native_connection
@@ -94,6 +124,11 @@ uint32_t pw_protocol_native_connection_add_fd(struct pw_protocol_native_connecti
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 	uint32_t index, i;
 
+	if (fd < 0) {
+		pw_log_error("connection %p: invalid fd %d", conn, fd);
+		return -1;
+	}
+
 	for (i = 0; i < impl->out.n_fds; i++) {
 		if (impl->out.fds[i] == fd)
 			return i;
@@ -148,8 +183,9 @@ static bool refill_buffer(struct pw_protocol_native_connection *conn, struct buf
 		if (len < 0) {
 			if (errno == EINTR)
 				continue;
-			if (errno != EAGAIN || errno != EWOULDBLOCK)
-				goto recv_error;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return false;
+			goto recv_error;
 		}
 		break;
 	}
@@ -184,6 +220,172 @@ static void clear_buffer(struct buffer *buf)
 	buf->buffer_size = 0;
 }
 
+static void segment_release_fds(struct impl *impl, struct segment *seg)
+{
+	uint32_t i;
+
+	for (i = 0; i < seg->n_fds; i++) {
+		if (seg->owned[i])
+			close(seg->fds[i]);
+		seg->owned[i] = false;
+	}
+	impl->queue_fds -= seg->n_fds;
+	seg->n_fds = 0;
+}
+
+static void segment_free(struct segment *seg)
+{
+	free(seg->data);
+	free(seg);
+}
+
+static void recycle_segment(struct impl *impl, struct segment *seg)
+{
+	spa_list_remove(&seg->link);
+	segment_release_fds(impl, seg);
+	impl->queue_size -= seg->size;
+
+	if (impl->n_free >= MAX_FREE_SEGMENTS) {
+		segment_free(seg);
+		return;
+	}
+	spa_list_append(&impl->free, &seg->link);
+	impl->n_free++;
+}
+
+static void clear_queue(struct impl *impl)
+{
+	struct segment *seg, *t;
+
+	spa_list_for_each_safe(seg, t, &impl->queue, link)
+		recycle_segment(impl, seg);
+}
+
+/* move the messages of the out buffer to the end of the queue, the data is
+ * swapped with a free segment so that nothing is copied */
+static int queue_out_buffer(struct impl *impl)
+{
+	struct buffer *buf = &impl->out;
+	struct segment *seg;
+	uint8_t *data;
+	size_t maxsize;
+
+	if (!spa_list_is_empty(&impl->free)) {
+		seg = spa_list_first(&impl->free, struct segment, link);
+		spa_list_remove(&seg->link);
+		impl->n_free--;
+		data = seg->data;
+		maxsize = seg->maxsize;
+	} else {
+		if ((seg = calloc(1, sizeof(struct segment))) == NULL)
+			return -ENOMEM;
+		maxsize = MAX_BUFFER_SIZE;
+		if ((data = malloc(maxsize)) == NULL) {
+			free(seg);
+			return -ENOMEM;
+		}
+	}
+	seg->data = buf->buffer_data;
+	seg->maxsize = buf->buffer_maxsize;
+	seg->size = buf->buffer_size;
+	seg->offset = 0;
+	memcpy(seg->fds, buf->fds, buf->n_fds * sizeof(int));
+	memset(seg->owned, 0, buf->n_fds * sizeof(bool));
+	seg->n_fds = buf->n_fds;
+	spa_list_append(&impl->queue, &seg->link);
+	impl->queue_size += seg->size;
+	impl->queue_fds += seg->n_fds;
+
+	buf->buffer_data = data;
+	buf->buffer_maxsize = maxsize;
+	buf->buffer_size = 0;
+	buf->n_fds = 0;
+
+	return 0;
+}
+
+/* the caller can close its fds when the flush returns, keep our own
+ * copies of the fds that are not sent yet. When an fd can't be copied,
+ * the messages that refer to it can't be sent anymore. */
+static int dup_queue_fds(struct pw_protocol_native_connection *conn)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct segment *seg;
+	uint32_t i, j;
+	int fd, res;
+
+	spa_list_for_each(seg, &impl->queue, link) {
+		for (i = 0; i < seg->n_fds; i++) {
+			if (seg->owned[i])
+				continue;
+
+			if ((fd = fcntl(seg->fds[i], F_DUPFD_CLOEXEC, 0)) < 0) {
+				res = -errno;
+				pw_log_error("connection %p: can't dup fd %d: %m", conn, seg->fds[i]);
+				/* drop the fds from here on and close the copies among them */
+				for (j = i; j < seg->n_fds; j++) {
+					if (seg->owned[j])
+						close(seg->fds[j]);
+					seg->owned[j] = false;
+				}
+				impl->queue_fds -= seg->n_fds - i;
+				seg->n_fds = i;
+				return res;
+			}
+			seg->fds[i] = fd;
+			seg->owned[i] = true;
+		}
+	}
+	return 0;
+}
+
+static void capture_open(struct impl *impl)
+{
+	struct pw_protocol_native_capture_header header = {
+		PW_PROTOCOL_NATIVE_CAPTURE_MAGIC, PW_PROTOCOL_NATIVE_CAPTURE_VERSION };
+	char path[PATH_MAX];
+	int i, fd = -1;
+
+	/* one file per connection, don't overwrite older captures */
+	for (i = 0; i < 1024 && fd < 0; i++) {
+		snprintf(path, sizeof(path), "%s.%d.%d", capture_path, getpid(), i);
+		fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (fd < 0 && errno != EEXIST)
+			break;
+	}
+	if (fd < 0 || (impl->capture = fdopen(fd, "w")) == NULL) {
+		pw_log_error("connection %p: can't create capture file: %m", &impl->this);
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	pw_log_info("connection %p: capturing messages to %s", &impl->this, path);
+
+	fwrite(&header, sizeof(header), 1, impl->capture);
+}
+
+static void capture_message(struct impl *impl, uint8_t flags, uint32_t dest_id,
+			    uint8_t opcode, const void *data, uint32_t size, uint32_t n_fds)
+{
+	static const uint8_t padding[8] = { 0, };
+	struct pw_protocol_native_capture_record rec;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	rec.time = SPA_TIMESPEC_TO_TIME(&ts);
+	rec.dest_id = dest_id;
+	rec.opcode = opcode;
+	rec.flags = flags;
+	rec.n_fds = n_fds;
+	rec.size = size;
+	rec.padding = 0;
+
+	fwrite(&rec, sizeof(rec), 1, impl->capture);
+	fwrite(data, size, 1, impl->capture);
+	fwrite(padding, SPA_ROUND_UP_N(size, 8) - size, 1, impl->capture);
+}
+
 /** Make a new connection object for the given socket
  *
  * \param fd the socket
@@ -201,6 +403,7 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(int fd)
 		return NULL;
 
 	debug_messages = pw_debug_is_category_enabled("connection");
+	capture_path = getenv("PIPEWIRE_PROTOCOL_CAPTURE");
 
 	this = &impl->this;
 
@@ -214,10 +417,15 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(int fd)
 	impl->in.buffer_data = malloc(MAX_BUFFER_SIZE);
 	impl->in.buffer_maxsize = MAX_BUFFER_SIZE;
 	impl->in.update = true;
+	spa_list_init(&impl->queue);
+	spa_list_init(&impl->free);
 
 	if (impl->out.buffer_data == NULL || impl->in.buffer_data == NULL)
 		goto no_mem;
 
+	if (capture_path)
+		capture_open(impl);
+
 	return this;
 
       no_mem:
@@ -236,11 +444,19 @@ struct pw_protocol_native_connection *pw_protocol_native_connection_new(int fd)
 void pw_protocol_native_connection_destroy(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+	struct segment *seg, *t;
 
 	pw_log_debug("connection %p: destroy", conn);
 
 	spa_hook_list_call(&conn->listener_list, struct pw_protocol_native_connection_events, destroy);
 
+	clear_queue(impl);
+	spa_list_for_each_safe(seg, t, &impl->free, link)
+		segment_free(seg);
+
+	if (impl->capture)
+		fclose(impl->capture);
+
 	free(impl->out.buffer_data);
 	free(impl->in.buffer_data);
 	free(impl);
@@ -277,6 +493,7 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 
 	/* move to next packet */
 	buf->offset += buf->size;
+	buf->size = 0;
 
       again:
 	if (buf->update) {
@@ -329,6 +546,8 @@ pw_protocol_native_connection_get_next(struct pw_protocol_native_connection *con
 		printf("<<<<<<<<< in: %d %d %zd\n", *dest_id, *opcode, len);
 	        spa_debug_pod((struct spa_pod *)data, 0);
 	}
+	if (impl->capture)
+		capture_message(impl, 0, *dest_id, *opcode, data, len, buf->n_fds);
 
 	return true;
 }
@@ -359,12 +578,37 @@ static uint32_t write_pod(struct spa_pod_builder *b, const void *data, uint32_t
         return ref;
 }
 
+/** Start a new message
+ *
+ * \param conn the connection
+ * \param dest_id the id of the destination object
+ * \param opcode the opcode of the message
+ * \return a builder for the message payload, finish the message with
+ *	pw_protocol_native_connection_end()
+ *
+ * No types are sent to the peer, use this only for messages that don't
+ * contain new type ids.
+ *
+ * \memberof pw_protocol_native_connection
+ */
+struct spa_pod_builder *
+pw_protocol_native_connection_begin(struct pw_protocol_native_connection *conn,
+				    uint32_t dest_id, uint8_t opcode)
+{
+	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
+
+	impl->dest_id = dest_id;
+	impl->opcode = opcode;
+	impl->builder = (struct spa_pod_builder) { NULL, 0, write_pod };
+
+	return &impl->builder;
+}
+
 struct spa_pod_builder *
 pw_protocol_native_connection_begin_resource(struct pw_protocol_native_connection *conn,
 					     struct pw_resource *resource,
 					     uint8_t opcode)
 {
-	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
         uint32_t diff, base, i, b;
         struct pw_client *client = resource->client;
         struct pw_core *core = client->core;
@@ -381,11 +625,7 @@ pw_protocol_native_connection_begin_resource(struct pw_protocol_native_connectio
 		pw_core_resource_update_types(client->core_resource, base, diff, types);
 	}
 
-	impl->dest_id = resource->id;
-	impl->opcode = opcode;
-	impl->builder = (struct spa_pod_builder) { NULL, 0, write_pod };
-
-	return &impl->builder;
+	return pw_protocol_native_connection_begin(conn, resource->id, opcode);
 }
 
 struct spa_pod_builder *
@@ -393,7 +633,6 @@ pw_protocol_native_connection_begin_proxy(struct pw_protocol_native_connection *
 					  struct pw_proxy *proxy,
 					  uint8_t opcode)
 {
-	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
         uint32_t diff, base, i, b;
         const char **types;
         struct pw_remote *remote = proxy->remote;
@@ -410,11 +649,7 @@ pw_protocol_native_connection_begin_proxy(struct pw_protocol_native_connection *
 	        pw_core_proxy_update_types(remote->core_proxy, base, diff, types);
 	}
 
-	impl->dest_id = proxy->id;
-	impl->opcode = opcode;
-	impl->builder = (struct spa_pod_builder) { NULL, 0, write_pod };
-
-	return &impl->builder;
+	return pw_protocol_native_connection_begin(conn, proxy->id, opcode);
 }
 
 void
@@ -437,79 +672,118 @@ pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
 		printf(">>>>>>>>> out: %d %d %d\n", impl->dest_id, impl->opcode, size);
 	        spa_debug_pod((struct spa_pod *)p, 0);
 	}
+	if (impl->capture)
+		capture_message(impl, PW_PROTOCOL_NATIVE_CAPTURE_FLAG_OUT,
+				impl->dest_id, impl->opcode, p, size, buf->n_fds);
 	spa_hook_list_call(&conn->listener_list, struct pw_protocol_native_connection_events, need_flush);
 }
 
 /** Flush the connection object
  *
  * \param conn the connection object
- * \return true on success
+ * \return 0 when all messages are written, -EAGAIN when the socket is full
+ *	and messages are still queued, -ENOBUFS when the peer does not read
+ *	and too much data or fds are queued, a negative errno on error
  *
- * Write the queued messages on the connection to the socket
+ * Write the queued messages on the connection to the socket. When -EAGAIN
+ * is returned, the caller should wait for SPA_IO_OUT on the socket and
+ * flush again.
  *
  * \memberof pw_protocol_native_connection
  */
-bool pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn)
+int pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn)
 {
 	struct impl *impl = SPA_CONTAINER_OF(conn, struct impl, this);
 	ssize_t len;
 	struct msghdr msg = { 0 };
-	struct iovec iov[1];
+	struct iovec iov[MAX_IOV];
 	struct cmsghdr *cmsg;
 	char cmsgbuf[CMSG_SPACE(MAX_FDS * sizeof(int))];
-	int *cm, i, fds_len;
-	struct buffer *buf;
-
-	buf = &impl->out;
-
-	if (buf->buffer_size == 0)
-		return true;
-
-	fds_len = buf->n_fds * sizeof(int);
-
-	iov[0].iov_base = buf->buffer_data;
-	iov[0].iov_len = buf->buffer_size;
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 1;
+	int *cm, fds_len, n_iov, res;
+	struct segment *first, *seg, *t;
+	size_t size;
 
-	if (buf->n_fds > 0) {
-		msg.msg_control = cmsgbuf;
-		msg.msg_controllen = CMSG_SPACE(fds_len);
-		cmsg = CMSG_FIRSTHDR(&msg);
-		cmsg->cmsg_level = SOL_SOCKET;
-		cmsg->cmsg_type = SCM_RIGHTS;
-		cmsg->cmsg_len = CMSG_LEN(fds_len);
-		cm = (int *) CMSG_DATA(cmsg);
-		for (i = 0; i < buf->n_fds; i++)
-			cm[i] = buf->fds[i] > 0 ? buf->fds[i] : -buf->fds[i];
-		msg.msg_controllen = cmsg->cmsg_len;
-	} else {
-		msg.msg_control = NULL;
-		msg.msg_controllen = 0;
+	if (impl->out.buffer_size > 0) {
+		if ((res = queue_out_buffer(impl)) < 0)
+			return res;
+	}
+	if (impl->queue_size > MAX_QUEUE_SIZE || impl->queue_fds > MAX_QUEUE_FDS) {
+		pw_log_error("connection %p: %d peer is not reading, %zd bytes and %u fds queued",
+			     conn, conn->fd, impl->queue_size, impl->queue_fds);
+		return -ENOBUFS;
 	}
 
-	while (true) {
-		len = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
-		if (len < 0) {
-			if (errno == EINTR)
-				continue;
-			else
+	while (!spa_list_is_empty(&impl->queue)) {
+		first = spa_list_first(&impl->queue, struct segment, link);
+
+		/* gather segments until the next one that has fds to send */
+		n_iov = 0;
+		spa_list_for_each(seg, &impl->queue, link) {
+			if (n_iov == MAX_IOV || (seg != first && seg->n_fds > 0))
+				break;
+			iov[n_iov].iov_base = seg->data + seg->offset;
+			iov[n_iov].iov_len = seg->size - seg->offset;
+			n_iov++;
+		}
+		msg.msg_iov = iov;
+		msg.msg_iovlen = n_iov;
+
+		if (first->n_fds > 0) {
+			fds_len = first->n_fds * sizeof(int);
+			msg.msg_control = cmsgbuf;
+			msg.msg_controllen = CMSG_SPACE(fds_len);
+			cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(fds_len);
+			cm = (int *) CMSG_DATA(cmsg);
+			memcpy(cm, first->fds, fds_len);
+			msg.msg_controllen = cmsg->cmsg_len;
+		} else {
+			msg.msg_control = NULL;
+			msg.msg_controllen = 0;
+		}
+
+		while (true) {
+			len = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (len < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					goto again;
 				goto send_error;
+			}
+			break;
+		}
+		pw_log_trace("connection %p: %d written %zd bytes and %u fds", conn, conn->fd, len,
+			     first->n_fds);
+
+		/* the fds went out with the first byte */
+		segment_release_fds(impl, first);
+
+		spa_list_for_each_safe(seg, t, &impl->queue, link) {
+			if (len == 0)
+				break;
+			size = SPA_MIN((size_t) len, seg->size - seg->offset);
+			seg->offset += size;
+			len -= size;
+			if (seg->offset == seg->size)
+				recycle_segment(impl, seg);
 		}
-		break;
 	}
-	pw_log_trace("connection %p: %d written %zd bytes and %u fds", conn, conn->fd, len,
-		     buf->n_fds);
-
-	buf->buffer_size -= len;
-	buf->n_fds = 0;
+	return 0;
 
-	return true;
+      again:
+	pw_log_trace("connection %p: %d socket full, keep messages queued", conn, conn->fd);
+	if ((res = dup_queue_fds(conn)) < 0)
+		return res;
+	return -EAGAIN;
 
 	/* ERRORS */
       send_error:
+	res = -errno;
 	pw_log_error("could not sendmsg: %s", strerror(errno));
-	return false;
+	return res;
 }
 
 /** Clear the connection object
@@ -528,6 +802,7 @@ bool pw_protocol_native_connection_clear(struct pw_protocol_native_connection *c
 	clear_buffer(&impl->out);
 	clear_buffer(&impl->in);
 	impl->in.update = true;
+	clear_queue(impl);
 
 	return true;
 }
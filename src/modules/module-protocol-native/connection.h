@@ -74,6 +74,10 @@ uint32_t pw_protocol_native_connection_add_fd(struct pw_protocol_native_connecti
 
 int pw_protocol_native_connection_get_fd(struct pw_protocol_native_connection *conn, uint32_t index);
 
+struct spa_pod_builder *
+pw_protocol_native_connection_begin(struct pw_protocol_native_connection *conn,
+				    uint32_t dest_id, uint8_t opcode);
+
 struct spa_pod_builder *
 pw_protocol_native_connection_begin_resource(struct pw_protocol_native_connection *conn,
                                              struct pw_resource *resource,
@@ -87,7 +91,7 @@ void
 pw_protocol_native_connection_end(struct pw_protocol_native_connection *conn,
                                   struct spa_pod_builder *builder);
 
-bool
+int
 pw_protocol_native_connection_flush(struct pw_protocol_native_connection *conn);
 
 bool
@@ -0,0 +1,252 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+#include "connection.h"
+
+/* Saturates a socketpair with messages of varying size and checks that all
+ * of them arrive intact and in order, while the sender keeps queueing
+ * messages when the socket is full. Then checks that a peer that stops
+ * reading makes the flush fail instead of queueing without limit. */
+
+#define N_MESSAGES	20000
+#define MAX_PAYLOAD	4000
+
+static size_t type_map_get_size(const struct spa_type_map *map)
+{
+	return 0;
+}
+
+static struct spa_type_map type_map = {
+	SPA_VERSION_TYPE_MAP,
+	.get_size = type_map_get_size,
+};
+
+static struct pw_core core;
+static struct pw_client client;
+static struct pw_resource resource;
+
+static uint32_t payload_size(uint32_t seq)
+{
+	return (seq * 2654435761u) % MAX_PAYLOAD + 1;
+}
+
+static void fill_payload(uint8_t *data, uint32_t seq, uint32_t size)
+{
+	uint32_t i;
+	for (i = 0; i < size; i++)
+		data[i] = (seq + i * 7) & 0xff;
+}
+
+static void send_message(struct pw_protocol_native_connection *conn, uint32_t seq, int fd)
+{
+	static uint8_t data[MAX_PAYLOAD];
+	struct spa_pod_builder *b;
+	uint32_t size = payload_size(seq);
+
+	fill_payload(data, seq, size);
+
+	b = pw_protocol_native_connection_begin_resource(conn, &resource, seq & 0x7f);
+	spa_pod_builder_add(b,
+			    "[",
+			    "i", seq,
+			    "z", data, size,
+			    "i", fd == -1 ? -1 : pw_protocol_native_connection_add_fd(conn, fd),
+			    "]", NULL);
+	pw_protocol_native_connection_end(conn, b);
+}
+
+static uint32_t receive_messages(struct pw_protocol_native_connection *conn, uint32_t *next,
+				 uint32_t *n_fds)
+{
+	static uint8_t expected[MAX_PAYLOAD];
+	struct spa_pod_parser prs;
+	uint8_t opcode;
+	uint32_t id, size, count = 0;
+	void *message, *data;
+	uint32_t data_size;
+	int32_t seq, index;
+
+	while (pw_protocol_native_connection_get_next(conn, &opcode, &id, &message, &size)) {
+		spa_pod_parser_init(&prs, message, size, 0);
+		if (spa_pod_parser_get(&prs,
+				"["
+				"i", &seq,
+				"z", &data, &data_size,
+				"i", &index, NULL) < 0) {
+			fprintf(stderr, "message %u: parse error\n", *next);
+			exit(1);
+		}
+		if (seq != *next || opcode != (seq & 0x7f) || id != resource.id) {
+			fprintf(stderr, "message %u: got seq %d opcode %u id %u\n",
+				*next, seq, opcode, id);
+			exit(1);
+		}
+		fill_payload(expected, seq, payload_size(seq));
+		if (data_size != payload_size(seq) || memcmp(data, expected, data_size) != 0) {
+			fprintf(stderr, "message %u: corrupt payload\n", *next);
+			exit(1);
+		}
+		if (index != -1) {
+			struct stat st;
+			int fd = pw_protocol_native_connection_get_fd(conn, index);
+
+			if (fd < 0 || fstat(fd, &st) < 0) {
+				fprintf(stderr, "message %u: fd %d not received\n", *next, index);
+				exit(1);
+			}
+			close(fd);
+			(*n_fds)++;
+		}
+		(*next)++;
+		count++;
+	}
+	return count;
+}
+
+static int test_stalled_reader(void)
+{
+	struct pw_protocol_native_connection *out;
+	uint32_t seq;
+	int fds[2], res = 0;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0) {
+		perror("socketpair");
+		return -1;
+	}
+	out = pw_protocol_native_connection_new(fds[0]);
+
+	/* nobody reads fds[1], every message has an fd */
+	for (seq = 0; seq < N_MESSAGES; seq++) {
+		int fd = eventfd(0, EFD_CLOEXEC);
+
+		send_message(out, seq, fd);
+		res = pw_protocol_native_connection_flush(out);
+		close(fd);
+
+		if (res < 0 && res != -EAGAIN)
+			break;
+	}
+	printf("stalled reader: flush failed after %u messages: %s\n", seq, strerror(-res));
+
+	pw_protocol_native_connection_destroy(out);
+	close(fds[0]);
+	close(fds[1]);
+
+	return res == -ENOBUFS ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_protocol_native_connection *out, *in;
+	uint32_t seq, next = 0, n_eagain = 0, n_fds = 0, n_sent_fds = 0;
+	int fds[2], size = 4096, res;
+
+	core.type.map = &type_map;
+	client.core = &core;
+	resource.client = &client;
+	resource.core = &core;
+	resource.id = 5;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+	/* a small socket buffer makes the sender hit EAGAIN all the time */
+	setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	out = pw_protocol_native_connection_new(fds[0]);
+	in = pw_protocol_native_connection_new(fds[1]);
+
+	for (seq = 0; seq < N_MESSAGES; seq++) {
+		int fd = -1;
+
+		/* send an fd now and then, the sender closes it right away */
+		if (seq % 997 == 0) {
+			fd = eventfd(0, EFD_CLOEXEC);
+			n_sent_fds++;
+		}
+		send_message(out, seq, fd);
+
+		if (seq % 8 == 7 || fd != -1) {
+			res = pw_protocol_native_connection_flush(out);
+			if (res == -EAGAIN)
+				n_eagain++;
+			else if (res < 0) {
+				fprintf(stderr, "flush error: %s\n", strerror(-res));
+				return 1;
+			}
+		}
+		if (fd != -1)
+			close(fd);
+
+		/* the reader is slower than the writer */
+		if (seq % 32 == 31)
+			receive_messages(in, &next, &n_fds);
+
+		/* but catches up now and then, the queue is limited */
+		if (seq % 1024 == 1023) {
+			while (pw_protocol_native_connection_flush(out) == -EAGAIN)
+				receive_messages(in, &next, &n_fds);
+		}
+	}
+
+	while ((res = pw_protocol_native_connection_flush(out)) == -EAGAIN) {
+		n_eagain++;
+		receive_messages(in, &next, &n_fds);
+	}
+	if (res < 0) {
+		fprintf(stderr, "flush error: %s\n", strerror(-res));
+		return 1;
+	}
+	while (next < N_MESSAGES) {
+		if (receive_messages(in, &next, &n_fds) == 0)
+			break;
+	}
+
+	printf("received %u of %u messages and %u of %u fds, %u flushes hit EAGAIN\n",
+	       next, N_MESSAGES, n_fds, n_sent_fds, n_eagain);
+
+	pw_protocol_native_connection_destroy(out);
+	pw_protocol_native_connection_destroy(in);
+	close(fds[0]);
+	close(fds[1]);
+
+	if (next != N_MESSAGES || n_fds != n_sent_fds || n_eagain == 0)
+		return 1;
+
+	if (test_stalled_reader() < 0)
+		return 1;
+
+	return 0;
+}
@@ -130,6 +130,7 @@ struct pw_client *pw_client_new(struct pw_core *core,
 
 	pw_map_init(&this->objects, 0, 32);
 	pw_map_init(&this->types, 0, 32);
+	pw_array_init(&this->permission_cache, 1024);
 
 	this->info.props = this->properties ? &this->properties->dict : NULL;
 
@@ -222,6 +223,7 @@ void pw_client_destroy(struct pw_client *client)
 
 	pw_map_clear(&client->objects);
 	pw_map_clear(&client->types);
+	pw_array_clear(&client->permission_cache);
 
 	if (client->properties)
 		pw_properties_free(client->properties);
@@ -271,6 +273,9 @@ void pw_client_update_properties(struct pw_client *client, const struct spa_dict
 	client->info.change_mask |= PW_CLIENT_CHANGE_MASK_PROPS;
 	client->info.props = client->properties ? &client->properties->dict : NULL;
 
+	/* the permissions can depend on the properties */
+	client->permission_cache.size = 0;
+
 	spa_hook_list_call(&client->listener_list, struct pw_client_events, info_changed, &client->info);
 
 	spa_list_for_each(resource, &client->resource_list, link)
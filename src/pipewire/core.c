@@ -20,6 +20,10 @@
 #include <unistd.h>
 #include <time.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#include <spa/pod/parser.h>
+#include <spa/param/format.h>
 
 #define spa_debug pw_log_trace
 
@@ -32,13 +36,112 @@
 #include <pipewire/core.h>
 #include <pipewire/data-loop.h>
 
-#include <spa/graph/graph-scheduler6.h>
+#include <spa/graph/graph-scheduler7.h>
+
+#define DEFAULT_BUFFER_POOL_SIZE	(16 * 1024 * 1024)
+#define DEFAULT_BUFFER_ARENA_SIZE	(1024 * 1024)
+#define DEFAULT_MLOCK_LIMIT		(16 * 1024 * 1024)
+#define FREEWHEEL_IDLE_TIMEOUT		(100 * SPA_NSEC_PER_MSEC)
 
 /** \cond */
+struct impl {
+	struct pw_core this;
+
+	struct spa_graph_data graph_data;
+
+	struct spa_source *freewheel_source;
+	struct spa_source *freewheel_idle;
+	bool freewheel;
+};
+
 struct resource_data {
 	struct spa_hook resource_listener;
 };
 
+/* parse a decimal property value between 0 and max, the complete value
+ * must be a number */
+static int parse_uint_prop(const char *str, unsigned long long max, unsigned long long *val)
+{
+	char *end;
+	unsigned long long v;
+
+	while (*str == ' ' || *str == '\t')
+		str++;
+	if (*str < '0' || *str > '9')
+		return -EINVAL;
+
+	errno = 0;
+	v = strtoull(str, &end, 10);
+	if (errno != 0 || *end != '\0' || v > max)
+		return -ERANGE;
+
+	*val = v;
+	return 0;
+}
+
+static void graph_workers_wakeup(void *data, uint32_t n_workers)
+{
+	struct pw_core *this = data;
+	pw_data_loop_wakeup_workers(this->data_loop_impl, n_workers);
+}
+
+static const struct spa_graph_workers graph_workers = {
+	SPA_VERSION_GRAPH_WORKERS,
+	.wakeup = graph_workers_wakeup,
+};
+
+static void do_graph_work(void *data)
+{
+	struct impl *impl = data;
+	spa_graph_plan_work(&impl->graph_data);
+}
+
+static void do_freewheel(void *data, uint64_t count)
+{
+	struct impl *impl = data;
+	struct timespec value = { 0, FREEWHEEL_IDLE_TIMEOUT };
+	int res;
+
+	if (!impl->graph_data.freewheel)
+		return;
+
+	res = spa_graph_plan_freewheel(&impl->graph_data);
+	if (res == 0) {
+		/* nothing to run, look again later instead of spinning */
+		pw_loop_update_timer(impl->this.data_loop, impl->freewheel_idle,
+				     &value, NULL, false);
+		return;
+	}
+	if (res < 0 && res != -EBUSY)
+		pw_log_warn("core %p: freewheel cycle failed: %s", impl, spa_strerror(res));
+
+	/* schedule the next cycle, other sources on the data loop are
+	 * dispatched in between */
+	pw_loop_signal_event(impl->this.data_loop, impl->freewheel_source);
+}
+
+static int
+do_set_freewheel(struct spa_loop *loop,
+		 bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct impl *impl = user_data;
+	int res;
+
+	spa_graph_data_set_freewheel(&impl->graph_data, impl->freewheel);
+
+	/* the cycles run back-to-back, don't let them keep a core at
+	 * realtime priority */
+	if ((res = pw_data_loop_set_realtime(impl->this.data_loop_impl, !impl->freewheel)) < 0)
+		pw_log_warn("core %p: can't change scheduling: %s", impl, spa_strerror(res));
+
+	if (impl->freewheel)
+		pw_loop_signal_event(impl->this.data_loop, impl->freewheel_source);
+	else
+		pw_loop_update_timer(impl->this.data_loop, impl->freewheel_idle,
+				     NULL, NULL, false);
+	return 0;
+}
+
 /** \endcond */
 
 static void registry_bind(void *object, uint32_t id,
@@ -319,8 +422,14 @@ static void core_update_types(void *object, uint32_t first_id, uint32_t n_types,
 
 	for (i = 0; i < n_types; i++, first_id++) {
 		uint32_t this_id = spa_type_map_get_id(this->type.map, types[i]);
-		if (!pw_map_insert_at(&client->types, first_id, PW_MAP_ID_TO_PTR(this_id)))
+		if (!pw_map_insert_at(&client->types, first_id, PW_MAP_ID_TO_PTR(this_id))) {
 			pw_log_error("can't add type for client");
+			continue;
+		}
+		if (this_id == first_id && first_id == client->n_types_identity)
+			client->n_types_identity++;
+		else if (this_id != first_id && first_id < client->n_types_identity)
+			client->n_types_identity = first_id;
 	}
 }
 
@@ -393,13 +502,17 @@ core_bind_func(struct pw_global *global,
  */
 struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *properties)
 {
+	struct impl *impl;
 	struct pw_core *this;
-	const char *name;
+	const char *name, *str;
+	unsigned long long arena_size, pool_size;
 
-	this = calloc(1, sizeof(struct pw_core));
-	if (this == NULL)
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
 		return NULL;
 
+	this = &impl->this;
+
 	if (properties == NULL)
 		properties = pw_properties_new(NULL, NULL);
 	if (properties == NULL)
@@ -418,7 +531,66 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	pw_map_init(&this->globals, 128, 32);
 
 	spa_graph_init(&this->rt.graph);
-	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, NULL);
+	spa_graph_data_init(&impl->graph_data, &this->rt.graph);
+	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, &impl->graph_data);
+
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_DATA_WORKERS)) != NULL) {
+		unsigned long long n_workers;
+		int res;
+
+		if (parse_uint_prop(str, PW_DATA_LOOP_MAX_WORKERS, &n_workers) < 0) {
+			pw_log_warn("core %p: invalid %s \"%s\", expected 0 to %d", this,
+				    PW_CORE_PROP_DATA_WORKERS, str, PW_DATA_LOOP_MAX_WORKERS);
+			res = 0;
+		} else
+			res = pw_data_loop_start_workers(this->data_loop_impl,
+							 n_workers, do_graph_work, impl);
+		if (res > 0)
+			spa_graph_data_set_workers(&impl->graph_data, &graph_workers, this, res);
+		else if (res < 0)
+			pw_log_warn("core %p: can't start data workers: %s", this, spa_strerror(res));
+	}
+	impl->freewheel_source = pw_loop_add_event(this->data_loop, do_freewheel, impl);
+	impl->freewheel_idle = pw_loop_add_timer(this->data_loop, do_freewheel, impl);
+
+	/* an arena size of 0 disables the arena */
+	arena_size = DEFAULT_BUFFER_ARENA_SIZE;
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_BUFFER_ARENA_SIZE)) != NULL &&
+	    parse_uint_prop(str, SIZE_MAX, &arena_size) < 0) {
+		pw_log_warn("core %p: invalid %s \"%s\", using %d", this,
+			    PW_CORE_PROP_BUFFER_ARENA_SIZE, str, DEFAULT_BUFFER_ARENA_SIZE);
+		arena_size = DEFAULT_BUFFER_ARENA_SIZE;
+	}
+	if (arena_size > 0) {
+		this->buffer_arena = pw_memblock_arena_new(arena_size);
+		if (this->buffer_arena == NULL)
+			goto no_arena;
+	}
+
+	pool_size = DEFAULT_BUFFER_POOL_SIZE;
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_BUFFER_POOL_SIZE)) != NULL &&
+	    parse_uint_prop(str, SIZE_MAX, &pool_size) < 0) {
+		pw_log_warn("core %p: invalid %s \"%s\", using %d", this,
+			    PW_CORE_PROP_BUFFER_POOL_SIZE, str, DEFAULT_BUFFER_POOL_SIZE);
+		pool_size = DEFAULT_BUFFER_POOL_SIZE;
+	}
+	this->buffer_pool = pw_memblock_pool_new(this->buffer_arena, pool_size);
+	if (this->buffer_pool == NULL)
+		goto no_pool;
+
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_MLOCK)) != NULL)
+		this->mlock = pw_properties_parse_bool(str);
+	this->mlock_limit = DEFAULT_MLOCK_LIMIT;
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_MLOCK_LIMIT)) != NULL) {
+		unsigned long long limit;
+
+		if (parse_uint_prop(str, SIZE_MAX, &limit) < 0) {
+			pw_log_warn("core %p: invalid %s \"%s\", using %d", this,
+				    PW_CORE_PROP_MLOCK_LIMIT, str, DEFAULT_MLOCK_LIMIT);
+		} else
+			this->mlock_limit = limit;
+	}
+	pw_memblock_pool_set_lock_limit(this->buffer_pool, this->mlock_limit);
 
 	spa_debug_set_type_map(this->type.map);
 
@@ -467,11 +639,23 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 					  this);
 	this->info.id = this->global->id;
 
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_FREEWHEEL)) != NULL &&
+	    pw_properties_parse_bool(str))
+		pw_core_set_freewheel(this, true);
+
 	return this;
 
+      no_pool:
+	if (this->buffer_arena)
+		pw_memblock_arena_destroy(this->buffer_arena);
+      no_arena:
+	pw_loop_destroy_source(this->data_loop, impl->freewheel_idle);
+	pw_loop_destroy_source(this->data_loop, impl->freewheel_source);
+	pw_data_loop_destroy(this->data_loop_impl);
+	spa_graph_data_clear(&impl->graph_data);
       no_mem:
       no_data_loop:
-	free(this);
+	free(impl);
 	return NULL;
 }
 
@@ -483,6 +667,7 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
  */
 void pw_core_destroy(struct pw_core *core)
 {
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
 	struct pw_global *global, *t;
 	struct pw_module *module, *tm;
 	struct pw_remote *remote, *tr;
@@ -505,14 +690,22 @@ void pw_core_destroy(struct pw_core *core)
 
 	spa_hook_list_call(&core->listener_list, struct pw_core_events, free);
 
+	pw_loop_destroy_source(core->data_loop, impl->freewheel_idle);
+	pw_loop_destroy_source(core->data_loop, impl->freewheel_source);
 	pw_data_loop_destroy(core->data_loop_impl);
 
+	pw_memblock_pool_destroy(core->buffer_pool);
+	if (core->buffer_arena)
+		pw_memblock_arena_destroy(core->buffer_arena);
+
 	pw_properties_free(core->properties);
 
 	pw_map_clear(&core->globals);
 
+	spa_graph_data_clear(&impl->graph_data);
+
 	pw_log_debug("core %p: free", core);
-	free(core);
+	free(impl);
 }
 
 const struct pw_core_info *pw_core_get_info(struct pw_core *core)
@@ -539,6 +732,25 @@ void pw_core_set_permission_callback(struct pw_core *core,
 {
 	core->permission_func = callback;
 	core->permission_data = data;
+	pw_core_invalidate_permissions(core);
+}
+
+/** Invalidate the cached permissions
+ *
+ * \param core a core
+ *
+ * The result of the permission callback is cached for each client and
+ * global. Call this when the callback would return something else for
+ * globals that already exist.
+ *
+ * \memberof pw_core
+ */
+void pw_core_invalidate_permissions(struct pw_core *core)
+{
+	struct pw_client *client;
+
+	spa_list_for_each(client, &core->client_list, link)
+		client->permission_cache.size = 0;
 }
 
 struct pw_type *pw_core_get_type(struct pw_core *core)
@@ -576,8 +788,14 @@ void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict
 	struct pw_resource *resource;
 	uint32_t i;
 
-	for (i = 0; i < dict->n_items; i++)
-		pw_properties_set(core->properties, dict->items[i].key, dict->items[i].value);
+	for (i = 0; i < dict->n_items; i++) {
+		const char *key = dict->items[i].key, *value = dict->items[i].value;
+
+		pw_properties_set(core->properties, key, value);
+
+		if (strcmp(key, PW_CORE_PROP_FREEWHEEL) == 0)
+			pw_core_set_freewheel(core, value ? pw_properties_parse_bool(value) : false);
+	}
 
 	core->info.change_mask = PW_CORE_CHANGE_MASK_PROPS;
 	core->info.props = &core->properties->dict;
@@ -590,6 +808,35 @@ void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict
 	core->info.change_mask = 0;
 }
 
+/** Enter or leave freewheel mode
+ * \param core a core
+ * \param freewheel true to enter freewheel mode
+ * \return 0 on success
+ *
+ * In freewheel mode, the data loop runs the graph cycles back-to-back as
+ * fast as the nodes can process them, the need_input and have_output
+ * requests of the nodes are ignored. Sinks that consume data on their own
+ * clock should be paused while freewheeling. The data loop thread leaves
+ * realtime scheduling while freewheeling and when the graph has no sinks,
+ * it only checks for new ones every 100 milliseconds.
+ *
+ * \memberof pw_core
+ */
+int pw_core_set_freewheel(struct pw_core *core, bool freewheel)
+{
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
+
+	if (impl->freewheel == freewheel)
+		return 0;
+
+	pw_log_debug("core %p: freewheel %d", core, freewheel);
+	impl->freewheel = freewheel;
+
+	pw_loop_invoke(core->data_loop,
+		       do_set_freewheel, SPA_ID_INVALID, 0, NULL, true, impl);
+	return 0;
+}
+
 bool pw_core_for_each_global(struct pw_core *core,
 			     bool (*callback) (void *data, struct pw_global *global),
 			     void *data)
@@ -628,7 +875,7 @@ struct pw_port *pw_core_find_port(struct pw_core *core,
 				  struct spa_pod **format_filters,
 				  char **error)
 {
-	struct pw_port *best = NULL;
+	struct pw_port *best = NULL, *convertible = NULL;
 	bool have_id;
 	struct pw_node *n;
 
@@ -684,11 +931,17 @@ struct pw_port *pw_core_find_port(struct pw_core *core,
 						&b,
 						error) < 0) {
 				free(*error);
+				/* a link to this port will get a converter */
+				if (convertible == NULL && n_format_filters == 0 &&
+				    pw_core_can_convert(core, pout, pin))
+					convertible = p;
 				continue;
 			}
 			best = p;
 		}
 	}
+	if (best == NULL)
+		best = convertible;
 	if (best == NULL) {
 		asprintf(error, "No matching Node found");
 	}
@@ -810,6 +1063,93 @@ int pw_core_find_format(struct pw_core *core,
 	return res;
 }
 
+static bool port_is_audio_raw(struct pw_core *core, struct pw_port *port)
+{
+	uint8_t buf[4096];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buf, sizeof(buf));
+	struct spa_pod *format;
+	uint32_t idx = 0, media_type, media_subtype;
+
+	if (spa_node_port_enum_params(port->node->node, port->direction, port->port_id,
+				      core->type.param.idEnumFormat, &idx,
+				      NULL, &format, &b) <= 0)
+		return false;
+
+	if (spa_pod_object_parse(format,
+			"I", &media_type,
+			"I", &media_subtype) < 0)
+		return false;
+
+	return media_type == spa_type_map_get_id(core->type.map, SPA_TYPE_MEDIA_TYPE__audio) &&
+	    media_subtype == spa_type_map_get_id(core->type.map, SPA_TYPE_MEDIA_SUBTYPE__raw);
+}
+
+/** Check if a converter can be placed between 2 ports
+ *
+ * \param core a core object
+ * \param output an output port
+ * \param input an input port
+ * \return true when both ports use raw audio and a converter can be made
+ *
+ * \memberof pw_core
+ */
+bool pw_core_can_convert(struct pw_core *core,
+			 struct pw_port *output,
+			 struct pw_port *input)
+{
+	if (pw_core_find_factory(core, PW_CORE_CONVERTER_FACTORY) == NULL)
+		return false;
+
+	return port_is_audio_raw(core, output) && port_is_audio_raw(core, input);
+}
+
+/** Make a converter node
+ *
+ * \param core a core object
+ * \param[out] error an error when something is wrong
+ * \return a new active audio converter node or NULL on error
+ *
+ * The converter has one input and one output port and converts between
+ * all raw audio sample formats and numbers of channels with the same rate.
+ *
+ * \memberof pw_core
+ */
+struct pw_node *pw_core_create_converter(struct pw_core *core, char **error)
+{
+	struct pw_factory *factory;
+	struct pw_properties *props;
+	struct pw_node *node;
+
+	if ((factory = pw_core_find_factory(core, PW_CORE_CONVERTER_FACTORY)) == NULL)
+		goto no_factory;
+
+	props = pw_properties_new("spa.library.name", "audioconvert/libspa-audioconvert",
+				  "spa.factory.name", "audioconvert",
+				  "name", "audioconvert",
+				  NULL);
+	if (props == NULL)
+		goto no_mem;
+
+	node = pw_factory_create_object(factory, NULL, core->type.node, PW_VERSION_NODE,
+					props, SPA_ID_INVALID);
+	if (node == NULL)
+		goto no_node;
+
+	pw_node_set_active(node, true);
+
+	return node;
+
+      no_factory:
+	asprintf(error, "no converter factory");
+	return NULL;
+      no_mem:
+	asprintf(error, "no memory");
+	return NULL;
+      no_node:
+	asprintf(error, "can't create converter");
+	return NULL;
+}
+
 /** Find a factory by name
  *
  * \param core the core object
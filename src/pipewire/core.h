@@ -111,6 +111,23 @@ struct pw_core_events {
 #define PW_CORE_PROP_VERSION	"pipewire.core.version"
 /** If the core should listen for connections, boolean default false */
 #define PW_CORE_PROP_DAEMON	"pipewire.daemon"
+/** The number of extra realtime threads that process the graph, default 0 */
+#define PW_CORE_PROP_DATA_WORKERS	"pipewire.core.data-workers"
+/** Run the graph as fast as possible instead of following the clock of
+ * the nodes, boolean default false */
+#define PW_CORE_PROP_FREEWHEEL	"pipewire.core.freewheel"
+/** The size in bytes of the buffer memory that is kept to reuse for new links,
+ * default 16M. 0 disables reuse */
+#define PW_CORE_PROP_BUFFER_POOL_SIZE	"pipewire.core.buffer-pool-size"
+/** The size in bytes of the first memfd that the buffers of the links of a
+ * client are allocated from, default 1M. 0 uses a memfd for each link */
+#define PW_CORE_PROP_BUFFER_ARENA_SIZE	"pipewire.core.buffer-arena-size"
+/** Fault in and lock the buffer memory of the nodes so that the data thread
+ * doesn't take page faults, boolean default false */
+#define PW_CORE_PROP_MLOCK	"pipewire.core.mlock"
+/** The max size in bytes of the buffer memory that is locked for a client,
+ * default 16M. The buffers above the limit are only faulted in */
+#define PW_CORE_PROP_MLOCK_LIMIT	"pipewire.core.mlock-limit"
 
 /** Make a new core object for a given main_loop. Ownership of the properties is taken */
 struct pw_core * pw_core_new(struct pw_loop *main_loop, struct pw_properties *props);
@@ -130,6 +147,9 @@ void pw_core_set_permission_callback(struct pw_core *core,
 				     pw_permission_func_t callback,
 				     void *data);
 
+/** Make the permission callback be called again for all globals and clients */
+void pw_core_invalidate_permissions(struct pw_core *core);
+
 /** Get the type object of a core */
 struct pw_type *pw_core_get_type(struct pw_core *core);
 
@@ -145,6 +165,9 @@ const struct pw_properties *pw_core_get_properties(struct pw_core *core);
 /** Update the core properties */
 void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict);
 
+/** Enter or leave freewheel mode */
+int pw_core_set_freewheel(struct pw_core *core, bool freewheel);
+
 /** Get the core support objects */
 const struct spa_support *pw_core_get_support(struct pw_core *core, uint32_t *n_support);
 
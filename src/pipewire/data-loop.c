@@ -90,6 +90,43 @@ static void *do_loop(void *user_data)
 }
 
 
+static void *do_worker(void *user_data)
+{
+	struct pw_data_loop *this = user_data;
+
+	make_realtime(this);
+
+	pw_log_debug("data-loop %p: enter worker", this);
+	while (true) {
+		while (sem_wait(&this->worker_sem) < 0 && errno == EINTR);
+		if (!this->workers_running)
+			break;
+		this->work(this->work_data);
+	}
+	pw_log_debug("data-loop %p: leave worker", this);
+
+	return NULL;
+}
+
+static void stop_workers(struct pw_data_loop *this)
+{
+	uint32_t i;
+
+	if (this->workers == NULL)
+		return;
+
+	this->workers_running = false;
+	for (i = 0; i < this->n_workers; i++)
+		sem_post(&this->worker_sem);
+	for (i = 0; i < this->n_workers; i++)
+		pthread_join(this->workers[i], NULL);
+
+	sem_destroy(&this->worker_sem);
+	free(this->workers);
+	this->workers = NULL;
+	this->n_workers = 0;
+}
+
 static void do_stop(void *data, uint64_t count)
 {
 	struct pw_data_loop *this = data;
@@ -137,6 +174,7 @@ void pw_data_loop_destroy(struct pw_data_loop *loop)
 	spa_hook_list_call(&loop->listener_list, struct pw_data_loop_events, destroy);
 
 	pw_data_loop_stop(loop);
+	stop_workers(loop);
 
 	pw_loop_destroy_source(loop->loop, loop->event);
 	pw_loop_destroy(loop->loop);
@@ -198,6 +236,115 @@ int pw_data_loop_stop(struct pw_data_loop *loop)
 	return 0;
 }
 
+/** Start worker threads
+ * \param loop the data loop
+ * \param n_workers the number of threads
+ * \param work called from the workers after a wakeup
+ * \param data data passed to \a work
+ * \return the number of started workers or < 0 on error
+ *
+ * The workers are realtime threads like the loop thread. They are used by
+ * the graph scheduler to process independent parts of the graph in
+ * parallel.
+ *
+ * \memberof pw_data_loop
+ */
+int pw_data_loop_start_workers(struct pw_data_loop *loop, uint32_t n_workers,
+			       void (*work) (void *data), void *data)
+{
+	int err;
+
+	if (loop->workers != NULL)
+		return -EBUSY;
+
+	n_workers = SPA_MIN(n_workers, PW_DATA_LOOP_MAX_WORKERS);
+	if (n_workers == 0)
+		return 0;
+
+	if ((loop->workers = calloc(n_workers, sizeof(pthread_t))) == NULL)
+		return -ENOMEM;
+	if (sem_init(&loop->worker_sem, 0, 0) < 0) {
+		err = errno;
+		free(loop->workers);
+		loop->workers = NULL;
+		return -err;
+	}
+
+	loop->work = work;
+	loop->work_data = data;
+	loop->workers_running = true;
+
+	for (loop->n_workers = 0; loop->n_workers < n_workers; loop->n_workers++) {
+		if ((err = pthread_create(&loop->workers[loop->n_workers], NULL,
+					  do_worker, loop)) != 0) {
+			pw_log_warn("data-loop %p: can't create worker: %s", loop, strerror(err));
+			break;
+		}
+	}
+	if (loop->n_workers == 0) {
+		stop_workers(loop);
+		return -err;
+	}
+	pw_log_debug("data-loop %p: started %d workers", loop, loop->n_workers);
+
+	return loop->n_workers;
+}
+
+/** Wake up workers
+ * \param loop the data loop
+ * \param n_workers the number of workers to wake up
+ *
+ * \memberof pw_data_loop
+ */
+void pw_data_loop_wakeup_workers(struct pw_data_loop *loop, uint32_t n_workers)
+{
+	n_workers = SPA_MIN(n_workers, loop->n_workers);
+	while (n_workers--)
+		sem_post(&loop->worker_sem);
+}
+
+/** Leave or enter realtime scheduling
+ * \param loop the data loop
+ * \param realtime false to run the loop thread as a normal thread
+ * \return 0 on success, < 0 on error
+ *
+ * This is used when the loop thread runs work back-to-back that should not
+ * starve the other threads of the system, like freewheeling. Must be called
+ * from the loop thread.
+ *
+ * \memberof pw_data_loop
+ */
+int pw_data_loop_set_realtime(struct pw_data_loop *loop, bool realtime)
+{
+	struct sched_param sp;
+	int err;
+
+	if (!realtime) {
+		if (loop->realtime_dropped)
+			return 0;
+		if ((err = pthread_getschedparam(pthread_self(),
+						 &loop->rt_policy, &loop->rt_param)) != 0)
+			return -err;
+
+		spa_zero(sp);
+		if ((err = pthread_setschedparam(pthread_self(),
+						 SCHED_OTHER | SCHED_RESET_ON_FORK, &sp)) != 0)
+			return -err;
+		loop->realtime_dropped = true;
+		pw_log_debug("data-loop %p: left realtime scheduling", loop);
+	} else {
+		if (!loop->realtime_dropped)
+			return 0;
+		loop->realtime_dropped = false;
+
+		/* without privileges, going back needs rtkit again */
+		if (pthread_setschedparam(pthread_self(), loop->rt_policy, &loop->rt_param) != 0)
+			make_realtime(loop);
+		pw_log_debug("data-loop %p: entered realtime scheduling", loop);
+	}
+	return 0;
+}
+
 /** Check if we are inside the data loop
  * \param loop the data loop to check
  * \return true is the current thread is the data loop thread
@@ -18,6 +18,7 @@
  */
 
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdio.h>
@@ -33,16 +34,49 @@ struct global_impl {
 	struct pw_global this;
 };
 
+struct permission_entry {
+	uint32_t serial;	/**< serial of the global */
+	uint32_t permissions;
+};
+
 /** \endcond */
 
+static struct permission_entry *
+get_permission_entry(struct pw_client *client, uint32_t id)
+{
+	struct pw_array *cache = &client->permission_cache;
+	size_t len = pw_array_get_len(cache, struct permission_entry);
+
+	if (id >= len) {
+		/* make room for all globals at once */
+		size_t n = SPA_MAX(id + 1, pw_map_get_size(&client->core->globals));
+		size_t extra = (n - len) * sizeof(struct permission_entry);
+
+		if (!pw_array_ensure_size(cache, extra))
+			return NULL;
+		/* zeroed entries have no valid serial */
+		memset(cache->data + cache->size, 0, extra);
+		cache->size += extra;
+	}
+	return pw_array_get_unchecked(cache, id, struct permission_entry);
+}
+
 uint32_t pw_global_get_permissions(struct pw_global *global, struct pw_client *client)
 {
 	struct pw_core *core = client->core;
+	struct permission_entry *e;
 
 	if (core->permission_func == NULL)
 		return PW_PERM_RWX;
 
-	return core->permission_func(global, client, core->permission_data);
+	if ((e = get_permission_entry(client, global->id)) == NULL)
+		return core->permission_func(global, client, core->permission_data);
+
+	if (e->serial != global->serial) {
+		e->permissions = core->permission_func(global, client, core->permission_data);
+		e->serial = global->serial;
+	}
+	return e->permissions;
 }
 
 /** Create and add a new global to the core
@@ -86,6 +120,8 @@ pw_core_add_global(struct pw_core *core,
 	this->object = object;
 
 	this->id = pw_map_insert_new(&core->globals, this);
+	if ((this->serial = ++core->global_serial) == 0)
+		this->serial = ++core->global_serial;
 
 	if (owner)
 		parent = owner->global;
@@ -50,6 +50,15 @@ struct impl {
 	struct spa_hook input_node_listener;
 	struct spa_hook output_port_listener;
 	struct spa_hook output_node_listener;
+
+	/* converter between the ports when they have no common format, the
+	 * link goes from the converter to the input port, converter_output
+	 * is the output port the link was made with */
+	struct pw_node *converter;
+	struct pw_link *converter_link;
+	struct pw_port *converter_output;
+	struct spa_hook converter_link_listener;
+	struct spa_hook converter_output_listener;
 };
 
 struct resource_data {
@@ -111,6 +120,8 @@ static void complete_streaming(void *obj, void *data, int res, uint32_t id)
 	}
 }
 
+static int insert_converter(struct impl *impl, char **error);
+
 static int do_negotiate(struct pw_link *this, uint32_t in_state, uint32_t out_state)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
@@ -133,8 +144,19 @@ static int do_negotiate(struct pw_link *this, uint32_t in_state, uint32_t out_st
 	input = this->input;
 	output = this->output;
 
-	if ((res = pw_core_find_format(this->core, output, input, NULL, 0, NULL, &format, &b, &error)) < 0)
-		goto error;
+	if ((res = pw_core_find_format(this->core, output, input, NULL, 0, NULL, &format, &b, &error)) < 0) {
+		/* raw audio ports without a common format get a converter */
+		if (impl->converter != NULL || !pw_core_can_convert(this->core, output, input))
+			goto error;
+
+		free(error);
+		error = NULL;
+		if ((res = insert_converter(impl, &error)) < 0)
+			goto error;
+
+		/* check the states again with the converter output */
+		return 1;
+	}
 
 	format = pw_spa_pod_copy(format);
 	spa_pod_fixate(format);
@@ -262,6 +284,29 @@ static struct spa_pod *find_meta(struct pw_core *core, struct spa_pod **params,
 	return NULL;
 }
 
+/* buffer memory is shared with the owners of the nodes. Only reuse it
+ * for links of the same client, or of the server alone */
+static uint32_t buffer_pool_tag(struct pw_link *this)
+{
+	struct pw_client *out_owner = NULL, *in_owner = NULL, *owner;
+
+	if (this->output->node->global)
+		out_owner = pw_global_get_owner(this->output->node->global);
+	if (this->input->node->global)
+		in_owner = pw_global_get_owner(this->input->node->global);
+
+	if (out_owner && in_owner && out_owner != in_owner)
+		return PW_MEMBLOCK_POOL_TAG_NONE;
+
+	owner = out_owner ? out_owner : in_owner;
+	if (owner == NULL)
+		return 0;
+	if (owner->global == NULL)
+		return PW_MEMBLOCK_POOL_TAG_NONE;
+
+	return owner->global->serial;
+}
+
 static struct spa_buffer **alloc_buffers(struct pw_link *this,
 					 uint32_t n_buffers,
 					 uint32_t n_params,
@@ -325,9 +370,12 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 	/* pointer to buffer structures */
 	bp = SPA_MEMBER(buffers, n_buffers * sizeof(struct spa_buffer *), struct spa_buffer);
 
-	pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
-			  PW_MEMBLOCK_FLAG_MAP_READWRITE |
-			  PW_MEMBLOCK_FLAG_SEAL, n_buffers * data_size, mem);
+	pw_memblock_pool_alloc(this->core->buffer_pool,
+			       PW_MEMBLOCK_FLAG_WITH_FD |
+			       PW_MEMBLOCK_FLAG_MAP_READWRITE |
+			       PW_MEMBLOCK_FLAG_SEAL |
+			       (this->core->mlock ? PW_MEMBLOCK_FLAG_MAP_LOCK : 0),
+			       buffer_pool_tag(this), n_buffers * data_size, mem);
 
 	for (i = 0; i < n_buffers; i++) {
 		int j;
@@ -353,7 +401,7 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 
 				msh->flags = 0;
 				msh->fd = mem->fd;
-				msh->offset = data_size * i;
+				msh->offset = mem->offset + data_size * i;
 				msh->size = data_size;
 			} else if (m->type == this->core->type.meta.Ringbuffer) {
 				struct spa_meta_ringbuffer *rb = p;
@@ -374,11 +422,11 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 			d->chunk = &cdp[j];
 			if (data_sizes[j] > 0) {
 				d->type = this->core->type.data.MemFd;
-				d->flags = 0;
+				d->flags = SPA_DATA_FLAG_DYNAMIC;
 				d->fd = mem->fd;
-				d->mapoffset = SPA_PTRDIFF(ddp, mem->ptr);
+				d->mapoffset = mem->offset + SPA_PTRDIFF(ddp, mem->ptr);
 				d->maxsize = data_sizes[j];
-				d->data = SPA_MEMBER(mem->ptr, d->mapoffset, void);
+				d->data = ddp;
 				d->chunk->offset = 0;
 				d->chunk->size = data_sizes[j];
 				d->chunk->stride = data_strides[j];
@@ -431,6 +479,36 @@ param_filter(struct pw_link *this,
 	return num;
 }
 
+static int check_states(struct pw_link *this, void *user_data, int res);
+
+/* make the other links of @input that use the buffers allocated by the
+ * input node allocate buffers of their own */
+static int unshare_input_buffers(struct pw_link *this, struct pw_port *input)
+{
+	struct pw_link *l;
+
+	spa_list_for_each(l, &input->links, input_link) {
+		struct impl *limpl = SPA_CONTAINER_OF(l, struct impl, this);
+
+		if (l == this || l->buffer_owner != input)
+			continue;
+
+		/* the other links of the output use the same buffers */
+		if (l->output->links.next != l->output->links.prev)
+			return -EBUSY;
+
+		pw_log_debug("link %p: link %p gets its own buffers", this, l);
+		l->buffers = NULL;
+		l->n_buffers = 0;
+		l->buffer_owner = NULL;
+		pw_port_use_buffers(l->output, NULL, 0);
+
+		pw_work_queue_add(limpl->work,
+				  l, -EBUSY, (pw_work_func_t) check_states, l);
+	}
+	return 0;
+}
+
 static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_state)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
@@ -440,6 +518,7 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 	char *error = NULL;
 	struct pw_port *input, *output;
 	struct pw_type *t = &this->core->type;
+	bool mix;
 
 	if (in_state != PW_PORT_STATE_READY && out_state != PW_PORT_STATE_READY)
 		return 0;
@@ -504,6 +583,12 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		return 0;
 	}
 
+	/* the input port is already fed by another link, this link gets its
+	 * own buffers and the input mixes all links */
+	mix = input->n_buffers > 0 && input->mix != NULL;
+	if (mix)
+		in_flags = 0;
+
 	if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG)) {
 		spa_debug_port_info(oinfo);
 		spa_debug_port_info(iinfo);
@@ -515,7 +600,7 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
 		int i, offset, n_params;
 		uint32_t max_buffers;
-		size_t minsize = 1024, stride = 0;
+		size_t minsize = 1024, stride = 0, mix_size;
 
 		n_params = param_filter(this, input, output, t->param.idBuffers, &b);
 		n_params += param_filter(this, input, output, t->param.idMeta, &b);
@@ -569,19 +654,22 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			}
 		}
 
+		mix_size = minsize;
+
 		if ((in_flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS) ||
 		    (out_flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS))
 			minsize = 0;
 
 		if (output->n_buffers) {
+			/* a mixing input keeps its own buffers */
 			out_flags = 0;
-			in_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+			in_flags = mix ? 0 : SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
 			this->n_buffers = output->n_buffers;
 			this->buffers = output->buffers;
 			this->buffer_owner = output;
 			pw_log_debug("link %p: reusing %d output buffers %p", this, this->n_buffers,
 				     this->buffers);
-		} else if (input->n_buffers && input->mix == NULL) {
+		} else if (!mix && input->n_buffers) {
 			out_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
 			in_flags = 0;
 			this->n_buffers = input->n_buffers;
@@ -610,6 +698,45 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 				     this->n_buffers, this->buffers, minsize, stride);
 		}
 
+		if (mix && !input->mixing && input->allocated) {
+			/* the node of the input allocated the buffers, give the
+			 * links that share them buffers of their own and mix
+			 * into the buffers of the node */
+			if ((res = unshare_input_buffers(this, input)) < 0 ||
+			    (res = pw_port_use_mix_buffers(input, NULL, 0, NULL)) < 0) {
+				asprintf(&error, "input port can't mix: %d", res);
+				pw_link_update_state(this, PW_LINK_STATE_ERROR, error);
+				return res;
+			}
+		}
+		else if (mix && !input->mixing) {
+			struct pw_memblock mem;
+			struct spa_buffer **buffers;
+			size_t data_sizes[1];
+			ssize_t data_strides[1];
+
+			data_sizes[0] = mix_size;
+			data_strides[0] = stride;
+
+			buffers = alloc_buffers(this, this->n_buffers, n_params, params,
+						1, data_sizes, data_strides, &mem);
+
+			pw_log_debug("link %p: allocating %d mix buffers %p on input", this,
+				     this->n_buffers, buffers);
+
+			if ((res = pw_port_use_mix_buffers(input, buffers,
+							   this->n_buffers, &mem)) < 0) {
+				/* don't touch the buffers of the other links */
+				free(buffers);
+				pw_memblock_pool_release(this->core->buffer_pool, &mem);
+				asprintf(&error, "input port can't mix: %d", res);
+				pw_link_update_state(this, PW_LINK_STATE_ERROR, error);
+				return res;
+			}
+			if (SPA_RESULT_IS_ASYNC(res))
+				pw_work_queue_add(impl->work, input->node, res, complete_paused, input);
+		}
+
 		if (out_flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS) {
 			if ((res = pw_port_alloc_buffers(output,
 							 params, n_params,
@@ -657,7 +784,7 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		}
 		if (SPA_RESULT_IS_ASYNC(res))
 			pw_work_queue_add(impl->work, output->node, res, complete_paused, output);
-	} else {
+	} else if (!mix) {
 		asprintf(&error, "no common buffer alloc found");
 		goto error;
 	}
@@ -807,6 +934,10 @@ output_node_async_complete(void *data, uint32_t seq, int res)
 
 static void clear_port_buffers(struct pw_link *link, struct pw_port *port)
 {
+	/* a mixing input port keeps its buffers while other links use it */
+	if (port->mixing && port->links.next != port->links.prev)
+		return;
+
 	if (link->buffer_owner != port)
 		pw_port_use_buffers(port, NULL, 0);
 }
@@ -897,6 +1028,99 @@ static void output_port_destroy(void *data)
 	on_port_destroy(&impl->this, impl->this.output);
 }
 
+static void converter_link_destroy(void *data)
+{
+	struct impl *impl = data;
+	spa_hook_remove(&impl->converter_link_listener);
+	impl->converter_link = NULL;
+}
+
+static const struct pw_link_events converter_link_events = {
+	PW_VERSION_LINK_EVENTS,
+	.destroy = converter_link_destroy,
+};
+
+/* the output port linked to the converter is gone */
+static void converter_output_destroy(void *data)
+{
+	struct impl *impl = data;
+	struct pw_link *this = &impl->this;
+
+	spa_hook_list_call(&this->listener_list, struct pw_link_events, port_unlinked,
+			   impl->converter_output);
+
+	pw_link_update_state(this, PW_LINK_STATE_UNLINKED, NULL);
+	pw_link_destroy(this);
+}
+
+static const struct pw_port_events converter_output_events = {
+	PW_VERSION_PORT_EVENTS,
+	.destroy = converter_output_destroy,
+};
+
+static void set_output(struct impl *impl, struct pw_port *output);
+
+/* link the output to a new converter and move the link to the converter
+ * output */
+static int insert_converter(struct impl *impl, char **error)
+{
+	struct pw_link *this = &impl->this;
+	struct pw_core *core = this->core;
+	struct pw_port *output = this->output, *conv_in, *conv_out;
+
+	if ((impl->converter = pw_core_create_converter(core, error)) == NULL)
+		return -ENOENT;
+
+	conv_in = pw_node_get_free_port(impl->converter, PW_DIRECTION_INPUT);
+	conv_out = pw_node_get_free_port(impl->converter, PW_DIRECTION_OUTPUT);
+	if (conv_in == NULL || conv_out == NULL) {
+		asprintf(error, "converter has no ports");
+		return -EIO;
+	}
+
+	impl->converter_link = pw_link_new(core, output, conv_in, NULL, NULL, error, 0);
+	if (impl->converter_link == NULL)
+		return -EIO;
+
+	pw_link_add_listener(impl->converter_link, &impl->converter_link_listener,
+			     &converter_link_events, impl);
+	pw_link_register(impl->converter_link, NULL, NULL);
+
+	impl->converter_output = output;
+	pw_port_add_listener(output, &impl->converter_output_listener,
+			     &converter_output_events, impl);
+
+	pw_log_debug("link %p: converter %p between %p and %p", impl,
+		     impl->converter, output, this->input);
+
+	set_output(impl, conv_out);
+	return 0;
+}
+
+/* the gain of the link, the default is 1.0 */
+static float parse_volume(struct pw_properties *properties)
+{
+	const char *str;
+
+	if (properties == NULL ||
+	    (str = pw_properties_get(properties, PW_LINK_PROP_VOLUME)) == NULL)
+		return 1.0f;
+
+	return SPA_MAX(pw_properties_parse_float(str), 0.0f);
+}
+
+static void remove_converter(struct impl *impl)
+{
+	if (impl->converter_output)
+		spa_hook_remove(&impl->converter_output_listener);
+	if (impl->converter_link) {
+		spa_hook_remove(&impl->converter_link_listener);
+		pw_link_destroy(impl->converter_link);
+	}
+	if (impl->converter)
+		pw_node_destroy(impl->converter);
+}
+
 bool pw_link_activate(struct pw_link *this)
 {
 	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
@@ -1051,6 +1275,36 @@ static const struct pw_node_events output_node_events = {
 	.async_complete = output_node_async_complete,
 };
 
+/* move the output side of the link to another port */
+static void set_output(struct impl *impl, struct pw_port *output)
+{
+	struct pw_link *this = &impl->this;
+	struct pw_port *old = this->output;
+
+	/* the buffers of the old port stay, other links can use them */
+	spa_hook_remove(&impl->output_port_listener);
+	spa_hook_remove(&impl->output_node_listener);
+	pw_loop_invoke(old->node->data_loop,
+		       do_remove_output, 1, 0, NULL, true, this);
+	spa_list_remove(&this->output_link);
+	spa_hook_list_call(&old->listener_list, struct pw_port_events, link_removed, this);
+
+	if (impl->active) {
+		old->node->n_used_output_links--;
+		output->node->n_used_output_links++;
+	}
+
+	this->output = output;
+	pw_port_add_listener(output, &impl->output_port_listener, &output_port_events, impl);
+	pw_node_add_listener(output->node, &impl->output_node_listener, &output_node_events, impl);
+	spa_list_append(&output->links, &this->output_link);
+
+	pw_loop_invoke(output->node->data_loop, do_add_link,
+		       SPA_ID_INVALID, sizeof(struct pw_port *), &output, false, this);
+
+	spa_hook_list_call(&output->listener_list, struct pw_port_events, link_added, this);
+}
+
 struct pw_link *pw_link_new(struct pw_core *core,
 			    struct pw_port *output,
 			    struct pw_port *input,
@@ -1091,6 +1345,8 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	input_node = input->node;
 	output_node = output->node;
 
+	this->volume = parse_volume(properties);
+
 	if (properties) {
 		const char *str = pw_properties_get(properties, PW_LINK_PROP_PASSIVE);
 		if (str && pw_properties_parse_bool(str)) {
@@ -1238,8 +1494,10 @@ void pw_link_destroy(struct pw_link *link)
 
 	if (link->buffer_owner == link) {
 		free(link->buffers);
-		pw_memblock_free(&link->buffer_mem);
+		pw_memblock_pool_release(link->core->buffer_pool, &link->buffer_mem);
 	}
+	remove_converter(impl);
+
 	free(impl);
 }
 
@@ -1252,12 +1510,52 @@ void pw_link_add_listener(struct pw_link *link,
 	spa_hook_list_append(&link->listener_list, listener, events, data);
 }
 
+static int
+do_set_volume(struct spa_loop *loop,
+	      bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct pw_link *this = user_data;
+	this->volume = *(const float *) data;
+	return 0;
+}
+
+void pw_link_update_properties(struct pw_link *link, const struct spa_dict *dict)
+{
+	struct pw_resource *resource;
+	float volume;
+	uint32_t i;
+
+	if (link->properties == NULL &&
+	    (link->properties = pw_properties_new(NULL, NULL)) == NULL)
+		return;
+
+	for (i = 0; i < dict->n_items; i++)
+		pw_properties_set(link->properties, dict->items[i].key, dict->items[i].value);
+
+	link->info.props = &link->properties->dict;
+
+	/* the input port mixes with the volume in the data thread */
+	volume = parse_volume(link->properties);
+	if (volume != link->volume)
+		pw_loop_invoke(link->input->node->data_loop, do_set_volume,
+			       SPA_ID_INVALID, sizeof(float), &volume, false, link);
+
+	link->info.change_mask = PW_LINK_CHANGE_MASK_PROPS;
+	spa_hook_list_call(&link->listener_list, struct pw_link_events, info_changed, &link->info);
+
+	spa_list_for_each(resource, &link->resource_list, link)
+		pw_link_resource_info(resource, &link->info);
+
+	link->info.change_mask = 0;
+}
+
 struct pw_link *pw_link_find(struct pw_port *output_port, struct pw_port *input_port)
 {
 	struct pw_link *pl;
 
-	spa_list_for_each(pl, &output_port->links, output_link) {
-		if (pl->input == input_port)
+	/* a converted link is in the links of the converter output */
+	spa_list_for_each(pl, &input_port->links, input_link) {
+		if (pw_link_get_output(pl) == output_port)
 			return pl;
 	}
 	return NULL;
@@ -1285,7 +1583,8 @@ struct pw_global *pw_link_get_global(struct pw_link *link)
 
 struct pw_port *pw_link_get_output(struct pw_link *link)
 {
-	return link->output;
+	struct impl *impl = SPA_CONTAINER_OF(link, struct impl, this);
+	return impl->converter_output ? impl->converter_output : link->output;
 }
 
 struct pw_port *pw_link_get_input(struct pw_link *link)
@@ -75,6 +75,11 @@ struct pw_link_events {
   * set to "1" or "0" */
 #define PW_LINK_PROP_PASSIVE	"pipewire.link.passive"
 
+/** The gain applied to the data of the link when it is mixed with other
+  * links on the input port, as a float, default "1.0". It can be changed
+  * with pw_link_update_properties() */
+#define PW_LINK_PROP_VOLUME	"pipewire.link.volume"
+
 /** Make a new link between two ports \memberof pw_link
  * \return a newly allocated link */
 struct pw_link *
@@ -113,12 +118,16 @@ const struct pw_link_info *pw_link_get_info(struct pw_link *link);
 /** Get the global of the link */
 struct pw_global *pw_link_get_global(struct pw_link *link);
 
-/** Get the output port of the link */
+/** Get the output port of the link, this is the port the link was made
+ * with, also when the data goes through a converter */
 struct pw_port *pw_link_get_output(struct pw_link *link);
 
 /** Get the input port of the link */
 struct pw_port *pw_link_get_input(struct pw_link *link);
 
+/** Update the link properties and notify the clients */
+void pw_link_update_properties(struct pw_link *link, const struct spa_dict *dict);
+
 /** Find the link between 2 ports \memberof pw_link */
 struct pw_link *pw_link_find(struct pw_port *output, struct pw_port *input);
 
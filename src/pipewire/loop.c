@@ -74,7 +74,7 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 
 	if ((res = spa_handle_factory_init(factory,
 					   impl->handle,
-					   NULL,
+					   properties ? &properties->dict : NULL,
 					   support,
 					   n_support)) < 0) {
 		fprintf(stderr, "can't make factory instance: %d\n", res);
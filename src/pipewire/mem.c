@@ -30,9 +30,13 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/syscall.h>
+#include <sys/stat.h>
+
+#include <spa/utils/list.h>
 
 #include <pipewire/log.h>
 #include <pipewire/mem.h>
+#include <pipewire/private.h>
 
 /*
  * No glibc wrappers exist for memfd_create(2), so provide our own.
@@ -76,6 +80,20 @@ static inline int memfd_create(const char *name, unsigned int flags)
 
 #define USE_MEMFD
 
+static size_t page_size(void)
+{
+	long size = sysconf(_SC_PAGESIZE);
+	return size > 0 ? size : 4096;
+}
+
+static void lock_mapping(struct pw_memblock *mem, void *ptr, size_t size)
+{
+	if (mlock(ptr, size) < 0) {
+		pw_log_info("memblock %p: can't lock %zd bytes: %s", mem, size, strerror(errno));
+		mem->flags &= ~PW_MEMBLOCK_FLAG_MAP_LOCK;
+	}
+}
+
 /** Map a memblock
  * \param mem a memblock
  * \return 0 on success, < 0 on error
@@ -87,12 +105,14 @@ int pw_memblock_map(struct pw_memblock *mem)
 		return 0;
 
 	if (mem->flags & PW_MEMBLOCK_FLAG_MAP_READWRITE) {
-		int prot = 0;
+		int prot = 0, flags = MAP_SHARED;
 
 		if (mem->flags & PW_MEMBLOCK_FLAG_MAP_READ)
 			prot |= PROT_READ;
 		if (mem->flags & PW_MEMBLOCK_FLAG_MAP_WRITE)
 			prot |= PROT_WRITE;
+		if (mem->flags & PW_MEMBLOCK_FLAG_MAP_LOCK)
+			flags |= MAP_POPULATE;
 
 		if (mem->flags & PW_MEMBLOCK_FLAG_MAP_TWICE) {
 			void *ptr;
@@ -104,7 +124,7 @@ int pw_memblock_map(struct pw_memblock *mem)
 				return -errno;
 
 			ptr =
-			    mmap(mem->ptr, mem->size, prot, MAP_FIXED | MAP_SHARED, mem->fd,
+			    mmap(mem->ptr, mem->size, prot, MAP_FIXED | flags, mem->fd,
 				 mem->offset);
 			if (ptr != mem->ptr) {
 				munmap(mem->ptr, mem->size << 1);
@@ -112,16 +132,20 @@ int pw_memblock_map(struct pw_memblock *mem)
 			}
 
 			ptr =
-			    mmap(mem->ptr + mem->size, mem->size, prot, MAP_FIXED | MAP_SHARED,
+			    mmap(mem->ptr + mem->size, mem->size, prot, MAP_FIXED | flags,
 				 mem->fd, mem->offset);
 			if (ptr != mem->ptr + mem->size) {
 				munmap(mem->ptr, mem->size << 1);
 				return -ENOMEM;
 			}
+			if (mem->flags & PW_MEMBLOCK_FLAG_MAP_LOCK)
+				lock_mapping(mem, mem->ptr, mem->size << 1);
 		} else {
-			mem->ptr = mmap(NULL, mem->size, prot, MAP_SHARED, mem->fd, 0);
+			mem->ptr = mmap(NULL, mem->size, prot, flags, mem->fd, 0);
 			if (mem->ptr == MAP_FAILED)
 				return -ENOMEM;
+			if (mem->flags & PW_MEMBLOCK_FLAG_MAP_LOCK)
+				lock_mapping(mem, mem->ptr, mem->size);
 		}
 	} else {
 		mem->ptr = NULL;
@@ -187,6 +211,7 @@ int pw_memblock_alloc(enum pw_memblock_flags flags, size_t size, struct pw_membl
 		if (mem->ptr == NULL)
 			return -ENOMEM;
 		mem->fd = -1;
+		mem->flags &= ~PW_MEMBLOCK_FLAG_MAP_LOCK;
 	}
 	if (!(flags & PW_MEMBLOCK_FLAG_WITH_FD) && mem->fd != -1) {
 		close(mem->fd);
@@ -208,6 +233,11 @@ void pw_memblock_free(struct pw_memblock *mem)
 	if (mem == NULL)
 		return;
 
+	if (mem->flags & PW_MEMBLOCK_FLAG_ARENA) {
+		pw_log_warn("memblock %p: arena block must be freed with its arena", mem);
+		return;
+	}
+
 	if (mem->flags & PW_MEMBLOCK_FLAG_WITH_FD) {
 		if (mem->ptr)
 			munmap(mem->ptr, mem->size);
@@ -219,3 +249,678 @@ void pw_memblock_free(struct pw_memblock *mem)
 	mem->ptr = NULL;
 	mem->fd = -1;
 }
+
+/** Lock memory in RAM
+ * \param lock the locked memory of the owner
+ * \param ptr start of the memory
+ * \param size size of the memory
+ * \return 0 when the memory is locked, < 0 on error
+ *
+ * The memory is extended to whole pages. When it can't be locked, the
+ * pages are only faulted in so that the first access doesn't fault.
+ * \memberof pw_memlock
+ */
+int pw_memlock_lock(struct pw_memlock *lock, void *ptr, size_t size)
+{
+	size_t page = page_size(), i;
+	uint8_t *start = (uint8_t *) ((uintptr_t) ptr & ~(page - 1));
+	int res;
+
+	size = SPA_ROUND_UP_N(SPA_PTRDIFF(ptr, start) + size, page);
+
+	if (lock->limit != 0 && lock->locked + size > lock->limit)
+		res = -ENOSPC;
+	else if (mlock(start, size) < 0)
+		res = -errno;
+	else {
+		lock->locked += size;
+		return 0;
+	}
+
+	if (lock->n_failed++ == 0) {
+		pw_log_warn("memlock %p: can't lock %zd bytes, %zd locked: %s",
+			    lock, size, lock->locked, spa_strerror(res));
+	} else {
+		pw_log_debug("memlock %p: can't lock %zd bytes, %zd locked: %s",
+			     lock, size, lock->locked, spa_strerror(res));
+	}
+
+	for (i = 0; i < size; i += page)
+		(void) *(volatile uint8_t *) (start + i);
+
+	return res;
+}
+
+/** Unlock memory locked with pw_memlock_lock()
+ * \param lock the locked memory of the owner
+ * \param ptr start of the memory
+ * \param size size of the memory
+ * \memberof pw_memlock
+ */
+void pw_memlock_unlock(struct pw_memlock *lock, void *ptr, size_t size)
+{
+	size_t page = page_size();
+	uint8_t *start = (uint8_t *) ((uintptr_t) ptr & ~(page - 1));
+
+	size = SPA_ROUND_UP_N(SPA_PTRDIFF(ptr, start) + size, page);
+
+	munlock(start, size);
+	lock->locked -= SPA_MIN(size, lock->locked);
+}
+
+/** \cond */
+#define ARENA_MAX_GROW	16
+
+struct arena_range {
+	struct spa_list link;
+	size_t offset;
+	size_t size;
+};
+
+struct arena {
+	struct spa_list link;
+	uint32_t tag;
+	struct pw_memblock mem;		/**< the memfd of the arena */
+	struct spa_list free;		/**< free ranges, sorted by offset */
+	size_t used;
+};
+
+struct pw_memblock_arena {
+	struct spa_list arenas;
+	size_t arena_size;
+	size_t page_size;
+};
+/** \endcond */
+
+/** Make a new memblock arena
+ * \param arena_size the size of the first memfd of a tag
+ * \return a new arena or NULL
+ * \memberof pw_memblock_arena
+ */
+struct pw_memblock_arena *pw_memblock_arena_new(size_t arena_size)
+{
+	struct pw_memblock_arena *arena;
+
+	arena = calloc(1, sizeof(struct pw_memblock_arena));
+	if (arena == NULL)
+		return NULL;
+
+	arena->page_size = page_size();
+	arena->arena_size = SPA_ROUND_UP_N(SPA_MAX(arena_size, arena->page_size),
+					   arena->page_size);
+	spa_list_init(&arena->arenas);
+
+	return arena;
+}
+
+static void arena_free(struct arena *a)
+{
+	struct arena_range *r, *t;
+
+	spa_list_for_each_safe(r, t, &a->free, link)
+		free(r);
+	spa_list_remove(&a->link);
+	pw_memblock_free(&a->mem);
+	free(a);
+}
+
+/** Destroy a memblock arena
+ * \param arena an arena
+ *
+ * All memfds of the arena are freed, blocks that are still used become
+ * invalid.
+ * \memberof pw_memblock_arena
+ */
+void pw_memblock_arena_destroy(struct pw_memblock_arena *arena)
+{
+	struct arena *a, *t;
+
+	spa_list_for_each_safe(a, t, &arena->arenas, link)
+		arena_free(a);
+	free(arena);
+}
+
+static struct arena *arena_add(struct pw_memblock_arena *arena, uint32_t tag, size_t size)
+{
+	struct arena *a;
+	struct arena_range *r;
+	size_t arena_size = arena->arena_size;
+
+	spa_list_for_each(a, &arena->arenas, link) {
+		if (a->tag == tag && arena_size < arena->arena_size * ARENA_MAX_GROW)
+			arena_size <<= 1;
+	}
+	arena_size = SPA_MAX(arena_size, size);
+
+	a = calloc(1, sizeof(struct arena));
+	r = calloc(1, sizeof(struct arena_range));
+	if (a == NULL || r == NULL)
+		goto no_mem;
+
+	if (pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+			      PW_MEMBLOCK_FLAG_MAP_READWRITE |
+			      PW_MEMBLOCK_FLAG_SEAL, arena_size, &a->mem) < 0)
+		goto no_mem;
+
+	pw_log_debug("arena %p: add memfd %d of size %zd for tag %u",
+		     arena, a->mem.fd, arena_size, tag);
+
+	a->tag = tag;
+	spa_list_init(&a->free);
+	r->offset = 0;
+	r->size = arena_size;
+	spa_list_append(&a->free, &r->link);
+	spa_list_append(&arena->arenas, &a->link);
+
+	return a;
+
+      no_mem:
+	free(r);
+	free(a);
+	return NULL;
+}
+
+/** Allocate a memblock from an arena
+ * \param arena an arena
+ * \param flags memblock flags, must include PW_MEMBLOCK_FLAG_WITH_FD
+ * \param tag blocks are only allocated from the memfds of the same tag
+ * \param size size to allocate
+ * \param[out] mem memblock structure to fill
+ * \return 0 on success, < 0 on error
+ *
+ * The block is page aligned in the memfd of \a mem and \a mem->offset is
+ * the offset of the block in the memfd. The memory is not cleared.
+ * \memberof pw_memblock_arena
+ */
+int pw_memblock_arena_alloc(struct pw_memblock_arena *arena, enum pw_memblock_flags flags,
+			    uint32_t tag, size_t size, struct pw_memblock *mem)
+{
+	struct arena *a;
+	struct arena_range *r;
+	size_t alloc_size;
+
+	if (mem == NULL || size == 0)
+		return -EINVAL;
+	if (!(flags & PW_MEMBLOCK_FLAG_WITH_FD) || (flags & PW_MEMBLOCK_FLAG_MAP_TWICE))
+		return -ENOTSUP;
+
+	alloc_size = SPA_ROUND_UP_N(size, arena->page_size);
+
+	spa_list_for_each(a, &arena->arenas, link) {
+		if (a->tag != tag)
+			continue;
+		spa_list_for_each(r, &a->free, link) {
+			if (r->size >= alloc_size)
+				goto found;
+		}
+	}
+	if ((a = arena_add(arena, tag, alloc_size)) == NULL)
+		return -ENOMEM;
+	r = spa_list_first(&a->free, struct arena_range, link);
+
+      found:
+	mem->flags = flags | PW_MEMBLOCK_FLAG_ARENA;
+	mem->fd = a->mem.fd;
+	mem->offset = r->offset;
+	mem->ptr = SPA_MEMBER(a->mem.ptr, r->offset, void);
+	mem->size = size;
+
+	r->offset += alloc_size;
+	r->size -= alloc_size;
+	if (r->size == 0) {
+		spa_list_remove(&r->link);
+		free(r);
+	}
+	a->used += alloc_size;
+
+	return 0;
+}
+
+/** Free a memblock of an arena
+ * \param arena an arena
+ * \param mem a memblock allocated with pw_memblock_arena_alloc()
+ *
+ * A memfd is freed when it has no more used blocks.
+ * \memberof pw_memblock_arena
+ */
+void pw_memblock_arena_free(struct pw_memblock_arena *arena, struct pw_memblock *mem)
+{
+	struct arena *a;
+	struct arena_range *r, *prev = NULL, *n;
+	size_t offset, size;
+
+	if (mem == NULL || !(mem->flags & PW_MEMBLOCK_FLAG_ARENA))
+		return;
+
+	spa_list_for_each(a, &arena->arenas, link) {
+		if (a->mem.fd == mem->fd)
+			break;
+	}
+	if (&a->link == &arena->arenas) {
+		pw_log_warn("arena %p: unknown block %p with fd %d", arena, mem, mem->fd);
+		return;
+	}
+
+	offset = mem->offset;
+	size = SPA_ROUND_UP_N(mem->size, arena->page_size);
+	mem->ptr = NULL;
+	mem->fd = -1;
+
+	a->used -= size;
+	if (a->used == 0) {
+		arena_free(a);
+		return;
+	}
+
+	/* insert sorted and merge with the neighbours */
+	spa_list_for_each(r, &a->free, link) {
+		if (r->offset > offset)
+			break;
+		prev = r;
+	}
+	if (prev && prev->offset + prev->size == offset) {
+		prev->size += size;
+		n = prev;
+	} else {
+		if ((n = calloc(1, sizeof(struct arena_range))) == NULL)
+			return;
+		n->offset = offset;
+		n->size = size;
+		spa_list_append(&r->link, &n->link);
+	}
+	if (&r->link != &a->free && n->offset + n->size == r->offset) {
+		n->size += r->size;
+		spa_list_remove(&r->link);
+		free(r);
+	}
+}
+
+/** \cond */
+struct pool_block {
+	struct spa_list link;
+	enum pw_memblock_flags flags;	/**< flags of the allocation */
+	struct pw_memblock mem;
+	uint32_t tag;
+	bool locked;
+};
+
+struct pool_lock {
+	struct spa_list link;
+	uint32_t tag;
+	struct pw_memlock lock;
+};
+
+struct pw_memblock_pool {
+	struct pw_memblock_arena *arena;	/**< arena for new blocks or NULL */
+	struct spa_list locks;		/**< locked memory of each tag */
+	size_t lock_limit;		/**< max locked memory of a tag */
+	struct spa_list free;	/**< blocks that can be reused, oldest first */
+	struct spa_list used;	/**< blocks that are handed out */
+	size_t free_size;	/**< total size of the free blocks */
+	size_t max_size;	/**< max total size of the free blocks */
+};
+/** \endcond */
+
+/** Make a new memblock pool
+ * \param arena an arena to allocate new blocks from or NULL
+ * \param max_size the maximum size of the memory that is kept for reuse
+ * \return a new pool or NULL
+ * \memberof pw_memblock_pool
+ */
+struct pw_memblock_pool *pw_memblock_pool_new(struct pw_memblock_arena *arena, size_t max_size)
+{
+	struct pw_memblock_pool *pool;
+
+	pool = calloc(1, sizeof(struct pw_memblock_pool));
+	if (pool == NULL)
+		return NULL;
+
+	spa_list_init(&pool->free);
+	spa_list_init(&pool->used);
+	spa_list_init(&pool->locks);
+	pool->arena = arena;
+	pool->max_size = max_size;
+
+	return pool;
+}
+
+static struct pool_lock *pool_find_lock(struct pw_memblock_pool *pool, uint32_t tag)
+{
+	struct pool_lock *l;
+
+	spa_list_for_each(l, &pool->locks, link) {
+		if (l->tag == tag)
+			return l;
+	}
+	return NULL;
+}
+
+static bool pool_block_lock(struct pw_memblock_pool *pool, struct pool_block *b)
+{
+	struct pool_lock *l;
+
+	if ((l = pool_find_lock(pool, b->tag)) == NULL) {
+		if ((l = calloc(1, sizeof(struct pool_lock))) == NULL)
+			return false;
+		l->tag = b->tag;
+		l->lock.limit = pool->lock_limit;
+		spa_list_append(&pool->locks, &l->link);
+	}
+	if (pw_memlock_lock(&l->lock, b->mem.ptr, b->mem.size) < 0) {
+		if (l->lock.locked == 0) {
+			spa_list_remove(&l->link);
+			free(l);
+		}
+		return false;
+	}
+	pw_log_debug("pool %p: tag %u locked %zd bytes", pool, b->tag, l->lock.locked);
+	return true;
+}
+
+static void pool_block_unlock(struct pw_memblock_pool *pool, struct pool_block *b)
+{
+	struct pool_lock *l;
+
+	if ((l = pool_find_lock(pool, b->tag)) == NULL)
+		return;
+
+	pw_memlock_unlock(&l->lock, b->mem.ptr, b->mem.size);
+	if (l->lock.locked == 0) {
+		spa_list_remove(&l->link);
+		free(l);
+	}
+}
+
+static void pool_block_free(struct pw_memblock_pool *pool, struct pool_block *b)
+{
+	spa_list_remove(&b->link);
+	if (b->locked)
+		pool_block_unlock(pool, b);
+	if (b->mem.flags & PW_MEMBLOCK_FLAG_ARENA)
+		pw_memblock_arena_free(pool->arena, &b->mem);
+	else
+		pw_memblock_free(&b->mem);
+	free(b);
+}
+
+/** Destroy a memblock pool
+ * \param pool a pool
+ *
+ * The free blocks are freed. Blocks that are still used are not tracked
+ * anymore and must be freed with pw_memblock_free(), or are freed with
+ * the arena of the pool.
+ * \memberof pw_memblock_pool
+ */
+void pw_memblock_pool_destroy(struct pw_memblock_pool *pool)
+{
+	struct pool_block *b, *t;
+	struct pool_lock *l, *tl;
+
+	spa_list_for_each_safe(b, t, &pool->free, link)
+		pool_block_free(pool, b);
+	spa_list_for_each_safe(b, t, &pool->used, link) {
+		spa_list_remove(&b->link);
+		free(b);
+	}
+	spa_list_for_each_safe(l, tl, &pool->locks, link)
+		free(l);
+	free(pool);
+}
+
+/** Allocate a memblock from a pool
+ * \param pool a pool
+ * \param flags memblock flags
+ * \param tag blocks are only reused for the same tag, PW_MEMBLOCK_POOL_TAG_NONE
+ *	allocates a block that is not reused
+ * \param size size to allocate
+ * \param[out] mem memblock structure to fill
+ * \return 0 on success, < 0 on error
+ *
+ * A new block has its pages faulted in. Reused blocks are not cleared.
+ * \memberof pw_memblock_pool
+ */
+int pw_memblock_pool_alloc(struct pw_memblock_pool *pool, enum pw_memblock_flags flags,
+			   uint32_t tag, size_t size, struct pw_memblock *mem)
+{
+	struct pool_block *b;
+	enum pw_memblock_flags alloc_flags = flags & ~PW_MEMBLOCK_FLAG_MAP_LOCK;
+	int res;
+
+	if (tag == PW_MEMBLOCK_POOL_TAG_NONE ||
+	    !(flags & PW_MEMBLOCK_FLAG_WITH_FD) || (flags & PW_MEMBLOCK_FLAG_MAP_TWICE))
+		return pw_memblock_alloc(flags, size, mem);
+	if (pool->max_size == 0 && pool->arena == NULL)
+		return pw_memblock_alloc(flags, size, mem);
+
+	/* the most recently released block is the most likely to be in the cache */
+	spa_list_for_each_reverse(b, &pool->free, link) {
+		if (b->flags != flags || b->mem.size != size || b->tag != tag)
+			continue;
+
+		spa_list_remove(&b->link);
+		spa_list_append(&pool->used, &b->link);
+		pool->free_size -= size;
+		if ((flags & PW_MEMBLOCK_FLAG_MAP_LOCK) && !b->locked &&
+		    (b->locked = pool_block_lock(pool, b)))
+			b->mem.flags |= PW_MEMBLOCK_FLAG_MAP_LOCK;
+		*mem = b->mem;
+		return 0;
+	}
+
+	b = calloc(1, sizeof(struct pool_block));
+	if (b == NULL)
+		return -ENOMEM;
+
+	if (pool->arena == NULL ||
+	    pw_memblock_arena_alloc(pool->arena, alloc_flags, tag, size, &b->mem) < 0) {
+		if ((res = pw_memblock_alloc(alloc_flags, size, &b->mem)) < 0) {
+			free(b);
+			return res;
+		}
+	}
+	if (b->mem.ptr && (flags & PW_MEMBLOCK_FLAG_MAP_WRITE))
+		memset(b->mem.ptr, 0, size);
+
+	b->flags = flags;
+	b->tag = tag;
+	if ((flags & PW_MEMBLOCK_FLAG_MAP_LOCK) && (b->locked = pool_block_lock(pool, b)))
+		b->mem.flags |= PW_MEMBLOCK_FLAG_MAP_LOCK;
+	spa_list_append(&pool->used, &b->link);
+	*mem = b->mem;
+
+	return 0;
+}
+
+/** Release a memblock to a pool
+ * \param pool a pool
+ * \param mem a memblock
+ *
+ * When \a mem was allocated from \a pool, it is kept for reuse, else
+ * it is freed.
+ * \memberof pw_memblock_pool
+ */
+void pw_memblock_pool_release(struct pw_memblock_pool *pool, struct pw_memblock *mem)
+{
+	struct pool_block *b, *t;
+
+	if (mem == NULL || mem->fd == -1) {
+		pw_memblock_free(mem);
+		return;
+	}
+
+	spa_list_for_each(b, &pool->used, link) {
+		if (b->mem.fd == mem->fd && b->mem.ptr == mem->ptr)
+			break;
+	}
+	if (&b->link == &pool->used) {
+		if ((mem->flags & PW_MEMBLOCK_FLAG_ARENA) && pool->arena)
+			pw_memblock_arena_free(pool->arena, mem);
+		else
+			pw_memblock_free(mem);
+		return;
+	}
+
+	spa_list_remove(&b->link);
+	spa_list_append(&pool->free, &b->link);
+	pool->free_size += b->mem.size;
+
+	spa_list_for_each_safe(b, t, &pool->free, link) {
+		if (pool->free_size <= pool->max_size)
+			break;
+		pool->free_size -= b->mem.size;
+		pool_block_free(pool, b);
+	}
+	mem->ptr = NULL;
+	mem->fd = -1;
+}
+
+/** Set the max locked memory of a tag
+ * \param pool a pool
+ * \param limit max bytes that are locked for the blocks of a tag, 0 is
+ *	no limit
+ *
+ * Blocks that can't be locked anymore are only faulted in.
+ * \memberof pw_memblock_pool
+ */
+void pw_memblock_pool_set_lock_limit(struct pw_memblock_pool *pool, size_t limit)
+{
+	struct pool_lock *l;
+
+	pool->lock_limit = limit;
+	spa_list_for_each(l, &pool->locks, link)
+		l->lock.limit = limit;
+}
+
+/** Get the shared memfd of an fd received from the server
+ * \param maps the list of memfds of the receiver
+ * \param fd an fd, owned by the memmap after this call
+ * \param shared when the fd can be the same memfd as other fds
+ * \return a memmap with one more reference or NULL on error
+ *
+ * The buffers of the links of a client are carved out of a few memfds, the
+ * server sends a new fd for each mem_id. When \a fd refers to a memfd that
+ * is already in \a maps, \a fd is closed and the existing memmap is used
+ * so that each memfd is kept open and mapped only once.
+ */
+struct pw_memmap *pw_memmap_get(struct spa_list *maps, int fd, bool shared)
+{
+	struct pw_memmap *map;
+	struct stat st;
+
+	if (shared && fstat(fd, &st) == 0) {
+		spa_list_for_each(map, maps, link) {
+			if (map->dev == st.st_dev && map->ino == st.st_ino) {
+				close(fd);
+				map->ref++;
+				return map;
+			}
+		}
+	} else
+		shared = false;
+
+	if ((map = calloc(1, sizeof(struct pw_memmap))) == NULL) {
+		close(fd);
+		return NULL;
+	}
+	map->fd = fd;
+	map->ref = 1;
+	if (shared) {
+		map->dev = st.st_dev;
+		map->ino = st.st_ino;
+		map->file_size = st.st_size;
+		spa_list_append(maps, &map->link);
+	} else
+		spa_list_init(&map->link);
+
+	return map;
+}
+
+/** Map a memmap
+ * \param map a memmap
+ * \param prot the protection of the mapping
+ * \param size the minimum size of the mapping
+ * \return the start of the mapping of the whole memfd or NULL on error
+ *
+ * The first call maps the whole memfd, later calls reuse the mapping and
+ * add \a prot to it when needed. Each call must be balanced with
+ * pw_memmap_unmap().
+ */
+void *pw_memmap_map(struct pw_memmap *map, int prot, size_t size)
+{
+	if (map->ptr == NULL) {
+		size = SPA_MAX(size, map->file_size);
+		map->ptr = mmap(NULL, size, prot, MAP_SHARED, map->fd, 0);
+		if (map->ptr == MAP_FAILED) {
+			map->ptr = NULL;
+			return NULL;
+		}
+		map->prot = prot;
+		map->size = size;
+		pw_log_debug("memmap %p: map fd %d size %zd %p", map, map->fd, size, map->ptr);
+	} else if (size > map->size) {
+		errno = ENOSPC;
+		return NULL;
+	} else if ((map->prot | prot) != map->prot) {
+		if (mprotect(map->ptr, map->size, map->prot | prot) < 0)
+			return NULL;
+		map->prot |= prot;
+	}
+	map->map_ref++;
+	return map->ptr;
+}
+
+/** Release a mapping made with pw_memmap_map() */
+void pw_memmap_unmap(struct pw_memmap *map)
+{
+	if (map->map_ref == 0 || --map->map_ref > 0)
+		return;
+
+	munmap(map->ptr, map->size);
+	map->ptr = NULL;
+	map->size = 0;
+}
+
+/** Lock the mapping of a memmap
+ * \param map a mapped memmap
+ * \param lock the locked memory of the owner
+ * \return 0 when the mapping is locked, < 0 when it is only faulted in
+ *
+ * The whole mapping is locked once, so that the pages that are shared by
+ * the mem_ids of the memfd are counted only once. Each call must be
+ * balanced with pw_memmap_unlock() before the mapping is released.
+ */
+int pw_memmap_lock(struct pw_memmap *map, struct pw_memlock *lock)
+{
+	int res;
+
+	if (map->lock_ref++ > 0)
+		return map->locked ? 0 : -ENOSPC;
+
+	res = pw_memlock_lock(lock, map->ptr, map->size);
+	map->locked = res == 0;
+	return res;
+}
+
+/** Release a lock made with pw_memmap_lock() */
+void pw_memmap_unlock(struct pw_memmap *map, struct pw_memlock *lock)
+{
+	if (map->lock_ref == 0 || --map->lock_ref > 0)
+		return;
+
+	if (map->locked)
+		pw_memlock_unlock(lock, map->ptr, map->size);
+	map->locked = false;
+}
+
+/** Release a memmap, the fd is closed when this was the last reference */
+void pw_memmap_put(struct pw_memmap *map)
+{
+	if (--map->ref > 0)
+		return;
+
+	if (map->ptr != NULL)
+		munmap(map->ptr, map->size);
+	close(map->fd);
+	spa_list_remove(&map->link);
+	free(map);
+}
@@ -34,6 +34,10 @@ enum pw_memblock_flags {
 	PW_MEMBLOCK_FLAG_MAP_READ = (1 << 2),
 	PW_MEMBLOCK_FLAG_MAP_WRITE = (1 << 3),
 	PW_MEMBLOCK_FLAG_MAP_TWICE = (1 << 4),
+	PW_MEMBLOCK_FLAG_ARENA = (1 << 5),	/**< block is part of an arena, set by
+						  *  pw_memblock_arena_alloc() */
+	PW_MEMBLOCK_FLAG_MAP_LOCK = (1 << 6),	/**< fault in the pages and lock them in
+						  *  memory, removed when locking fails */
 };
 
 #define PW_MEMBLOCK_FLAG_MAP_READWRITE (PW_MEMBLOCK_FLAG_MAP_READ | PW_MEMBLOCK_FLAG_MAP_WRITE)
@@ -57,6 +61,79 @@ pw_memblock_map(struct pw_memblock *mem);
 void
 pw_memblock_free(struct pw_memblock *mem);
 
+/** \class pw_memlock
+ * Memory that is locked for an owner
+ *
+ * Locking fails when \a limit would be exceeded or when the process hits
+ * RLIMIT_MEMLOCK, the pages are then only faulted in.
+ */
+struct pw_memlock {
+	size_t locked;		/**< bytes that are locked */
+	size_t limit;		/**< max bytes to lock, 0 is no limit */
+	uint32_t n_failed;	/**< number of times locking failed */
+};
+
+int
+pw_memlock_lock(struct pw_memlock *lock, void *ptr, size_t size);
+
+void
+pw_memlock_unlock(struct pw_memlock *lock, void *ptr, size_t size);
+
+/** \class pw_memblock_arena
+ * Blocks carved out of a few large memfds
+ *
+ * An arena is one sealed memfd that holds many blocks, all blocks share
+ * the fd and the mapping of the arena and have their own offset. Blocks
+ * are only allocated from the arenas with the same tag. When the arenas
+ * of a tag are full, a new arena of double the size is added.
+ */
+struct pw_memblock_arena;
+
+struct pw_memblock_arena *
+pw_memblock_arena_new(size_t arena_size);
+
+void
+pw_memblock_arena_destroy(struct pw_memblock_arena *arena);
+
+int
+pw_memblock_arena_alloc(struct pw_memblock_arena *arena, enum pw_memblock_flags flags,
+			uint32_t tag, size_t size, struct pw_memblock *mem);
+
+void
+pw_memblock_arena_free(struct pw_memblock_arena *arena, struct pw_memblock *mem);
+
+/** \class pw_memblock_pool
+ * A pool of memblocks that can be reused
+ *
+ * Blocks that are released to the pool stay mapped and keep their pages
+ * and are handed out again for an allocation with the same flags, size
+ * and tag. Only blocks with an fd are pooled. New blocks are allocated
+ * from the arena of the pool, when there is one.
+ *
+ * Blocks allocated with PW_MEMBLOCK_FLAG_MAP_LOCK are locked as long as
+ * they are in the pool. The locked memory is counted for each tag.
+ */
+struct pw_memblock_pool;
+
+/** Tag of memblocks that must not be reused \memberof pw_memblock_pool */
+#define PW_MEMBLOCK_POOL_TAG_NONE	SPA_ID_INVALID
+
+struct pw_memblock_pool *
+pw_memblock_pool_new(struct pw_memblock_arena *arena, size_t max_size);
+
+void
+pw_memblock_pool_destroy(struct pw_memblock_pool *pool);
+
+int
+pw_memblock_pool_alloc(struct pw_memblock_pool *pool, enum pw_memblock_flags flags,
+		       uint32_t tag, size_t size, struct pw_memblock *mem);
+
+void
+pw_memblock_pool_release(struct pw_memblock_pool *pool, struct pw_memblock *mem);
+
+void
+pw_memblock_pool_set_lock_limit(struct pw_memblock_pool *pool, size_t limit);
+
 #ifdef __cplusplus
 }
 #endif
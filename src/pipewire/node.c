@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <inttypes.h>
 
 #include <spa/clock/clock.h>
 
@@ -38,8 +39,15 @@ struct impl {
 	struct pw_node this;
 
 	struct pw_work_queue *work;
+
+	struct spa_graph_node_profile profile;	/**< written by the data thread */
+	uint64_t profile_cycles;		/**< cycles in the last update */
+	struct spa_source *profile_timer;	/**< armed while running and bound */
+	bool profile_timer_armed;
 };
 
+#define PROFILE_INTERVAL_SEC	1
+
 struct resource_data {
 	struct spa_hook resource_listener;
 };
@@ -296,6 +304,74 @@ static const struct pw_resource_events resource_events = {
 	.destroy = node_unbind_func,
 };
 
+/* copy the statistics into the properties when the node was processed
+ * since the last time, returns true when the properties changed */
+static bool update_profile(struct pw_node *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct spa_graph_node_profile p;
+
+	if (!spa_graph_node_profile_read(&impl->profile, &p) ||
+	    p.cycles == impl->profile_cycles)
+		return false;
+
+	impl->profile_cycles = p.cycles;
+
+	pw_properties_setf(this->properties, PW_NODE_PROP_PROFILE_CYCLES, "%" PRIu64, p.cycles);
+	pw_properties_setf(this->properties, PW_NODE_PROP_PROFILE_LAST, "%" PRIu64, p.last_ns);
+	pw_properties_setf(this->properties, PW_NODE_PROP_PROFILE_AVG, "%" PRIu64, p.avg_ns);
+	pw_properties_setf(this->properties, PW_NODE_PROP_PROFILE_MAX, "%" PRIu64, p.max_ns);
+	pw_properties_setf(this->properties, PW_NODE_PROP_PROFILE_WAKEUP, "%" PRIu64, p.wakeup_ns);
+	pw_properties_setf(this->properties, PW_NODE_PROP_PROFILE_XRUNS, "%" PRIu64, p.xruns);
+	this->info.props = &this->properties->dict;
+
+	return true;
+}
+
+/* the statistics are sent periodically only while the node runs and
+ * a client is bound to it */
+static void update_profile_timer(struct pw_node *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct timespec interval = { PROFILE_INTERVAL_SEC, 0 };
+	bool arm;
+
+	if (impl->profile_timer == NULL)
+		return;
+
+	arm = this->info.state == PW_NODE_STATE_RUNNING &&
+	      !spa_list_is_empty(&this->resource_list);
+	if (arm == impl->profile_timer_armed)
+		return;
+
+	impl->profile_timer_armed = arm;
+	if (arm)
+		pw_loop_update_timer(this->core->main_loop, impl->profile_timer,
+				     &interval, &interval, false);
+	else
+		pw_loop_update_timer(this->core->main_loop, impl->profile_timer,
+				     NULL, NULL, false);
+}
+
+static void on_profile_timeout(void *data, uint64_t expirations)
+{
+	struct pw_node *this = data;
+	struct pw_resource *resource;
+
+	/* the last client could have gone away since the last update */
+	update_profile_timer(this);
+	if (!update_profile(this))
+		return;
+
+	this->info.change_mask = PW_NODE_CHANGE_MASK_PROPS;
+	spa_hook_list_call(&this->listener_list, struct pw_node_events, info_changed, &this->info);
+
+	spa_list_for_each(resource, &this->resource_list, link)
+		pw_node_resource_info(resource, &this->info);
+
+	this->info.change_mask = 0;
+}
+
 static int
 node_bind_func(struct pw_global *global,
 	       struct pw_client *client, uint32_t permissions,
@@ -316,10 +392,15 @@ node_bind_func(struct pw_global *global,
 
 	spa_list_append(&this->resource_list, &resource->link);
 
+	/* the statistics are only published when someone looks at them */
+	update_profile(this);
+
 	this->info.change_mask = ~0;
 	pw_node_resource_info(resource, &this->info);
 	this->info.change_mask = 0;
 
+	update_profile_timer(this);
+
 	return 0;
 
       no_mem:
@@ -411,6 +492,11 @@ struct pw_node *pw_node_new(struct pw_core *core,
 	pw_map_init(&this->output_port_map, 64, 64);
 
 	spa_graph_node_init(&this->rt.node);
+	spa_graph_node_set_profile(&this->rt.node, &impl->profile);
+
+	impl->profile_timer = pw_loop_add_timer(core->main_loop, on_profile_timeout, this);
+	if (impl->profile_timer == NULL)
+		pw_log_warn("node %p: can't create profile timer", this);
 
 	return this;
 
@@ -582,6 +668,9 @@ void pw_node_destroy(struct pw_node *node)
 
 	pw_loop_invoke(node->data_loop, do_node_remove, 1, 0, NULL, true, node);
 
+	if (impl->profile_timer)
+		pw_loop_destroy_source(node->core->main_loop, impl->profile_timer);
+
 	if (node->global) {
 		spa_list_remove(&node->link);
 		pw_global_destroy(node->global);
@@ -855,12 +944,16 @@ void pw_node_update_state(struct pw_node *node, enum pw_node_state state, char *
 				 old, state, error);
 
 		node->info.change_mask |= PW_NODE_CHANGE_MASK_STATE;
+		if (update_profile(node))
+			node->info.change_mask |= PW_NODE_CHANGE_MASK_PROPS;
 		spa_hook_list_call(&node->listener_list, struct pw_node_events, info_changed, &node->info);
 
 		spa_list_for_each(resource, &node->resource_list, link)
 			pw_node_resource_info(resource, &node->info);
 
 		node->info.change_mask = 0;
+
+		update_profile_timer(node);
 	}
 }
 
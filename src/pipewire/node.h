@@ -94,6 +94,18 @@ struct pw_node_events {
 /** Try to connect the node to this node id */
 #define PW_NODE_PROP_TARGET_NODE	"pipewire.target.node"
 
+/** Processing statistics, updated when a client binds to the node, when
+ * the state of the node changes and about once per second while the node
+ * runs and a client is bound to it */
+#define PW_NODE_PROP_PROFILE_CYCLES	"pipewire.node.profile.cycles"	/**< times processed */
+#define PW_NODE_PROP_PROFILE_LAST	"pipewire.node.profile.last-ns"	/**< last processing time */
+#define PW_NODE_PROP_PROFILE_AVG	"pipewire.node.profile.avg-ns"	/**< average processing time */
+#define PW_NODE_PROP_PROFILE_MAX	"pipewire.node.profile.max-ns"	/**< longest processing time */
+#define PW_NODE_PROP_PROFILE_WAKEUP	"pipewire.node.profile.wakeup-ns"	/**< delay from the start
+										  *  of the cycle */
+#define PW_NODE_PROP_PROFILE_XRUNS	"pipewire.node.profile.xruns"	/**< processing that ended
+									  *  after the cycle period */
+
 /** Create a new node \memberof pw_node */
 struct pw_node *
 pw_node_new(struct pw_core *core,		/**< the core */
@@ -29,6 +29,8 @@
 #include <errno.h>
 #include <dlfcn.h>
 
+#include <spa/support/type-map-static.h>
+
 #include "pipewire/pipewire.h"
 #include "pipewire/private.h"
 
@@ -95,7 +97,8 @@ load_interface(struct support_info *info,
         }
 
 	map = pw_get_support_interface(SPA_TYPE__TypeMap);
-	type_id = map ? spa_type_map_get_id(map, type) : 0;
+	type_id = map ? spa_type_map_get_id(map, type) :
+		SPA_TYPE_STATIC_ID(SPA_TYPE__TypeMap);
 
         if ((res = spa_handle_get_interface(handle, type_id, &iface)) < 0) {
                 fprintf(stderr, "can't get %s interface %d\n", type, res);
@@ -21,15 +21,42 @@
 #include <stdlib.h>
 #include <errno.h>
 
+#include <spa/param/audio/format-utils.h>
+#include <spa/lib/mix.h>
+
 #include "pipewire/pipewire.h"
 #include "pipewire/private.h"
 #include "pipewire/port.h"
 
 /** \cond */
+struct type {
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+}
+
 struct impl {
 	struct pw_port this;
 
 	struct spa_node mix_node;
+
+	struct type type;
+	struct spa_audiomixer_ops ops;
+	int conv;			/**< CONV_ of the format or -1 when we can't mix */
+
+	struct {
+		bool mixing;		/**< mix all inputs into the port buffers */
+		uint32_t mix_index;	/**< next port buffer to mix into */
+	} rt;
 };
 /** \endcond */
 
@@ -97,6 +124,112 @@ static const struct spa_node schedule_tee_node = {
 	.port_reuse_buffer = schedule_tee_reuse_buffer,
 };
 
+static void mix_reuse_input(struct spa_graph_port *p, uint32_t buffer_id)
+{
+	struct pw_link *link = p->scheduler_data;
+	struct spa_graph_port *pp;
+
+	if ((pp = p->peer) != NULL) {
+		pw_log_trace("mix reuse input buffer %d", buffer_id);
+		spa_node_port_reuse_buffer(pp->node->implementation,
+					   link->output->port_id, buffer_id);
+	}
+}
+
+static void mix_data(struct impl *impl, void *dst, const void *src, float volume,
+		     int n_bytes, int layer)
+{
+	struct spa_audiomixer_ops *ops = &impl->ops;
+	int conv = impl->conv;
+
+	if (volume == 1.0f) {
+		if (layer == 0)
+			ops->copy[conv](dst, src, n_bytes);
+		else
+			ops->add[conv](dst, src, n_bytes);
+	}
+	else {
+		if (layer == 0)
+			ops->copy_volume[conv](dst, src, &volume, n_bytes);
+		else
+			ops->add_volume[conv](dst, src, &volume, n_bytes);
+	}
+}
+
+static int mix_inputs(struct impl *impl)
+{
+	struct pw_port *this = &impl->this;
+	struct spa_graph_node *node = &this->rt.mix_node;
+	struct spa_graph_port *p;
+	struct spa_port_io *io = this->rt.mix_port.io;
+	struct spa_buffer *outbuf;
+	struct spa_data *od;
+	uint32_t n_bytes;
+	int layer;
+
+	if (io->status == SPA_STATUS_HAVE_BUFFER)
+		return io->status;
+
+	outbuf = this->buffers[impl->rt.mix_index];
+	od = outbuf->datas;
+	n_bytes = od[0].maxsize;
+
+	/* mix the amount of data that is available on all inputs */
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		struct pw_link *link = p->scheduler_data;
+		struct spa_data *d;
+
+		if (p->io->status != SPA_STATUS_HAVE_BUFFER ||
+		    p->io->buffer_id >= link->n_buffers)
+			continue;
+
+		d = link->buffers[p->io->buffer_id]->datas;
+		n_bytes = SPA_MIN(n_bytes, d[0].chunk->size);
+		n_bytes = SPA_MIN(n_bytes, d[0].maxsize - (d[0].chunk->offset % d[0].maxsize));
+	}
+
+	layer = 0;
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		struct pw_link *link = p->scheduler_data;
+		uint32_t buffer_id = p->io->buffer_id;
+		struct spa_data *d;
+
+		if (p->io->status != SPA_STATUS_HAVE_BUFFER ||
+		    buffer_id >= link->n_buffers)
+			continue;
+
+		d = link->buffers[buffer_id]->datas;
+
+		pw_log_trace("mix %p: input %p buffer %d layer %d size %d", node,
+			     p, buffer_id, layer, n_bytes);
+
+		mix_data(impl, od[0].data,
+			 SPA_MEMBER(d[0].data, d[0].chunk->offset % d[0].maxsize, void),
+			 link->volume, n_bytes, layer++);
+
+		p->io->buffer_id = SPA_ID_INVALID;
+		p->io->status = SPA_STATUS_OK;
+		mix_reuse_input(p, buffer_id);
+	}
+
+	if (layer == 0) {
+		io->status = SPA_STATUS_NEED_BUFFER;
+		return io->status;
+	}
+
+	od[0].chunk->offset = 0;
+	od[0].chunk->size = n_bytes;
+	od[0].chunk->stride = 0;
+
+	io->buffer_id = outbuf->id;
+	io->status = SPA_STATUS_HAVE_BUFFER;
+
+	if (++impl->rt.mix_index >= this->n_buffers)
+		impl->rt.mix_index = 0;
+
+	return io->status;
+}
+
 static int schedule_mix_input(struct spa_node *data)
 {
 	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, mix_node);
@@ -105,6 +238,9 @@ static int schedule_mix_input(struct spa_node *data)
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
 
+	if (impl->rt.mixing)
+		return mix_inputs(impl);
+
 	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
 		pw_log_trace("mix %p: input %p %p->%p %d %d", node,
 				p, p->io, io, p->io->status, p->io->buffer_id);
@@ -123,8 +259,20 @@ static int schedule_mix_output(struct spa_node *data)
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
 
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
-		*p->io = *io;
+	if (impl->rt.mixing) {
+		/* the buffers of the port are ours, only pass the request upstream */
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+			if (p->io->status == SPA_STATUS_HAVE_BUFFER)
+				continue;
+			p->io->status = io->status;
+			p->io->range = io->range;
+		}
+		io->buffer_id = SPA_ID_INVALID;
+	}
+	else {
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
+			*p->io = *io;
+	}
 	pw_log_trace("mix output %d %d", io->status, io->buffer_id);
 	return io->status;
 }
@@ -134,14 +282,16 @@ static int schedule_mix_reuse_buffer(struct spa_node *data, uint32_t port_id, ui
 	struct impl *impl = SPA_CONTAINER_OF(data, struct impl, mix_node);
 	struct pw_port *this = &impl->this;
 	struct spa_graph_node *node = &this->rt.mix_node;
-	struct spa_graph_port *p, *pp;
+	struct spa_graph_port *p;
+
+	/* the upstream buffers were recycled when mixing, the port buffers
+	 * are reused in order */
+	if (impl->rt.mixing)
+		return 0;
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
+		mix_reuse_input(p, buffer_id);
 
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
-		if ((pp = p->peer) != NULL) {
-			pw_log_trace("mix reuse buffer %d %d", port_id, buffer_id);
-			spa_node_port_reuse_buffer(pp->node->implementation, port_id, buffer_id);
-		}
-	}
 	return 0;
 }
 
@@ -195,6 +345,7 @@ struct pw_port *pw_port_new(enum pw_direction direction,
 
 	impl->mix_node = this->direction == PW_DIRECTION_INPUT ?  schedule_mix_node : schedule_tee_node;
 	spa_graph_node_set_implementation(&this->rt.mix_node, &impl->mix_node);
+	impl->conv = -1;
 	spa_graph_port_init(&this->rt.mix_port,
 			    pw_direction_reverse(this->direction),
 			    0,
@@ -269,10 +420,14 @@ static int do_add_port(struct spa_loop *loop,
 
 bool pw_port_add(struct pw_port *port, struct pw_node *node)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	uint32_t port_id = port->port_id;
 
 	port->node = node;
 
+	init_type(&impl->type, node->core->type.map);
+	spa_audiomixer_get_ops(&impl->ops, spa_cpu_get_flags());
+
 	pw_log_debug("port %p: add to node %p", port, node);
 	if (port->direction == PW_DIRECTION_INPUT) {
 		spa_list_insert(&node->input_ports, &port->link);
@@ -345,7 +500,7 @@ void pw_port_destroy(struct pw_port *port)
 
 	if (port->allocated) {
 		free(port->buffers);
-		pw_memblock_free(&port->buffer_mem);
+		pw_memblock_pool_release(node->core->buffer_pool, &port->buffer_mem);
 	}
 
 	if (port->properties)
@@ -364,9 +519,62 @@ do_port_pause(struct spa_loop *loop,
 				&SPA_COMMAND_INIT(node->core->type.command_node.Pause));
 }
 
+static int get_conv(struct impl *impl, const struct spa_pod *format)
+{
+	struct type *t = &impl->type;
+	struct spa_audio_info info = { 0 };
+
+	if (format == NULL)
+		return -1;
+
+	spa_pod_object_parse(format,
+		"I", &info.media_type,
+		"I", &info.media_subtype);
+
+	if (info.media_type != t->media_type.audio ||
+	    info.media_subtype != t->media_subtype.raw)
+		return -1;
+
+	if (spa_format_audio_raw_parse(format, &info.info.raw, &t->format_audio) < 0)
+		return -1;
+
+	if (info.info.raw.layout != SPA_AUDIO_LAYOUT_INTERLEAVED)
+		return -1;
+	if (info.info.raw.format == t->audio_format.S16)
+		return CONV_S16_S16;
+	if (info.info.raw.format == t->audio_format.F32)
+		return CONV_F32_F32;
+
+	return -1;
+}
+
+static int
+do_set_mixing(struct spa_loop *loop,
+	      bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct impl *impl = user_data;
+	impl->rt.mixing = *(bool *) data;
+	impl->rt.mix_index = 0;
+	return 0;
+}
+
+static void port_set_mixing(struct pw_port *port, bool mixing)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+
+	if (port->mixing == mixing)
+		return;
+
+	pw_log_debug("port %p: mixing %d", port, mixing);
+	port->mixing = mixing;
+	pw_loop_invoke(port->node->data_loop,
+		       do_set_mixing, SPA_ID_INVALID, sizeof(bool), &mixing, true, impl);
+}
+
 int pw_port_set_param(struct pw_port *port, uint32_t id, uint32_t flags,
 		      const struct spa_pod *param)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	int res;
 
 	res = spa_node_port_set_param(port->node->node, port->direction, port->port_id, id, flags, param);
@@ -374,9 +582,13 @@ int pw_port_set_param(struct pw_port *port, uint32_t id, uint32_t flags,
 
 	if (!SPA_RESULT_IS_ASYNC(res) && id == port->node->core->type.param.idFormat) {
 		if (param == NULL || res < 0) {
+			port_set_mixing(port, false);
+			impl->conv = -1;
+			port->mix = NULL;
 			if (port->allocated) {
 				free(port->buffers);
-				pw_memblock_free(&port->buffer_mem);
+				pw_memblock_pool_release(port->node->core->buffer_pool,
+							 &port->buffer_mem);
 			}
 			port->buffers = NULL;
 			port->n_buffers = 0;
@@ -384,6 +596,12 @@ int pw_port_set_param(struct pw_port *port, uint32_t id, uint32_t flags,
 			port_update_state (port, PW_PORT_STATE_CONFIGURE);
 		}
 		else {
+			/* input ports with a format we can mix accept multiple links */
+			impl->conv = get_conv(impl, param);
+			if (port->direction == PW_DIRECTION_INPUT && impl->conv >= 0)
+				port->mix = &impl->mix_node;
+			else
+				port->mix = NULL;
 			port_update_state (port, PW_PORT_STATE_READY);
 		}
 	}
@@ -406,12 +624,14 @@ int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint3
 		port_update_state (port, PW_PORT_STATE_PAUSED);
 	}
 
+	port_set_mixing(port, false);
+
 	pw_log_debug("port %p: use %d buffers", port, n_buffers);
 	res = spa_node_port_use_buffers(port->node->node, port->direction, port->port_id, buffers, n_buffers);
 
 	if (port->allocated) {
 		free(port->buffers);
-		pw_memblock_free(&port->buffer_mem);
+		pw_memblock_pool_release(port->node->core->buffer_pool, &port->buffer_mem);
 	}
 	port->buffers = buffers;
 	port->n_buffers = n_buffers;
@@ -440,6 +660,8 @@ int pw_port_alloc_buffers(struct pw_port *port,
 		port_update_state (port, PW_PORT_STATE_PAUSED);
 	}
 
+	port_set_mixing(port, false);
+
 	pw_log_debug("port %p: alloc %d buffers", port, *n_buffers);
 
 	res = spa_node_port_alloc_buffers(port->node->node, port->direction, port->port_id,
@@ -447,7 +669,7 @@ int pw_port_alloc_buffers(struct pw_port *port,
 							  buffers, n_buffers);
 	if (port->allocated) {
 		free(port->buffers);
-		pw_memblock_free(&port->buffer_mem);
+		pw_memblock_pool_release(port->node->core->buffer_pool, &port->buffer_mem);
 	}
 	port->buffers = buffers;
 	port->n_buffers = *n_buffers;
@@ -458,3 +680,47 @@ int pw_port_alloc_buffers(struct pw_port *port,
 
 	return res;
 }
+
+/** Give the input port its own buffers to mix the data of all links into
+ *
+ * \param port an input port
+ * \param buffers the buffers, owned by the port after this call, or NULL
+ *	to mix into the buffers that the node of the port allocated
+ * \param n_buffers the number of buffers
+ * \param mem the memory of \a buffers, freed with the buffers
+ * \return 0 on success or < 0 when the port can't mix
+ *
+ * When the node allocated the buffers, the caller must first make sure
+ * that no link uses them anymore.
+ */
+int pw_port_use_mix_buffers(struct pw_port *port, struct spa_buffer **buffers,
+			    uint32_t n_buffers, struct pw_memblock *mem)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+	int res;
+
+	if (port->direction != PW_DIRECTION_INPUT || impl->conv < 0)
+		return -ENOTSUP;
+
+	if (buffers == NULL) {
+		if (!port->allocated || port->n_buffers == 0)
+			return -EINVAL;
+
+		pw_log_debug("port %p: mix into %d node buffers", port, port->n_buffers);
+		port_set_mixing(port, true);
+		return 0;
+	}
+	if (n_buffers == 0)
+		return -ENOTSUP;
+
+	pw_log_debug("port %p: use %d mix buffers", port, n_buffers);
+	if ((res = pw_port_use_buffers(port, buffers, n_buffers)) < 0)
+		return res;
+
+	port->allocated = true;
+	port->buffer_mem = *mem;
+
+	port_set_mixing(port, true);
+
+	return res;
+}
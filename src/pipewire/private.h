@@ -25,6 +25,8 @@ extern "C" {
 #endif
 
 #include <sys/socket.h>
+#include <semaphore.h>
+#include <sched.h>
 
 
 #include "pipewire/mem.h"
@@ -84,9 +86,14 @@ struct pw_client {
 	struct pw_map objects;		/**< list of resource objects */
 	uint32_t n_types;		/**< number of client types */
 	struct pw_map types;		/**< map of client types */
+	uint32_t n_types_identity;	/**< client types below this id have the same
+					  *  id in the core */
 
 	struct spa_list resource_list;	/**< The list of resources of this client */
 
+	struct pw_array permission_cache;	/**< cached permissions on the globals,
+						  *  indexed with the global id */
+
 	bool busy;
 
 	struct spa_hook_list listener_list;
@@ -104,6 +111,7 @@ struct pw_global {
 
 	struct spa_list link;		/**< link in core list of globals */
 	uint32_t id;			/**< server id of the object */
+	uint32_t serial;		/**< unique serial, ids are reused */
 	struct pw_global *parent;	/**< parent global */
 
 	uint32_t type;			/**< type of interface */
@@ -124,6 +132,7 @@ struct pw_core {
 
 	pw_permission_func_t permission_func;	/**< get permissions of an object */
 	void *permission_data;			/**< data passed to permission function */
+	uint32_t global_serial;			/**< serial of the last global */
 
 	struct pw_map globals;			/**< map of globals */
 
@@ -147,6 +156,11 @@ struct pw_core {
 	struct spa_support support[4];	/**< support for spa plugins */
 	uint32_t n_support;		/**< number of support items */
 
+	struct pw_memblock_arena *buffer_arena;	/**< memfds of the buffers of links */
+	struct pw_memblock_pool *buffer_pool;	/**< buffer memory of old links */
+	bool mlock;				/**< lock the buffer memory */
+	size_t mlock_limit;			/**< max locked buffer memory of a client */
+
 	struct {
 		struct spa_graph graph;
 	} rt;
@@ -161,8 +175,58 @@ struct pw_data_loop {
 
         bool running;
         pthread_t thread;
+
+	/* threads that help the loop thread with processing the graph */
+	uint32_t n_workers;
+	pthread_t *workers;
+	sem_t worker_sem;
+	bool workers_running;
+	void (*work) (void *data);
+	void *work_data;
+
+	/* realtime scheduling of the loop thread, saved while it is dropped */
+	bool realtime_dropped;
+	int rt_policy;
+	struct sched_param rt_param;
 };
 
+#define PW_DATA_LOOP_MAX_WORKERS	64
+
+/** Start \a n_workers realtime threads that call \a work after a wakeup */
+int pw_data_loop_start_workers(struct pw_data_loop *loop, uint32_t n_workers,
+			       void (*work) (void *data), void *data);
+
+/** Wake up \a n_workers workers */
+void pw_data_loop_wakeup_workers(struct pw_data_loop *loop, uint32_t n_workers);
+
+/** Leave or enter realtime scheduling for the loop thread, must be called
+ * from the loop thread */
+int pw_data_loop_set_realtime(struct pw_data_loop *loop, bool realtime);
+
+/** A memfd received from the server, shared by all mem_ids that refer
+ * to the same memfd */
+struct pw_memmap {
+	struct spa_list link;
+	dev_t dev;
+	ino_t ino;
+	size_t file_size;
+	int fd;			/**< the only fd of the memfd */
+	int ref;		/**< mem_ids that use the memfd */
+	void *ptr;		/**< mapping of the whole memfd */
+	size_t size;
+	int prot;
+	int map_ref;		/**< users of the mapping */
+	int lock_ref;		/**< users that want the mapping locked */
+	bool locked;		/**< the mapping is locked */
+};
+
+struct pw_memmap *pw_memmap_get(struct spa_list *maps, int fd, bool shared);
+void pw_memmap_put(struct pw_memmap *map);
+void *pw_memmap_map(struct pw_memmap *map, int prot, size_t size);
+void pw_memmap_unmap(struct pw_memmap *map);
+int pw_memmap_lock(struct pw_memmap *map, struct pw_memlock *lock);
+void pw_memmap_unlock(struct pw_memmap *map, struct pw_memlock *lock);
+
 struct pw_main_loop {
         struct pw_loop *loop;
 
@@ -186,6 +250,7 @@ struct pw_link {
 	struct spa_list resource_list;	/**< list of bound resources */
 
 	struct spa_port_io io;		/**< link io area */
+	float volume;			/**< gain when mixed into the input port */
 
 	struct pw_port *output;		/**< output port */
 	struct spa_list output_link;	/**< link in output port links */
@@ -282,6 +347,8 @@ struct pw_port {
 	struct spa_hook_list listener_list;
 
 	struct spa_node *mix;		/**< optional port buffer mix/split */
+	bool mixing;			/**< input port buffers are owned by the port and
+					  *  all links are mixed into them */
 
 	struct {
 		struct spa_graph *graph;
@@ -342,6 +409,10 @@ struct pw_remote {
 
 	uint32_t n_types;			/**< number of client types */
 	struct pw_map types;			/**< client types */
+	uint32_t n_types_identity;		/**< server types below this id have the
+						  *  same id locally */
+
+	struct pw_memlock memlock;		/**< locked buffer memory */
 
 	struct spa_list proxy_list;		/**< list of \ref pw_proxy objects */
 	struct spa_list stream_list;		/**< list of \ref pw_stream objects */
@@ -410,6 +481,17 @@ pw_core_find_port(struct pw_core *core,
 		  struct spa_pod **format_filters,
 		  char **error);
 
+/** The factory used to make converter nodes */
+#define PW_CORE_CONVERTER_FACTORY	"spa-node-factory"
+
+/** Check if a converter can be placed between 2 ports */
+bool pw_core_can_convert(struct pw_core *core,
+			 struct pw_port *output,
+			 struct pw_port *input);
+
+/** Make an audio converter node */
+struct pw_node *pw_core_create_converter(struct pw_core *core, char **error);
+
 /** Create a new port \memberof pw_port
  * \return a newly allocated port */
 struct pw_port *
@@ -439,6 +521,11 @@ int pw_port_alloc_buffers(struct pw_port *port,
 			  struct spa_pod **params, uint32_t n_params,
 			  struct spa_buffer **buffers, uint32_t *n_buffers);
 
+/** Use port owned buffers, or the buffers of its node, on an input port
+ * to mix all links into \memberof pw_port */
+int pw_port_use_mix_buffers(struct pw_port *port, struct spa_buffer **buffers,
+			    uint32_t n_buffers, struct pw_memblock *mem);
+
 /** Change the state of the node */
 int pw_node_set_state(struct pw_node *node, enum pw_node_state state);
 
@@ -19,21 +19,105 @@
 
 #include <stdio.h>
 
+#include <spa/utils/hash.h>
+
 #include "pipewire/pipewire.h"
 #include "pipewire/properties.h"
 
+/* small property sets are searched linearly, the index is made when
+ * there are this many items */
+#define INDEX_MIN_ITEMS	16
+
 /** \cond */
+struct entry {
+	uint32_t hash;
+	int index;		/* index in items or -1 when free */
+};
+
 struct properties {
 	struct pw_properties this;
 
 	struct pw_array items;
+
+	/* open addressing hash table with the indexes of the items, the size
+	 * is a power of 2 and it is kept at most half full */
+	struct entry *index;
+	uint32_t index_size;
 };
 /** \endcond */
 
+static inline struct spa_dict_item *get_item(struct properties *impl, int index)
+{
+	return pw_array_get_unchecked(&impl->items, index, struct spa_dict_item);
+}
+
+static inline int n_items(struct properties *impl)
+{
+	return pw_array_get_len(&impl->items, struct spa_dict_item);
+}
+
+static void index_insert(struct properties *impl, uint32_t hash, int index)
+{
+	uint32_t mask = impl->index_size - 1, i;
+
+	for (i = hash & mask; impl->index[i].index != -1; i = (i + 1) & mask);
+	impl->index[i].hash = hash;
+	impl->index[i].index = index;
+}
+
+static bool make_index(struct properties *impl, uint32_t size)
+{
+	struct entry *index;
+	int i, len = n_items(impl);
+
+	if ((index = malloc(size * sizeof(struct entry))) == NULL)
+		return false;
+
+	free(impl->index);
+	impl->index = index;
+	impl->index_size = size;
+	for (i = 0; i < size; i++)
+		index[i].index = -1;
+	for (i = 0; i < len; i++)
+		index_insert(impl, spa_hash_string(get_item(impl, i)->key), i);
+
+	return true;
+}
+
+/* find the slot of key in the index */
+static int index_find(struct properties *impl, uint32_t hash, const char *key)
+{
+	uint32_t mask = impl->index_size - 1, i;
+	struct entry *e;
+
+	for (i = hash & mask; (e = &impl->index[i])->index != -1; i = (i + 1) & mask) {
+		if (e->hash == hash && strcmp(get_item(impl, e->index)->key, key) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/* remove the entry in slot and move the entries after it back so that
+ * they can still be found */
+static void index_remove(struct properties *impl, uint32_t slot)
+{
+	uint32_t mask = impl->index_size - 1, i, home;
+
+	for (i = (slot + 1) & mask; impl->index[i].index != -1; i = (i + 1) & mask) {
+		home = impl->index[i].hash & mask;
+		if (((i - home) & mask) >= ((i - slot) & mask)) {
+			impl->index[slot] = impl->index[i];
+			slot = i;
+		}
+	}
+	impl->index[slot].index = -1;
+}
+
 static void add_func(struct pw_properties *this, char *key, char *value)
 {
 	struct spa_dict_item *item;
 	struct properties *impl = SPA_CONTAINER_OF(this, struct properties, this);
+	int index = n_items(impl);
 
 	item = pw_array_add(&impl->items, sizeof(struct spa_dict_item));
 	item->key = key;
@@ -41,6 +125,19 @@ static void add_func(struct pw_properties *this, char *key, char *value)
 
 	this->dict.items = impl->items.data;
 	this->dict.n_items = pw_array_get_len(&impl->items, struct spa_dict_item);
+
+	if (impl->index) {
+		if ((index + 1) * 2 > impl->index_size) {
+			if (!make_index(impl, impl->index_size * 2)) {
+				free(impl->index);
+				impl->index = NULL;
+			}
+		}
+		else
+			index_insert(impl, spa_hash_string(key), index);
+	}
+	else if (index + 1 >= INDEX_MIN_ITEMS)
+		make_index(impl, INDEX_MIN_ITEMS * 4);
 }
 
 static void clear_item(struct spa_dict_item *item)
@@ -52,17 +149,65 @@ static void clear_item(struct spa_dict_item *item)
 static int find_index(const struct pw_properties *this, const char *key)
 {
 	struct properties *impl = SPA_CONTAINER_OF(this, struct properties, this);
-	int i, len = pw_array_get_len(&impl->items, struct spa_dict_item);
+	int i, len = n_items(impl);
+
+	if (impl->index) {
+		int slot = index_find(impl, spa_hash_string(key), key);
+		return slot == -1 ? -1 : impl->index[slot].index;
+	}
 
 	for (i = 0; i < len; i++) {
-		struct spa_dict_item *item =
-		    pw_array_get_unchecked(&impl->items, i, struct spa_dict_item);
-		if (strcmp(item->key, key) == 0)
+		if (strcmp(get_item(impl, i)->key, key) == 0)
 			return i;
 	}
 	return -1;
 }
 
+/* remove the item at index, the last item is moved in its place */
+static void remove_item(struct properties *impl, int index)
+{
+	struct spa_dict_item *item = get_item(impl, index);
+	int last = n_items(impl) - 1;
+
+	if (impl->index) {
+		index_remove(impl, index_find(impl, spa_hash_string(item->key), item->key));
+		if (index != last) {
+			struct spa_dict_item *other = get_item(impl, last);
+			int slot = index_find(impl, spa_hash_string(other->key), other->key);
+			impl->index[slot].index = index;
+		}
+	}
+	clear_item(item);
+	if (index != last)
+		*item = *get_item(impl, last);
+
+	impl->items.size -= sizeof(struct spa_dict_item);
+	impl->this.dict.n_items = last;
+}
+
+static void do_replace(struct pw_properties *properties, char *key, char *value)
+{
+	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
+	int index = find_index(properties, key);
+
+	if (index == -1) {
+		if (value == NULL)
+			free(key);
+		else
+			add_func(properties, key, value);
+	} else if (value == NULL) {
+		free(key);
+		remove_item(impl, index);
+	} else {
+		struct spa_dict_item *item = get_item(impl, index);
+
+		/* the index points to the item, the key stays the same */
+		free((char *) item->value);
+		free(key);
+		item->value = value;
+	}
+}
+
 /** Make a new properties object
  *
  * \param key a first key
@@ -86,7 +231,7 @@ struct pw_properties *pw_properties_new(const char *key, ...)
 	va_start(varargs, key);
 	while (key != NULL) {
 		value = va_arg(varargs, char *);
-		add_func(&impl->this, strdup(key), value ? strdup(value) : NULL);
+		do_replace(&impl->this, strdup(key), value ? strdup(value) : NULL);
 		key = va_arg(varargs, char *);
 	}
 	va_end(varargs);
@@ -114,8 +259,8 @@ struct pw_properties *pw_properties_new_dict(const struct spa_dict *dict)
 
 	for (i = 0; i < dict->n_items; i++) {
 		if (dict->items[i].key != NULL)
-			add_func(&impl->this, strdup(dict->items[i].key),
-				 dict->items[i].value ? strdup(dict->items[i].value) : NULL);
+			do_replace(&impl->this, strdup(dict->items[i].key),
+				   dict->items[i].value ? strdup(dict->items[i].value) : NULL);
 	}
 
 	return &impl->this;
@@ -197,35 +342,10 @@ void pw_properties_free(struct pw_properties *properties)
 	    clear_item(item);
 
 	pw_array_clear(&impl->items);
+	free(impl->index);
 	free(impl);
 }
 
-static void do_replace(struct pw_properties *properties, char *key, char *value)
-{
-	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
-	int index = find_index(properties, key);
-
-	if (index == -1) {
-		add_func(properties, key, value);
-	} else {
-		struct spa_dict_item *item =
-		    pw_array_get_unchecked(&impl->items, index, struct spa_dict_item);
-
-		clear_item(item);
-		if (value == NULL) {
-			struct spa_dict_item *other = pw_array_get_unchecked(&impl->items,
-						     pw_array_get_len(&impl->items, struct spa_dict_item) - 1,
-						     struct spa_dict_item);
-			item->key = other->key;
-			item->value = other->value;
-			impl->items.size -= sizeof(struct spa_dict_item);
-		} else {
-			item->key = key;
-			item->value = value;
-		}
-	}
-}
-
 /** Set a property value
  *
  * \param properties the properties to change
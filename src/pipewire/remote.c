@@ -48,11 +48,13 @@ struct remote {
 
 struct mem_id {
 	uint32_t id;
-	int fd;
+	uint32_t type;
 	uint32_t flags;
-	void *ptr;
+	void *ptr;		/**< mapping of the memfd when used */
 	uint32_t offset;
 	uint32_t size;
+	struct pw_memmap *map;	/**< the memfd, shared with other mem_ids */
+	bool locked;		/**< holds a lock on the mapping */
 };
 
 struct buffer_id {
@@ -73,6 +75,17 @@ struct port {
 	bool in_order;
 };
 
+/** a client node that one of our output ports is linked to directly */
+struct peer {
+	struct spa_list link;
+	uint32_t peer_id;
+	uint32_t port_id;
+	uint32_t peer_port_id;
+	int signalfd;
+	struct pw_memblock mem;		/**< mapping of the peer area */
+	struct pw_client_node_peer_area *area;
+};
+
 struct node_data {
 	struct pw_remote *remote;
 	struct pw_core *core;
@@ -83,6 +96,10 @@ struct node_data {
 	struct spa_source *rtsocket_source;
         struct pw_client_node_transport *trans;
 
+	struct spa_list peers;
+	struct spa_list mem_maps;	/**< mappings of the memfds of the buffers */
+	bool direct_output;	/**< all outputs go to peers, don't wake up the daemon */
+
 	struct spa_node out_node_impl;
 	struct spa_graph_node out_node;
 	struct port *out_ports;
@@ -192,8 +209,14 @@ core_event_update_types(void *data, uint32_t first_id, uint32_t n_types, const c
 
 	for (i = 0; i < n_types; i++, first_id++) {
 		uint32_t this_id = spa_type_map_get_id(this->core->type.map, types[i]);
-		if (!pw_map_insert_at(&this->types, first_id, PW_MAP_ID_TO_PTR(this_id)))
+		if (!pw_map_insert_at(&this->types, first_id, PW_MAP_ID_TO_PTR(this_id))) {
 			pw_log_error("can't add type for client");
+			continue;
+		}
+		if (this_id == first_id && first_id == this->n_types_identity)
+			this->n_types_identity++;
+		else if (this_id != first_id && first_id < this->n_types_identity)
+			this->n_types_identity = first_id;
 	}
 }
 
@@ -223,6 +246,7 @@ struct pw_remote *pw_remote_new(struct pw_core *core,
 	pw_log_debug("remote %p: new", impl);
 
 	this->core = core;
+	this->memlock.limit = core->mlock_limit;
 
 	if (user_data_size > 0)
 		this->user_data = SPA_MEMBER(impl, sizeof(struct remote), void);
@@ -418,6 +442,7 @@ void pw_remote_disconnect(struct pw_remote *remote)
 	pw_map_clear(&remote->objects);
 	pw_map_clear(&remote->types);
 	remote->n_types = 0;
+	remote->n_types_identity = 0;
 
 	if (remote->info) {
 		pw_core_info_free (remote->info);
@@ -481,6 +506,54 @@ static void handle_rtnode_message(struct pw_proxy *proxy, struct pw_client_node_
 	}
 }
 
+static void process_triggered(struct node_data *data)
+{
+	struct pw_client_node_peer_area *area = data->trans->peer_area;
+	struct pw_client_node_activation *activation;
+	struct spa_port_io *inputs;
+	uint32_t i;
+
+	if (area == NULL)
+		return;
+
+	activation = &area->activation;
+	if (activation->status == PW_CLIENT_NODE_ACTIVATION_TRIGGERED) {
+		/* our upstream peers placed their output in the peer area */
+		inputs = pw_client_node_peer_area_get_inputs(area);
+		for (i = 0; i < area->max_input_ports; i++) {
+			if (inputs[i].buffer_id == SPA_ID_INVALID)
+				continue;
+			data->trans->inputs[i] = inputs[i];
+			inputs[i].buffer_id = SPA_ID_INVALID;
+		}
+		activation->status = PW_CLIENT_NODE_ACTIVATION_NOT_TRIGGERED;
+		activation->pending = activation->required;
+		pw_log_trace("remote %p: triggered by peers", data->remote);
+		spa_graph_have_output(data->node->rt.graph, &data->in_node);
+	}
+}
+
+static void process_signals(struct node_data *data)
+{
+	struct pw_client_node_activation *activation = &data->trans->area->activation;
+	struct timespec ts;
+	uint32_t signals;
+
+	while ((signals = pw_client_node_activation_take(activation))) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		activation->awake_time = SPA_TIMESPEC_TO_TIME(&ts);
+
+		if (signals & PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT) {
+			pw_log_trace("remote %p: process input", data->remote);
+			spa_graph_have_output(data->node->rt.graph, &data->in_node);
+		}
+		if (signals & PW_CLIENT_NODE_SIGNAL_PROCESS_OUTPUT) {
+			pw_log_trace("remote %p: process output", data->remote);
+			spa_graph_need_input(data->node->rt.graph, &data->out_node);
+		}
+	}
+}
+
 static void
 on_rtsocket_condition(void *user_data, int fd, enum spa_io mask)
 {
@@ -509,19 +582,38 @@ on_rtsocket_condition(void *user_data, int fd, enum spa_io mask)
 			pw_client_node_transport_parse_message(data->trans, msg);
 			handle_rtnode_message(proxy, msg);
 		}
+
+		if (data->trans->area->version >= PW_CLIENT_NODE_AREA_VERSION_ACTIVATION)
+			process_signals(data);
+
+		process_triggered(data);
 	}
 }
 
+static void free_peer(struct peer *p)
+{
+	pw_memblock_free(&p->mem);
+	close(p->signalfd);
+	free(p);
+}
+
 static void clean_transport(struct pw_proxy *proxy)
 {
 	struct node_data *data = proxy->user_data;
 	struct pw_port *port;
+	struct peer *p, *t;
 
 	if (data->trans == NULL)
 		return;
 
 	unhandle_socket(proxy);
 
+	spa_list_for_each_safe(p, t, &data->peers, link) {
+		spa_list_remove(&p->link);
+		free_peer(p);
+	}
+	data->direct_output = false;
+
 	spa_list_for_each(port, &data->node->input_ports, link) {
 		spa_graph_port_remove(&data->in_ports[port->port_id].output);
 		spa_graph_port_remove(&data->in_ports[port->port_id].input);
@@ -633,6 +725,7 @@ static void client_node_transport(void *object, uint32_t node_id,
                                                readfd,
                                                SPA_IO_ERR | SPA_IO_HUP,
                                                true, on_rtsocket_condition, proxy);
+	data->rtsocket_source->priority = SPA_SOURCE_PRIORITY_HIGH;
 	if (data->node->active)
 		pw_client_node_proxy_set_active(data->node_proxy, true);
 }
@@ -713,18 +806,63 @@ static void node_need_input(void *data)
 {
 	struct node_data *d = data;
         uint64_t cmd = 1;
-	pw_client_node_transport_add_message(d->trans,
+
+	if (d->trans->area->version >= PW_CLIENT_NODE_AREA_VERSION_ACTIVATION) {
+		if (!pw_client_node_activation_signal(&d->trans->area->server,
+						      PW_CLIENT_NODE_SIGNAL_NEED_INPUT))
+			return;
+	} else {
+		pw_client_node_transport_add_message(d->trans,
 				&PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_NEED_INPUT));
+	}
         write(d->rtwritefd, &cmd, 8);
 }
 
+static void signal_peer(struct node_data *d, struct peer *p)
+{
+	struct pw_client_node_activation *a = &p->area->activation;
+	struct spa_port_io *inputs = pw_client_node_peer_area_get_inputs(p->area);
+	uint64_t cmd = 1;
+
+	inputs[p->peer_port_id] = d->trans->outputs[p->port_id];
+
+	if (__atomic_sub_fetch(&a->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		a->signal_time = SPA_TIMESPEC_TO_TIME(&ts);
+		__atomic_store_n(&a->status, PW_CLIENT_NODE_ACTIVATION_TRIGGERED, __ATOMIC_SEQ_CST);
+
+		if (write(p->signalfd, &cmd, 8) != 8)
+			pw_log_warn("node %p: failed to signal peer %u: %m", d, p->peer_id);
+	}
+}
+
 static void node_have_output(void *data)
 {
 	struct node_data *d = data;
+	struct peer *p;
         uint64_t cmd = 1;
-        pw_client_node_transport_add_message(d->trans,
-                               &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT));
-        write(d->rtwritefd, &cmd, 8);
+	bool wakeup = true;
+
+	if (d->trans->area->version >= PW_CLIENT_NODE_AREA_VERSION_ACTIVATION) {
+		if (d->direct_output)
+			__atomic_or_fetch(&d->trans->area->server.signals,
+					  PW_CLIENT_NODE_SIGNAL_HAVE_OUTPUT, __ATOMIC_SEQ_CST);
+		else
+			wakeup = pw_client_node_activation_signal(&d->trans->area->server,
+								  PW_CLIENT_NODE_SIGNAL_HAVE_OUTPUT);
+	} else {
+		pw_client_node_transport_add_message(d->trans,
+				&PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT));
+	}
+
+	spa_list_for_each(p, &d->peers, link)
+		signal_peer(d, p);
+
+	/* the daemon picks up our output when the peers signal it */
+	if (!d->direct_output && wakeup)
+		write(d->rtwritefd, &cmd, 8);
 }
 
 static void client_node_command(void *object, uint32_t seq, const struct spa_command *command)
@@ -840,20 +978,44 @@ static struct mem_id *find_mem(struct port *port, uint32_t id)
 	return NULL;
 }
 
-static void clear_memid(struct mem_id *mid)
+/* the buffers of the links of a client are carved out of a few memfds,
+ * each memfd is mapped only once */
+static int map_memid(struct node_data *data, struct mem_id *mid, int prot)
 {
 	if (mid->ptr != NULL)
-		munmap(mid->ptr, mid->size + mid->offset);
+		return 0;
+	if (mid->map == NULL)
+		return -EINVAL;
+
+	mid->ptr = pw_memmap_map(mid->map, prot, (size_t) mid->offset + mid->size);
+	if (mid->ptr == NULL)
+		return -errno;
+
+	pw_log_debug("mem %u: mapped fd %d at %p", mid->id, mid->map->fd, mid->ptr);
+	return 0;
+}
+
+static void clear_memid(struct node_data *data, struct mem_id *mid)
+{
+	if (mid->locked)
+		pw_memmap_unlock(mid->map, &data->remote->memlock);
+	mid->locked = false;
+
+	if (mid->map != NULL) {
+		if (mid->ptr != NULL)
+			pw_memmap_unmap(mid->map);
+		pw_memmap_put(mid->map);
+	}
+	mid->map = NULL;
 	mid->ptr = NULL;
-	close(mid->fd);
 }
 
-static void clear_mems(struct port *port)
+static void clear_mems(struct node_data *data, struct port *port)
 {
 	struct mem_id *mid;
 
 	pw_array_for_each(mid, &port->mem_ids)
-		clear_memid(mid);
+		clear_memid(data, mid);
 	port->mem_ids.size = 0;
 }
 
@@ -870,10 +1032,10 @@ static void clear_buffers(struct port *port)
         port->buffer_ids.size = 0;
 }
 
-static void clear_port(struct port *port)
+static void clear_port(struct node_data *data, struct port *port)
 {
 	clear_buffers(port);
-	clear_mems(port);
+	clear_mems(data, port);
 	pw_array_clear(&port->mem_ids);
 	pw_array_clear(&port->buffer_ids);
 }
@@ -893,18 +1055,24 @@ client_node_port_add_mem(void *object,
 	if (m) {
 		pw_log_debug("update mem %u, fd %d, flags %d, off %d, size %d",
 			     mem_id, memfd, flags, offset, size);
-		clear_memid(m);
+		clear_memid(data, m);
 	} else {
 		m = pw_array_add(&port->mem_ids, sizeof(struct mem_id));
 		pw_log_debug("add mem %u, fd %d, flags %d, off %d, size %d",
 			     mem_id, memfd, flags, offset, size);
 	}
 	m->id = mem_id;
-	m->fd = memfd;
+	m->type = type;
 	m->flags = flags;
 	m->ptr = NULL;
 	m->offset = offset;
 	m->size = size;
+	m->locked = false;
+
+	/* the fd is closed when the memfd is already known */
+	m->map = pw_memmap_get(&data->mem_maps, memfd, type == data->t->data.MemFd);
+	if (m->map == NULL)
+		pw_log_warn("can't add mem %u: %m", mem_id);
 }
 
 static void
@@ -943,16 +1111,17 @@ client_node_port_use_buffers(void *object,
 			continue;
 		}
 
-		if (mid->ptr == NULL) {
-			mid->ptr =
-			    mmap(NULL, mid->size + mid->offset, prot, MAP_SHARED,
-				 mid->fd, 0);
-			if (mid->ptr == MAP_FAILED) {
-				mid->ptr = NULL;
-				pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
-					    strerror(errno));
-				continue;
-			}
+		if ((res = map_memid(data, mid, prot)) < 0) {
+			pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
+				    spa_strerror(res));
+			continue;
+		}
+		/* the buffer memory holds the metadata, chunks and data of the
+		 * buffers allocated by the server, the whole memfd is locked
+		 * once or only faulted in when that fails */
+		if (data->core->mlock && !mid->locked) {
+			pw_memmap_lock(mid->map, &data->remote->memlock);
+			mid->locked = true;
 		}
 		len = pw_array_get_len(&port->buffer_ids, struct buffer_id);
 		bid = pw_array_add(&port->buffer_ids, sizeof(struct buffer_id));
@@ -1002,18 +1171,17 @@ client_node_port_use_buffers(void *object,
 
 			if (d->type == proxy->remote->core->type.data.Id) {
 				struct mem_id *bmid = find_mem(port, SPA_PTR_TO_UINT32(d->data));
-				void *map;
 
-				d->type = proxy->remote->core->type.data.MemFd;
-				d->fd = bmid->fd;
-				map = mmap(NULL, d->maxsize + d->mapoffset, prot, MAP_SHARED, d->fd, 0);
-				if (map == MAP_FAILED) {
-					pw_log_error("data %d failed to mmap memory %m", j);
-					res = errno;
+				res = bmid ? map_memid(data, bmid, prot) : -EINVAL;
+				if (res < 0) {
+					pw_log_error("data %d failed to mmap memory: %s", j,
+						     spa_strerror(res));
 					goto done;
 				}
-				d->data = SPA_MEMBER(map, d->mapoffset, uint8_t);
-				pw_log_debug(" data %d %u -> fd %d mem %p", j, bmid->id, bmid->fd, map);
+				d->type = proxy->remote->core->type.data.MemFd;
+				d->fd = bmid->map->fd;
+				d->data = SPA_MEMBER(bmid->ptr, d->mapoffset, uint8_t);
+				pw_log_debug(" data %d %u -> fd %d mem %p", j, bmid->id, d->fd, bmid->ptr);
 			} else if (d->type == proxy->remote->core->type.data.MemPtr) {
 				d->data = SPA_MEMBER(bid->buf_ptr, SPA_PTR_TO_INT(d->data), void);
 				d->fd = -1;
@@ -1028,7 +1196,7 @@ client_node_port_use_buffers(void *object,
 	res = pw_port_use_buffers(port->port, bufs, n_buffers);
 
 	if (n_buffers == 0)
-		clear_mems(port);
+		clear_mems(data, port);
 
       done:
 	pw_client_node_proxy_done(data->node_proxy, seq, res);
@@ -1044,6 +1212,128 @@ client_node_port_command(void *object,
 	pw_log_warn("port command not supported");
 }
 
+static void update_direct_output(struct node_data *data)
+{
+	struct pw_port *port;
+	struct peer *p;
+	bool direct = !spa_list_is_empty(&data->node->output_ports);
+
+	spa_list_for_each(port, &data->node->output_ports, link) {
+		bool found = false;
+		spa_list_for_each(p, &data->peers, link) {
+			if (p->port_id == port->port_id) {
+				found = true;
+				break;
+			}
+		}
+		direct &= found;
+	}
+	data->direct_output = direct;
+}
+
+static int
+do_add_peer(struct spa_loop *loop,
+	    bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct node_data *d = user_data;
+	struct peer *p = *(struct peer **) data;
+
+	spa_list_append(&d->peers, &p->link);
+	update_direct_output(d);
+	return 0;
+}
+
+static int
+do_remove_peer(struct spa_loop *loop,
+	       bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct node_data *d = user_data;
+	struct peer *p = *(struct peer **) data;
+
+	spa_list_remove(&p->link);
+	update_direct_output(d);
+	return 0;
+}
+
+static void
+client_node_add_peer(void *object,
+		     uint32_t peer_id,
+		     uint32_t port_id,
+		     uint32_t peer_port_id,
+		     int signalfd,
+		     int memfd,
+		     uint32_t offset,
+		     uint32_t size)
+{
+	struct pw_proxy *proxy = object;
+	struct node_data *data = proxy->user_data;
+	struct peer *p;
+
+	if (data->trans == NULL || port_id >= data->trans->area->max_output_ports ||
+	    size < sizeof(struct pw_client_node_peer_area)) {
+		pw_log_warn("remote-node %p: invalid peer port %u -> %u", proxy, port_id, peer_port_id);
+		goto error;
+	}
+
+	p = calloc(1, sizeof(struct peer));
+	if (p == NULL)
+		goto error;
+
+	p->peer_id = peer_id;
+	p->port_id = port_id;
+	p->peer_port_id = peer_port_id;
+	p->signalfd = signalfd;
+
+	p->mem.flags = PW_MEMBLOCK_FLAG_MAP_READWRITE | PW_MEMBLOCK_FLAG_WITH_FD;
+	p->mem.fd = memfd;
+	p->mem.offset = offset;
+	p->mem.size = size;
+	if (pw_memblock_map(&p->mem) < 0) {
+		pw_log_warn("remote-node %p: can't map peer area: %m", proxy);
+		free(p);
+		goto error;
+	}
+	p->area = p->mem.ptr;
+
+	if (peer_port_id >= p->area->max_input_ports ||
+	    size < pw_client_node_peer_area_get_size(p->area->max_input_ports)) {
+		pw_log_warn("remote-node %p: invalid peer port %u -> %u", proxy, port_id, peer_port_id);
+		free_peer(p);
+		return;
+	}
+
+	pw_log_debug("remote-node %p: port %u linked directly to node %u port %u",
+		     proxy, port_id, peer_id, peer_port_id);
+
+	pw_loop_invoke(data->core->data_loop,
+		       do_add_peer, SPA_ID_INVALID, sizeof(struct peer *), &p, true, data);
+	return;
+
+      error:
+	close(memfd);
+	close(signalfd);
+}
+
+static void
+client_node_remove_peer(void *object, uint32_t peer_id, uint32_t port_id)
+{
+	struct pw_proxy *proxy = object;
+	struct node_data *data = proxy->user_data;
+	struct peer *p, *t;
+
+	spa_list_for_each_safe(p, t, &data->peers, link) {
+		if (p->peer_id != peer_id || p->port_id != port_id)
+			continue;
+
+		pw_log_debug("remote-node %p: remove direct link of port %u to node %u",
+			     proxy, port_id, peer_id);
+
+		pw_loop_invoke(data->core->data_loop,
+			       do_remove_peer, SPA_ID_INVALID, sizeof(struct peer *), &p, true, data);
+		free_peer(p);
+	}
+}
+
 static const struct pw_client_node_proxy_events client_node_events = {
 	PW_VERSION_CLIENT_NODE_PROXY_EVENTS,
 	.transport = client_node_transport,
@@ -1056,6 +1346,8 @@ static const struct pw_client_node_proxy_events client_node_events = {
 	.port_add_mem = client_node_port_add_mem,
 	.port_use_buffers = client_node_port_use_buffers,
 	.port_command = client_node_port_command,
+	.add_peer = client_node_add_peer,
+	.remove_peer = client_node_remove_peer,
 };
 
 static void do_node_init(struct pw_proxy *proxy)
@@ -1116,9 +1408,9 @@ static void node_proxy_destroy(void *_data)
 
 	if (data->trans) {
 		for (i = 0; i < data->trans->area->max_input_ports; i++)
-			clear_port(&data->in_ports[i]);
+			clear_port(data, &data->in_ports[i]);
 		for (i = 0; i < data->trans->area->max_output_ports; i++)
-			clear_port(&data->out_ports[i]);
+			clear_port(data, &data->out_ports[i]);
 	}
 	clean_transport(proxy);
 
@@ -1165,14 +1457,24 @@ struct pw_proxy *pw_remote_export(struct pw_remote *remote,
 {
 	struct remote *impl = SPA_CONTAINER_OF(remote, struct remote, this);
 	struct pw_proxy *proxy;
+	struct pw_properties *props;
 	struct node_data *data;
 
+	/* we can wake up directly linked peers ourselves */
+	props = pw_properties_copy(node->properties);
+	pw_properties_set(props, "pipewire.client.direct-wakeup", "1");
+	/* and we understand process signals in the activation records */
+	if (pw_properties_get(props, "pipewire.client.transport-version") == NULL)
+		pw_properties_setf(props, "pipewire.client.transport-version", "%d",
+				   PW_CLIENT_NODE_AREA_VERSION_ACTIVATION);
+
 	proxy = pw_core_proxy_create_object(remote->core_proxy,
 					    "client-node",
 					    impl->type_client_node,
 					    PW_VERSION_CLIENT_NODE,
-					    &node->properties->dict,
+					    &props->dict,
 					    sizeof(struct node_data));
+	pw_properties_free(props);
         if (proxy == NULL)
                 return NULL;
 
@@ -1182,6 +1484,8 @@ struct pw_proxy *pw_remote_export(struct pw_remote *remote,
 	data->core = pw_node_get_core(node);
 	data->t = pw_core_get_type(data->core);
 	data->node_proxy = (struct pw_client_node_proxy *)proxy;
+	spa_list_init(&data->peers);
+	spa_list_init(&data->mem_maps);
 	data->in_node_impl = node_impl;
 	data->out_node_impl = node_impl;
 
@@ -41,14 +41,16 @@
 #define MAX_FDS         32
 #define MAX_INPUTS      64
 #define MAX_OUTPUTS     64
+#define MAX_IDS         (1 << 16)
 
 struct mem_id {
 	uint32_t id;
-	int fd;
 	uint32_t flags;
-	void *ptr;
+	void *ptr;		/**< mapping of the memfd when used */
 	uint32_t offset;
 	uint32_t size;
+	struct pw_memmap *map;	/**< the memfd, shared with other mem_ids */
+	bool locked;		/**< holds a lock on the mapping */
 };
 
 struct buffer_id {
@@ -92,10 +94,13 @@ struct stream {
 	struct spa_source *timeout_source;
 
 	struct pw_array mem_ids;
+	struct pw_array mem_map;	/* mem id -> position in mem_ids */
+	struct spa_list mem_maps;	/* memfds of the mem ids */
 	struct pw_array buffer_ids;
-	bool in_order;
+	struct pw_array buffer_map;	/* buffer id -> position in buffer_ids */
 
 	bool client_reuse;
+	bool mlock;
 
 	struct spa_list free;
 	bool in_need_buffer;
@@ -107,27 +112,58 @@ struct stream {
 };
 /** \endcond */
 
+/* Make \a id map to \a pos in an id map. Ids are used as an index in the map
+ * so that they can be looked up in constant time no matter how they are
+ * assigned. */
+static int id_map_set(struct pw_array *map, uint32_t id, uint32_t pos)
+{
+	uint32_t *p, len;
+
+	if (id >= MAX_IDS)
+		return -ENOSPC;
+
+	len = pw_array_get_len(map, uint32_t);
+	if (id >= len) {
+		if ((p = pw_array_add(map, (id + 1 - len) * sizeof(uint32_t))) == NULL)
+			return -ENOMEM;
+		for (; len <= id; len++)
+			*p++ = SPA_ID_INVALID;
+	}
+	*pw_array_get_unchecked(map, id, uint32_t) = pos;
+	return 0;
+}
+
+static inline uint32_t id_map_get(struct pw_array *map, uint32_t id)
+{
+	if (SPA_LIKELY(pw_array_check_index(map, id, uint32_t)))
+		return *pw_array_get_unchecked(map, id, uint32_t);
+	return SPA_ID_INVALID;
+}
+
 static void clear_memid(struct stream *impl, struct mem_id *mid)
 {
-	if (mid->ptr != NULL)
-		munmap(mid->ptr, mid->size + mid->offset);
+	if (mid->locked)
+		pw_memmap_unlock(mid->map, &impl->this.remote->memlock);
+	mid->locked = false;
+	if (mid->map != NULL) {
+		if (mid->ptr != NULL)
+			pw_memmap_unmap(mid->map);
+		pw_memmap_put(mid->map);
+	}
+	mid->map = NULL;
 	mid->ptr = NULL;
-	if (mid->fd != -1) {
-		bool has_ref = false;
-		int fd;
+}
 
-		fd = mid->fd;
-		mid->fd = -1;
+static int map_memid(struct mem_id *mid)
+{
+	if (mid->ptr != NULL)
+		return 0;
+	if (mid->map == NULL)
+		return -EINVAL;
 
-		pw_array_for_each(mid, &impl->mem_ids) {
-			if (mid->fd == fd) {
-				has_ref = true;
-				break;
-			}
-		}
-		if (!has_ref)
-			close(fd);
-	}
+	mid->ptr = pw_memmap_map(mid->map, PROT_READ | PROT_WRITE,
+				 (size_t) mid->offset + mid->size);
+	return mid->ptr ? 0 : -errno;
 }
 
 static void clear_mems(struct pw_stream *stream)
@@ -138,6 +174,7 @@ static void clear_mems(struct pw_stream *stream)
 	pw_array_for_each(mid, &impl->mem_ids)
 	    clear_memid(impl, mid);
 	impl->mem_ids.size = 0;
+	impl->mem_map.size = 0;
 }
 
 static void clear_buffers(struct pw_stream *stream)
@@ -154,7 +191,7 @@ static void clear_buffers(struct pw_stream *stream)
 		bid->used = false;
 	}
 	impl->buffer_ids.size = 0;
-	impl->in_order = true;
+	impl->buffer_map.size = 0;
 	spa_list_init(&impl->free);
 }
 
@@ -231,14 +268,22 @@ struct pw_stream *pw_stream_new(struct pw_remote *remote,
 	str = pw_properties_get(props, "pipewire.client.reuse");
 	impl->client_reuse = str && pw_properties_parse_bool(str);
 
+	str = pw_properties_get(props, PW_STREAM_PROP_MLOCK);
+	impl->mlock = str ? pw_properties_parse_bool(str) : remote->core->mlock;
+
 	spa_hook_list_init(&this->listener_list);
 
 	this->state = PW_STREAM_STATE_UNCONNECTED;
 
 	pw_array_init(&impl->mem_ids, 64);
 	pw_array_ensure_size(&impl->mem_ids, sizeof(struct mem_id) * 64);
+	pw_array_init(&impl->mem_map, 64);
+	pw_array_ensure_size(&impl->mem_map, sizeof(uint32_t) * 64);
+	spa_list_init(&impl->mem_maps);
 	pw_array_init(&impl->buffer_ids, 32);
 	pw_array_ensure_size(&impl->buffer_ids, sizeof(struct buffer_id) * 64);
+	pw_array_init(&impl->buffer_map, 32);
+	pw_array_ensure_size(&impl->buffer_map, sizeof(uint32_t) * 64);
 	impl->pending_seq = SPA_ID_INVALID;
 	spa_list_init(&impl->free);
 
@@ -373,9 +418,11 @@ void pw_stream_destroy(struct pw_stream *stream)
 
 	clear_buffers(stream);
 	pw_array_clear(&impl->buffer_ids);
+	pw_array_clear(&impl->buffer_map);
 
 	clear_mems(stream);
 	pw_array_clear(&impl->mem_ids);
+	pw_array_clear(&impl->mem_map);
 
 	if (stream->properties)
 		pw_properties_free(stream->properties);
@@ -506,30 +553,21 @@ static void on_timeout(void *data, uint64_t expirations)
 static struct mem_id *find_mem(struct pw_stream *stream, uint32_t id)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	struct mem_id *mid;
+	uint32_t pos;
 
-	pw_array_for_each(mid, &impl->mem_ids) {
-		if (mid->id == id)
-			return mid;
-	}
-	return NULL;
+	if ((pos = id_map_get(&impl->mem_map, id)) == SPA_ID_INVALID)
+		return NULL;
+	return pw_array_get_unchecked(&impl->mem_ids, pos, struct mem_id);
 }
 
 static struct buffer_id *find_buffer(struct pw_stream *stream, uint32_t id)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	uint32_t pos;
 
-	if (impl->in_order && pw_array_check_index(&impl->buffer_ids, id, struct buffer_id)) {
-		return pw_array_get_unchecked(&impl->buffer_ids, id, struct buffer_id);
-	} else {
-		struct buffer_id *bid;
-
-		pw_array_for_each(bid, &impl->buffer_ids) {
-			if (bid->id == id)
-				return bid;
-		}
-	}
-	return NULL;
+	if ((pos = id_map_get(&impl->buffer_map, id)) == SPA_ID_INVALID)
+		return NULL;
+	return pw_array_get_unchecked(&impl->buffer_ids, pos, struct buffer_id);
 }
 
 static inline void reuse_buffer(struct pw_stream *stream, uint32_t id)
@@ -649,6 +687,7 @@ static void handle_socket(struct pw_stream *stream, int rtreadfd, int rtwritefd)
 					       rtreadfd,
 					       SPA_IO_ERR | SPA_IO_HUP,
 					       true, on_rtsocket_condition, stream);
+	impl->rtsocket_source->priority = SPA_SOURCE_PRIORITY_HIGH;
 
 	impl->timeout_source = pw_loop_add_timer(stream->remote->core->main_loop, on_timeout, stream);
 	interval.tv_sec = 0;
@@ -796,16 +835,28 @@ client_node_port_add_mem(void *data,
 			     mem_id, memfd, flags, offset, size);
 		clear_memid(impl, m);
 	} else {
-		m = pw_array_add(&impl->mem_ids, sizeof(struct mem_id));
+		if (id_map_set(&impl->mem_map, mem_id,
+			       pw_array_get_len(&impl->mem_ids, struct mem_id)) < 0 ||
+		    (m = pw_array_add(&impl->mem_ids, sizeof(struct mem_id))) == NULL) {
+			pw_log_warn("can't add mem %u", mem_id);
+			close(memfd);
+			return;
+		}
 		pw_log_debug("add mem %u, fd %d, flags %d, off %d, size %d",
 			     mem_id, memfd, flags, offset, size);
 	}
 	m->id = mem_id;
-	m->fd = memfd;
 	m->flags = flags;
 	m->ptr = NULL;
 	m->offset = offset;
 	m->size = size;
+	m->locked = false;
+
+	/* the fd is closed when the memfd is already known */
+	m->map = pw_memmap_get(&impl->mem_maps, memfd,
+			       type == stream->remote->core->type.data.MemFd);
+	if (m->map == NULL)
+		pw_log_warn("can't add mem %u: %m", mem_id);
 }
 
 static void
@@ -819,31 +870,39 @@ client_node_port_use_buffers(void *data,
 	struct buffer_id *bid;
 	uint32_t i, j, len;
 	struct spa_buffer *b;
+	int res;
 
 	/* clear previous buffers */
 	clear_buffers(stream);
 
+	/* make sure the array does not move, we keep links to the buffers */
+	pw_array_ensure_size(&impl->buffer_ids, sizeof(struct buffer_id) * n_buffers);
+
 	for (i = 0; i < n_buffers; i++) {
 		off_t offset;
 
 		struct mem_id *mid = find_mem(stream, buffers[i].mem_id);
 		if (mid == NULL) {
 			pw_log_warn("unknown memory id %u", buffers[i].mem_id);
-			continue;
+			res = -EINVAL;
+			goto error;
 		}
 
-		if (mid->ptr == NULL) {
-			mid->ptr =
-			    mmap(NULL, mid->size + mid->offset, PROT_READ | PROT_WRITE, MAP_SHARED,
-				 mid->fd, 0);
-			if (mid->ptr == MAP_FAILED) {
-				mid->ptr = NULL;
-				pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
-					    strerror(errno));
-				continue;
-			}
-		}
+		/* check the id before the memory is mapped for the buffer */
 		len = pw_array_get_len(&impl->buffer_ids, struct buffer_id);
+		if ((res = id_map_set(&impl->buffer_map, buffers[i].buffer->id, len)) < 0) {
+			pw_log_warn("invalid buffer id %u", buffers[i].buffer->id);
+			goto error;
+		}
+
+		if ((res = map_memid(mid)) < 0) {
+			pw_log_warn("Failed to mmap memory %d %p: %m", mid->size, mid);
+			goto error;
+		}
+		if (impl->mlock && !mid->locked) {
+			pw_memmap_lock(mid->map, &stream->remote->memlock);
+			mid->locked = true;
+		}
 		bid = pw_array_add(&impl->buffer_ids, sizeof(struct buffer_id));
 		if (impl->direction == SPA_DIRECTION_OUTPUT) {
 			bid->used = false;
@@ -873,11 +932,6 @@ client_node_port_use_buffers(void *data,
 				       struct spa_data);
 		}
 		bid->id = b->id;
-
-		if (bid->id != len) {
-			pw_log_warn("unexpected id %u found, expected %u", bid->id, len);
-			impl->in_order = false;
-		}
 		pw_log_debug("add buffer %d %d %u", mid->id, bid->id, buffers[i].offset);
 
 		offset = 0;
@@ -898,10 +952,17 @@ client_node_port_use_buffers(void *data,
 
 			if (d->type == stream->remote->core->type.data.Id) {
 				struct mem_id *bmid = find_mem(stream, SPA_PTR_TO_UINT32(d->data));
+
+				if (bmid == NULL || map_memid(bmid) < 0) {
+					pw_log_warn("data %d: can't map memory", j);
+					d->data = NULL;
+					d->fd = -1;
+					continue;
+				}
 				d->type = stream->remote->core->type.data.MemFd;
-				d->data = NULL;
-				d->fd = bmid->fd;
-				pw_log_debug(" data %d %u -> fd %d", j, bmid->id, bmid->fd);
+				d->fd = bmid->map->fd;
+				d->data = SPA_MEMBER(bmid->ptr, d->mapoffset, void);
+				pw_log_debug(" data %d %u -> fd %d mem %p", j, bmid->id, d->fd, d->data);
 			} else if (d->type == stream->remote->core->type.data.MemPtr) {
 				d->data = SPA_MEMBER(bid->buf_ptr, SPA_PTR_TO_INT(d->data), void);
 				d->fd = -1;
@@ -921,6 +982,13 @@ client_node_port_use_buffers(void *data,
 		clear_mems(stream);
 		stream_set_state(stream, PW_STREAM_STATE_READY, NULL);
 	}
+	return;
+
+      error:
+	/* don't keep some of the buffers, the server uses all or none */
+	clear_buffers(stream);
+	add_async_complete(stream, seq, res);
+	stream_set_state(stream, PW_STREAM_STATE_READY, NULL);
 }
 
 static void
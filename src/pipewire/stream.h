@@ -249,6 +249,9 @@ const char *pw_stream_get_name(struct pw_stream *stream);
 #define PW_STREAM_PROP_LATENCY_MIN	"pipewire.latency.min"
 /** The maximum latency of the stream, int default MAXINT */
 #define PW_STREAM_PROP_LATENCY_MAX	"pipewire.latency.max"
+/** Fault in and lock the buffer memory of the stream, boolean, default
+ * the pipewire.core.mlock property of the core */
+#define PW_STREAM_PROP_MLOCK		"pipewire.stream.mlock"
 
 const struct pw_properties *pw_stream_get_properties(struct pw_stream *stream);
 
@@ -0,0 +1,100 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pipewire/mem.h>
+
+/* Measures the cost of the buffer memory of a link that is renegotiated
+ * over and over, with a new memfd each time and with memory from a pool.
+ * Every relink allocates the memory, writes to all of it like the first
+ * cycles of the graph do, and frees or releases it again. */
+
+#define N_RELINKS	2000
+
+#define FLAGS	(PW_MEMBLOCK_FLAG_WITH_FD | PW_MEMBLOCK_FLAG_MAP_READWRITE | PW_MEMBLOCK_FLAG_SEAL)
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void touch(struct pw_memblock *mem)
+{
+	size_t i, page = sysconf(_SC_PAGESIZE);
+
+	for (i = 0; i < mem->size; i += page)
+		((uint8_t *) mem->ptr)[i] = i;
+}
+
+static double run(struct pw_memblock_pool *pool, size_t size)
+{
+	struct pw_memblock mem;
+	int64_t t;
+	int i;
+
+	t = get_time();
+	for (i = 0; i < N_RELINKS; i++) {
+		if (pool) {
+			if (pw_memblock_pool_alloc(pool, FLAGS, 0, size, &mem) < 0)
+				return -1.0;
+			touch(&mem);
+			pw_memblock_pool_release(pool, &mem);
+		} else {
+			if (pw_memblock_alloc(FLAGS, size, &mem) < 0)
+				return -1.0;
+			touch(&mem);
+			pw_memblock_free(&mem);
+		}
+	}
+	return (get_time() - t) / 1000.0 / N_RELINKS;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		size_t size;
+	} layouts[] = {
+		{ "audio 2x1024 f32", 2 * (1024 * 4 + 128) },
+		{ "audio 8x8192 f32", 8 * (8192 * 4 + 128) },
+		{ "video 4x640x480 yuy2", 4 * (640 * 480 * 2 + 128) },
+		{ "video 4x1920x1080 rgba", 4 * (1920 * 1080 * 4 + 128) },
+	};
+	struct pw_memblock_pool *pool;
+	int i;
+
+	pool = pw_memblock_pool_new(NULL, 64 * 1024 * 1024);
+
+	printf("layout                      size   memfd us   pool us\n");
+	for (i = 0; i < SPA_N_ELEMENTS(layouts); i++) {
+		double fresh = run(NULL, layouts[i].size);
+		double pooled = run(pool, layouts[i].size);
+
+		printf("%-24s %8zd %10.2f %9.2f\n", layouts[i].name, layouts[i].size, fresh, pooled);
+	}
+	pw_memblock_pool_destroy(pool);
+
+	return 0;
+}
@@ -0,0 +1,284 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <spa/utils/defs.h>
+
+#include <extensions/client-node.h>
+
+#include "modules/module-client-node/transport.h"
+
+/* Runs a chain of client threads that each have a client-node transport
+ * with one input and one output, like a chain of filters, and measures how
+ * long it takes for a buffer that the daemon places in the input of the
+ * first client to come out of the output of the last client.
+ *
+ * In "daemon" mode, every client signals have-output to the daemon, which
+ * copies the output io into the input io of the next client and signals it
+ * to process its input. In "direct" mode, each client only maps the peer
+ * area of the next client, like a client that received add_peer. It copies
+ * its output io into the peer area, decrements the pending count and wakes
+ * up the next client itself. The daemon is only woken up by the last
+ * client in the chain. */
+
+#define MAX_CLIENTS	32
+#define N_CYCLES	2000
+
+struct bench;
+
+struct client {
+	struct bench *bench;
+	int index;
+	int fd;
+	pthread_t thread;
+	struct pw_client_node_transport *daemon_trans;
+	struct pw_client_node_transport *trans;
+	struct pw_memblock peer_mem;	/**< peer area of the next client */
+	struct pw_client_node_peer_area *peer;
+};
+
+struct bench {
+	bool direct;
+	bool stop;
+	int n_clients;
+	int daemon_fd;
+	struct client clients[MAX_CLIENTS];
+};
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void signal_fd(int fd)
+{
+	uint64_t cmd = 1;
+	if (write(fd, &cmd, 8) != 8)
+		perror("write");
+}
+
+static void signal_peer(struct client *c)
+{
+	struct pw_client_node_activation *a = &c->peer->activation;
+	struct spa_port_io *inputs = pw_client_node_peer_area_get_inputs(c->peer);
+
+	inputs[0] = c->trans->outputs[0];
+
+	if (__atomic_sub_fetch(&a->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+		a->signal_time = get_time();
+		__atomic_store_n(&a->status, PW_CLIENT_NODE_ACTIVATION_TRIGGERED, __ATOMIC_SEQ_CST);
+		signal_fd(c->bench->clients[c->index + 1].fd);
+	}
+}
+
+static bool process_triggered(struct client *c)
+{
+	struct pw_client_node_peer_area *area = c->trans->peer_area;
+	struct spa_port_io *inputs = pw_client_node_peer_area_get_inputs(area);
+
+	if (area->activation.status != PW_CLIENT_NODE_ACTIVATION_TRIGGERED)
+		return false;
+
+	c->trans->inputs[0] = inputs[0];
+	inputs[0].buffer_id = SPA_ID_INVALID;
+	area->activation.status = PW_CLIENT_NODE_ACTIVATION_NOT_TRIGGERED;
+	area->activation.pending = area->activation.required;
+	return true;
+}
+
+static void *client_thread(void *data)
+{
+	struct client *c = data;
+	struct bench *b = c->bench;
+	struct pw_client_node_area *a = c->trans->area;
+	uint32_t signals;
+	uint64_t cmd;
+
+	while (read(c->fd, &cmd, 8) == 8 && !b->stop) {
+		bool process = false;
+
+		while ((signals = pw_client_node_activation_take(&a->activation)))
+			process |= (signals & PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT) != 0;
+		process |= process_triggered(c);
+
+		if (!process)
+			continue;
+
+		/* pass the buffer through */
+		c->trans->outputs[0].buffer_id = c->trans->inputs[0].buffer_id;
+		c->trans->outputs[0].status = SPA_STATUS_HAVE_BUFFER;
+
+		if (b->direct && c->peer) {
+			signal_peer(c);
+			continue;
+		}
+		if (pw_client_node_activation_signal(&a->server, PW_CLIENT_NODE_SIGNAL_HAVE_OUTPUT))
+			signal_fd(b->daemon_fd);
+	}
+	return NULL;
+}
+
+static void setup_client(struct bench *b, int i)
+{
+	struct client *c = &b->clients[i];
+	struct pw_client_node_transport_info info;
+
+	c->bench = b;
+	c->index = i;
+	c->fd = eventfd(0, EFD_CLOEXEC);
+	c->daemon_trans = pw_client_node_transport_new(1, 1);
+	c->daemon_trans->area->version = PW_CLIENT_NODE_AREA_VERSION_ACTIVATION;
+	pw_client_node_transport_add_peer_area(c->daemon_trans);
+	pw_client_node_transport_get_info(c->daemon_trans, &info);
+	info.memfd = dup(info.memfd);
+	info.peer_memfd = dup(info.peer_memfd);
+	c->trans = pw_client_node_transport_new_from_info(&info);
+}
+
+static void link_peer(struct client *c, struct client *next)
+{
+	struct pw_client_node_transport_info info;
+	struct pw_client_node_activation *a = &next->daemon_trans->peer_area->activation;
+
+	/* what the daemon does in add_peer and the client in client_node_add_peer */
+	pw_client_node_transport_get_info(next->daemon_trans, &info);
+	c->peer_mem.flags = PW_MEMBLOCK_FLAG_MAP_READWRITE | PW_MEMBLOCK_FLAG_WITH_FD;
+	c->peer_mem.fd = dup(info.peer_memfd);
+	c->peer_mem.offset = info.peer_offset;
+	c->peer_mem.size = info.peer_size;
+	pw_memblock_map(&c->peer_mem);
+	c->peer = c->peer_mem.ptr;
+
+	a->required++;
+	a->pending = a->required;
+}
+
+static void run(struct bench *b, int n_clients, bool direct,
+		double *avg, double *max, int *wakeups)
+{
+	int64_t t, sum = 0, worst = 0;
+	struct client *last;
+	uint64_t cmd;
+	int i, j, n_wakeups = 0, n_errors = 0;
+
+	spa_zero(*b);
+	b->direct = direct;
+	b->n_clients = n_clients;
+	b->daemon_fd = eventfd(0, EFD_CLOEXEC);
+
+	for (i = 0; i < n_clients; i++)
+		setup_client(b, i);
+	if (direct) {
+		for (i = 0; i + 1 < n_clients; i++)
+			link_peer(&b->clients[i], &b->clients[i + 1]);
+	}
+	for (i = 0; i < n_clients; i++)
+		pthread_create(&b->clients[i].thread, NULL, client_thread, &b->clients[i]);
+
+	last = &b->clients[n_clients - 1];
+
+	for (i = 0; i < N_CYCLES; i++) {
+		struct client *c = &b->clients[0];
+
+		t = get_time();
+		c->daemon_trans->inputs[0].buffer_id = i;
+		c->daemon_trans->inputs[0].status = SPA_STATUS_HAVE_BUFFER;
+		if (pw_client_node_activation_signal(&c->daemon_trans->area->activation,
+						     PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT))
+			signal_fd(c->fd);
+
+		for (j = 0; j < n_clients; j++) {
+			struct pw_client_node_transport *trans;
+
+			if (read(b->daemon_fd, &cmd, 8) != 8)
+				perror("read");
+			n_wakeups++;
+
+			/* with direct links, only the last client signals us */
+			c = direct ? last : &b->clients[j];
+			while (pw_client_node_activation_take(&c->daemon_trans->area->server));
+
+			if (c == last)
+				break;
+
+			trans = b->clients[j + 1].daemon_trans;
+			trans->inputs[0] = c->daemon_trans->outputs[0];
+			if (pw_client_node_activation_signal(&trans->area->activation,
+							     PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT))
+				signal_fd(b->clients[j + 1].fd);
+		}
+		t = get_time() - t;
+		sum += t;
+		worst = SPA_MAX(worst, t);
+
+		if (last->daemon_trans->outputs[0].buffer_id != i)
+			n_errors++;
+	}
+
+	b->stop = true;
+	for (i = 0; i < n_clients; i++) {
+		struct client *c = &b->clients[i];
+
+		signal_fd(c->fd);
+		pthread_join(c->thread, NULL);
+		close(c->fd);
+		if (c->peer)
+			pw_memblock_free(&c->peer_mem);
+		pw_client_node_transport_destroy(c->trans);
+		pw_client_node_transport_destroy(c->daemon_trans);
+	}
+	close(b->daemon_fd);
+
+	if (n_errors > 0)
+		fprintf(stderr, "%d cycles lost their buffer\n", n_errors);
+
+	*avg = (double)sum / N_CYCLES / 1000.0;
+	*max = (double)worst / 1000.0;
+	*wakeups = n_wakeups / N_CYCLES;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int lengths[] = { 1, 2, 4, 8, 16, 32 };
+	struct bench b;
+	int i;
+
+	printf("clients   daemon: avg us  max us wakeups   direct: avg us  max us wakeups\n");
+
+	for (i = 0; i < SPA_N_ELEMENTS(lengths); i++) {
+		double davg, dmax, xavg, xmax;
+		int dw, xw;
+
+		run(&b, lengths[i], false, &davg, &dmax, &dw);
+		run(&b, lengths[i], true, &xavg, &xmax, &xw);
+
+		printf("%7d %15.1f %7.1f %7d %15.1f %7.1f %7d\n", lengths[i],
+		       davg, dmax, dw, xavg, xmax, xw);
+	}
+	return 0;
+}
@@ -0,0 +1,220 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <alloca.h>
+#include <sys/eventfd.h>
+
+#include <spa/utils/defs.h>
+
+#include <extensions/client-node.h>
+
+#include "modules/module-client-node/transport.h"
+
+/* Runs the process cycle of a client node that has an input and an output,
+ * like a filter, between a daemon thread and a client thread that share
+ * a transport area.
+ *
+ * Every cycle, the daemon asks the client to process its input and its
+ * output, the client answers with need-input and have-output. With the
+ * message transport, each request is a message in the ringbuffer followed
+ * by an eventfd write. With the activation transport, requests are signal
+ * bits in the activation record and the eventfd is only written when the
+ * receiver is asleep. */
+
+#define N_CYCLES	100000
+
+struct bench {
+	uint32_t version;
+	bool stop;
+	int daemon_fd;
+	int client_fd;
+	struct pw_client_node_transport *daemon_trans;
+	struct pw_client_node_transport *client_trans;
+	int n_writes;
+	int n_messages;
+};
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static void signal_fd(struct bench *b, int fd)
+{
+	uint64_t cmd = 1;
+	if (write(fd, &cmd, 8) != 8)
+		perror("write");
+	__atomic_add_fetch(&b->n_writes, 1, __ATOMIC_SEQ_CST);
+}
+
+static void send_message(struct bench *b, struct pw_client_node_transport *trans,
+			 struct pw_client_node_activation *a, int fd,
+			 uint32_t signal, uint32_t type)
+{
+	if (b->version >= PW_CLIENT_NODE_AREA_VERSION_ACTIVATION) {
+		if (pw_client_node_activation_signal(a, signal))
+			signal_fd(b, fd);
+	} else {
+		pw_client_node_transport_add_message(trans, &PW_CLIENT_NODE_MESSAGE_INIT(type));
+		signal_fd(b, fd);
+	}
+}
+
+static uint32_t take_messages(struct bench *b, struct pw_client_node_transport *trans,
+			      struct pw_client_node_activation *a)
+{
+	struct pw_client_node_message message;
+	uint32_t signals = 0, s;
+
+	if (b->version >= PW_CLIENT_NODE_AREA_VERSION_ACTIVATION) {
+		while ((s = pw_client_node_activation_take(a)))
+			signals |= s;
+		return signals;
+	}
+
+	while (pw_client_node_transport_next_message(trans, &message) == 1) {
+		struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
+		pw_client_node_transport_parse_message(trans, msg);
+		__atomic_add_fetch(&b->n_messages, 1, __ATOMIC_SEQ_CST);
+
+		switch (PW_CLIENT_NODE_MESSAGE_TYPE(msg)) {
+		case PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT:
+			signals |= PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT;
+			break;
+		case PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT:
+			signals |= PW_CLIENT_NODE_SIGNAL_PROCESS_OUTPUT;
+			break;
+		case PW_CLIENT_NODE_MESSAGE_NEED_INPUT:
+			signals |= PW_CLIENT_NODE_SIGNAL_NEED_INPUT;
+			break;
+		case PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT:
+			signals |= PW_CLIENT_NODE_SIGNAL_HAVE_OUTPUT;
+			break;
+		}
+	}
+	return signals;
+}
+
+static void *client_thread(void *data)
+{
+	struct bench *b = data;
+	struct pw_client_node_transport *trans = b->client_trans;
+	struct pw_client_node_area *a = trans->area;
+	uint32_t signals;
+	uint64_t cmd;
+
+	while (read(b->client_fd, &cmd, 8) == 8 && !b->stop) {
+		signals = take_messages(b, trans, &a->activation);
+
+		if (signals & PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT)
+			send_message(b, trans, &a->server, b->daemon_fd,
+				     PW_CLIENT_NODE_SIGNAL_NEED_INPUT,
+				     PW_CLIENT_NODE_MESSAGE_NEED_INPUT);
+		if (signals & PW_CLIENT_NODE_SIGNAL_PROCESS_OUTPUT)
+			send_message(b, trans, &a->server, b->daemon_fd,
+				     PW_CLIENT_NODE_SIGNAL_HAVE_OUTPUT,
+				     PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT);
+	}
+	return NULL;
+}
+
+static void run(uint32_t version, double *avg, double *writes, double *messages)
+{
+	struct pw_client_node_transport_info info;
+	struct pw_client_node_area *a;
+	struct bench b;
+	pthread_t thread;
+	uint32_t done;
+	uint64_t cmd;
+	int64_t t;
+	int i;
+
+	spa_zero(b);
+	b.version = version;
+	b.daemon_fd = eventfd(0, EFD_CLOEXEC);
+	b.client_fd = eventfd(0, EFD_CLOEXEC);
+	b.daemon_trans = pw_client_node_transport_new(1, 1);
+	b.daemon_trans->area->version = version;
+	pw_client_node_transport_get_info(b.daemon_trans, &info);
+	b.client_trans = pw_client_node_transport_new_from_info(&info);
+	a = b.daemon_trans->area;
+
+	pthread_create(&thread, NULL, client_thread, &b);
+
+	t = get_time();
+	for (i = 0; i < N_CYCLES; i++) {
+		send_message(&b, b.daemon_trans, &a->activation, b.client_fd,
+			     PW_CLIENT_NODE_SIGNAL_PROCESS_INPUT,
+			     PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT);
+		send_message(&b, b.daemon_trans, &a->activation, b.client_fd,
+			     PW_CLIENT_NODE_SIGNAL_PROCESS_OUTPUT,
+			     PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT);
+
+		for (done = 0; done != (PW_CLIENT_NODE_SIGNAL_NEED_INPUT |
+					PW_CLIENT_NODE_SIGNAL_HAVE_OUTPUT);) {
+			if (read(b.daemon_fd, &cmd, 8) != 8)
+				perror("read");
+			done |= take_messages(&b, b.daemon_trans, &a->server);
+		}
+	}
+	t = get_time() - t;
+
+	b.stop = true;
+	signal_fd(&b, b.client_fd);
+	pthread_join(thread, NULL);
+
+	pw_client_node_transport_destroy(b.client_trans);
+	pw_client_node_transport_destroy(b.daemon_trans);
+	close(b.daemon_fd);
+	close(b.client_fd);
+
+	*avg = (double)t / N_CYCLES / 1000.0;
+	*writes = (double)(b.n_writes - 1) / N_CYCLES;
+	*messages = (double)b.n_messages / N_CYCLES;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		uint32_t version;
+	} modes[] = {
+		{ "messages", PW_CLIENT_NODE_AREA_VERSION_MESSAGES },
+		{ "activation", PW_CLIENT_NODE_AREA_VERSION_ACTIVATION },
+	};
+	int i;
+
+	printf("transport   cycle us  writes/cycle  messages/cycle\n");
+
+	for (i = 0; i < SPA_N_ELEMENTS(modes); i++) {
+		double avg, writes, messages;
+
+		run(modes[i].version, &avg, &writes, &messages);
+
+		printf("%-10s %9.2f %13.2f %15.2f\n", modes[i].name, avg, writes, messages);
+	}
+	return 0;
+}
@@ -0,0 +1,159 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+/* Measures the buffer memory of the links of one client, with a memfd
+ * for each link and with blocks from an arena. For each layout, N_LINKS
+ * blocks are allocated, then received and mapped like a client does, and
+ * freed again. The client gets a new fd for each block and keeps one fd
+ * and one mmap per memfd, those are counted. */
+
+#define N_LINKS		64
+#define N_RUNS		50
+
+#define FLAGS	(PW_MEMBLOCK_FLAG_WITH_FD | PW_MEMBLOCK_FLAG_MAP_READWRITE | PW_MEMBLOCK_FLAG_SEAL)
+
+struct result {
+	double alloc_us;
+	double map_us;
+	double free_us;
+	int n_fds;
+	int n_maps;
+};
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/* receive and map the blocks like the client side of a remote */
+static int map_blocks(struct spa_list *files, struct pw_memblock *mem, int n_mem,
+		      struct pw_memmap **maps)
+{
+	struct pw_memmap *map;
+	int i, n_maps = 0;
+
+	for (i = 0; i < n_mem; i++) {
+		maps[i] = pw_memmap_get(files, dup(mem[i].fd), true);
+		if (maps[i] == NULL ||
+		    pw_memmap_map(maps[i], PROT_READ | PROT_WRITE, mem[i].offset + mem[i].size) == NULL)
+			return -1;
+	}
+	spa_list_for_each(map, files, link)
+		n_maps++;
+	return n_maps;
+}
+
+static int run(struct pw_memblock_arena *arena, size_t size, struct result *res)
+{
+	struct pw_memblock mem[N_LINKS];
+	struct pw_memmap *maps[N_LINKS];
+	struct spa_list files;
+	int64_t t1, t2, t3, t4;
+	int i, j, n_maps = 0;
+
+	memset(res, 0, sizeof(struct result));
+
+	for (i = 0; i < N_RUNS; i++) {
+		t1 = get_time();
+		for (j = 0; j < N_LINKS; j++) {
+			if (arena) {
+				if (pw_memblock_arena_alloc(arena, FLAGS, 1, size, &mem[j]) < 0)
+					return -1;
+			} else {
+				if (pw_memblock_alloc(FLAGS, size, &mem[j]) < 0)
+					return -1;
+			}
+		}
+		t2 = get_time();
+		spa_list_init(&files);
+		if ((n_maps = map_blocks(&files, mem, N_LINKS, maps)) < 0)
+			return -1;
+		t3 = get_time();
+		for (j = 0; j < N_LINKS; j++) {
+			pw_memmap_unmap(maps[j]);
+			pw_memmap_put(maps[j]);
+		}
+		for (j = 0; j < N_LINKS; j++) {
+			if (arena)
+				pw_memblock_arena_free(arena, &mem[j]);
+			else
+				pw_memblock_free(&mem[j]);
+		}
+		t4 = get_time();
+
+		res->alloc_us += (t2 - t1) / 1000.0;
+		res->map_us += (t3 - t2) / 1000.0;
+		res->free_us += (t4 - t3) / 1000.0;
+	}
+	res->alloc_us /= N_RUNS * N_LINKS;
+	res->map_us /= N_RUNS * N_LINKS;
+	res->free_us /= N_RUNS * N_LINKS;
+	res->n_maps = res->n_fds = n_maps;
+
+	return 0;
+}
+
+static void print(const char *name, size_t size, const char *kind, struct result *res)
+{
+	printf("%-20s %8zd %-6s %9.2f %9.2f %9.2f %6d %6d\n", name, size, kind,
+	       res->alloc_us, res->map_us, res->free_us, res->n_fds, res->n_maps);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		size_t size;
+	} layouts[] = {
+		{ "audio 2x256 f32", 2 * (256 * 4 + 128) },
+		{ "audio 2x1024 f32", 2 * (1024 * 4 + 128) },
+		{ "audio 8x8192 f32", 8 * (8192 * 4 + 128) },
+		{ "video 4x640x480 yuy2", 4 * (640 * 480 * 2 + 128) },
+	};
+	struct pw_memblock_arena *arena;
+	struct result res;
+	int i;
+
+	arena = pw_memblock_arena_new(1024 * 1024);
+
+	printf("%d links of one client, times per link\n", N_LINKS);
+	printf("layout                   size kind    alloc us    map us   free us    fds  mmaps\n");
+	for (i = 0; i < SPA_N_ELEMENTS(layouts); i++) {
+		if (run(NULL, layouts[i].size, &res) < 0)
+			return 1;
+		print(layouts[i].name, layouts[i].size, "memfd", &res);
+		if (run(arena, layouts[i].size, &res) < 0)
+			return 1;
+		print(layouts[i].name, layouts[i].size, "arena", &res);
+	}
+	pw_memblock_arena_destroy(arena);
+
+	return 0;
+}
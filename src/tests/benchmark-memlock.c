@@ -0,0 +1,146 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <pipewire/mem.h>
+
+/* Measures the page faults of the first cycle of a client that maps the
+ * buffer memory of a link. The memory is mapped like the client side of
+ * a remote does, then every page is written once like the first cycle of
+ * the data thread. With locking, the faults are taken when the buffers
+ * are added, with a limit below the buffer size they are only faulted in. */
+
+#define N_RUNS		20
+
+#define FLAGS	(PW_MEMBLOCK_FLAG_WITH_FD | PW_MEMBLOCK_FLAG_MAP_READWRITE | PW_MEMBLOCK_FLAG_SEAL)
+
+enum mode {
+	MODE_NONE,
+	MODE_LOCK,
+	MODE_LIMIT,
+};
+
+struct result {
+	double map_us;
+	double cycle_us;
+	long map_faults;
+	long cycle_faults;
+	int locked;
+};
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static long get_faults(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_minflt + usage.ru_majflt;
+}
+
+static int run(struct pw_memblock *mem, enum mode mode, struct result *res)
+{
+	size_t i, page = sysconf(_SC_PAGESIZE);
+	struct pw_memlock lock = { 0, };
+	int64_t t1, t2, t3;
+	long f1, f2, f3;
+	uint8_t *ptr;
+	int j;
+
+	memset(res, 0, sizeof(struct result));
+
+	if (mode == MODE_LIMIT)
+		lock.limit = mem->size / 2;
+
+	for (j = 0; j < N_RUNS; j++) {
+		f1 = get_faults();
+		t1 = get_time();
+		ptr = mmap(NULL, mem->size, PROT_READ | PROT_WRITE, MAP_SHARED, mem->fd, 0);
+		if (ptr == MAP_FAILED)
+			return -1;
+		if (mode != MODE_NONE && pw_memlock_lock(&lock, ptr, mem->size) == 0)
+			res->locked++;
+		f2 = get_faults();
+		t2 = get_time();
+		for (i = 0; i < mem->size; i += page)
+			ptr[i] = i;
+		f3 = get_faults();
+		t3 = get_time();
+
+		if (lock.locked)
+			pw_memlock_unlock(&lock, ptr, mem->size);
+		munmap(ptr, mem->size);
+
+		res->map_us += (t2 - t1) / 1000.0;
+		res->cycle_us += (t3 - t2) / 1000.0;
+		res->map_faults += f2 - f1;
+		res->cycle_faults += f3 - f2;
+	}
+	res->map_us /= N_RUNS;
+	res->cycle_us /= N_RUNS;
+	res->map_faults /= N_RUNS;
+	res->cycle_faults /= N_RUNS;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		size_t size;
+	} layouts[] = {
+		{ "audio 2x1024 f32", 2 * (1024 * 4 + 128) },
+		{ "audio 8x8192 f32", 8 * (8192 * 4 + 128) },
+		{ "video 4x640x480 yuy2", 4 * (640 * 480 * 2 + 128) },
+	};
+	static const char *modes[] = { "none", "lock", "limit" };
+	struct pw_memblock mem;
+	struct result res;
+	int i, m;
+
+	printf("layout                   size mode    map us  faults  cycle us  faults locked\n");
+	for (i = 0; i < SPA_N_ELEMENTS(layouts); i++) {
+		/* the server has faulted in the pages, like the buffer pool does */
+		if (pw_memblock_alloc(FLAGS, layouts[i].size, &mem) < 0)
+			return 1;
+		memset(mem.ptr, 0, mem.size);
+
+		for (m = MODE_NONE; m <= MODE_LIMIT; m++) {
+			if (run(&mem, m, &res) < 0)
+				return 1;
+			printf("%-20s %8zd %-6s %8.2f %7ld %9.2f %7ld %3d/%d\n",
+			       layouts[i].name, layouts[i].size, modes[m],
+			       res.map_us, res.map_faults, res.cycle_us, res.cycle_faults,
+			       res.locked, N_RUNS);
+		}
+		pw_memblock_free(&mem);
+	}
+	return 0;
+}
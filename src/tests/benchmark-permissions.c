@@ -0,0 +1,264 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+/* Measures how much the permission callback is called for registry
+ * enumeration and for broadcasting new and removed globals, for a
+ * growing number of clients. The callback is the one of module-flatpak:
+ * it checks the owner of the global and, for links, walks to the nodes
+ * of both ports and checks their owners. Half of the globals are nodes,
+ * the other half links between them. Every client first makes a registry
+ * with an empty permission cache and then a second one. */
+
+#define N_GLOBALS	2000
+#define N_ADDED		100
+#define MAX_CLIENTS	300
+
+static uint32_t n_calls;
+
+static bool
+check_global_owner(struct pw_core *core, struct pw_client *client, struct pw_global *global)
+{
+	struct pw_client *owner;
+	const struct ucred *owner_ucred, *client_ucred;
+
+	if (global == NULL)
+		return false;
+
+	owner = pw_global_get_owner(global);
+	if (owner == NULL)
+		return true;
+
+	owner_ucred = pw_client_get_ucred(owner);
+	client_ucred = pw_client_get_ucred(client);
+
+	if (owner_ucred == NULL || client_ucred == NULL)
+		return true;
+
+	return owner_ucred->uid == client_ucred->uid;
+}
+
+static uint32_t
+do_permission(struct pw_global *global, struct pw_client *client, void *data)
+{
+	struct pw_core *core = data;
+
+	n_calls++;
+
+	if (pw_global_get_type(global) == core->type.link) {
+		struct pw_link *link = pw_global_get_object(global);
+		struct pw_port *port;
+		struct pw_node *node;
+
+		port = pw_link_get_output(link);
+		node = pw_port_get_node(port);
+		if (port && node && !check_global_owner(core, client, pw_node_get_global(node)))
+			 return 0;
+
+		port = pw_link_get_input(link);
+		node = pw_port_get_node(port);
+		if (port && node && !check_global_owner(core, client, pw_node_get_global(node)))
+			 return 0;
+	}
+	else if (!check_global_owner(core, client, global))
+		return 0;
+
+	return PW_PERM_RWX;
+}
+
+/* only the fields that the permission callback looks at */
+struct object {
+	struct pw_node node;
+	struct pw_port port;
+	struct pw_link link;
+};
+
+static struct pw_global *add_global(struct pw_core *core, struct pw_client *owner,
+				    struct object *objects, int i)
+{
+	struct object *o = &objects[i];
+
+	/* even globals are nodes, odd globals link the two nodes before them */
+	if (i % 2 == 0 || i < 3) {
+		o->port.node = &o->node;
+		o->node.global = pw_core_add_global(core, owner, NULL,
+						    core->type.node, 0, NULL, &o->node);
+		return o->node.global;
+	}
+	o->link.output = &objects[i - 1].port;
+	o->link.input = &objects[i - 3].port;
+	return pw_core_add_global(core, owner, NULL, core->type.link, 0, NULL, &o->link);
+}
+
+static void core_update_types(void *object, uint32_t first_id, uint32_t n_types, const char **types) { }
+static void core_done(void *object, uint32_t seq) { }
+static void core_error(void *object, uint32_t id, int res, const char *error, ...) { }
+static void core_remove_id(void *object, uint32_t id) { }
+static void core_info(void *object, struct pw_core_info *info) { }
+
+static const struct pw_core_proxy_events core_events = {
+	PW_VERSION_CORE_PROXY_EVENTS,
+	core_update_types,
+	core_done,
+	core_error,
+	core_remove_id,
+	core_info,
+};
+
+static const struct pw_protocol_marshal core_marshal = {
+	PW_TYPE_INTERFACE__Core,
+	PW_VERSION_CORE,
+	0, NULL, NULL,
+	PW_CORE_PROXY_EVENT_NUM,
+	&core_events,
+	NULL,
+};
+
+static void registry_global(void *object, uint32_t id, uint32_t parent_id,
+			    uint32_t permissions, uint32_t type, uint32_t version) { }
+static void registry_global_remove(void *object, uint32_t id) { }
+
+static const struct pw_registry_proxy_events registry_events = {
+	PW_VERSION_REGISTRY_PROXY_EVENTS,
+	registry_global,
+	registry_global_remove,
+};
+
+static const struct pw_protocol_marshal registry_marshal = {
+	PW_TYPE_INTERFACE__Registry,
+	PW_VERSION_REGISTRY,
+	0, NULL, NULL,
+	PW_REGISTRY_PROXY_EVENT_NUM,
+	&registry_events,
+	NULL,
+};
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+struct result {
+	double ms;
+	uint32_t calls;
+};
+
+static void make_registries(struct pw_client **clients, int n_clients, uint32_t id,
+			    struct result *r)
+{
+	int64_t t;
+	int i;
+
+	n_calls = 0;
+	t = get_time();
+	for (i = 0; i < n_clients; i++)
+		pw_resource_do(clients[i]->core_resource, struct pw_core_proxy_methods,
+			       get_registry, PW_VERSION_REGISTRY, id);
+	r->ms = (get_time() - t) / 1000000.0;
+	r->calls = n_calls;
+}
+
+static void run(struct pw_core *core, struct pw_protocol *protocol, int n_clients)
+{
+	struct pw_client *clients[MAX_CLIENTS];
+	struct pw_global *globals[N_GLOBALS], *added[N_ADDED];
+	static struct object objects[N_GLOBALS + N_ADDED];
+	struct result cold, warm, add, remove;
+	int64_t t;
+	int i;
+
+	for (i = 0; i < n_clients; i++) {
+		struct ucred ucred = { .pid = i + 1, .uid = 1000 + (i % 4), .gid = 1000 };
+
+		clients[i] = pw_client_new(core, &ucred, NULL, 0);
+		clients[i]->protocol = protocol;
+		pw_client_register(clients[i], NULL, NULL);
+		pw_global_bind(pw_core_get_global(core), clients[i], PW_PERM_RWX, PW_VERSION_CORE, 0);
+	}
+	for (i = 0; i < N_GLOBALS; i++)
+		globals[i] = add_global(core, clients[i % n_clients], objects, i);
+
+	make_registries(clients, n_clients, 1, &cold);
+	make_registries(clients, n_clients, 2, &warm);
+
+	n_calls = 0;
+	t = get_time();
+	for (i = 0; i < N_ADDED; i++)
+		added[i] = add_global(core, clients[0], objects, N_GLOBALS + i);
+	add.ms = (get_time() - t) / 1000000.0;
+	add.calls = n_calls;
+
+	n_calls = 0;
+	t = get_time();
+	/* links go before the nodes they point to */
+	for (i = N_ADDED - 1; i >= 0; i--)
+		pw_global_destroy(added[i]);
+	remove.ms = (get_time() - t) / 1000000.0;
+	remove.calls = n_calls;
+
+	printf("%7d  %9.3f %8u  %9.3f %8u  %9.2f %7u  %9.2f %7u\n", n_clients,
+	       cold.ms, cold.calls, warm.ms, warm.calls,
+	       add.ms * 1000.0 / N_ADDED, add.calls / N_ADDED,
+	       remove.ms * 1000.0 / N_ADDED, remove.calls / N_ADDED);
+
+	for (i = N_GLOBALS - 1; i >= 0; i--)
+		pw_global_destroy(globals[i]);
+	for (i = 0; i < n_clients; i++)
+		pw_client_destroy(clients[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	static const int n_clients[] = { 10, 50, 100, 300 };
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+	struct pw_protocol *protocol;
+	int i;
+
+	pw_init(&argc, &argv);
+
+	loop = pw_main_loop_new(NULL);
+	core = pw_core_new(pw_main_loop_get_loop(loop), NULL);
+
+	protocol = pw_protocol_new(core, "benchmark", 0);
+	pw_protocol_add_marshal(protocol, &core_marshal);
+	pw_protocol_add_marshal(protocol, &registry_marshal);
+
+	pw_core_set_permission_callback(core, do_permission, core);
+
+	printf("%d globals, registry times for all clients, add/remove per global\n", N_GLOBALS);
+	printf("clients   cold ms     calls   warm ms     calls   add us     calls  remove us   calls\n");
+
+	for (i = 0; i < SPA_N_ELEMENTS(n_clients); i++)
+		run(core, protocol, n_clients[i]);
+
+	pw_protocol_destroy(protocol);
+	pw_core_destroy(core);
+	pw_main_loop_destroy(loop);
+
+	return 0;
+}
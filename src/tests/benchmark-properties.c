@@ -0,0 +1,198 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <pipewire/properties.h>
+
+/* Builds property sets of the size that devices and nodes have and looks
+ * up keys in them, once with pw_properties_get() and once with a linear
+ * scan of the dict. Then does random sets and removes and checks that the
+ * properties and their dict stay the same as a reference. */
+
+#define N_OBJECTS	1000
+#define N_ROUNDS	20
+#define MAX_KEYS	256
+
+static int n_failed;
+
+static int64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static char *make_key(int i)
+{
+	static const char *prefix[] = {
+		"device.", "node.", "media.", "alsa.", "api.alsa.", "application.process.",
+	};
+	char *key;
+
+	asprintf(&key, "%s%s.%d", prefix[i % SPA_N_ELEMENTS(prefix)],
+		 i & 1 ? "description" : "name", i);
+	return key;
+}
+
+static void bench(int n_keys, char **keys)
+{
+	struct pw_properties **props;
+	int64_t t1, t2, t3, t4;
+	int i, j, k, n_found = 0;
+
+	props = calloc(N_OBJECTS, sizeof(struct pw_properties *));
+
+	t1 = get_time();
+	for (i = 0; i < N_OBJECTS; i++) {
+		props[i] = pw_properties_new(NULL, NULL);
+		for (j = 0; j < n_keys; j++)
+			pw_properties_setf(props[i], keys[j], "%d", i + j);
+	}
+	t2 = get_time();
+	for (k = 0; k < N_ROUNDS; k++) {
+		for (i = 0; i < N_OBJECTS; i++) {
+			for (j = 0; j < n_keys; j++)
+				n_found += pw_properties_get(props[i], keys[j]) != NULL;
+		}
+	}
+	t3 = get_time();
+	for (k = 0; k < N_ROUNDS; k++) {
+		for (i = 0; i < N_OBJECTS; i++) {
+			for (j = 0; j < n_keys; j++)
+				n_found += spa_dict_lookup(&props[i]->dict, keys[j]) != NULL;
+		}
+	}
+	t4 = get_time();
+
+	if (n_found != 2 * N_ROUNDS * N_OBJECTS * n_keys) {
+		printf("%d keys: found %d keys\n", n_keys, n_found);
+		n_failed++;
+	}
+
+	printf("%3d keys: build %6.1f ns per set, lookup %5.1f ns, linear %6.1f ns\n", n_keys,
+	       (double)(t2 - t1) / (N_OBJECTS * n_keys),
+	       (double)(t3 - t2) / (N_ROUNDS * N_OBJECTS * n_keys),
+	       (double)(t4 - t3) / (N_ROUNDS * N_OBJECTS * n_keys));
+
+	for (i = 0; i < N_OBJECTS; i++)
+		pw_properties_free(props[i]);
+	free(props);
+}
+
+static void check(struct pw_properties *props, char **keys, int *values, int n_keys)
+{
+	const char *key, *value;
+	void *state = NULL;
+	int i, n_set = 0, n_iter = 0;
+
+	for (i = 0; i < n_keys; i++) {
+		value = pw_properties_get(props, keys[i]);
+		if (values[i] == -1) {
+			if (value != NULL) {
+				printf("%s: removed but has value %s\n", keys[i], value);
+				n_failed++;
+			}
+			continue;
+		}
+		n_set++;
+		if (value == NULL || atoi(value) != values[i]) {
+			printf("%s: value %s != %d\n", keys[i], value, values[i]);
+			n_failed++;
+		}
+		if (value != spa_dict_lookup(&props->dict, keys[i])) {
+			printf("%s: dict does not match\n", keys[i]);
+			n_failed++;
+		}
+	}
+	while ((key = pw_properties_iterate(props, &state)))
+		n_iter++;
+
+	if (n_set != n_iter || n_set != props->dict.n_items) {
+		printf("%d keys set, %d iterated, %u in dict\n", n_set, n_iter, props->dict.n_items);
+		n_failed++;
+	}
+}
+
+static void test_random(char **keys)
+{
+	struct pw_properties *props, *copy;
+	int values[MAX_KEYS];
+	int i, j;
+
+	srand(4711);
+
+	for (i = 0; i < MAX_KEYS; i++)
+		values[i] = -1;
+
+	props = pw_properties_new(NULL, NULL);
+	for (i = 0; i < 100000; i++) {
+		j = rand() % MAX_KEYS;
+		if (rand() % 3 == 0) {
+			pw_properties_set(props, keys[j], NULL);
+			values[j] = -1;
+		} else {
+			pw_properties_setf(props, keys[j], "%d", i);
+			values[j] = i;
+		}
+		if (i % 1000 == 0)
+			check(props, keys, values, MAX_KEYS);
+	}
+	check(props, keys, values, MAX_KEYS);
+
+	copy = pw_properties_copy(props);
+	check(copy, keys, values, MAX_KEYS);
+
+	/* remove everything again */
+	for (i = 0; i < MAX_KEYS; i++) {
+		pw_properties_set(copy, keys[i], NULL);
+		values[i] = -1;
+	}
+	check(copy, keys, values, MAX_KEYS);
+
+	pw_properties_free(copy);
+	pw_properties_free(props);
+}
+
+int main(int argc, char *argv[])
+{
+	static const int sizes[] = { 4, 8, 16, 32, 48, 64, 128, 256 };
+	char *keys[MAX_KEYS];
+	int i;
+
+	for (i = 0; i < MAX_KEYS; i++)
+		keys[i] = make_key(i);
+
+	for (i = 0; i < SPA_N_ELEMENTS(sizes); i++)
+		bench(sizes[i], keys);
+
+	test_random(keys);
+
+	for (i = 0; i < MAX_KEYS; i++)
+		free(keys[i]);
+
+	if (n_failed > 0) {
+		printf("%d checks failed\n", n_failed);
+		return 1;
+	}
+	return 0;
+}
@@ -19,6 +19,8 @@
 
 #include <stdio.h>
 #include <signal.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <spa/lib/debug.h>
 
@@ -124,12 +126,68 @@ static const struct pw_module_proxy_events module_events = {
         .info = module_event_info,
 };
 
+#define PROFILE_PREFIX	"pipewire.node.profile."
+
+/* true when only the profile properties changed, the periodic updates of
+ * a running node */
+static bool only_profile_changed(const struct pw_node_info *old, const struct pw_node_info *info)
+{
+	const struct spa_dict_item *item, *o;
+
+	if (old == NULL || info->change_mask != PW_NODE_CHANGE_MASK_PROPS ||
+	    info->props == NULL || old->props == NULL ||
+	    spa_dict_lookup(info->props, PW_NODE_PROP_PROFILE_CYCLES) == NULL)
+		return false;
+
+	spa_dict_for_each(item, info->props) {
+		if (strncmp(item->key, PROFILE_PREFIX, strlen(PROFILE_PREFIX)) == 0)
+			continue;
+		o = spa_dict_lookup_item(old->props, item->key);
+		if (o == NULL || (o->value == NULL) != (item->value == NULL) ||
+		    (o->value && strcmp(o->value, item->value) != 0))
+			return false;
+	}
+	return true;
+}
+
+static const char *profile_value(const struct pw_node_info *info, const char *key)
+{
+	const char *str = spa_dict_lookup(info->props, key);
+	return str ? str : "-";
+}
+
+static double profile_us(const struct pw_node_info *info, const char *key)
+{
+	const char *str = spa_dict_lookup(info->props, key);
+	return str ? atoll(str) / 1000.0 : 0.0;
+}
+
+/* one line for the updates that only change the profile */
+static void print_profile(struct proxy_data *data, const struct pw_node_info *info)
+{
+	printf("profile: id %d \"%s\" cycles %s last %.1fus avg %.1fus max %.1fus "
+	       "wakeup %.1fus xruns %s\n",
+	       data->id, info->name,
+	       profile_value(info, PW_NODE_PROP_PROFILE_CYCLES),
+	       profile_us(info, PW_NODE_PROP_PROFILE_LAST),
+	       profile_us(info, PW_NODE_PROP_PROFILE_AVG),
+	       profile_us(info, PW_NODE_PROP_PROFILE_MAX),
+	       profile_us(info, PW_NODE_PROP_PROFILE_WAKEUP),
+	       profile_value(info, PW_NODE_PROP_PROFILE_XRUNS));
+}
+
 static void node_event_info(void *object, struct pw_node_info *info)
 {
         struct proxy_data *data = object;
 	bool print_all, print_mark;
 	struct pw_type *t = pw_core_get_type(data->data->core);
 
+	if (only_profile_changed(data->info, info)) {
+		info = data->info = pw_node_info_update(data->info, info);
+		print_profile(data, info);
+		return;
+	}
+
 	print_all = true;
         if (data->info == NULL) {
 		printf("added:\n");
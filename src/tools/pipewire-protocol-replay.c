@@ -0,0 +1,481 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/interfaces.h>
+
+#include "modules/module-protocol-native/connection.h"
+#include "modules/module-protocol-native/capture.h"
+
+/* Replays the messages of a capture made with PIPEWIRE_PROTOCOL_CAPTURE
+ * against a running daemon. After every message a sync is sent and the
+ * time until the done event arrives, minus the time of an empty sync,
+ * is accounted to the opcode of the message. */
+
+#define MAX_FDS		28
+#define MAX_STATS	256
+#define N_BASELINE	200
+#define SYNC_SEQ	0x40000000
+#define PLACEHOLDER_SIZE (1024 * 1024)
+
+struct stats {
+	uint32_t dest_id;
+	uint8_t opcode;
+	uint32_t count;
+	uint64_t total;
+	uint64_t max;
+};
+
+struct data {
+	int fd;
+	struct pw_protocol_native_connection *conn;
+
+	int placeholders[MAX_FDS];	/**< sent in place of the captured fds */
+	int fds[MAX_FDS];		/**< fds received from the daemon */
+	uint32_t n_fds;
+
+	uint32_t seq;
+	uint32_t n_errors;
+
+	struct stats stats[MAX_STATS];
+	uint32_t n_stats;
+};
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static int connect_daemon(const char *name)
+{
+	struct sockaddr_un addr = { 0 };
+	const char *runtime_dir;
+	int fd;
+
+	if ((runtime_dir = getenv("XDG_RUNTIME_DIR")) == NULL) {
+		fprintf(stderr, "XDG_RUNTIME_DIR not set in the environment\n");
+		return -1;
+	}
+	addr.sun_family = AF_LOCAL;
+	if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s",
+		     runtime_dir, name) >= (int) sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long\n");
+		return -1;
+	}
+	if ((fd = socket(PF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "can't connect to %s: %m\n", addr.sun_path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* fds are not captured, send a file that can be mapped in their place.
+ * The connection only sends an fd once per message, so every fd of a
+ * message gets its own copy of the file. */
+static int make_placeholders(struct data *d)
+{
+	char path[] = "/tmp/pipewire-replay-XXXXXX";
+	int fd, i;
+
+	if ((fd = mkostemp(path, O_CLOEXEC)) < 0)
+		return -1;
+	unlink(path);
+	if (ftruncate(fd, PLACEHOLDER_SIZE) < 0) {
+		close(fd);
+		return -1;
+	}
+	d->placeholders[0] = fd;
+	for (i = 1; i < MAX_FDS; i++) {
+		if ((d->placeholders[i] = fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int wait_fd(struct data *d, short events)
+{
+	struct pollfd pfd = { d->fd, events, 0 };
+
+	while (poll(&pfd, 1, -1) < 0) {
+		if (errno != EINTR)
+			return -errno;
+	}
+	if (pfd.revents & (POLLERR | POLLHUP))
+		return -EPIPE;
+	return 0;
+}
+
+static int flush(struct data *d)
+{
+	int res;
+
+	while ((res = pw_protocol_native_connection_flush(d->conn)) == -EAGAIN) {
+		if ((res = wait_fd(d, POLLOUT)) < 0)
+			return res;
+	}
+	return res;
+}
+
+static int send_message(struct data *d, uint32_t dest_id, uint8_t opcode,
+			const void *data, uint32_t size, uint32_t n_fds)
+{
+	struct spa_pod_builder *b;
+	uint32_t i;
+
+	b = pw_protocol_native_connection_begin(d->conn, dest_id, opcode);
+	for (i = 0; i < SPA_MIN(n_fds, MAX_FDS); i++)
+		pw_protocol_native_connection_add_fd(d->conn, d->placeholders[i]);
+	spa_pod_builder_raw(b, data, size);
+	pw_protocol_native_connection_end(d->conn, b);
+
+	return flush(d);
+}
+
+static int send_sync(struct data *d, uint32_t seq)
+{
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_connection_begin(d->conn, 0, PW_CORE_PROXY_METHOD_SYNC);
+	spa_pod_builder_struct(b, "i", seq);
+	pw_protocol_native_connection_end(d->conn, b);
+
+	return flush(d);
+}
+
+/* we don't use the fds of the daemon, they are closed when all messages
+ * of the read that brought them in are handled */
+static void keep_fds(struct data *d)
+{
+	uint32_t i, j;
+	int fd;
+
+	for (i = 0; (fd = pw_protocol_native_connection_get_fd(d->conn, i)) != -1; i++) {
+		for (j = 0; j < d->n_fds; j++) {
+			if (d->fds[j] == fd)
+				break;
+		}
+		if (j == d->n_fds && d->n_fds < MAX_FDS)
+			d->fds[d->n_fds++] = fd;
+	}
+}
+
+static void close_fds(struct data *d)
+{
+	while (d->n_fds > 0)
+		close(d->fds[--d->n_fds]);
+}
+
+/* read events until the done event for seq arrives */
+static int wait_done(struct data *d, uint32_t seq)
+{
+	struct spa_pod_parser prs;
+	uint8_t opcode;
+	uint32_t dest_id, size, done_seq;
+	void *message;
+	int res;
+
+	while (true) {
+		while (pw_protocol_native_connection_get_next(d->conn, &opcode, &dest_id,
+							      &message, &size)) {
+			keep_fds(d);
+
+			if (dest_id != 0)
+				continue;
+
+			if (opcode == PW_CORE_PROXY_EVENT_ERROR) {
+				d->n_errors++;
+			} else if (opcode == PW_CORE_PROXY_EVENT_DONE) {
+				spa_pod_parser_init(&prs, message, size, 0);
+				if (spa_pod_parser_get(&prs, "[ i", &done_seq, NULL) < 0 ||
+				    done_seq != seq)
+					continue;
+				return 0;
+			}
+		}
+		close_fds(d);
+
+		if ((res = wait_fd(d, POLLIN)) < 0)
+			return res;
+	}
+}
+
+static int roundtrip(struct data *d, uint64_t *time)
+{
+	uint32_t seq = SYNC_SEQ + d->seq++;
+	uint64_t t1 = get_time();
+	int res;
+
+	if ((res = send_sync(d, seq)) < 0)
+		return res;
+	if ((res = wait_done(d, seq)) < 0)
+		return res;
+
+	*time = get_time() - t1;
+	return 0;
+}
+
+static struct stats *find_stats(struct data *d, uint32_t dest_id, uint8_t opcode)
+{
+	uint32_t i;
+
+	for (i = 0; i < d->n_stats; i++) {
+		if (d->stats[i].dest_id == dest_id && d->stats[i].opcode == opcode)
+			return &d->stats[i];
+	}
+	if (d->n_stats == MAX_STATS)
+		return NULL;
+
+	d->stats[d->n_stats] = (struct stats) { dest_id, opcode, };
+	return &d->stats[d->n_stats++];
+}
+
+static int compare_stats(const void *a, const void *b)
+{
+	const struct stats *sa = a, *sb = b;
+	return sa->total < sb->total ? 1 : sa->total > sb->total ? -1 : 0;
+}
+
+static void *read_file(const char *path, size_t *size)
+{
+	FILE *f;
+	void *data = NULL;
+	long len;
+
+	if ((f = fopen(path, "r")) == NULL)
+		return NULL;
+
+	if (fseek(f, 0, SEEK_END) < 0 || (len = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET) < 0)
+		goto done;
+
+	if ((data = malloc(len)) == NULL)
+		goto done;
+
+	if (fread(data, 1, len, f) != (size_t) len) {
+		free(data);
+		data = NULL;
+		goto done;
+	}
+	*size = len;
+      done:
+	fclose(f);
+	return data;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [options] <capture file>\n"
+		"  -r, --realtime      send the messages at their original times\n"
+		"  -t, --throughput    don't sync after every message, only measure the total time\n"
+		"  -i, --incoming      replay the received messages instead of the sent ones,\n"
+		"                      for captures made in the daemon\n"
+		"  -R, --remote NAME   the remote to connect to\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option options[] = {
+		{ "realtime", no_argument, NULL, 'r' },
+		{ "throughput", no_argument, NULL, 't' },
+		{ "incoming", no_argument, NULL, 'i' },
+		{ "remote", required_argument, NULL, 'R' },
+		{ NULL, 0, NULL, 0 },
+	};
+	struct data data = { 0, }, *d = &data;
+	struct pw_protocol_native_capture_header *header;
+	struct pw_protocol_native_capture_record *rec;
+	bool realtime = false, throughput = false;
+	uint8_t direction = PW_PROTOCOL_NATIVE_CAPTURE_FLAG_OUT;
+	const char *remote = getenv("PIPEWIRE_REMOTE");
+	uint64_t baseline = 0, first = 0, start, elapsed, t;
+	uint32_t i, n_messages = 0;
+	size_t size, offset;
+	uint8_t *file;
+	int c, res;
+
+	pw_init(&argc, &argv);
+
+	while ((c = getopt_long(argc, argv, "rtiR:h", options, NULL)) != -1) {
+		switch (c) {
+		case 'r':
+			realtime = true;
+			break;
+		case 't':
+			throughput = true;
+			break;
+		case 'i':
+			direction = 0;
+			break;
+		case 'R':
+			remote = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : -1;
+		}
+	}
+	if (optind >= argc) {
+		usage(argv[0]);
+		return -1;
+	}
+
+	if ((file = read_file(argv[optind], &size)) == NULL) {
+		fprintf(stderr, "can't read %s: %m\n", argv[optind]);
+		return -1;
+	}
+	header = (struct pw_protocol_native_capture_header *) file;
+	if (size < sizeof(*header) ||
+	    header->magic != PW_PROTOCOL_NATIVE_CAPTURE_MAGIC ||
+	    header->version != PW_PROTOCOL_NATIVE_CAPTURE_VERSION) {
+		fprintf(stderr, "%s is not a protocol capture\n", argv[optind]);
+		return -1;
+	}
+
+	if (make_placeholders(d) < 0) {
+		fprintf(stderr, "can't make placeholder fds: %m\n");
+		return -1;
+	}
+	if ((d->fd = connect_daemon(remote ? remote : "pipewire-0")) < 0)
+		return -1;
+
+	/* don't capture the replay itself */
+	unsetenv("PIPEWIRE_PROTOCOL_CAPTURE");
+
+	if ((d->conn = pw_protocol_native_connection_new(d->fd)) == NULL) {
+		fprintf(stderr, "can't make connection\n");
+		return -1;
+	}
+
+	/* the cost of a sync on its own */
+	for (i = 0; i < N_BASELINE; i++) {
+		if ((res = roundtrip(d, &t)) < 0)
+			goto error;
+		baseline += t;
+	}
+	baseline /= N_BASELINE;
+
+	start = get_time();
+
+	for (offset = sizeof(*header); offset + sizeof(*rec) <= size;) {
+		void *pod;
+
+		rec = (struct pw_protocol_native_capture_record *) (file + offset);
+		pod = SPA_MEMBER(rec, sizeof(*rec), void);
+		offset += sizeof(*rec) + SPA_ROUND_UP_N(rec->size, 8);
+		if (offset > size)
+			break;
+
+		if ((rec->flags & PW_PROTOCOL_NATIVE_CAPTURE_FLAG_OUT) != direction)
+			continue;
+
+		if (realtime) {
+			uint64_t now = get_time();
+
+			if (n_messages == 0)
+				first = rec->time;
+			else if (rec->time - first > now - start) {
+				struct timespec ts;
+				t = rec->time - first - (now - start);
+				ts.tv_sec = t / SPA_NSEC_PER_SEC;
+				ts.tv_nsec = t % SPA_NSEC_PER_SEC;
+				nanosleep(&ts, NULL);
+			}
+		}
+
+		t = get_time();
+		if ((res = send_message(d, rec->dest_id, rec->opcode, pod, rec->size, rec->n_fds)) < 0)
+			goto error;
+
+		if (!throughput) {
+			struct stats *s;
+			uint32_t seq = SYNC_SEQ + d->seq++;
+
+			if ((res = send_sync(d, seq)) < 0 ||
+			    (res = wait_done(d, seq)) < 0)
+				goto error;
+
+			t = get_time() - t;
+			t = t > baseline ? t - baseline : 0;
+
+			if ((s = find_stats(d, rec->dest_id, rec->opcode)) != NULL) {
+				s->count++;
+				s->total += t;
+				s->max = SPA_MAX(s->max, t);
+			}
+		}
+		n_messages++;
+	}
+
+	/* wait until the daemon handled everything */
+	if ((res = roundtrip(d, &t)) < 0)
+		goto error;
+
+	elapsed = get_time() - start;
+
+	printf("replayed %u messages in %.3f ms, %.0f messages/s, %u errors\n",
+	       n_messages, elapsed / 1000000.0,
+	       n_messages * (double) SPA_NSEC_PER_SEC / SPA_MAX(elapsed, 1u), d->n_errors);
+	printf("sync roundtrip %.2f us\n", baseline / 1000.0);
+
+	if (!throughput) {
+		qsort(d->stats, d->n_stats, sizeof(struct stats), compare_stats);
+
+		printf("  dest  opcode   count    total ms   avg us   max us\n");
+		for (i = 0; i < d->n_stats; i++) {
+			struct stats *s = &d->stats[i];
+			printf("%6u  %6u  %6u  %10.3f  %7.2f  %7.2f\n",
+			       s->dest_id, s->opcode, s->count, s->total / 1000000.0,
+			       s->total / 1000.0 / s->count, s->max / 1000.0);
+		}
+	}
+
+	close_fds(d);
+	pw_protocol_native_connection_destroy(d->conn);
+	close(d->fd);
+	for (i = 0; i < MAX_FDS; i++)
+		close(d->placeholders[i]);
+	free(file);
+
+	return 0;
+
+      error:
+	fprintf(stderr, "replay failed: %s\n", strerror(-res));
+	return -1;
+}